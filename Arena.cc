@@ -0,0 +1,67 @@
+/*
+ * A bump allocator for the short-lived objects of a statement.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "Arena.h"
+
+using namespace std;
+
+Arena::Arena()
+  : used(0), next(NULL), end(NULL)
+{
+}
+
+Arena::~Arena()
+{
+  for (unsigned i = 0; i < blocks.size(); i++) {
+    free(blocks[i].data);
+  }
+}
+
+void* Arena::allocateBlock(size_t size)
+{
+  // reuse the first free block that is large enough
+  unsigned i = used;
+  while (i < blocks.size() && blocks[i].size < size) i++;
+  if (i == blocks.size()) {
+    Block block;
+    block.size = max(size, BLOCK_SIZE);
+    block.data = (char*) malloc(block.size);
+    blocks.push_back(block);
+  }
+  swap(blocks[used], blocks[i]);
+
+  Block& block = blocks[used++];
+  next = block.data + size;
+  end = block.data + block.size;
+  return block.data;
+}
+
+char* Arena::copy(const char* s, size_t n)
+{
+  char* p = (char*) allocate(n + 1);
+  memcpy(p, s, n);
+  p[n] = 0;
+  return p;
+}
+
+void Arena::reset()
+{
+  size_t retained = 0;
+  unsigned n = 0;
+
+  for (unsigned i = 0; i < blocks.size(); i++) {
+    if (retained + blocks[i].size > MAX_RETAINED) {
+      free(blocks[i].data);
+    } else {
+      retained += blocks[i].size;
+      blocks[n++] = blocks[i];
+    }
+  }
+  blocks.resize(n);
+  used = 0;
+  next = end = NULL;
+}
@@ -0,0 +1,76 @@
+/*
+ * A bump allocator for the short-lived objects of a statement.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Hands out memory from large blocks by moving a pointer, and frees
+ * it all at once with reset(). The arena does not destruct what it
+ * holds: plain data (tokens, conditions, lists, page buffers), or
+ * objects placed in it with new (arena.allocate(n)) T(...) whose owner
+ * calls their destructor. reset() keeps the blocks for the next
+ * statement, so a statement that fits in them mallocs nothing.
+ */
+class Arena {
+ public:
+  // the size of a block. larger requests get a block of their own.
+  static const size_t BLOCK_SIZE = 8192;
+
+  // the memory that reset() keeps for reuse
+  static const size_t MAX_RETAINED = 1 << 20;
+
+  Arena();
+  ~Arena();
+
+  /**
+   * allocate memory aligned for any plain type.
+   * @param size[IN] # bytes
+   * @return the memory. valid until reset() or the arena is destroyed
+   */
+  void* allocate(size_t size)
+  {
+    size = (size + ALIGN - 1) & ~(ALIGN - 1);
+    if ((size_t) (end - next) < size) return allocateBlock(size);
+    void* p = next;
+    next += size;
+    return p;
+  }
+
+  /**
+   * copy a string into the arena.
+   * @param s[IN] the string
+   * @param n[IN] # characters of s to copy. a NUL is added.
+   * @return the copy
+   */
+  char* copy(const char* s, size_t n);
+
+  /**
+   * free everything allocated. the blocks are kept for reuse, up to
+   * MAX_RETAINED bytes.
+   */
+  void reset();
+
+ private:
+  static const size_t ALIGN = 8;
+
+  struct Block {
+    char*  data;
+    size_t size;
+  };
+
+  std::vector<Block> blocks;  // the blocks in use, then the free ones
+  unsigned used;              // # blocks in use. the last is the current one
+  char* next;                 // the free part of the current block
+  char* end;
+
+  void* allocateBlock(size_t size);
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+};
+
+#endif /* ARENA_H */
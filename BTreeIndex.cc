@@ -9,6 +9,9 @@
  
 #include "BTreeIndex.h"
 #include "BTreeNode.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 
@@ -29,9 +32,9 @@ BTreeIndex::BTreeIndex()
  * @param mode[IN] 'r' for read, 'w' for write
  * @return error code. 0 if no error
  */
-RC BTreeIndex::open(const string& indexname, char mode)
+RC BTreeIndex::open(const string& indexname, char mode, bool compress)
 {
-    RC rc = pf.open(indexname, mode);
+    RC rc = pf.open(indexname, mode, compress);
     if (rc)
         return rc;
     
@@ -67,10 +70,10 @@ RC BTreeIndex::open(const string& indexname, char mode)
 }
 
 /*
- * Close the index file.
+ * Write the header of the index, if the tree changed since it was written.
  * @return error code. 0 if no error
  */
-RC BTreeIndex::close()
+RC BTreeIndex::flush()
 {
     // this code puts all the information back into the page file. 
     // the problem with this code may be that there are atomicity issues in the future. 
@@ -78,17 +81,37 @@ RC BTreeIndex::close()
     // so we don't want to guarantee that our code will remain this way. 
     RC rc;
     char buffer[PageFile::PAGE_SIZE]; 
-    rc = pf.read(0, buffer);
-    if (rc)
+    if (pf.endPid() == 0)
+        memset(buffer, 0, PageFile::PAGE_SIZE);
+    else if ((rc = pf.read(0, buffer)) < 0)
         return rc;   
     
     Header* header = (Header *)buffer; 
-    header->initialized = true;
-    header->treeHeight = treeHeight;
-    header->rootPid = rootPid;
-    rc = pf.write(0, buffer);
+    if (!header->initialized || header->treeHeight != treeHeight ||
+        header->rootPid != rootPid)
+    {
+        // only rewrite the header if the tree has changed. this also
+        // keeps us from writing to an index opened in 'r' mode.
+        header->initialized = true;
+        header->treeHeight = treeHeight;
+        header->rootPid = rootPid;
+        return pf.write(0, buffer);
+    }
+    return 0;
+}
+
+/*
+ * Close the index file.
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::close()
+{
+    RC rc = flush();
     if (rc)
+    {
+        pf.close();
         return rc;
+    }
     return pf.close();
 }
 
@@ -100,6 +123,8 @@ RC BTreeIndex::close()
  */
 RC BTreeIndex::insert(int key, const RecordId& rid)
 {
+    RC rc;
+
     if (treeHeight == 0) {
         //initialize a new tree
         // we assume a new tree will have its root be a leaf. 
@@ -107,7 +132,7 @@ RC BTreeIndex::insert(int key, const RecordId& rid)
         rootPid = 1;
         treeHeight = 1;
         root.insert(key, rid);
-        root.write(rootPid, pf);
+        return root.write(rootPid, pf);
     } else {
         IndexCursor cursor;
         vector<PageId> path;
@@ -116,75 +141,54 @@ RC BTreeIndex::insert(int key, const RecordId& rid)
         PageId leafId = path.back();
         path.pop_back();
         BTLeafNode leaf;
-        leaf.read(leafId, pf);
+        if ((rc = leaf.read(leafId, pf)) < 0) return rc;
 
 
         if (leaf.insert(key, rid)) { 
             BTLeafNode sibling;
             int siblingKey;
-			sibling.read(pf.endPid(), pf);
+            PageId siblingId = pf.endPid();
+            sibling.read(siblingId, pf);
             leaf.insertAndSplit(key, rid, sibling, siblingKey);
 
             // save the new leaves. 
-            leaf.write(leaf.getPid(), pf);
-            sibling.write(pf.endPid(), pf);
-
-            BTNonLeafNode parent;
-
-            if (path.empty())
-            {
-                // creates the first nonleaf root. 
-                PageId new_root_id = pf.endPid();
-                BTNonLeafNode new_root;
-                treeHeight++;
-                rootPid = new_root_id;
-                new_root.read(new_root_id, pf);
-                new_root.initializeRoot(leafId, siblingKey, sibling.getPid());
-                new_root.write(new_root_id, pf);
-            }
-            else
-            {
-                // propogate up the new key to add into stuff. 
+            if ((rc = leaf.write(leafId, pf)) < 0) return rc;
+            if ((rc = sibling.write(siblingId, pf)) < 0) return rc;
+
+            // propagate the (siblingKey, siblingId) pair up the tree
+            // until a parent has room for it.
+            PageId leftId = leafId;
+            while (!path.empty()) {
                 PageId parentId = path.back(); 
                 path.pop_back();
-                parent.read(parentId, pf);
-            
-                // we need to insert the sibling's key into the parent. 
-                while (parent.insert(siblingKey, sibling.getPid())) {
-                    BTNonLeafNode siblingNonLeaf;
-                    int midKey;
-                    parent.insertAndSplit(siblingKey, sibling.getPid(), siblingNonLeaf, midKey);
-
-                    parent.write(parentId, pf);
-                    PageId siblingId = pf.endPid();
-                    siblingNonLeaf.write(siblingId, pf);
-
-                    if (path.empty()) {
-                        //leaf is old root node, 
-                        //need to increase tree height,
-                        //create new root node
-                        //update first page in pagefile to say where new root node is
-                        BTNonLeafNode newRoot;
-                        PageId newRootId = pf.endPid();
-                        treeHeight++;
-                        rootPid = newRootId;
-                        newRoot.write(newRootId, pf);
-                        newRoot.initializeRoot(parentId, midKey, siblingId);
-                        break;
-                    } else {
-                        // we still have parents to go up to. 
-                        // and we still have to split. 
-                        siblingKey = midKey;
-                        parentId = path.back();
-                        path.pop_back();
-
-                        parent.read(parentId, pf);
-                    }
+                BTNonLeafNode parent;
+                if ((rc = parent.read(parentId, pf)) < 0) return rc;
+
+                if (parent.insertBehind(leftId, siblingKey, siblingId) == 0) {
+                    return parent.write(parentId, pf);
                 }
-            parent.write(parentId, pf);
+
+                BTNonLeafNode siblingNonLeaf;
+                int midKey;
+                parent.insertBehindAndSplit(leftId, siblingKey, siblingId, siblingNonLeaf, midKey);
+
+                PageId siblingNonLeafId = pf.endPid();
+                if ((rc = parent.write(parentId, pf)) < 0) return rc;
+                if ((rc = siblingNonLeaf.write(siblingNonLeafId, pf)) < 0) return rc;
+
+                siblingKey = midKey;
+                siblingId = siblingNonLeafId;
+                leftId = parentId;
             }
+
+            // the old root was split. create a new root above it. 
+            BTNonLeafNode newRoot;
+            newRoot.initializeRoot(leftId, siblingKey, siblingId);
+            rootPid = pf.endPid();
+            treeHeight++;
+            return newRoot.write(rootPid, pf);
         } else {
-            leaf.write(leaf.getPid(), pf);
+            return leaf.write(leafId, pf);
         }
     }
     return 0;
@@ -211,7 +215,13 @@ RC BTreeIndex::insert(int key, const RecordId& rid)
 RC BTreeIndex::locate(int searchKey, IndexCursor& cursor)
 {
     vector<PageId> path;
-  //  fprintf(stdout, "rootpid: %d, searchKey: %d\n", rootPid, searchKey);
+    if (treeHeight == 0) {
+        // the tree is empty. readForward() will report the end of tree.
+        cursor.pid = -1;
+        cursor.eid = 0;
+        return RC_NO_SUCH_RECORD;
+    }
+    path.reserve(treeHeight);
     return locate(searchKey, cursor, rootPid, 1, path);
 }
 
@@ -240,10 +250,7 @@ RC BTreeIndex::locate(int searchKey, IndexCursor& cursor,
         leaf.read(cur_page, pf);
         
         int eid;
-        int key; 
-        RecordId rid;
         RC val = leaf.locate(searchKey, eid);
-        leaf.readEntry(eid, key, rid);
 
         cursor.pid = cur_page;
         cursor.eid = eid;
@@ -269,18 +276,135 @@ RC BTreeIndex::locate(int searchKey, IndexCursor& cursor,
 RC BTreeIndex::readForward(IndexCursor& cursor, int& key, RecordId& rid)
 {
     BTLeafNode leaf;
-    leaf.read(cursor.pid, pf);
-    RC successfulRead = leaf.readEntry(cursor.eid, key, rid);
+    RC rc;
+
+    if (cursor.pid < 0)
+        return RC_END_OF_TREE;
+    if ((rc = leaf.read(cursor.pid, pf)) < 0)
+        return rc;
+
+    // the cursor may point right behind the last entry of a leaf
+    // (e.g., after locate()). move on to the next leaf in that case.
+    while (cursor.eid >= leaf.getKeyCount()) {
+        cursor.pid = leaf.getNextNodePtr();
+        cursor.eid = 0;
+        if (cursor.pid < 0)
+            return RC_END_OF_TREE;
+        if ((rc = leaf.read(cursor.pid, pf)) < 0)
+            return rc;
+    }
+
+    if ((rc = leaf.readEntry(cursor.eid, key, rid)) < 0)
+        return rc;
+
     cursor.eid++;
-    if ( cursor.eid >= leaf.getKeyCount()-1) {
-		//fprintf(stdout, "before locate, cursor.eid: %d, cursor.pid: %d, leaf.getKeyCount() = %d\n", cursor.eid, cursor.pid, leaf.getKeyCount());
-		//locate(key + 1, cursor);
-		//fprintf(stdout, "after locate(%d, cursor), new cursor.eid = %d, new cursor.pid = %d\n", key + 1, cursor.eid, cursor.pid);
-		cursor.pid = leaf.getNextNodePtr();
-		
-		if (cursor.pid == -1)
-            return 1;
+    if (cursor.eid >= leaf.getKeyCount() && leaf.getNextNodePtr() >= 0) {
+        cursor.pid = leaf.getNextNodePtr();
         cursor.eid = 0;
     }
-    return successfulRead;
+    return 0;
+}
+
+/*
+ * Read up to n (key, rid) pairs starting at the index cursor, and move
+ * forward the cursor behind them. Each leaf node is read once.
+ * @param cursor[IN/OUT] the cursor pointing to an leaf-node index entry in the b+tree
+ * @param n[IN] the maximum # pairs to read
+ * @param keys[OUT] the keys read
+ * @param rids[OUT] the RecordIds read
+ * @param count[OUT] the # pairs read
+ * @return 0 if n pairs were read. RC_END_OF_TREE if the end of the tree
+ *         was reached. Otherwise an error code.
+ */
+RC BTreeIndex::readBatch(IndexCursor& cursor, int n, int keys[], RecordId rids[], int& count)
+{
+    BTLeafNode leaf;
+    RC rc;
+
+    count = 0;
+    while (count < n) {
+        if (cursor.pid < 0)
+            return RC_END_OF_TREE;
+        if ((rc = leaf.read(cursor.pid, pf)) < 0)
+            return rc;
+
+        int n_keys = leaf.getKeyCount();
+        while (cursor.eid < n_keys && count < n) {
+            leaf.readEntry(cursor.eid++, keys[count], rids[count]);
+            count++;
+        }
+        if (cursor.eid >= n_keys) {
+            cursor.pid = leaf.getNextNodePtr();
+            cursor.eid = 0;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Split the key range [minKey, maxKey] into up to n disjoint sub-ranges
+ * using the separator keys of the internal nodes.
+ * @param minKey[IN] the smallest key of the range
+ * @param maxKey[IN] the largest key of the range
+ * @param n[IN] the maximum # sub-ranges
+ * @param splits[OUT] the keys that start the second and later sub-ranges
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::partition(int minKey, int maxKey, int n, vector<int>& splits)
+{
+    RC rc;
+    vector<PageId> nodes(1, rootPid);
+    vector<int> keys;
+
+    splits.clear();
+    if (n <= 1 || treeHeight <= 1 || minKey >= maxKey)
+        return 0;
+
+    // walk down the internal levels, keeping the nodes that overlap the
+    // range, until a level has enough separator keys inside the range
+    for (int level = 1; level < treeHeight; level++) {
+        vector<PageId> children;
+        keys.clear();
+
+        for (unsigned j = 0; j < nodes.size(); j++) {
+            BTNonLeafNode node;
+            if ((rc = node.read(nodes[j], pf)) < 0)
+                return rc;
+
+            // child i holds the keys between key i-1 and key i
+            PageId child = node.getFirstChildPtr();
+            int    prev = INT_MIN;
+            for (int i = 0; i < node.getKeyCount(); i++) {
+                int    key;
+                PageId next;
+                node.readEntry(i, key, next);
+                if (prev <= maxKey && key >= minKey)
+                    children.push_back(child);
+                if (key > minKey && key <= maxKey)
+                    keys.push_back(key);
+                prev = key;
+                child = next;
+            }
+            if (prev <= maxKey)
+                children.push_back(child);
+        }
+
+        if ((int) keys.size() >= n - 1 || level == treeHeight - 1)
+            break;
+        nodes.swap(children);
+    }
+
+    // duplicate keys may repeat a separator. pick n-1 evenly spaced ones.
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    int k = keys.size();
+    if (k <= n - 1) {
+        splits = keys;
+        return 0;
+    }
+    for (int i = 1; i < n; i++) {
+        int key = keys[(long long) i * k / n];
+        if (splits.empty() || splits.back() < key)
+            splits.push_back(key);
+    }
+    return 0;
 }
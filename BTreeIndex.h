@@ -48,9 +48,19 @@ class BTreeIndex {
    * Under 'w' mode, the index file should be created if it does not exist.
    * @param indexname[IN] the name of the index file
    * @param mode[IN] 'r' for read, 'w' for write
+   * @param compress[IN] whether a file created by this call stores its
+   *                     pages compressed (see PageFile)
    * @return error code. 0 if no error
    */
-  RC open(const std::string& indexname, char mode);
+  RC open(const std::string& indexname, char mode, bool compress = false);
+
+  /**
+   * Write the header of the index (its root and height) if the tree
+   * changed since it was written. A LOAD batch writes it before it
+   * commits, so that the committed tree is complete.
+   * @return error code. 0 if no error
+   */
+  RC flush();
 
   /**
    * Close the index file.
@@ -97,6 +107,51 @@ class BTreeIndex {
    */
   RC readForward(IndexCursor& cursor, int& key, RecordId& rid);
   RC readCurrent(IndexCursor& cursor, int& key, RecordId& rid);
+
+  /**
+   * Read up to n (key, rid) pairs starting at the index cursor, and move
+   * forward the cursor behind them. Each leaf node is read once.
+   * @param cursor[IN/OUT] the cursor pointing to an leaf-node index entry in the b+tree
+   * @param n[IN] the maximum # pairs to read
+   * @param keys[OUT] the keys read
+   * @param rids[OUT] the RecordIds read
+   * @param count[OUT] the # pairs read
+   * @return 0 if n pairs were read. RC_END_OF_TREE if the end of the tree
+   *         was reached. Otherwise an error code.
+   */
+  RC readBatch(IndexCursor& cursor, int n, int keys[], RecordId rids[], int& count);
+
+  /**
+   * Split the key range [minKey, maxKey] into up to n disjoint sub-ranges
+   * holding about the same number of entries, so that the sub-ranges can
+   * be read by separate cursors. The split keys are the separator keys of
+   * the highest level of internal nodes that has enough of them in the
+   * range. Sub-range i is [splits[i-1], splits[i]-1], where the first
+   * sub-range starts at minKey and the last one ends at maxKey.
+   * @param minKey[IN] the smallest key of the range
+   * @param maxKey[IN] the largest key of the range
+   * @param n[IN] the maximum # sub-ranges
+   * @param splits[OUT] the increasing keys in (minKey, maxKey] that start
+   *                    the second and later sub-ranges. empty if the range
+   *                    is not split.
+   * @return error code. 0 if no error
+   */
+  RC partition(int minKey, int maxKey, int n, std::vector<int>& splits);
+
+  /**
+   * @return the height of the tree. 0 if the tree is empty
+   */
+  int getTreeHeight() const { return treeHeight; }
+
+  /**
+   * @return the # of pages in the index file
+   */
+  PageId getPageCount() const { return pf.endPid(); }
+
+  /**
+   * @return the PageFile storing the tree (for its read statistics)
+   */
+  const PageFile& getPageFile() const { return pf; }
   
  private:
   PageFile pf;         /// the PageFile used to store the actual b+tree in disk
@@ -1,15 +1,19 @@
 #include "BTreeNode.h"
+#include <cstring>
 #include <iostream>
 #include <fstream>
 
 using namespace std;
 
 BTLeafNode::BTLeafNode() {
+    // the unused part of a node is kept zero so that it compresses
+    memset(buffer, 0, sizeof(buffer));
     LeafNodeHeader* header = (LeafNodeHeader*) buffer;
     header->num_keys = 0;
 }
 
 BTLeafNode::BTLeafNode(PageId prev, PageId next) {
+    memset(buffer, 0, sizeof(buffer));
     LeafNodeHeader* header = (LeafNodeHeader*) buffer;
     header->previous_page = prev;
     header->next_page = next;
@@ -96,7 +100,7 @@ RC BTLeafNode::insert(int key, const RecordId& rid)
 {
     LeafNodeHeader * header = (LeafNodeHeader*) buffer; 
     int n_keys = header->num_keys;
-    if ( n_keys >= MAX_LEAF_PAIRS )
+    if ( n_keys >= (int) MAX_LEAF_PAIRS )
         return RC_NODE_FULL;
 
     LeafPair tmp_pair; 
@@ -145,25 +149,19 @@ RC BTLeafNode::insert(int key, const RecordId& rid)
 RC BTLeafNode::insertAndSplit(int key, const RecordId& rid, 
                               BTLeafNode& sibling, int& siblingKey)
 {
-    // force sibling to be empty
-//    BTLeafNode node;
-//    sibling = node;
-    
     int n_keys = getKeyCount();
     if (n_keys != MAX_LEAF_PAIRS) {
         return 1;   //todo: get correct error code
     }
+
+    // after the split this node keeps the first half of the n_keys + 1
+    // entries and the sibling gets the rest.
+    int half = (n_keys + 1) / 2;
     int loc;
-    RC val = locate(key, loc);
-    if (val == 0) {
-        return 1; // todo: we found it for some weird reason get correct error code
-    }
-    
-    if (loc <= n_keys/2) {
-        LeafPair* orig_pair = (LeafPair*) (buffer + byteIndexOf(n_keys/2));
-        sibling.insert(orig_pair->key, orig_pair->rid);
-    }
-    for (int i = n_keys/2 + 1; i < n_keys; i++) {
+    locate(key, loc);
+    int keep = (loc < half) ? half - 1 : half;
+
+    for (int i = keep; i < n_keys; i++) {
         LeafPair* orig_pair = (LeafPair*) (buffer + byteIndexOf(i));
         sibling.insert(orig_pair->key, orig_pair->rid);
     }
@@ -173,16 +171,15 @@ RC BTLeafNode::insertAndSplit(int key, const RecordId& rid,
     sibling.setPrevNodePtr(header->pid);
     sibling.setNextNodePtr(header->next_page);    
     
-    header->num_keys = n_keys/2 + (loc <= n_keys/2);
+    header->num_keys = keep;
     header->next_page = sibling.getPid();
- //   fprintf(stdout, "pointer from: %d -> %d\t", header->pid, header->next_page);
- //   fprintf(stdout, "pointer from: %d -> %d\n", sibling.getPid(), sibling.getNextNodePtr());
+    memset(buffer + byteIndexOf(keep), 0, byteIndexOf(n_keys) - byteIndexOf(keep));
     
     //insert new value
-    (loc <= n_keys/2) ? insert(key, rid) : sibling.insert(key, rid);    
+    (loc < half) ? insert(key, rid) : sibling.insert(key, rid);    
 
     RecordId r;
-    val = sibling.readEntry(0, siblingKey, r);
+    sibling.readEntry(0, siblingKey, r);
     return 0;
 }
 
@@ -344,134 +341,155 @@ int BTNonLeafNode::getKeyCount()
  */
 RC BTNonLeafNode::insert(int key, PageId pid)
 {
-    NonLeafHeader * header = (NonLeafHeader*) buffer; 
-    int n_keys = header->num_keys;
-    if ( n_keys >= MAX_NONLEAF_PAIRS )
-        return RC_NODE_FULL;
+    return insertAt(positionOf(key), key, pid);
+}
 
-    NodePair tmp_pair; 
+/*
+ * Insert a (key, pid) pair right behind the child-node pointer left.
+ * @param left[IN] the child node that pid was split from
+ * @param key[IN] the key to insert
+ * @param pid[IN] the PageId to insert
+ * @return 0 if successful. Return an error code if the node is full.
+ */
+RC BTNonLeafNode::insertBehind(PageId left, int key, PageId pid)
+{
+    return insertAt(positionBehind(left, key), key, pid);
+}
 
-    NodePair storage_pair;
-    storage_pair.pid = pid;
-    storage_pair.key = key;
+/*
+ * Insert the (key, pid) pair to the node
+ * and split the node half and half with sibling.
+ * The middle key after the split is returned in midKey.
+ * @param key[IN] the key to insert
+ * @param pid[IN] the PageId to insert
+ * @param sibling[IN] the sibling node to split with. This node MUST be empty when this function is called.
+ * @param midKey[OUT] the key in the middle after the split. This key should be inserted to the parent node.
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, int& midKey)
+{
+    return insertAtAndSplit(positionOf(key), key, pid, sibling, midKey);
+}
 
-    // TODO: assuming the case that insert is only ever called when there's a lower overflow
-    // will there ever be a case where we insert something that requires changing the 
-    // first_pid? i don't think so for leaf. 
-    // what about non-leaf overflow? potentially actually. 
-    // how to deal with this case? i'll try a hacky solution for now so that it doesn't. 
-    NodePair* pair; 
+/*
+ * Insert the (key, pid) pair right behind the child-node pointer left
+ * and split the node half and half with sibling.
+ * @param left[IN] the child node that pid was split from
+ * @param key[IN] the key to insert
+ * @param pid[IN] the PageId to insert
+ * @param sibling[IN] the sibling node to split with. This node MUST be empty when this function is called.
+ * @param midKey[OUT] the key in the middle after the split. This key should be inserted to the parent node.
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTNonLeafNode::insertBehindAndSplit(PageId left, int key, PageId pid,
+                                       BTNonLeafNode& sibling, int& midKey)
+{
+    return insertAtAndSplit(positionBehind(left, key), key, pid, sibling, midKey);
+}
+
+/*
+ * Return the position to insert a pair with the key at:
+ * behind all pairs with keys not larger than key.
+ */
+int BTNonLeafNode::positionOf(int key)
+{
+    int n_keys = getKeyCount();
     for (int i = 0; i < n_keys; i++)
     {
-        pair = (NodePair*) (buffer + byteIndexOf(i));
-        if ( pair->key > storage_pair.key )
-        {
-            tmp_pair.key = pair->key;
-            tmp_pair.pid = pair->pid;
-
-            pair->key = storage_pair.key;
-            pair->pid = storage_pair.pid;
+        NodePair* pair = (NodePair*) (buffer + byteIndexOf(i));
+        if (pair->key > key)
+            return i;
+    }
+    return n_keys;
+}
 
-            // can we just do "storage_pair = tmp_pair;"? 
-            storage_pair.key = tmp_pair.key;
-            storage_pair.pid = tmp_pair.pid;
-        }
+/*
+ * Return the position right behind the child-node pointer left.
+ * When there are duplicate keys, several positions keep the keys sorted
+ * but only this one keeps the children in the order of the leaf chain.
+ */
+int BTNonLeafNode::positionBehind(PageId left, int key)
+{
+    if (getFirstChildPtr() == left)
+        return 0;
+    for (int i = 0; i < getKeyCount(); i++)
+    {
+        NodePair* pair = (NodePair*) (buffer + byteIndexOf(i));
+        if (pair->pid == left)
+            return i + 1;
     }
+    return positionOf(key);
+}
 
-    /* TODO: CHECK HOW THE POINTERS WORK. 
-        BECAUSE OF LAST PID. Like do pointers have to shift? 
-        I feel like it does. */
+/*
+ * Insert the (key, pid) pair as the pos-th pair of the node.
+ */
+RC BTNonLeafNode::insertAt(int pos, int key, PageId pid)
+{
+    NonLeafHeader * header = (NonLeafHeader*) buffer; 
+    int n_keys = header->num_keys;
+    if ( n_keys >= (int) MAX_NONLEAF_PAIRS )
+        return RC_NODE_FULL;
 
-    pair = (NodePair*)(buffer + byteIndexOf(n_keys));
-    pair->key = storage_pair.key;
-    pair->pid = storage_pair.pid;
+    memmove(buffer + byteIndexOf(pos + 1), buffer + byteIndexOf(pos),
+            (n_keys - pos) * sizeof(NodePair));
+    NodePair* pair = (NodePair*) (buffer + byteIndexOf(pos));
+    pair->key = key;
+    pair->pid = pid;
 
     header->num_keys++;
-
     return 0; 
 }
 
 /*
- * Insert the (key, pid) pair to the node
+ * Insert the (key, pid) pair as the pos-th pair of the node
  * and split the node half and half with sibling.
- * The middle key after the split is returned in midKey.
- * @param key[IN] the key to insert
- * @param pid[IN] the PageId to insert
- * @param sibling[IN] the sibling node to split with. This node MUST be empty when this function is called.
- * @param midKey[OUT] the key in the middle after the split. This key should be inserted to the parent node.
- * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, int& midKey)
+RC BTNonLeafNode::insertAtAndSplit(int pos, int key, PageId pid,
+                                   BTNonLeafNode& sibling, int& midKey)
 {
-    // force sibling to be empty
-    // BTLeafNode node;  
-    // sibling = node;
-    
     int n_keys = getKeyCount();
     if (n_keys != MAX_NONLEAF_PAIRS) {
         return 1;   
     }
 
-    int loc;
-    //RC val = locate(key, loc); // TODO: do we need to implement something similar? 
-
-    for (int i = 0; i < getKeyCount(); i++)
+    // lay out all n_keys + 1 pairs in order first
+    NodePair pairs[MAX_NONLEAF_PAIRS + 1];
+    int n = 0;
+    for (int i = 0; i < n_keys; i++)
     {
-        NodePair* pair = (NodePair*) (buffer + byteIndexOf(i));
-        if (key >= pair->key) // equal case shouldn't ever trigger. 
+        if (i == pos)
         {
-            loc = i;
-            break;
+            pairs[n].key = key;
+            pairs[n++].pid = pid;
         }
+        pairs[n++] = *(NodePair*) (buffer + byteIndexOf(i));
     }
-    
-
-    if (loc == (n_keys + 1) / 2)
+    if (pos >= n_keys)
     {
-        midKey = key;
-        NodePair* pair = (NodePair*) (buffer + byteIndexOf((n_keys + 1)/2));
-        sibling.initializeRoot(pid, pair->key, pair->pid);
-        
-        NodePair* next_pair = (NodePair*) (buffer + byteIndexOf((n_keys+1)/2 + 1));
-        sibling.insert(next_pair->key, next_pair->pid);
+        pairs[n].key = key;
+        pairs[n++].pid = pid;
     }
-    else if (loc < (n_keys + 1) / 2)
-    {
-        NodePair* mid_pair = (NodePair*) (buffer + byteIndexOf((n_keys + 1)/2 - 1));
-        midKey = mid_pair->key;
 
-        NodePair* orig_pair = (NodePair*) (buffer + byteIndexOf((n_keys + 1)/2));
-        sibling.initializeRoot(mid_pair->pid, orig_pair->key, orig_pair->pid);
+    // the first half stays here, the middle key moves up to the parent,
+    // and its pid becomes the first pid of the sibling.
+    int mid = n / 2;
+    midKey = pairs[mid].key;
 
-        NodePair* next_pair = (NodePair*) (buffer + byteIndexOf((n_keys+1)/2 + 1));
-        sibling.insert(next_pair->key, next_pair->pid);
-    }
-    else
+    NonLeafHeader* header = (NonLeafHeader*) buffer;
+    for (int i = 0; i < mid; i++)
     {
-        NodePair* mid_pair = (NodePair*) (buffer + byteIndexOf((n_keys + 1)/2));
-        midKey = mid_pair->key;
-
-        NodePair* moved_pair = (NodePair*) (buffer + byteIndexOf((n_keys+1)/2 + 1));
-        sibling.initializeRoot(mid_pair->pid, moved_pair->key, moved_pair->pid);
-        sibling.insert(key, pid); // insert the new pair into sibling. 
+        NodePair* pair = (NodePair*) (buffer + byteIndexOf(i));
+        *pair = pairs[i];
     }
-    
-    // TODO: here, we are using insert as if we are inserting the pid before the key. 
-    //       however, I am not sure if this is the correct usage right now. 
-    // TODO: check how insertion works in this case. 
-    //       I have a feeling we remove the key returned up. 
-    LeafNodeHeader* header = (LeafNodeHeader*) buffer;
-    for (int i = (n_keys + 1)/2 + 2; i < n_keys; i++) 
+    header->num_keys = mid;
+    memset(buffer + byteIndexOf(mid), 0, byteIndexOf(n_keys) - byteIndexOf(mid));
+
+    sibling.initializeRoot(pairs[mid].pid, pairs[mid + 1].key, pairs[mid + 1].pid);
+    for (int i = mid + 2; i < n; i++)
     {
-        NodePair* orig_pair = (NodePair*) (buffer + byteIndexOf(i));
-        sibling.insert(orig_pair->key, orig_pair->pid);
-        header->num_keys--;
+        sibling.insertAt(i - mid - 1, pairs[i].key, pairs[i].pid);
     }
-
-    
-    if (loc < header->num_keys)
-        insert(key, pid); // insert the new pair into us. 
-    
     return 0;
 }
 
@@ -484,8 +502,11 @@ RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, in
  */
 RC BTNonLeafNode::locateChildPtr(int searchKey, PageId& pid)
 {
+    // a key equal to a separator may also be stored at the end of the
+    // child in front of the separator (duplicate keys split across two
+    // leaves), so follow the leftmost child that may hold searchKey.
     NodePair* pair = (NodePair*) (buffer + byteIndexOf(0));
-    if (searchKey < pair->key)
+    if (searchKey <= pair->key)
     {
         NonLeafHeader* header = (NonLeafHeader*) buffer; 
         pid = header->first_pid;
@@ -494,16 +515,47 @@ RC BTNonLeafNode::locateChildPtr(int searchKey, PageId& pid)
     for (int i = 1; i < getKeyCount(); i++)
     {
         pair = (NodePair*) (buffer + byteIndexOf(i));
-        if ( searchKey < pair->key )
+        if ( searchKey <= pair->key )
         {
             NodePair* prev_pair = (NodePair*) (buffer + byteIndexOf(i-1));
             pid = prev_pair->pid;
             return 0;
         }
     }
+    // searchKey is larger than every key. follow the last pointer.
+    pair = (NodePair*) (buffer + byteIndexOf(getKeyCount() - 1));
+    pid = pair->pid;
     return 0;
 }
 
+/*
+ * Read the i-th key of the node and the child-node pointer behind it.
+ * @param i[IN] the key number between 0 and getKeyCount()-1
+ * @param key[OUT] the i-th key
+ * @param pid[OUT] the child node holding the keys from the i-th key on
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTNonLeafNode::readEntry(int i, int& key, PageId& pid)
+{
+    if ( i < 0 || i >= getKeyCount() )
+        return RC_INVALID_CURSOR;
+
+    NodePair* pair = (NodePair*) (buffer + byteIndexOf(i));
+    key = pair->key;
+    pid = pair->pid;
+    return 0;
+}
+
+/*
+ * Return the child-node pointer in front of the first key.
+ * @return the PageId of the first child node
+ */
+PageId BTNonLeafNode::getFirstChildPtr()
+{
+    NonLeafHeader* header = (NonLeafHeader*) buffer;
+    return header->first_pid;
+}
+
 /*
  * Initialize the root node with (pid1, key, pid2).
  * @param pid1[IN] the first PageId to insert
@@ -513,6 +565,7 @@ RC BTNonLeafNode::locateChildPtr(int searchKey, PageId& pid)
  */
 RC BTNonLeafNode::initializeRoot(PageId pid1, int key, PageId pid2)
 {
+    memset(buffer, 0, sizeof(buffer));
     NonLeafHeader* header = (NonLeafHeader*) buffer; 
     header->num_keys = 1;
     header->first_pid = pid1;
@@ -44,8 +44,8 @@ typedef struct {
   PageId pid; 
 } NodePair; // 8 bytes each.  
 
-#define MAX_LEAF_PAIRS (PageFile::PAGE_SIZE - sizeof(LeafNodeHeader)) / sizeof(LeafPair)
-#define MAX_NONLEAF_PAIRS (PageFile::PAGE_SIZE - sizeof(NonLeafHeader)) / sizeof(NodePair)
+#define MAX_LEAF_PAIRS ((PageFile::PAGE_SIZE - sizeof(LeafNodeHeader)) / sizeof(LeafPair))
+#define MAX_NONLEAF_PAIRS ((PageFile::PAGE_SIZE - sizeof(NonLeafHeader)) / sizeof(NodePair))
 
 /**
  * BTLeafNode: The class representing a B+tree leaf node.
@@ -174,6 +174,17 @@ class BTNonLeafNode {
     */
     RC insert(int key, PageId pid);
 
+   /**
+    * Insert a (key, pid) pair right behind the child-node pointer left,
+    * which pid was split from. Unlike insert(), this keeps the children
+    * in the order of the leaf chain when the node has duplicate keys.
+    * @param left[IN] the child node that pid was split from
+    * @param key[IN] the key to insert
+    * @param pid[IN] the PageId to insert
+    * @return 0 if successful. Return an error code if the node is full.
+    */
+    RC insertBehind(PageId left, int key, PageId pid);
+
    /**
     * Insert the (key, pid) pair to the node
     * and split the node half and half with sibling.
@@ -188,6 +199,18 @@ class BTNonLeafNode {
     */
     RC insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, int& midKey);
 
+   /**
+    * Insert the (key, pid) pair right behind the child-node pointer left
+    * and split the node half and half with sibling.
+    * @param left[IN] the child node that pid was split from
+    * @param key[IN] the key to insert
+    * @param pid[IN] the PageId to insert
+    * @param sibling[IN] the sibling node to split with. This node MUST be empty when this function is called.
+    * @param midKey[OUT] the key in the middle after the split. This key should be inserted to the parent node.
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC insertBehindAndSplit(PageId left, int key, PageId pid, BTNonLeafNode& sibling, int& midKey);
+
    /**
     * Given the searchKey, find the child-node pointer to follow and
     * output it in pid.
@@ -207,6 +230,21 @@ class BTNonLeafNode {
     */
     RC initializeRoot(PageId pid1, int key, PageId pid2);
 
+   /**
+    * Read the i-th key of the node and the child-node pointer behind it.
+    * @param i[IN] the key number between 0 and getKeyCount()-1
+    * @param key[OUT] the i-th key
+    * @param pid[OUT] the child node holding the keys from the i-th key on
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC readEntry(int i, int& key, PageId& pid);
+
+   /**
+    * Return the child-node pointer in front of the first key.
+    * @return the PageId of the first child node
+    */
+    PageId getFirstChildPtr();
+
    /**
     * Return the number of keys stored in the node.
     * @return the number of keys in the node
@@ -241,6 +279,11 @@ class BTNonLeafNode {
       * of the index of NodePairs to access in the buffer. 
       */
     int byteIndexOf(int i);
+
+    int positionOf(int key);
+    int positionBehind(PageId left, int key);
+    RC insertAt(int pos, int key, PageId pid);
+    RC insertAtAndSplit(int pos, int key, PageId pid, BTNonLeafNode& sibling, int& midKey);
 }; 
 
 #endif /* BTREENODE_H */
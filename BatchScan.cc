@@ -0,0 +1,232 @@
+/*
+ * Scan operators producing batches of tuples.
+ */
+
+#include <climits>
+#include <cstring>
+#include "BatchScan.h"
+
+using namespace std;
+
+TableBatchScan::TableBatchScan(const RecordFile& rf, Arena* arena)
+  : rf(rf), scanner(rf), values(true), probe(NULL), probeLength(0), probeHash(0)
+{
+  if (arena != NULL) {
+    pages = (char*) arena->allocate(BATCH_PAGES * PageFile::PAGE_SIZE);
+  } else {
+    buffer.resize(BATCH_PAGES * PageFile::PAGE_SIZE);
+    pages = &buffer[0];
+  }
+}
+
+TableBatchScan::TableBatchScan(const RecordFile& rf, PageId beginPid, PageId endPid)
+  : rf(rf), scanner(rf, beginPid, endPid), values(true),
+    buffer(BATCH_PAGES * PageFile::PAGE_SIZE), probe(NULL), probeLength(0), probeHash(0)
+{
+  pages = &buffer[0];
+}
+
+void TableBatchScan::setValue(const char* value)
+{
+  probe = value;
+  probeLength = strlen(value);
+  probeHash = BloomFilter::hash(value, probeLength);
+  scanner.setValue(probeHash);
+}
+
+RC TableBatchScan::next(TupleBatch& batch)
+{
+  RC rc;
+  PageId pid;
+  int count;
+  int n = 0;
+
+  batch.size = 0;
+  longValues.clear();
+
+  // read pages while the batch can hold another full page. when none
+  // of the records read may hold the value wanted, read the next pages
+  bool done = false;
+  while (n == 0 && !done) {
+    for (int p = 0; p < BATCH_PAGES && n + RecordFile::RECORDS_PER_PAGE <= TupleBatch::CAPACITY; p++) {
+      char* page = &pages[p * PageFile::PAGE_SIZE];
+      if ((rc = scanner.nextPage(page, pid, count)) == RC_END_OF_SCAN) {
+        done = true;
+        break;
+      }
+      if (rc < 0) return rc;
+
+      for (int sid = 0; sid < count; sid++) {
+        if (probe != NULL && !RecordFile::mayHoldValue(page, sid, probeLength, probeHash)) continue;
+
+        if (values) {
+          const char*& value = batch.values[n];
+          value = RecordFile::recordValue(page, sid, batch.keys[n]);
+          if (value == NULL &&
+              (rc = rf.recordValue(page, sid, batch.keys[n], value, longValues)) < 0) {
+            return rc;
+          }
+        } else {
+          batch.keys[n] = RecordFile::recordKey(page, sid);
+          batch.values[n] = NULL;
+        }
+        batch.rids[n].pid = pid;
+        batch.rids[n].sid = sid;
+        n++;
+      }
+    }
+  }
+
+  batch.size = n;
+  batch.selectAll();
+  return (n > 0) ? 0 : RC_END_OF_SCAN;
+}
+
+ColumnBatchScan::ColumnBatchScan(const ColumnFile& cf)
+  : cf(cf), segment(0), endSegment(cf.segmentCount()), row(0), rowCount(0), values(true),
+    minKey(INT_MIN), maxKey(INT_MAX), valueRange(NULL), minCode(0), maxCode(0),
+    keys(ColumnFile::SEGMENT_ROWS)
+{
+}
+
+ColumnBatchScan::ColumnBatchScan(const ColumnFile& cf, int beginSegment, int endSegment)
+  : cf(cf), segment(beginSegment), endSegment(endSegment), row(0), rowCount(0), values(true),
+    minKey(INT_MIN), maxKey(INT_MAX), valueRange(NULL), minCode(0), maxCode(0),
+    keys(ColumnFile::SEGMENT_ROWS)
+{
+}
+
+// whether a value is in a value range
+static bool inRange(const char* value, const ValueRange& range)
+{
+  if (range.hasMin) {
+    int c = strcmp(value, range.minValue.c_str());
+    if (c < 0 || (c == 0 && !range.minInclusive)) return false;
+  }
+  if (range.hasMax) {
+    int c = strcmp(value, range.maxValue.c_str());
+    if (c > 0 || (c == 0 && !range.maxInclusive)) return false;
+  }
+  return true;
+}
+
+RC ColumnBatchScan::next(TupleBatch& batch)
+{
+  RC rc;
+
+  batch.size = 0;
+
+  // read the columns of the next segment when this one is done,
+  // skipping the segments without a key in the range and the
+  // dictionaries without a value in the value range
+  while (row == rowCount) {
+    if (rowCount > 0) segment++;
+    while (segment < endSegment && !cf.mayContain(segment, minKey, maxKey)) segment++;
+    if (segment >= endSegment) return RC_END_OF_SCAN;
+
+    const ColumnFile::Segment& s = cf.getSegment(segment);
+    if ((values || valueRange != NULL) && (rc = cf.readValues(segment, column)) < 0) return rc;
+    rowCount = s.rowCount;
+    row = rowCount;
+    if (valueRange != NULL && s.dictionarySize > 0) {
+      ColumnFile::codeRange(column, s, *valueRange, minCode, maxCode);
+      if (minCode >= maxCode) continue;
+    }
+    if ((rc = cf.readKeys(segment, &keys[0])) < 0) return rc;
+    row = 0;
+  }
+
+  int n = rowCount - row;
+  if (n > TupleBatch::CAPACITY) n = TupleBatch::CAPACITY;
+
+  const ColumnFile::Segment& s = cf.getSegment(segment);
+  memcpy(batch.keys, &keys[row], n * sizeof(int));
+  for (int i = 0; i < n; i++) {
+    batch.values[i] = values ? ColumnFile::value(column, s, row + i) : NULL;
+    batch.rids[i].pid = s.pid;
+    batch.rids[i].sid = row + i;
+  }
+  batch.size = n;
+
+  // select the values in range by their codes if the segment has a
+  // dictionary that holds values outside the range
+  if (valueRange == NULL || (s.dictionarySize > 0 && minCode == 0 && maxCode == s.dictionarySize)) {
+    batch.selectAll();
+  } else if (s.dictionarySize > 0) {
+    batch.selSize = 0;
+    for (int i = 0; i < n; i++) {
+      int code = ColumnFile::code(column, row + i);
+      if (code >= minCode && code < maxCode) batch.sel[batch.selSize++] = i;
+    }
+  } else {
+    batch.selSize = 0;
+    for (int i = 0; i < n; i++) {
+      if (inRange(ColumnFile::value(column, s, row + i), *valueRange)) batch.sel[batch.selSize++] = i;
+    }
+  }
+  row += n;
+  return 0;
+}
+
+IndexBatchScan::IndexBatchScan(BTreeIndex& bt, int minKey, int maxKey)
+  : bt(bt), maxKey(maxKey), done(false)
+{
+  bt.locate(minKey, cursor);
+}
+
+RC IndexBatchScan::next(TupleBatch& batch)
+{
+  RC rc;
+  int n = 0;
+
+  batch.size = 0;
+  if (done) return RC_END_OF_SCAN;
+
+  rc = bt.readBatch(cursor, TupleBatch::CAPACITY, batch.keys, batch.rids, n);
+  if (rc < 0 && rc != RC_END_OF_TREE) return rc;
+  if (rc == RC_END_OF_TREE) done = true;
+
+  // the keys are sorted. cut the batch at the end of the range.
+  for (int i = 0; i < n; i++) {
+    if (batch.keys[i] > maxKey) {
+      n = i;
+      done = true;
+      break;
+    }
+    batch.values[i] = NULL;
+  }
+
+  batch.size = n;
+  batch.selectAll();
+  return (n > 0) ? 0 : RC_END_OF_SCAN;
+}
+
+ValueIndexScan::ValueIndexScan(const ValueIndex& vi, const ValueRange& range)
+  : vi(vi), range(range), located(false), done(false)
+{
+}
+
+RC ValueIndexScan::next(TupleBatch& batch)
+{
+  RC rc;
+  int n = 0;
+
+  batch.size = 0;
+  if (done) return RC_END_OF_SCAN;
+  if (!located) {
+    if ((rc = vi.locate(range, cursor)) < 0) return rc;
+    located = true;
+  }
+
+  rc = vi.readBatch(range, cursor, TupleBatch::CAPACITY, batch.rids, n);
+  if (rc < 0 && rc != RC_END_OF_TREE) return rc;
+  if (rc == RC_END_OF_TREE) done = true;
+
+  for (int i = 0; i < n; i++) {
+    batch.keys[i] = 0;
+    batch.values[i] = NULL;
+  }
+  batch.size = n;
+  batch.selectAll();
+  return (n > 0) ? 0 : RC_END_OF_SCAN;
+}
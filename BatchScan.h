@@ -0,0 +1,208 @@
+/*
+ * Scan operators producing batches of tuples.
+ */
+
+#ifndef BATCHSCAN_H
+#define BATCHSCAN_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "Arena.h"
+#include "RecordFile.h"
+#include "ColumnFile.h"
+#include "BTreeIndex.h"
+#include "ValueIndex.h"
+#include "TupleBatch.h"
+
+/**
+ * Reads the whole table, or a range of its pages, a batch at a time.
+ * Each call reads as many full pages as fit in a batch and returns
+ * their tuples with the values pointing into the pages read.
+ */
+class TableBatchScan {
+ public:
+  // the most pages read for one batch. a batch takes pages while any
+  // page could still fit in it
+  static const int BATCH_PAGES = 32;
+
+  /**
+   * read the whole table.
+   * @param rf[IN] the table to read
+   * @param arena[IN] the arena of the statement to take the page buffer
+   *                  from. NULL to allocate it with the scan
+   */
+  TableBatchScan(const RecordFile& rf, Arena* arena = NULL);
+
+  /**
+   * read only the pages in [beginPid, endPid) of the table.
+   * @param rf[IN] the table to read
+   * @param beginPid[IN] the first page to read
+   * @param endPid[IN] the page after the last page to read
+   */
+  TableBatchScan(const RecordFile& rf, PageId beginPid, PageId endPid);
+
+  /**
+   * read only the keys: the values of the batches are left NULL, for
+   * statements that never look at them (see QueryPlan::needsValues()).
+   */
+  void skipValues() { values = false; }
+
+  /**
+   * skip the pages whose keys are all outside [lo, hi] (see ZoneMap).
+   * the batches may still hold other keys.
+   */
+  void setKeyRange(int lo, int hi) { scanner.setKeyRange(lo, hi); }
+
+  /**
+   * look for one value: skip the pages whose Bloom filter rules it out
+   * and leave out of the batches the records whose slot does not match
+   * its length and fingerprint (see RecordFile::mayHoldValue()). the
+   * batches may still hold other values.
+   * @param value[IN] the value wanted. it must outlive the scan
+   */
+  void setValue(const char* value);
+
+  /**
+   * read the next batch of tuples.
+   * @param batch[OUT] the tuples read, all selected
+   * @return 0 if tuples were read. RC_END_OF_SCAN at the end of the
+   *         table. Otherwise an error code.
+   */
+  RC next(TupleBatch& batch);
+
+ private:
+  const RecordFile& rf;     // the table to read
+  RecordFile::Scanner scanner;  // the heap pages to read
+  bool   values;            // whether to set the values of the batches
+  char*  pages;             // the pages of the current batch
+  std::vector<char> buffer; // pages, unless they are in an arena
+  std::deque<std::string> longValues;  // the long values of the batch
+  const char* probe;        // the value wanted. NULL for any value
+  int    probeLength;       // # bytes of probe
+  unsigned probeHash;       // the hash of probe
+
+  TableBatchScan(const TableBatchScan&);
+  TableBatchScan& operator=(const TableBatchScan&);
+};
+
+/**
+ * Reads a table in the columnar format, or a range of its segments, a
+ * batch at a time. The key column of a segment is read when the scan
+ * reaches it and the value column only if the values are wanted.
+ */
+class ColumnBatchScan {
+ public:
+  /**
+   * read the whole table.
+   * @param cf[IN] the table to read
+   */
+  ColumnBatchScan(const ColumnFile& cf);
+
+  /**
+   * read only the segments in [beginSegment, endSegment) of the table.
+   * @param cf[IN] the table to read
+   * @param beginSegment[IN] the first segment to read
+   * @param endSegment[IN] the segment after the last segment to read
+   */
+  ColumnBatchScan(const ColumnFile& cf, int beginSegment, int endSegment);
+
+  /**
+   * read only the key column: the values of the batches are left NULL
+   * (see QueryPlan::needsValues()).
+   */
+  void skipValues() { values = false; }
+
+  /**
+   * skip the segments whose keys are all outside [lo, hi]. the batches
+   * may still hold other keys.
+   */
+  void setKeyRange(int lo, int hi) { minKey = lo; maxKey = hi; }
+
+  /**
+   * select only the tuples whose value is in a range. the values of a
+   * dictionary-encoded segment are selected by their codes, and the
+   * segment is skipped if its dictionary has no value in the range.
+   * @param range[IN] the values wanted. it must outlive the scan
+   */
+  void setValueRange(const ValueRange& range) { valueRange = &range; }
+
+  /**
+   * read the next batch of tuples.
+   * @param batch[OUT] the tuples read. only those in the value range are
+   *                   selected
+   * @return 0 if tuples were read. RC_END_OF_SCAN at the end of the
+   *         table. Otherwise an error code.
+   */
+  RC next(TupleBatch& batch);
+
+ private:
+  const ColumnFile& cf;     // the table to read
+  int  segment;             // the segment being read
+  int  endSegment;          // the segment after the last segment to read
+  int  row;                 // the next tuple of the segment to read
+  int  rowCount;            // # tuples of the segment. 0 before it is read
+  bool values;              // whether to set the values of the batches
+  int  minKey;              // the key range wanted
+  int  maxKey;
+  const ValueRange* valueRange;  // the values wanted. NULL for any value
+  int  minCode;             // the codes of the values wanted in the
+  int  maxCode;             //   dictionary of the segment: [minCode, maxCode)
+  std::vector<int>  keys;   // the key column of the segment
+  std::vector<char> column; // the value column of the segment
+};
+
+/**
+ * Reads the (key, rid) pairs in [minKey, maxKey] from an index
+ * a batch at a time. The values of the batch are NULL.
+ */
+class IndexBatchScan {
+ public:
+  IndexBatchScan(BTreeIndex& bt, int minKey, int maxKey);
+
+  /**
+   * read the next batch of index entries.
+   * @param batch[OUT] the keys and rids read, all selected
+   * @return 0 if entries were read. RC_END_OF_SCAN at the end of the
+   *         range. Otherwise an error code.
+   */
+  RC next(TupleBatch& batch);
+
+ private:
+  BTreeIndex& bt;       // the index to read
+  IndexCursor cursor;   // the next entry to read
+  int  maxKey;          // the largest key to read
+  bool done;            // whether the end of the range was reached
+};
+
+/**
+ * Reads the RecordIds of the entries of a value range from a value
+ * index a batch at a time. The keys and the values of the batch are
+ * left unset; the records are fetched with a BitmapHeapScan.
+ */
+class ValueIndexScan {
+ public:
+  /**
+   * @param vi[IN] the index to read
+   * @param range[IN] the values wanted. it must outlive the scan
+   */
+  ValueIndexScan(const ValueIndex& vi, const ValueRange& range);
+
+  /**
+   * read the next batch of index entries.
+   * @param batch[OUT] the rids read, all selected
+   * @return 0 if entries were read. RC_END_OF_SCAN at the end of the
+   *         range. Otherwise an error code.
+   */
+  RC next(TupleBatch& batch);
+
+ private:
+  const ValueIndex& vi;      // the index to read
+  const ValueRange& range;   // the values wanted
+  IndexCursor cursor;        // the next entry to read
+  bool located;              // whether the cursor was set
+  bool done;                 // whether the end of the range was reached
+};
+
+#endif /* BATCHSCAN_H */
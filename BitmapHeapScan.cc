@@ -0,0 +1,80 @@
+/*
+ * Bitmap heap scan: fetching the records of an index range scan
+ * in heap-page order.
+ */
+
+#include <algorithm>
+#include "BitmapHeapScan.h"
+
+using namespace std;
+
+BitmapHeapScan::BitmapHeapScan(const RecordFile& rf, Arena* arena)
+  : rf(rf), pos(0)
+{
+  if (arena != NULL) {
+    pages = (char*) arena->allocate(BATCH_PAGES * PageFile::PAGE_SIZE);
+  } else {
+    buffer.resize(BATCH_PAGES * PageFile::PAGE_SIZE);
+    pages = &buffer[0];
+  }
+}
+
+void BitmapHeapScan::add(const RecordId& rid)
+{
+  rids.push_back(rid);
+}
+
+void BitmapHeapScan::add(const TupleBatch& batch)
+{
+  for (int i = 0; i < batch.selSize; i++) {
+    rids.push_back(batch.rids[batch.sel[i]]);
+  }
+}
+
+void BitmapHeapScan::open()
+{
+  // bring the records of the same page together
+  sort(rids.begin(), rids.end());
+  pos = 0;
+}
+
+void BitmapHeapScan::clear()
+{
+  rids.clear();
+  pos = 0;
+}
+
+RC BitmapHeapScan::next(TupleBatch& batch)
+{
+  RC rc;
+  int n = 0;
+  int p = -1;           // the page slot holding the current page
+  PageId curPid = -1;   // the page in slot p
+
+  longValues.clear();
+  while (pos < rids.size() && n < TupleBatch::CAPACITY) {
+    const RecordId& rid = rids[pos];
+
+    // read the page only when we move on to a new page
+    if (rid.pid != curPid) {
+      if (p + 1 >= BATCH_PAGES) break;
+      p++;
+      if ((rc = rf.readPage(rid.pid, &pages[p * PageFile::PAGE_SIZE])) < 0) return rc;
+      curPid = rid.pid;
+    }
+
+    const char* page = &pages[p * PageFile::PAGE_SIZE];
+    batch.values[n] = RecordFile::recordValue(page, rid.sid, batch.keys[n]);
+    if (batch.values[n] == NULL &&
+        (rc = rf.recordValue(page, rid.sid, batch.keys[n], batch.values[n], longValues)) < 0) {
+      return rc;
+    }
+    batch.rids[n] = rid;
+    n++;
+    pos++;
+  }
+
+  batch.size = n;
+  batch.selectAll();
+  return (n > 0) ? 0 : RC_END_OF_SCAN;
+}
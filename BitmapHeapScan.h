@@ -0,0 +1,86 @@
+/*
+ * Bitmap heap scan: fetching the records of an index range scan
+ * in heap-page order.
+ */
+
+#ifndef BITMAPHEAPSCAN_H
+#define BITMAPHEAPSCAN_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "Arena.h"
+#include "PageFile.h"
+#include "RecordFile.h"
+#include "TupleBatch.h"
+
+/**
+ * Fetches a set of records from a RecordFile, reading every heap page once.
+ * The RecordIds returned by an index are in key order, which is random
+ * with respect to the heap pages. Instead of reading a record as soon as
+ * its index entry is found, the RecordIds are collected with add(),
+ * sorted by (pid, sid) in open(), and then next() returns the records
+ * page by page.
+ */
+class BitmapHeapScan {
+ public:
+  // # pages a batch of fetched records may point into
+  static const int BATCH_PAGES = 128;
+
+  /**
+   * @param rf[IN] the table to fetch the records from
+   * @param arena[IN] the arena of the statement to take the page buffer
+   *                  from. NULL to allocate it with the scan
+   */
+  BitmapHeapScan(const RecordFile& rf, Arena* arena = NULL);
+
+  /**
+   * add a record to the set of records to fetch.
+   * @param rid[IN] the id of the record
+   */
+  void add(const RecordId& rid);
+
+  /**
+   * add the selected tuples of a batch to the set of records to fetch.
+   * @param batch[IN] tuples with their rids
+   */
+  void add(const TupleBatch& batch);
+
+  /**
+   * @return the number of records added so far
+   */
+  int size() const { return (int) rids.size(); }
+
+  /**
+   * sort the collected RecordIds and rewind the scan to the first record.
+   * no more records can be added after open().
+   */
+  void open();
+
+  /**
+   * forget all the records added, so that the scan can be reused.
+   */
+  void clear();
+
+  /**
+   * read the next batch of records in heap order.
+   * @param batch[OUT] the records read, all selected
+   * @return 0 if records were read. RC_END_OF_SCAN if there are no more
+   *         records. Otherwise an error code.
+   */
+  RC next(TupleBatch& batch);
+
+ private:
+  const RecordFile& rf;        // the table to fetch the records from
+  std::vector<RecordId> rids;  // the records to fetch
+  unsigned pos;                // index of the next record in rids
+  char* pages;                 // the pages of the current batch
+  std::vector<char> buffer;    // pages, unless they are in an arena
+  std::deque<std::string> longValues;  // the long values of the batch
+
+  BitmapHeapScan(const BitmapHeapScan&);
+  BitmapHeapScan& operator=(const BitmapHeapScan&);
+};
+
+#endif /* BITMAPHEAPSCAN_H */
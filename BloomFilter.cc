@@ -0,0 +1,133 @@
+/*
+ * Bloom filters over the values of each page of a table.
+ */
+
+#include <cstring>
+#include <algorithm>
+#include "BloomFilter.h"
+
+using namespace std;
+
+//
+// the filter file:
+//   page 0: the header below
+//   page 1-: the filters of the pages in order, FILTERS_PER_PAGE to a page
+//
+typedef struct {
+  int    format;     // BLOOM_FORMAT
+  PageId endPid;     // the end of the table described
+  int    endSid;
+  int    pageCount;  // # filters
+} BloomHeader;
+
+static const int BLOOM_FORMAT = 0x4d4f4c42;
+static const int FILTER_BYTES = BloomFilter::FILTER_BITS / 8;
+static const int FILTERS_PER_PAGE = PageFile::PAGE_SIZE / FILTER_BYTES;
+
+BloomFilter::BloomFilter()
+  : valid(false), dirty(0)
+{
+}
+
+void BloomFilter::clear()
+{
+  bits.clear();
+  valid = true;
+  dirty = 0;
+}
+
+void BloomFilter::invalidate()
+{
+  bits.clear();
+  valid = false;
+  dirty = 0;
+}
+
+void BloomFilter::add(PageId pid, unsigned h)
+{
+  if (!valid) return;
+  if (pid >= pageCount()) bits.resize((pid + 1) * FILTER_WORDS, 0);
+
+  unsigned* filter = &bits[pid * FILTER_WORDS];
+  unsigned step = (h >> 17) | (h << 15) | 1;
+  for (int i = 0; i < HASH_COUNT; i++, h += step) {
+    unsigned bit = h % FILTER_BITS;
+    filter[bit / 32] |= 1u << (bit % 32);
+  }
+  if (pid < dirty) dirty = pid;
+}
+
+RC BloomFilter::load(const string& filename, PageId endPid, int endSid)
+{
+  RC rc;
+  PageFile pf;
+  char page[PageFile::PAGE_SIZE];
+  BloomHeader header;
+
+  invalidate();
+  if ((rc = pf.open(filename, 'r')) < 0) return rc;
+
+  // the filters must describe the table as it is now
+  if ((rc = pf.read(0, page)) < 0) {
+    pf.close();
+    return rc;
+  }
+  memcpy(&header, page, sizeof(header));
+  if (header.format != BLOOM_FORMAT || header.endPid != endPid || header.endSid != endSid ||
+      header.pageCount < 0 || header.pageCount > endPid + 1) {
+    pf.close();
+    return RC_INVALID_FILE_FORMAT;
+  }
+
+  bits.resize(header.pageCount * FILTER_WORDS);
+  for (int i = 0; i < header.pageCount; i += FILTERS_PER_PAGE) {
+    if ((rc = pf.read(1 + i / FILTERS_PER_PAGE, page)) < 0) {
+      pf.close();
+      bits.clear();
+      return rc;
+    }
+    int n = min(header.pageCount - i, FILTERS_PER_PAGE);
+    memcpy(&bits[i * FILTER_WORDS], page, n * FILTER_BYTES);
+  }
+  pf.close();
+
+  valid = true;
+  dirty = header.pageCount;
+  return 0;
+}
+
+RC BloomFilter::save(const string& filename, PageId endPid, int endSid)
+{
+  RC rc;
+  PageFile pf;
+  char page[PageFile::PAGE_SIZE];
+  BloomHeader header;
+
+  if (!valid) return 0;
+  if ((rc = pf.open(filename, 'w')) < 0) return rc;
+
+  // rewrite the pages of the filters from the first one changed
+  int count = pageCount();
+  for (int i = dirty - dirty % FILTERS_PER_PAGE; i < count; i += FILTERS_PER_PAGE) {
+    int n = min(count - i, FILTERS_PER_PAGE);
+    memset(page, 0, sizeof(page));
+    memcpy(page, &bits[i * FILTER_WORDS], n * FILTER_BYTES);
+    if ((rc = pf.write(1 + i / FILTERS_PER_PAGE, page)) < 0) {
+      pf.close();
+      return rc;
+    }
+  }
+
+  // the header goes last: the filters are not used until they are complete
+  header.format = BLOOM_FORMAT;
+  header.endPid = endPid;
+  header.endSid = endSid;
+  header.pageCount = count;
+  memset(page, 0, sizeof(page));
+  memcpy(page, &header, sizeof(header));
+  rc = pf.write(0, page);
+  pf.close();
+
+  if (rc == 0) dirty = count;
+  return rc;
+}
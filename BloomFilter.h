@@ -0,0 +1,122 @@
+/*
+ * Bloom filters over the values of each page of a table.
+ */
+
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "PageFile.h"
+
+/**
+ * A Bloom filter of FILTER_BITS bits for each page of a record file,
+ * holding the hashes of the values stored in the page. A scan for
+ * "value = 'v'" skips the pages whose filter does not hold the hash of
+ * 'v' without reading them. A filter never misses a value of its page;
+ * a page that does not hold the value passes its filter now and then.
+ *
+ * The filters are optional (LOAD ... WITH BLOOM). They are kept in the
+ * file "table.bloom" next to the table, which records the end of the
+ * table it describes; filters that do not match their table are not
+ * used.
+ */
+class BloomFilter {
+ public:
+  // # bits of the filter of a page
+  static const int FILTER_BITS = 512;
+
+  // # bits set for each value
+  static const int HASH_COUNT = 4;
+
+  /**
+   * @param value[IN] a value
+   * @param length[IN] # bytes of the value
+   * @return the hash of the value (32-bit FNV-1a)
+   */
+  static unsigned hash(const char* value, int length)
+  {
+    unsigned h = 2166136261u;
+    for (int i = 0; i < length; i++) {
+      h = (h ^ (unsigned char) value[i]) * 16777619u;
+    }
+    return h;
+  }
+
+  BloomFilter();
+
+  /**
+   * forget all pages. the filters describe an empty table.
+   */
+  void clear();
+
+  /**
+   * drop the filters: every page may hold any value.
+   */
+  void invalidate();
+
+  /**
+   * @return whether the filters describe the pages of the table
+   */
+  bool isValid() const { return valid; }
+
+  /**
+   * add a value stored in a page. nothing is done if the filters are
+   * not valid.
+   * @param pid[IN] the page
+   * @param h[IN] the hash of a value appended to the page
+   */
+  void add(PageId pid, unsigned h);
+
+  /**
+   * @param pid[IN] the page
+   * @param h[IN] the hash of the value wanted
+   * @return whether the page may hold the value. true for a page the
+   *         filters do not know
+   */
+  bool mayContain(PageId pid, unsigned h) const
+  {
+    if (!valid || pid >= pageCount()) return true;
+    const unsigned* filter = &bits[pid * FILTER_WORDS];
+    unsigned step = (h >> 17) | (h << 15) | 1;
+    for (int i = 0; i < HASH_COUNT; i++, h += step) {
+      unsigned bit = h % FILTER_BITS;
+      if ((filter[bit / 32] & (1u << (bit % 32))) == 0) return false;
+    }
+    return true;
+  }
+
+  /**
+   * read the filters of a table. filters written for a different end of
+   * the table are not loaded.
+   * @param filename[IN] the name of the filter file
+   * @param endPid[IN] the end of the table (RecordFile::endRid().pid)
+   * @param endSid[IN] the end of the table (RecordFile::endRid().sid)
+   * @return error code. 0 if no error. RC_INVALID_FILE_FORMAT if the
+   *         filters do not match the table
+   */
+  RC load(const std::string& filename, PageId endPid, int endSid);
+
+  /**
+   * write the filters that changed since they were loaded. nothing is
+   * written if the filters are not valid.
+   * @param filename[IN] the name of the filter file
+   * @param endPid[IN] the end of the table (RecordFile::endRid().pid)
+   * @param endSid[IN] the end of the table (RecordFile::endRid().sid)
+   * @return error code. 0 if no error
+   */
+  RC save(const std::string& filename, PageId endPid, int endSid);
+
+ private:
+  // # words of the filter of a page
+  static const int FILTER_WORDS = FILTER_BITS / 32;
+
+  std::vector<unsigned> bits;  // the filter of each page, in order
+  bool valid;                  // whether the filters describe the table
+  PageId dirty;                // the first filter changed since loaded
+
+  PageId pageCount() const { return bits.size() / FILTER_WORDS; }
+};
+
+#endif /* BLOOMFILTER_H */
@@ -0,0 +1,192 @@
+/*
+ * The tables kept open across statements.
+ */
+
+#include "Catalog.h"
+
+using namespace std;
+
+// the tables the thread holds locked shared, with the # statements of
+// the thread reading each. a thread locks a table once: if a LOAD waited
+// for the lock, a second lock would wait for the LOAD, which waits for
+// the first.
+struct HeldLock {
+  pthread_rwlock_t* lock;
+  int count;
+};
+static const int MAX_HELD_LOCKS = 32;
+static __thread HeldLock heldLocks[MAX_HELD_LOCKS];
+static __thread int heldCount = 0;
+
+// the entry of a lock the thread holds. NULL if it does not hold it
+static HeldLock* findHeld(pthread_rwlock_t* tableLock)
+{
+  for (int i = 0; i < heldCount; i++) {
+    if (heldLocks[i].lock == tableLock) return &heldLocks[i];
+  }
+  return NULL;
+}
+
+// lock a table shared for a statement of the thread, unless the thread
+// already holds the lock
+static RC lockShared(pthread_rwlock_t* tableLock)
+{
+  HeldLock* held = findHeld(tableLock);
+  if (held != NULL) {
+    held->count++;
+    return 0;
+  }
+  if (heldCount == MAX_HELD_LOCKS) return RC_TABLE_IN_USE;
+
+  pthread_rwlock_rdlock(tableLock);
+  heldLocks[heldCount].lock = tableLock;
+  heldLocks[heldCount].count = 1;
+  heldCount++;
+  return 0;
+}
+
+Catalog& Catalog::instance()
+{
+  static Catalog catalog;
+  return catalog;
+}
+
+Catalog::Catalog()
+{
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&opened, NULL);
+}
+
+Catalog::~Catalog()
+{
+  clear();
+  for (map<string, pthread_rwlock_t*>::iterator it = tableLocks.begin();
+       it != tableLocks.end(); ++it) {
+    pthread_rwlock_destroy(it->second);
+    delete it->second;
+  }
+  pthread_cond_destroy(&opened);
+  pthread_mutex_destroy(&lock);
+}
+
+// the lock of a table, created on first use
+pthread_rwlock_t* Catalog::getTableLock(const string& table)
+{
+  pthread_mutex_lock(&lock);
+  pthread_rwlock_t*& tableLock = tableLocks[table];
+  if (tableLock == NULL) {
+    // let a waiting LOAD go before the readers that come after it
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    tableLock = new pthread_rwlock_t;
+    pthread_rwlock_init(tableLock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+  }
+  pthread_rwlock_t* result = tableLock;
+  pthread_mutex_unlock(&lock);
+  return result;
+}
+
+RC Catalog::open(const string& table, TableHandle*& handle)
+{
+  RC rc;
+  pthread_rwlock_t* tableLock = getTableLock(table);
+
+  if ((rc = lockShared(tableLock)) < 0) return rc;
+
+  pthread_mutex_lock(&lock);
+
+  // wait while another statement opens the table
+  while (opening.count(table) > 0) {
+    pthread_cond_wait(&opened, &lock);
+  }
+
+  map<string, TableHandle*>::iterator it = handles.find(table);
+  if (it != handles.end()) {
+    handle = it->second;
+    handle->acquire(tableLock);
+    pthread_mutex_unlock(&lock);
+    return 0;
+  }
+
+  if (handles.size() >= MAX_OPEN_TABLES) closeUnused();
+  opening.insert(table);
+  pthread_mutex_unlock(&lock);
+
+  // read the files of the table without the lock, so that the
+  // statements on the other tables go on
+  handle = new TableHandle;
+  rc = handle->open(table);
+
+  pthread_mutex_lock(&lock);
+  opening.erase(table);
+  if (rc == 0) {
+    handle->acquire(tableLock);
+    handles[table] = handle;
+  }
+  pthread_cond_broadcast(&opened);
+  pthread_mutex_unlock(&lock);
+
+  if (rc < 0) {
+    unlockShared(tableLock);
+    delete handle;
+  }
+  return rc;
+}
+
+RC Catalog::lockTable(const string& table)
+{
+  pthread_rwlock_t* tableLock = getTableLock(table);
+  if (findHeld(tableLock) != NULL) return RC_TABLE_IN_USE;
+  pthread_rwlock_wrlock(tableLock);
+  return 0;
+}
+
+void Catalog::unlockShared(pthread_rwlock_t* tableLock)
+{
+  HeldLock* held = findHeld(tableLock);
+  if (held != NULL && --held->count > 0) return;
+  if (held != NULL) *held = heldLocks[--heldCount];
+  pthread_rwlock_unlock(tableLock);
+}
+
+void Catalog::unlockTable(const string& table)
+{
+  pthread_rwlock_unlock(getTableLock(table));
+}
+
+void Catalog::invalidate(const string& table)
+{
+  pthread_mutex_lock(&lock);
+  map<string, TableHandle*>::iterator it = handles.find(table);
+  if (it != handles.end()) {
+    it->second->invalidate();
+    handles.erase(it);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void Catalog::clear()
+{
+  pthread_mutex_lock(&lock);
+  for (map<string, TableHandle*>::iterator it = handles.begin(); it != handles.end(); ++it) {
+    it->second->invalidate();
+  }
+  handles.clear();
+  pthread_mutex_unlock(&lock);
+}
+
+// close the tables no statement is reading. called with the lock held.
+void Catalog::closeUnused()
+{
+  map<string, TableHandle*>::iterator it = handles.begin();
+  while (it != handles.end()) {
+    if (!it->second->inUse()) {
+      it->second->invalidate();
+      handles.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
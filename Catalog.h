@@ -0,0 +1,105 @@
+/*
+ * The tables kept open across statements.
+ */
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <pthread.h>
+#include "Bruinbase.h"
+#include "TableHandle.h"
+
+/**
+ * The open tables of the process, by table name (the path without the
+ * .tbl/.idx suffix). A table is opened by the first statement reading
+ * it and stays open, with its pages in the buffer pool, for the
+ * statements after it. LOAD and ANALYZE invalidate the handle of their
+ * table; the next statement opens the table again.
+ *
+ * Each table has a readers-writer lock. The statements reading a table
+ * hold it shared while they use its handle; LOAD and ANALYZE hold it
+ * exclusively while they change the files. A thread that reads a table
+ * with a statement (e.g., an open ResultCursor) locks it only once:
+ * its next statements on the table use the same lock, and it cannot
+ * lock the table exclusively until they are all done.
+ *
+ * A table is opened without holding the lock of the catalog, so the
+ * statements on the other tables do not wait for its files to be read.
+ * The statements on the same table wait until it is open.
+ */
+class Catalog {
+ public:
+  // # tables kept open. unused tables are closed beyond it.
+  static const unsigned MAX_OPEN_TABLES = 64;
+
+  /**
+   * @return the catalog of the process
+   */
+  static Catalog& instance();
+
+  /**
+   * lock the table shared and get the open table, opening it if
+   * needed. the caller uses the handle until it calls
+   * handle->release(), which unlocks the table. the handle is released
+   * by the thread that opened it.
+   * @param table[IN] the table name
+   * @param handle[OUT] the open table
+   * @return error code. 0 if no error. RC_TABLE_IN_USE if the thread
+   *         reads too many tables at once
+   */
+  RC open(const std::string& table, TableHandle*& handle);
+
+  /**
+   * drop the handle of a table whose files are about to change. the
+   * statements still reading it keep it until they release it.
+   * @param table[IN] the table name
+   */
+  void invalidate(const std::string& table);
+
+  /**
+   * lock a table exclusively. waits until no statement reads it.
+   * @param table[IN] the table name
+   * @return error code. 0 if no error. RC_TABLE_IN_USE if a statement
+   *         of the calling thread reads the table: it would wait for
+   *         itself.
+   */
+  RC lockTable(const std::string& table);
+
+  /**
+   * unlock a table locked by lockTable().
+   * @param table[IN] the table name
+   */
+  void unlockTable(const std::string& table);
+
+  /**
+   * drop the handles of all tables.
+   */
+  void clear();
+
+  /**
+   * unlock a table locked shared by open(). called by
+   * TableHandle::release().
+   * @param tableLock[IN] the lock of the table
+   */
+  static void unlockShared(pthread_rwlock_t* tableLock);
+
+ private:
+  pthread_mutex_t lock;                          // protects the maps
+  pthread_cond_t opened;                         // signaled when a table
+                                                 //   was opened (or not)
+  std::map<std::string, TableHandle*> handles;   // the open tables
+  std::set<std::string> opening;                 // the tables being opened
+  std::map<std::string, pthread_rwlock_t*> tableLocks;  // kept until exit
+
+  Catalog();
+  ~Catalog();
+  void closeUnused();
+  pthread_rwlock_t* getTableLock(const std::string& table);
+  Catalog(const Catalog&);
+  Catalog& operator=(const Catalog&);
+};
+
+#endif /* CATALOG_H */
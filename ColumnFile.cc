@@ -0,0 +1,390 @@
+/*
+ * Tables stored column by column.
+ */
+
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include "ColumnFile.h"
+
+using namespace std;
+
+//
+// a segment header page:
+//   int format      SEGMENT_FORMAT
+//   int rowCount    # tuples in the segment
+//   int keyPages    # pages of the key column
+//   int valuePages  # pages of the value column
+//   int minKey      the smallest key
+//   int maxKey      the largest key
+//   int dictionarySize  # values in the dictionary. 0 if none
+//
+// the key column:
+//   int keys[rowCount], padded to a full page
+//
+// the value column:
+//   int  offsets[rowCount + 1]  the offset of each value after the
+//                               offsets. the last one is the end
+//   char values[]               the NUL-terminated values
+//
+// or, encoded with a dictionary:
+//   ushort codes[rowCount]          the code of each value, padded to
+//                                   a multiple of 4 bytes
+//   int    offsets[dictionarySize + 1]  the offset of each value of
+//                                   the dictionary after the offsets
+//   char   values[]                 the distinct NUL-terminated values
+//                                   in sorted order
+//
+// the format tag leaves the bytes that the slotted heap pages use for
+// their own tag zero, so the two formats are told apart by page 0.
+//
+static const int SEGMENT_FORMAT = 0x4c4f4353;
+
+struct SegmentHeader {
+  int format;
+  int rowCount;
+  int keyPages;
+  int valuePages;
+  int minKey;
+  int maxKey;
+  int dictionarySize;
+};
+
+// # pages taken by a column of the given # bytes
+static int pageCount(size_t bytes)
+{
+  return (bytes + PageFile::PAGE_SIZE - 1) / PageFile::PAGE_SIZE;
+}
+
+// the order of the values of a dictionary
+static bool lessValue(const char* a, const char* b)
+{
+  return strcmp(a, b) < 0;
+}
+
+static bool sameValue(const char* a, const char* b)
+{
+  return strcmp(a, b) == 0;
+}
+
+// encode the values of a segment with a dictionary into column.
+// return false if the encoded column would not be smaller than the
+// plain column of plainBytes bytes
+static bool encodeDictionary(const vector<int>& offsets, const string& values, int plainBytes,
+                             string& column, int& dictionarySize)
+{
+  int rows = offsets.size();
+  vector<const char*> dict(rows);
+
+  for (int i = 0; i < rows; i++) dict[i] = values.data() + offsets[i];
+  sort(dict.begin(), dict.end(), lessValue);
+  dict.erase(unique(dict.begin(), dict.end(), sameValue), dict.end());
+
+  int size = dict.size();
+  int dictBytes = 0;
+  for (int j = 0; j < size; j++) dictBytes += strlen(dict[j]) + 1;
+
+  int start = ColumnFile::codeBytes(rows);
+  int bytes = start + (size + 1) * sizeof(int) + dictBytes;
+  if (bytes >= plainBytes) return false;
+
+  column.assign(bytes, '\0');
+  unsigned short* codes = (unsigned short*) &column[0];
+  for (int i = 0; i < rows; i++) {
+    codes[i] = lower_bound(dict.begin(), dict.end(), values.data() + offsets[i], lessValue) -
+               dict.begin();
+  }
+
+  int* dictOffsets = (int*) &column[start];
+  char* dictValues = &column[start + (size + 1) * sizeof(int)];
+  int offset = 0;
+  for (int j = 0; j < size; j++) {
+    int length = strlen(dict[j]) + 1;
+    dictOffsets[j] = offset;
+    memcpy(dictValues + offset, dict[j], length);
+    offset += length;
+  }
+  dictOffsets[size] = offset;
+
+  dictionarySize = size;
+  return true;
+}
+
+ColumnFile::ColumnFile()
+  : dictionary(false), tailPid(0), tailDirty(false)
+{
+}
+
+RC ColumnFile::open(const string& filename, char mode, bool compress)
+{
+  RC rc;
+  char page[PageFile::PAGE_SIZE];
+  SegmentHeader header;
+
+  if ((rc = pf.open(filename, mode, compress)) < 0) return rc;
+
+  segments.clear();
+  dictionary = false;
+  tailKeys.clear();
+  tailOffsets.clear();
+  tailValues.clear();
+  tailDirty = false;
+
+  // walk the segment headers
+  PageId pid = 0;
+  while (pid < pf.endPid()) {
+    if ((rc = pf.read(pid, page)) < 0) {
+      pf.close();
+      return rc;
+    }
+    memcpy(&header, page, sizeof(header));
+    if (header.format != SEGMENT_FORMAT) {
+      pf.close();
+      return RC_INVALID_FILE_FORMAT;
+    }
+
+    Segment segment;
+    segment.pid = pid;
+    segment.rowCount = header.rowCount;
+    segment.keyPages = header.keyPages;
+    segment.valuePages = header.valuePages;
+    segment.minKey = header.minKey;
+    segment.maxKey = header.maxKey;
+    segment.dictionarySize = header.dictionarySize;
+    segments.push_back(segment);
+    if (segment.dictionarySize > 0) dictionary = true;
+    pid += 1 + header.keyPages + header.valuePages;
+  }
+  tailPid = pid;
+
+  // continue the last segment unless it is full
+  if (mode == 'w' && !segments.empty() && segments.back().rowCount < SEGMENT_ROWS) {
+    if ((rc = readTail()) < 0) {
+      pf.close();
+      return rc;
+    }
+  }
+  return 0;
+}
+
+RC ColumnFile::close()
+{
+  RC rc = writeTail(true);
+
+  segments.clear();
+  dictionary = false;
+  tailKeys.clear();
+  tailOffsets.clear();
+  tailValues.clear();
+  tailDirty = false;
+  tailPid = 0;
+
+  RC closed = pf.close();
+  return (rc < 0) ? rc : closed;
+}
+
+RC ColumnFile::appendBatch(int n, const int* keys, const string* values, RecordId* rids)
+{
+  RC rc;
+
+  for (int i = 0; i < n; i++) {
+    // write the full segment and start the next one after it
+    if ((int) tailKeys.size() == SEGMENT_ROWS && (rc = writeTail(true)) < 0) return rc;
+
+    rids[i].pid = tailPid;
+    rids[i].sid = tailKeys.size();
+    tailKeys.push_back(keys[i]);
+    tailOffsets.push_back(tailValues.size());
+    tailValues.append(values[i].c_str(), values[i].size() + 1);
+    tailDirty = true;
+  }
+  return 0;
+}
+
+int ColumnFile::rowCount() const
+{
+  int n = tailKeys.size();
+  for (unsigned s = 0; s < segments.size(); s++) {
+    n += segments[s].rowCount;
+  }
+  return n;
+}
+
+PageId ColumnFile::endPid() const
+{
+  if (tailKeys.empty()) return tailPid;
+
+  int keyBytes = tailKeys.size() * sizeof(int);
+  int valueBytes = (tailKeys.size() + 1) * sizeof(int) + tailValues.size();
+  return tailPid + 1 + pageCount(keyBytes) + pageCount(valueBytes);
+}
+
+int ColumnFile::scanPageCount(int lo, int hi, bool values) const
+{
+  int n = 0;
+  for (unsigned s = 0; s < segments.size(); s++) {
+    if (!mayContain(s, lo, hi)) continue;
+    n += segments[s].keyPages + (values ? segments[s].valuePages : 0);
+  }
+  return n;
+}
+
+RC ColumnFile::readKeys(int s, int* keys) const
+{
+  RC rc;
+  const Segment& segment = segments[s];
+
+  for (int p = 0; p < segment.keyPages; p++) {
+    if ((rc = pf.read(segment.pid + 1 + p, (char*) keys + p * PageFile::PAGE_SIZE)) < 0) {
+      return rc;
+    }
+  }
+  return 0;
+}
+
+RC ColumnFile::readValues(int s, vector<char>& column) const
+{
+  RC rc;
+  const Segment& segment = segments[s];
+  PageId pid = segment.pid + 1 + segment.keyPages;
+
+  column.resize(segment.valuePages * PageFile::PAGE_SIZE);
+  for (int p = 0; p < segment.valuePages; p++) {
+    if ((rc = pf.read(pid + p, &column[p * PageFile::PAGE_SIZE])) < 0) return rc;
+  }
+  return 0;
+}
+
+// take the last segment back into memory to append to it
+RC ColumnFile::readTail()
+{
+  RC rc;
+  Segment segment = segments.back();
+  vector<int> keys(SEGMENT_ROWS);
+  vector<char> column;
+
+  if ((rc = readKeys(segments.size() - 1, &keys[0])) < 0) return rc;
+  if ((rc = readValues(segments.size() - 1, column)) < 0) return rc;
+
+  tailKeys.assign(keys.begin(), keys.begin() + segment.rowCount);
+  tailOffsets.clear();
+  tailValues.clear();
+  for (int i = 0; i < segment.rowCount; i++) {
+    const char* v = value(column, segment, i);
+    tailOffsets.push_back(tailValues.size());
+    tailValues.append(v, strlen(v) + 1);
+  }
+  tailPid = segment.pid;
+  segments.pop_back();
+  return 0;
+}
+
+RC ColumnFile::flush()
+{
+  // a full segment is done with
+  return writeTail((int) tailKeys.size() == SEGMENT_ROWS);
+}
+
+// write the last segment. if seal, start an empty one after it.
+// otherwise the segment is written again when tuples are appended to it
+RC ColumnFile::writeTail(bool seal)
+{
+  RC rc;
+  char page[PageFile::PAGE_SIZE];
+  SegmentHeader header;
+  int rows = tailKeys.size();
+
+  if (!tailDirty || rows == 0) return 0;
+
+  // the value column: the codes and the dictionary in dictionary mode
+  // if they are smaller. otherwise the offsets, the end of the last
+  // value, the values
+  string column;
+  int plainBytes = (rows + 1) * sizeof(int) + tailValues.size();
+  header.dictionarySize = 0;
+  if (!dictionary ||
+      !encodeDictionary(tailOffsets, tailValues, plainBytes, column, header.dictionarySize)) {
+    column.assign((rows + 1) * sizeof(int), '\0');
+    memcpy(&column[0], &tailOffsets[0], rows * sizeof(int));
+    int end = tailValues.size();
+    memcpy(&column[rows * sizeof(int)], &end, sizeof(int));
+    column += tailValues;
+  }
+
+  header.format = SEGMENT_FORMAT;
+  header.rowCount = rows;
+  header.keyPages = pageCount(rows * sizeof(int));
+  header.valuePages = pageCount(column.size());
+  header.minKey = header.maxKey = tailKeys[0];
+  for (int i = 1; i < rows; i++) {
+    if (tailKeys[i] < header.minKey) header.minKey = tailKeys[i];
+    if (tailKeys[i] > header.maxKey) header.maxKey = tailKeys[i];
+  }
+
+  memset(page, 0, sizeof(page));
+  memcpy(page, &header, sizeof(header));
+  if ((rc = pf.write(tailPid, page)) < 0) return rc;
+
+  // write each column page by page. the last page of a column is padded
+  const char* keys = (const char*) &tailKeys[0];
+  int keyBytes = rows * sizeof(int);
+  PageId pid = tailPid + 1;
+  for (int p = 0; p < header.keyPages; p++, pid++) {
+    int n = min(keyBytes - p * PageFile::PAGE_SIZE, (int) PageFile::PAGE_SIZE);
+    memset(page, 0, sizeof(page));
+    memcpy(page, keys + p * PageFile::PAGE_SIZE, n);
+    if ((rc = pf.write(pid, page)) < 0) return rc;
+  }
+  for (int p = 0; p < header.valuePages; p++, pid++) {
+    int n = min((int) column.size() - p * PageFile::PAGE_SIZE, (int) PageFile::PAGE_SIZE);
+    memset(page, 0, sizeof(page));
+    memcpy(page, column.data() + p * PageFile::PAGE_SIZE, n);
+    if ((rc = pf.write(pid, page)) < 0) return rc;
+  }
+  if (!seal) {
+    tailDirty = false;
+    return 0;
+  }
+
+  Segment segment;
+  segment.pid = tailPid;
+  segment.rowCount = rows;
+  segment.keyPages = header.keyPages;
+  segment.valuePages = header.valuePages;
+  segment.minKey = header.minKey;
+  segment.maxKey = header.maxKey;
+  segment.dictionarySize = header.dictionarySize;
+  segments.push_back(segment);
+
+  tailPid = pid;
+  tailKeys.clear();
+  tailOffsets.clear();
+  tailValues.clear();
+  tailDirty = false;
+  return 0;
+}
+
+void ColumnFile::codeRange(const vector<char>& column, const Segment& segment,
+                           const ValueRange& range, int& lo, int& hi)
+{
+  // binary search the sorted dictionary for both ends of the range
+  int a = 0, b = segment.dictionarySize;
+  if (range.hasMin) {
+    while (a < b) {
+      int mid = (a + b) / 2;
+      int c = strcmp(dictionaryValue(column, segment, mid), range.minValue.c_str());
+      if (c < 0 || (c == 0 && !range.minInclusive)) a = mid + 1; else b = mid;
+    }
+  }
+  lo = a;
+
+  b = segment.dictionarySize;
+  if (range.hasMax) {
+    while (a < b) {
+      int mid = (a + b) / 2;
+      int c = strcmp(dictionaryValue(column, segment, mid), range.maxValue.c_str());
+      if (c < 0 || (c == 0 && range.maxInclusive)) a = mid + 1; else b = mid;
+    }
+  }
+  hi = b;
+}
@@ -0,0 +1,254 @@
+/*
+ * Tables stored column by column.
+ */
+
+#ifndef COLUMNFILE_H
+#define COLUMNFILE_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "PageFile.h"
+#include "RecordFile.h"
+#include "ValueIndex.h"
+
+/**
+ * A table file in the columnar format. The tuples are kept in segments
+ * of up to SEGMENT_ROWS tuples. A segment is a header page followed by
+ * its key column (the keys packed as ints, KEYS_PER_PAGE to a page) and
+ * its value column (the offsets of the values, then the NUL-terminated
+ * values back to back). The columns of a segment are read separately,
+ * so a scan that only needs the keys reads a small fraction of the file.
+ *
+ * The record id of a tuple is (the header page of its segment, its
+ * position in the segment). Tuples are appended in memory a segment at
+ * a time; the last segment is written when it is full or when the file
+ * is closed. Appending to an existing file continues its last segment.
+ *
+ * In dictionary mode (see setDictionary()) the value column of a
+ * segment may instead hold a dictionary: a 16-bit code per tuple, then
+ * the distinct values of the segment in sorted order. The codes keep
+ * the order of the values, so a range of values is a range of codes
+ * (see codeRange()). A segment keeps its values as they are when the
+ * dictionary would not be smaller.
+ */
+class ColumnFile {
+ public:
+  // the most tuples in a segment
+  static const int SEGMENT_ROWS = 4096;
+
+  // # keys in a page of the key column
+  static const int KEYS_PER_PAGE = PageFile::PAGE_SIZE / sizeof(int);
+
+  /**
+   * a segment of the file
+   */
+  struct Segment {
+    PageId pid;      // the header page of the segment
+    int rowCount;    // # tuples in the segment
+    int keyPages;    // # pages of the key column, after the header
+    int valuePages;  // # pages of the value column, after the keys
+    int minKey;      // the smallest key in the segment
+    int maxKey;      // the largest key in the segment
+    int dictionarySize;  // # values in the dictionary of the value
+                         // column. 0 if it holds the values themselves
+  };
+
+  ColumnFile();
+
+  /**
+   * open a file in read or write mode.
+   * when opened in 'w' mode, if the file does not exist, it is created.
+   * @param filename[IN] the name of the file to open
+   * @param mode[IN] 'r' for read, 'w' for write
+   * @param compress[IN] whether a file created by this call stores its
+   *                     pages compressed (see PageFile)
+   * @return error code. 0 if no error. RC_INVALID_FILE_FORMAT if the
+   *         file is not in the columnar format
+   */
+  RC open(const std::string& filename, char mode, bool compress = false);
+
+  /**
+   * write the last segment if it changed. the tuples appended after
+   * it go to the same segment unless it is full.
+   * @return error code. 0 if no error
+   */
+  RC flush();
+
+  /**
+   * write the last segment, if it changed, and close the file.
+   * @return error code. 0 if no error
+   */
+  RC close();
+
+  /**
+   * append n tuples to the last segment, starting a new one whenever
+   * it is full. the tuples are written when their segment is full,
+   * flushed or when the file is closed.
+   * @param n[IN] # tuples to append
+   * @param keys[IN] the keys of the tuples
+   * @param values[IN] the values of the tuples
+   * @param rids[OUT] the record ids of the tuples
+   * @return error code. 0 if no error
+   */
+  RC appendBatch(int n, const int* keys, const std::string* values, RecordId* rids);
+
+  /**
+   * encode the value column of the segments written from now on with a
+   * dictionary. a file opened with a dictionary-encoded segment is in
+   * dictionary mode already.
+   * @param on[IN] whether to use dictionaries
+   */
+  void setDictionary(bool on) { dictionary = on; }
+
+  /**
+   * @return whether the file is in dictionary mode
+   */
+  bool isDictionary() const { return dictionary; }
+
+  /**
+   * @return # tuples in the file, including those not written yet
+   */
+  int rowCount() const;
+
+  /**
+   * @return the page after the last page of the file, including the
+   *         pages of the last segment not written yet
+   */
+  PageId endPid() const;
+
+  /**
+   * @param s[IN] the segment number
+   * @param lo[IN] the smallest key wanted (inclusive)
+   * @param hi[IN] the largest key wanted (inclusive)
+   * @return whether segment s may hold a key in [lo, hi]
+   */
+  bool mayContain(int s, int lo, int hi) const
+  {
+    return segments[s].minKey <= hi && segments[s].maxKey >= lo;
+  }
+
+  /**
+   * @param lo[IN] the smallest key wanted (inclusive)
+   * @param hi[IN] the largest key wanted (inclusive)
+   * @param values[IN] whether the value columns are read too
+   * @return # pages read by a scan of the segments that may hold keys
+   *         in [lo, hi]. the segment headers are read when the file is
+   *         opened
+   */
+  int scanPageCount(int lo, int hi, bool values) const;
+
+  /**
+   * @return # segments written to the file
+   */
+  int segmentCount() const { return segments.size(); }
+
+  /**
+   * @param s[IN] the segment number. the first one is 0
+   * @return the header of segment s
+   */
+  const Segment& getSegment(int s) const { return segments[s]; }
+
+  /**
+   * read the key column of a segment.
+   * @param s[IN] the segment number
+   * @param keys[OUT] memory buffer of SEGMENT_ROWS ints
+   * @return error code. 0 if no error
+   */
+  RC readKeys(int s, int* keys) const;
+
+  /**
+   * read the value column of a segment. the values are taken from the
+   * column with value().
+   * @param s[IN] the segment number
+   * @param column[OUT] the value column
+   * @return error code. 0 if no error
+   */
+  RC readValues(int s, std::vector<char>& column) const;
+
+  /**
+   * @param column[IN] the value column returned by readValues()
+   * @param segment[IN] the segment of the column
+   * @param row[IN] the position of the tuple in the segment
+   * @return the NUL-terminated value of the tuple inside column
+   */
+  static const char* value(const std::vector<char>& column, const Segment& segment, int row)
+  {
+    if (segment.dictionarySize > 0) {
+      return dictionaryValue(column, segment, code(column, row));
+    }
+    const int* offsets = (const int*) &column[0];
+    return &column[(segment.rowCount + 1) * sizeof(int) + offsets[row]];
+  }
+
+  /**
+   * @param column[IN] a dictionary-encoded value column
+   * @param row[IN] the position of the tuple in the segment
+   * @return the dictionary code of the value of the tuple
+   */
+  static int code(const std::vector<char>& column, int row)
+  {
+    return ((const unsigned short*) &column[0])[row];
+  }
+
+  /**
+   * @param column[IN] a dictionary-encoded value column
+   * @param segment[IN] the segment of the column
+   * @param code[IN] a code of the dictionary
+   * @return the NUL-terminated value of the code inside column
+   */
+  static const char* dictionaryValue(const std::vector<char>& column, const Segment& segment,
+                                     int code)
+  {
+    int start = codeBytes(segment.rowCount);
+    const int* offsets = (const int*) &column[start];
+    return &column[start + (segment.dictionarySize + 1) * sizeof(int) + offsets[code]];
+  }
+
+  /**
+   * find the codes of the values of a range in a dictionary.
+   * @param column[IN] a dictionary-encoded value column
+   * @param segment[IN] the segment of the column
+   * @param range[IN] the values wanted
+   * @param lo[OUT] the first code in range
+   * @param hi[OUT] the code after the last code in range. not above lo
+   *                if no value of the dictionary is in range
+   */
+  static void codeRange(const std::vector<char>& column, const Segment& segment,
+                        const ValueRange& range, int& lo, int& hi);
+
+  /**
+   * @param rows[IN] # tuples in a segment
+   * @return # bytes of the codes of a dictionary-encoded value column,
+   *         padded for the offsets of the dictionary after them
+   */
+  static int codeBytes(int rows)
+  {
+    return (rows * sizeof(unsigned short) + sizeof(int) - 1) / sizeof(int) * sizeof(int);
+  }
+
+  /**
+   * @return the PageFile storing the tuples (for its read statistics)
+   */
+  const PageFile& getPageFile() const { return pf; }
+
+ private:
+  PageFile pf;                    // the PageFile storing the segments
+  std::vector<Segment> segments;  // the segments written to the file
+  bool dictionary;                // whether new segments get dictionaries
+
+  // the last segment, while tuples are appended to it
+  PageId tailPid;                 // its header page
+  std::vector<int> tailKeys;      // its keys
+  std::vector<int> tailOffsets;   // the offsets of its values
+  std::string tailValues;         // its values, NUL-terminated
+  bool tailDirty;                 // whether it changed since written
+
+  RC readTail();
+  RC writeTail(bool seal);
+
+  ColumnFile(const ColumnFile&);
+  ColumnFile& operator=(const ColumnFile&);
+};
+
+#endif /* COLUMNFILE_H */
@@ -0,0 +1,311 @@
+/*
+ * The programming interface of Bruinbase.
+ */
+
+#include <cctype>
+#include <time.h>
+#include "Database.h"
+#include "PageFile.h"
+#include "WriteAheadLog.h"
+
+using namespace std;
+
+// the write-ahead log in the directory of the tables
+static const char* LOG_FILE = "bruinbase.wal";
+
+// the key of a statement in the statement cache: its text with the runs
+// of white space outside string constants collapsed and the trailing
+// ';' dropped
+static string normalize(const string& sql)
+{
+  string text;
+  bool quoted = false;  // whether in a string constant
+  bool space = false;   // whether white space was skipped
+
+  for (unsigned i = 0; i < sql.size(); i++) {
+    char c = sql[i];
+    if (!quoted && isspace((unsigned char) c)) {
+      space = true;
+      continue;
+    }
+    if (space && !text.empty()) text += ' ';
+    space = false;
+    if (c == '\'') quoted = !quoted;
+    text += c;
+  }
+  while (!text.empty() && text[text.size() - 1] == ';') {
+    text.erase(text.size() - 1);
+  }
+  return text;
+}
+
+ResultCursor::ResultCursor()
+  : batch(NULL), pos(0), countOnly(false), count(0), done(true)
+{
+}
+
+RC ResultCursor::next()
+{
+  RC rc;
+
+  if (done) return RC_END_OF_SCAN;
+
+  // SELECT count(*): count the whole result at once. it is the only tuple.
+  if (countOnly) {
+    done = true;
+    count = 0;
+    while ((rc = select.next(batch)) == 0) {
+      count += batch->selSize;
+    }
+    return (rc == RC_END_OF_SCAN) ? 0 : rc;
+  }
+
+  if (batch != NULL && ++pos < batch->selSize) return 0;
+
+  if ((rc = select.next(batch)) < 0) {
+    batch = NULL;
+    done = true;
+    return rc;
+  }
+  pos = 0;
+  return 0;
+}
+
+int ResultCursor::key() const
+{
+  if (countOnly) return count;
+  return batch->keys[batch->sel[pos]];
+}
+
+const char* ResultCursor::value() const
+{
+  if (countOnly) return NULL;
+  return batch->values[batch->sel[pos]];
+}
+
+void ResultCursor::close()
+{
+  select.close();
+  arena.reset();
+  batch = NULL;
+  done = true;
+}
+
+Database::Database()
+{
+  stats.statements = 0;
+  stats.cacheHits = 0;
+  stats.pageReads = 0;
+  stats.seconds = 0;
+}
+
+// the directory name with a trailing '/', "" for the current directory
+static string dirPrefix(const string& dir)
+{
+  if (!dir.empty() && dir[dir.size() - 1] != '/') return dir + '/';
+  return dir;
+}
+
+RC Database::openLog(const string& dir)
+{
+  return WriteAheadLog::instance().open(dirPrefix(dir) + LOG_FILE);
+}
+
+RC Database::open(const string& dir)
+{
+  this->dir = dirPrefix(dir);
+  return 0;
+}
+
+RC Database::prepare(const string& sql, Statement& stmt)
+{
+  RC rc;
+  string text = normalize(sql);
+
+  error.clear();
+  map<string, Statement>::const_iterator it = statements.find(text);
+  if (it != statements.end()) {
+    stmt = it->second;
+    stats.cacheHits++;
+    return 0;
+  }
+
+  if ((rc = parser.parse(sql, stmt, error)) < 0) return rc;
+  stmt.text = text;
+
+  // keep the statements that are planned. start over when the cache is full.
+  if (stmt.kind == Statement::SELECT || stmt.kind == Statement::EXPLAIN ||
+      stmt.kind == Statement::PREPARE) {
+    if (statements.size() >= MAX_CACHED_STATEMENTS) {
+      statements.clear();
+      plans.clear();
+    }
+    statements[text] = stmt;
+  }
+  return 0;
+}
+
+RC Database::execute(const Statement& stmt)
+{
+  return execute(stmt, stdout);
+}
+
+RC Database::execute(const Statement& stmt, FILE* out)
+{
+  struct timespec begin, end;
+  int reads = PageFile::getThreadReadCount();
+  RC  rc;
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  rc = run(stmt, out);
+  arena.reset();
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  stats.statements++;
+  stats.pageReads += PageFile::getThreadReadCount() - reads;
+  stats.seconds += (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9;
+  return rc;
+}
+
+RC Database::run(const Statement& stmt, FILE* out)
+{
+  RC rc;
+  SelectCursor cursor;
+  Statement select;
+
+  error.clear();
+  switch (stmt.kind) {
+  case Statement::EMPTY:
+  case Statement::QUIT:
+    return 0;
+  case Statement::SELECT:
+  case Statement::EXPLAIN:
+    if ((rc = openCursor(stmt, cursor, arena)) < 0) return rc;
+    return SqlEngine::select(cursor, path(stmt.table),
+                             stmt.kind == Statement::EXPLAIN, stmt.analyze, out,
+                             settings);
+  case Statement::LOAD:
+    rc = SqlEngine::load(path(stmt.table), filePath(stmt.file), stmt.index, stmt.columns,
+                         stmt.bloom, stmt.valueIndex, stmt.dictionary,
+                         stmt.compress);
+    if (rc == RC_TABLE_IN_USE) error = "table " + stmt.table + " is read by an open cursor";
+    if (rc == RC_INVALID_STATEMENT) error = "table " + stmt.table + " is columnar and cannot have an index on value";
+    return rc;
+  case Statement::ANALYZE:
+    rc = SqlEngine::analyze(path(stmt.table));
+    if (rc == RC_TABLE_IN_USE) error = "table " + stmt.table + " is read by an open cursor";
+    return rc;
+  case Statement::SET:
+    return SqlEngine::set(stmt.name, stmt.value, settings);
+  case Statement::PREPARE:
+    if (prepared.count(stmt.name) > 0) {
+      error = "prepared statement " + stmt.name + " already exists";
+      return RC_INVALID_STATEMENT;
+    }
+    select = stmt;
+    select.kind = Statement::SELECT;
+    prepared[stmt.name] = select;
+    return 0;
+  case Statement::EXECUTE:
+    if ((rc = resolve(stmt, select)) < 0) return rc;
+    return run(select, out);
+  case Statement::DEALLOCATE:
+    if (prepared.erase(stmt.name) == 0) {
+      error = "prepared statement " + stmt.name + " does not exist";
+      return RC_INVALID_STATEMENT;
+    }
+    return 0;
+  }
+  return RC_INVALID_STATEMENT;
+}
+
+RC Database::query(const Statement& stmt, ResultCursor& cursor)
+{
+  RC rc;
+  Statement select;
+
+  cursor.close();
+  error.clear();
+  if (stmt.kind == Statement::EXECUTE) {
+    if ((rc = resolve(stmt, select)) < 0) return rc;
+    return query(select, cursor);
+  }
+  if (stmt.kind != Statement::SELECT) return RC_INVALID_STATEMENT;
+
+  if ((rc = openCursor(stmt, cursor.select, cursor.arena)) < 0) {
+    return rc;
+  }
+  cursor.countOnly = (stmt.attr == 4);
+  cursor.done = false;
+  return 0;
+}
+
+RC Database::query(const Statement& stmt, RowCallback callback, void* arg)
+{
+  RC rc;
+  ResultCursor cursor;
+
+  if ((rc = query(stmt, cursor)) < 0) return rc;
+  while ((rc = cursor.next()) == 0) {
+    if (!callback(arg, cursor.key(), cursor.value())) break;
+  }
+  return (rc == RC_END_OF_SCAN) ? 0 : rc;
+}
+
+// the prepared SELECT statement run by EXECUTE, with its parameter
+// values bound
+RC Database::resolve(const Statement& stmt, Statement& select)
+{
+  map<string, Statement>::const_iterator it = prepared.find(stmt.name);
+  if (it == prepared.end()) {
+    error = "prepared statement " + stmt.name + " does not exist";
+    return RC_INVALID_STATEMENT;
+  }
+  if (stmt.args.size() != it->second.params.size()) {
+    error = "wrong number of parameters for prepared statement " + stmt.name;
+    return RC_INVALID_STATEMENT;
+  }
+
+  select = it->second;
+  for (unsigned i = 0; i < stmt.args.size(); i++) {
+    select.bind(i + 1, stmt.args[i]);
+  }
+  return 0;
+}
+
+// open a cursor over a SELECT statement with the open table and, if
+// there is one for it, the cached generic plan of the statement. the
+// operators of the cursor are put in arena.
+RC Database::openCursor(const Statement& stmt, SelectCursor& cursor, Arena& arena)
+{
+  RC rc;
+  TableHandle* handle;
+  const QueryPlan* generic = NULL;
+
+  if (!stmt.isBound()) {
+    error = "no value is bound to a placeholder";
+    return RC_INVALID_STATEMENT;
+  }
+  if ((rc = Catalog::instance().open(path(stmt.table), handle)) < 0) {
+    if (rc == RC_INVALID_FILE_FORMAT) {
+      error = "table " + stmt.table + " is in an old file format. delete its files and load it again";
+    }
+    return rc;
+  }
+
+  map<string, CachedPlan>::const_iterator it = plans.find(stmt.text);
+  if (!stmt.text.empty() && it != plans.end() &&
+      it->second.version == handle->getVersion()) {
+    generic = &it->second.plan;
+  }
+
+  if ((rc = cursor.open(stmt.attr, *handle, stmt.conds, generic, &arena)) < 0) return rc;
+
+  // keep a plan that other values of the conditions can reuse
+  if (generic == NULL && !stmt.text.empty() && cursor.getPlan().isGeneric()) {
+    CachedPlan& cached = plans[stmt.text];
+    cached.version = handle->getVersion();
+    cached.plan = cursor.getPlan();
+  }
+  return 0;
+}
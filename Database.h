@@ -0,0 +1,220 @@
+/*
+ * The programming interface of Bruinbase.
+ */
+
+#ifndef DATABASE_H
+#define DATABASE_H
+
+#include <map>
+#include <string>
+#include "Bruinbase.h"
+#include "Arena.h"
+#include "Statement.h"
+#include "SelectCursor.h"
+#include "Catalog.h"
+#include "QueryPlan.h"
+
+/**
+ * The result of a SELECT statement, pulled one tuple at a time.
+ * The key and value of the current tuple are read straight from the
+ * pages of the table or index without copying them.
+ */
+class ResultCursor {
+ public:
+  ResultCursor();
+
+  /**
+   * move to the next tuple of the result.
+   * @return 0 if there is a tuple. RC_END_OF_SCAN at the end of the
+   *         result. Otherwise an error code.
+   */
+  RC next();
+
+  /**
+   * @return the key of the current tuple. for SELECT count(*), the
+   *         result has one tuple whose key is the count.
+   */
+  int key() const;
+
+  /**
+   * @return the value of the current tuple. NULL if the statement does
+   *         not look at the values (SELECT key without a condition on
+   *         the value). the value stays valid until next().
+   */
+  const char* value() const;
+
+  /**
+   * close the table and index read by the cursor.
+   */
+  void close();
+
+ private:
+  friend class Database;
+
+  Arena arena;              // the operators of select. outlives select
+  SelectCursor select;
+  const TupleBatch* batch;  // the batch of the current tuple
+  int  pos;                 // the current tuple in batch->sel
+  bool countOnly;           // SELECT count(*)
+  int  count;               // the result of SELECT count(*)
+  bool done;
+};
+
+/**
+ * A database: the tables stored in one directory. A Database object is
+ * used by one thread at a time; the threads of a server each use
+ * their own, which share the open tables.
+ *
+ *   Database db;
+ *   Statement stmt;
+ *   ResultCursor cursor;
+ *   Database::openLog("data");
+ *   db.open("data");
+ *   db.prepare("select * from movie where key = ?", stmt);
+ *   stmt.bind(1, 100);
+ *   db.query(stmt, cursor);
+ *   while (cursor.next() == 0) use(cursor.key(), cursor.value());
+ *
+ * The database caches what repeated statements would redo: the parsed
+ * statements (by their normalized text) and the plans that do not
+ * depend on the values of the conditions (see QueryPlan::isGeneric()).
+ * The tables stay open in the Catalog. A plan is used only with the
+ * table handle it was made for, so LOAD and ANALYZE make it replanned.
+ * The settings changed by SET are those of the database object alone.
+ */
+class Database {
+ public:
+  /**
+   * the work done by the statements of a database (session)
+   */
+  struct Stats {
+    unsigned long statements;   // # statements run by execute()
+    unsigned long cacheHits;    // # statements prepare() took from the cache
+    unsigned long pageReads;    // # disk page reads of the statements run
+    double seconds;             // the time taken by the statements run
+  };
+
+  /**
+   * a function receiving the tuples of a result.
+   * @param arg[IN] the argument given to query()
+   * @param key[IN] the key of the tuple
+   * @param value[IN] the value of the tuple, as ResultCursor::value()
+   * @return true to go on, false to stop the query
+   */
+  typedef bool (*RowCallback)(void* arg, int key, const char* value);
+
+  Database();
+
+  /**
+   * open the write-ahead log in a directory, which redoes the LOADs
+   * cut short by a crash (see WriteAheadLog). the process calls it
+   * once, before its databases run any statement.
+   * @param dir[IN] the directory of the table files. "" for the
+   *                current directory
+   * @return error code. 0 if no error
+   */
+  static RC openLog(const std::string& dir);
+
+  /**
+   * open the database in a directory. the relative name of a LOAD
+   * file is taken in the directory too.
+   * @param dir[IN] the directory of the table files. "" for the
+   *                current directory
+   * @return error code. 0 if no error
+   */
+  RC open(const std::string& dir);
+
+  /**
+   * parse a statement, or copy it from the statement cache.
+   * @param sql[IN] one statement
+   * @param stmt[OUT] the parsed statement
+   * @return error code. 0 if no error. getError() tells why the
+   *         statement could not be parsed.
+   */
+  RC prepare(const std::string& sql, Statement& stmt);
+
+  /**
+   * run a statement. the result of a SELECT or EXPLAIN is printed on
+   * stdout as on the command line.
+   * @param stmt[IN] the statement to run
+   * @return error code. 0 if no error
+   */
+  RC execute(const Statement& stmt);
+
+  /**
+   * run a statement and print the result of a SELECT or EXPLAIN on out.
+   * @param stmt[IN] the statement to run
+   * @param out[IN] the stream to print to
+   * @return error code. 0 if no error
+   */
+  RC execute(const Statement& stmt, FILE* out);
+
+  /**
+   * run a SELECT statement and open a cursor over its result.
+   * the cursor keeps the table open until it is closed. until then, a
+   * LOAD or ANALYZE of the table by the same thread fails with
+   * RC_TABLE_IN_USE, and the other threads wait to load it.
+   * @param stmt[IN] the SELECT statement, or EXECUTE of a prepared one
+   * @param cursor[OUT] the cursor over the result
+   * @return error code. 0 if no error
+   */
+  RC query(const Statement& stmt, ResultCursor& cursor);
+
+  /**
+   * run a SELECT statement and pass each tuple of its result to callback.
+   * @param stmt[IN] the SELECT statement, or EXECUTE of a prepared one
+   * @param callback[IN] the function to call for each tuple
+   * @param arg[IN] the argument passed to callback
+   * @return error code. 0 if no error
+   */
+  RC query(const Statement& stmt, RowCallback callback, void* arg);
+
+  /**
+   * @return the message of the last error of prepare(), or of a
+   *         prepared statement run by execute() or query()
+   */
+  const std::string& getError() const { return error; }
+
+  /**
+   * @return the statistics of the statements of this database object.
+   *         the other sessions do not add to them.
+   */
+  const Stats& getStats() const { return stats; }
+
+ private:
+  // # statements kept in the statement cache
+  static const unsigned MAX_CACHED_STATEMENTS = 1024;
+
+  // a generic plan and the version of the table handle it was made for
+  struct CachedPlan {
+    unsigned long version;
+    QueryPlan plan;
+  };
+
+  std::string dir;    // the directory of the tables, with a trailing '/'
+  std::string error;  // the last error
+  Stats stats;
+  SqlEngine::Settings settings;  // changed by SET
+  StatementParser parser;
+  Arena arena;        // the temporaries of the statement run by execute()
+
+  std::map<std::string, Statement> statements;   // parsed, by normalized text
+  std::map<std::string, CachedPlan> plans;       // by normalized text
+  std::map<std::string, Statement> prepared;     // by name (PREPARE)
+
+  std::string path(const std::string& table) const { return dir + table; }
+
+  // a file named by a statement: relative to the directory of the tables
+  std::string filePath(const std::string& file) const {
+    return (!file.empty() && file[0] == '/') ? file : dir + file;
+  }
+
+  RC run(const Statement& stmt, FILE* out);
+  RC resolve(const Statement& stmt, Statement& select);
+  RC openCursor(const Statement& stmt, SelectCursor& cursor, Arena& arena);
+
+  Database(const Database&);
+  Database& operator=(const Database&);
+};
+
+#endif /* DATABASE_H */
@@ -0,0 +1,150 @@
+/*
+ * A byte-oriented LZ codec for compressing pages.
+ */
+
+#include <cstring>
+#include "PageCodec.h"
+
+// the farthest match, and the size of the table of recent positions
+static const int MAX_OFFSET = 65535;
+static const int HASH_BITS = 10;
+
+// the search steps over more bytes the longer it finds no match, so
+// that bytes that do not compress are passed over quickly
+static const int SKIP_SHIFT = 4;
+
+// the slot of the 4 bytes at p in the table of recent positions
+static unsigned hashAt(const char* p)
+{
+  unsigned v;
+  memcpy(&v, p, sizeof(v));
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// # bytes of a length of n after the 15 of its token
+static int lengthBytes(int n)
+{
+  return (n >= 15) ? (n - 15) / 255 + 1 : 0;
+}
+
+// write a length of n after the 15 of its token
+static void putLength(unsigned char* dst, int& out, int n)
+{
+  for (n -= 15; n >= 255; n -= 255) dst[out++] = 255;
+  dst[out++] = n;
+}
+
+// read the length bytes after a token part of 15 into n.
+// false if src ends first
+static bool getLength(const unsigned char* src, int& in, int length, int& n)
+{
+  unsigned char b;
+  do {
+    if (in >= length) return false;
+    b = src[in++];
+    n += b;
+  } while (b == 255);
+  return true;
+}
+
+// write a sequence of literals and a match (none if matchLength is 0).
+// false if it does not fit in capacity
+static bool putSequence(unsigned char* dst, int& out, int capacity, const char* literals,
+                        int literalLength, int offset, int matchLength)
+{
+  int m = (matchLength > 0) ? matchLength - PageCodec::MIN_MATCH : 0;
+  int need = 1 + lengthBytes(literalLength) + literalLength;
+  if (matchLength > 0) need += 2 + lengthBytes(m);
+  if (out + need > capacity) return false;
+
+  dst[out++] = ((literalLength < 15 ? literalLength : 15) << 4) | (m < 15 ? m : 15);
+  if (literalLength >= 15) putLength(dst, out, literalLength);
+  memcpy(dst + out, literals, literalLength);
+  out += literalLength;
+  if (matchLength == 0) return true;
+
+  dst[out++] = offset & 0xff;
+  dst[out++] = offset >> 8;
+  if (m >= 15) putLength(dst, out, m);
+  return true;
+}
+
+int PageCodec::compress(const char* src, int n, char* dst, int capacity)
+{
+  unsigned char* out = (unsigned char*) dst;
+  int recent[1 << HASH_BITS];  // the last position of each hashed 4 bytes
+  int length = 0;
+  int anchor = 0;              // the first byte not written yet
+  int pos = 0;
+  int misses = 0;              // # positions tried since the last match
+
+  memset(recent, 0xff, sizeof(recent));
+  while (pos + MIN_MATCH <= n) {
+    unsigned h = hashAt(src + pos);
+    int candidate = recent[h];
+    recent[h] = pos;
+    if (candidate < 0 || pos - candidate > MAX_OFFSET ||
+        memcmp(src + candidate, src + pos, MIN_MATCH) != 0) {
+      pos += 1 + (misses++ >> SKIP_SHIFT);
+      continue;
+    }
+    misses = 0;
+
+    // extend the match as far as it goes both ways. it may overlap the
+    // bytes it repeats
+    int matchLength = MIN_MATCH;
+    while (pos + matchLength < n && src[candidate + matchLength] == src[pos + matchLength]) {
+      matchLength++;
+    }
+    while (pos > anchor && candidate > 0 && src[pos - 1] == src[candidate - 1]) {
+      pos--;
+      candidate--;
+      matchLength++;
+    }
+    if (!putSequence(out, length, capacity, src + anchor, pos - anchor, pos - candidate,
+                     matchLength)) return 0;
+    pos += matchLength;
+    anchor = pos;
+  }
+
+  // the bytes after the last match
+  if (!putSequence(out, length, capacity, src + anchor, n - anchor, 0, 0)) return 0;
+  return length;
+}
+
+RC PageCodec::decompress(const char* src, int length, char* dst, int n)
+{
+  const unsigned char* in = (const unsigned char*) src;
+  int i = 0;
+  int out = 0;
+
+  while (i < length) {
+    int token = in[i++];
+
+    int literalLength = token >> 4;
+    if (literalLength == 15 && !getLength(in, i, length, literalLength)) {
+      return RC_INVALID_FILE_FORMAT;
+    }
+    if (literalLength > length - i || literalLength > n - out) return RC_INVALID_FILE_FORMAT;
+    memcpy(dst + out, in + i, literalLength);
+    i += literalLength;
+    out += literalLength;
+
+    // the last sequence has no match
+    if (i == length) break;
+
+    if (length - i < 2) return RC_INVALID_FILE_FORMAT;
+    int offset = in[i] | (in[i + 1] << 8);
+    i += 2;
+    int matchLength = token & 15;
+    if (matchLength == 15 && !getLength(in, i, length, matchLength)) {
+      return RC_INVALID_FILE_FORMAT;
+    }
+    matchLength += MIN_MATCH;
+    if (offset == 0 || offset > out || matchLength > n - out) return RC_INVALID_FILE_FORMAT;
+
+    // copy byte by byte: the match may overlap its own output
+    for (int k = 0; k < matchLength; k++, out++) dst[out] = dst[out - offset];
+  }
+  return (out == n) ? 0 : RC_INVALID_FILE_FORMAT;
+}
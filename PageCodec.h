@@ -0,0 +1,46 @@
+/*
+ * A byte-oriented LZ codec for compressing pages.
+ */
+
+#ifndef PAGECODEC_H
+#define PAGECODEC_H
+
+#include "Bruinbase.h"
+
+/**
+ * Compresses a page into a sequence of (literals, match) pairs in the
+ * style of LZ4: each sequence is a token byte (the # literals in its
+ * high 4 bits and the match length - MIN_MATCH in its low 4 bits, 15
+ * meaning that more length bytes follow), the literals, and the 2-byte
+ * offset of the match back into the output. The last sequence has
+ * literals only. Runs of one byte, such as the free space of a page,
+ * become a single match of offset 1.
+ */
+class PageCodec {
+ public:
+  // the shortest match
+  static const int MIN_MATCH = 4;
+
+  /**
+   * compress n bytes.
+   * @param src[IN] the bytes to compress
+   * @param n[IN] # bytes of src
+   * @param dst[OUT] memory buffer of capacity bytes
+   * @param capacity[IN] the most bytes to write to dst
+   * @return # bytes written to dst. 0 if they do not fit in capacity
+   */
+  static int compress(const char* src, int n, char* dst, int capacity);
+
+  /**
+   * decompress the output of compress().
+   * @param src[IN] the compressed bytes
+   * @param length[IN] # bytes of src
+   * @param dst[OUT] memory buffer of n bytes
+   * @param n[IN] # bytes that src was compressed from
+   * @return error code. 0 if no error. RC_INVALID_FILE_FORMAT if src is
+   *         not n compressed bytes
+   */
+  static RC decompress(const char* src, int length, char* dst, int n);
+};
+
+#endif /* PAGECODEC_H */
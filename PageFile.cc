@@ -9,32 +9,93 @@
 
 #include "Bruinbase.h"
 #include "PageFile.h"
+#include "PageCodec.h"
+#include "WriteAheadLog.h"
+#include <algorithm>
+#include <climits>
 #include <cstring>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 using std::string;
+using std::vector;
+using std::pair;
+
+//
+// a compressed file:
+//   unit 0:  the header below
+//   unit 1-: the images of the pages and the indirection map, an Extent
+//            per page, wherever they were placed
+//
+typedef struct {
+  int    format;     // COMPRESSED_FORMAT
+  PageId endPid;     // # pages
+  int    dataEnd;    // the unit after the last one used
+  int    mapOffset;  // the first unit of the map
+  int    mapLength;  // # bytes of the map
+} CompressedHeader;
+
+static const int COMPRESSED_FORMAT = 0x5a504642;
+
+// the map is written again when the places waiting for it take more
+// than MAP_WRITE_RATIO times its size, and at least MIN_PENDING_UNITS
+static const int MAP_WRITE_RATIO = 4;
+static const int MIN_PENDING_UNITS = 256;
+
+// a file is compacted when it is closed if more than 1/COMPACT_RATIO
+// of it is free, in at most MAX_COMPACT_ROUNDS rounds
+static const int COMPACT_RATIO = 8;
+static const int MAX_COMPACT_ROUNDS = 8;
+
+// the most units taken by a page
+static const int PAGE_UNITS = PageFile::PAGE_SIZE / PageFile::UNIT_SIZE;
+
+// # units taken by n bytes
+static int unitCount(int n)
+{
+  return (n + PageFile::UNIT_SIZE - 1) / PageFile::UNIT_SIZE;
+}
 
 int PageFile::readCount = 0;
+__thread int PageFile::threadReads = 0;
+__thread const PageFile* PageFile::watchedIndex = NULL;
+__thread const PageFile* PageFile::watchedHeap = NULL;
+__thread int PageFile::indexReads = 0;
+__thread int PageFile::heapReads = 0;
+__thread int PageFile::watchedHits = 0;
 int PageFile::writeCount = 0;
+int PageFile::hitCount = 0;
 int PageFile::cacheClock = 1;
+pthread_mutex_t PageFile::cacheLock = PTHREAD_MUTEX_INITIALIZER;
 struct PageFile::cacheStruct PageFile::readCache[PageFile::CACHE_COUNT];
 
 PageFile::PageFile() 
 { 
   fd = -1; 
   epid = 0; 
+  compressed = mapDirty = false;
+  dataEnd = mapOffset = mapLength = pendingUnits = 0;
+  loggedEpoch = -1;
+  inLog = false;
+  txnEpid = 0;
+  dropWrites = false;
 }
 
 PageFile::PageFile(const string& filename, char mode)
 {
   fd = -1;
   epid = 0;
+  compressed = mapDirty = false;
+  dataEnd = mapOffset = mapLength = pendingUnits = 0;
+  loggedEpoch = -1;
+  inLog = false;
+  txnEpid = 0;
+  dropWrites = false;
   open(filename.c_str(), mode);
 }
 
-RC PageFile::open(const string& filename, char mode)
+RC PageFile::open(const string& filename, char mode, bool compress)
 {
   RC   rc;
   int  oflag;
@@ -64,18 +125,116 @@ RC PageFile::open(const string& filename, char mode)
   rc = ::fstat(fd, &statbuf);
   if (rc < 0) { ::close(fd); fd = -1; return RC_FILE_OPEN_FAILED; }
   epid = statbuf.st_size / PAGE_SIZE;
+  name = filename;
+
+  // a compressed file starts with its header. a new file is created
+  // compressed if asked
+  compressed = false;
+  bool writable = (oflag & O_RDWR) != 0;
+  if ((statbuf.st_size == 0 && compress && writable) ||
+      statbuf.st_size >= (off_t) sizeof(CompressedHeader)) {
+    if ((rc = openCompressed(statbuf.st_size == 0, writable)) < 0) {
+      ::close(fd);
+      fd = -1;
+      return rc;
+    }
+  }
+
+  return 0;
+}
+
+// set up a new compressed file, or read the header and the map of a
+// file if it is compressed
+RC PageFile::openCompressed(bool create, bool writable)
+{
+  CompressedHeader header;
+
+  extents.clear();
+  freeSpace.clear();
+  freeBySize.clear();
+  pending.clear();
+  pendingUnits = 0;
+  mapDirty = false;
+
+  if (create) {
+    compressed = true;
+    epid = 0;
+    dataEnd = 1;
+    mapOffset = mapLength = 0;
+    return writeMap();
+  }
+
+  if (::pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+    return RC_FILE_READ_FAILED;
+  }
+  if (header.format != COMPRESSED_FORMAT) return 0;
+  if (header.endPid < 0 || header.mapLength != (int) (header.endPid * sizeof(Extent))) {
+    return RC_INVALID_FILE_FORMAT;
+  }
+
+  compressed = true;
+  epid = header.endPid;
+  dataEnd = header.dataEnd;
+  mapOffset = header.mapOffset;
+  mapLength = header.mapLength;
+  extents.resize(epid);
+  if (mapLength > 0 &&
+      ::pread(fd, &extents[0], mapLength, (off_t) mapOffset * UNIT_SIZE) != mapLength) {
+    extents.clear();
+    return RC_FILE_READ_FAILED;
+  }
+  if (!writable) return 0;
+
+  // the space that neither a page nor the map takes is free
+  vector<pair<int, int> > used;
+  for (PageId pid = 0; pid < epid; pid++) {
+    if (extents[pid].units > 0) used.push_back(pair<int, int>(extents[pid].offset, extents[pid].units));
+  }
+  if (mapLength > 0) used.push_back(pair<int, int>(mapOffset, unitCount(mapLength)));
+  sort(used.begin(), used.end());
 
+  int next = 1;
+  for (unsigned i = 0; i < used.size(); i++) {
+    if (used[i].first > next) release(next, used[i].first - next);
+    next = std::max(next, used[i].first + used[i].second);
+  }
+  dataEnd = next;
   return 0;
 }
 
 RC PageFile::close()
 {
+  RC rc = 0;
+
   if (fd <= 0) return RC_FILE_CLOSE_FAILED;
 
+  // the log stops tracking the file once it is synced
+  if (inLog) rc = WriteAheadLog::instance().closeFile(*this);
+  dirtyPids.clear();
+  dirtyPages.clear();
+  dirtySlots.clear();
+  logged.clear();
+  inLog = false;
+  dropWrites = false;
+
+  // the map goes to the file before it is closed. the free space at
+  // the end of the file is cut off
+  if (rc == 0 && compressed && mapDirty && (rc = compact()) == 0 &&
+      ::ftruncate(fd, (off_t) dataEnd * UNIT_SIZE) < 0) {
+    rc = RC_FILE_WRITE_FAILED;
+  }
+  compressed = mapDirty = false;
+  extents.clear();
+  freeSpace.clear();
+  freeBySize.clear();
+  pending.clear();
+  pendingUnits = 0;
+
   // close the file
   if (::close(fd) < 0) return RC_FILE_CLOSE_FAILED;
 
   // evict all cached pages for this file
+  pthread_mutex_lock(&cacheLock);
   for (int i = 0; i < CACHE_COUNT; i++) {
     if (readCache[i].fd == fd && readCache[i].lastAccessed != 0) {
        readCache[i].fd = 0;
@@ -83,11 +242,12 @@ RC PageFile::close()
        readCache[i].lastAccessed = 0;
     }
   }
+  pthread_mutex_unlock(&cacheLock);
 
   // set the fd and epid to the initial state
   fd = -1; 
   epid = 0;
-  return 0;
+  return rc;
 }
 
 PageId PageFile::endPid() const 
@@ -95,23 +255,64 @@ PageId PageFile::endPid() const
   return epid;
 }
 
-RC PageFile::seek(PageId pid) const
+void PageFile::watchFiles(const PageFile* index, const PageFile* heap)
+{
+  watchedIndex = index;
+  watchedHeap = heap;
+}
+
+void PageFile::getWatchedReads(int& indexReads, int& heapReads, int& hits)
 {
-  return (::lseek(fd, pid * PAGE_SIZE, SEEK_SET) < 0) ? RC_FILE_SEEK_FAILED : 0;
+  indexReads = PageFile::indexReads;
+  heapReads = PageFile::heapReads;
+  hits = watchedHits;
+}
+
+void PageFile::prefetch(PageId pid, int count) const
+{
+  if (fd < 0 || count <= 0) return;
+  if (!compressed) {
+    posix_fadvise(fd, (off_t) pid * PAGE_SIZE, (off_t) count * PAGE_SIZE, POSIX_FADV_WILLNEED);
+    return;
+  }
+
+  // the units holding the images of the pages
+  int lo = INT_MAX, hi = 0;
+  for (PageId p = std::max(pid, 0); p < pid + count && p < epid; p++) {
+    if (extents[p].length == 0) continue;
+    lo = std::min(lo, extents[p].offset);
+    hi = std::max(hi, extents[p].offset + unitCount(extents[p].length));
+  }
+  if (lo < hi) {
+    posix_fadvise(fd, (off_t) lo * UNIT_SIZE, (off_t) (hi - lo) * UNIT_SIZE, POSIX_FADV_WILLNEED);
+  }
 }
 
 RC PageFile::write(PageId pid, const void* buffer)
 {
-  RC rc;
   if (pid < 0) return RC_INVALID_PID; 
 
-  // seek to the location of the page
-  if ((rc = seek(pid)) < 0) return rc;
+  // a transaction keeps its pages until it commits. the file of an
+  // aborted transaction takes no more pages
+  if (dropWrites) return 0;
+  if (WriteAheadLog::inTransaction()) return logWrite(pid, buffer);
+  return writePage(pid, buffer);
+}
+
+// write a page to the disk
+RC PageFile::writePage(PageId pid, const void* buffer)
+{
+  RC rc;
 
   // write the buffer to the disk page
-  if (::write(fd, buffer, PAGE_SIZE) < 0) return RC_FILE_WRITE_FAILED;
+  if (compressed) {
+    if ((rc = writeImage(pid, buffer)) < 0) return rc;
+  } else if (::pwrite(fd, buffer, PAGE_SIZE, (off_t) pid * PAGE_SIZE) < 0) {
+    return RC_FILE_WRITE_FAILED;
+  }
 
   // if the page is in read cache, invalidate it
+  pthread_mutex_lock(&cacheLock);
   for (int i = 0; i < CACHE_COUNT; i++) {
     if (readCache[i].fd == fd && readCache[i].pid == pid &&
         readCache[i].lastAccessed != 0) {
@@ -122,39 +323,139 @@ RC PageFile::write(PageId pid, const void* buffer)
     }
   }
 
+  // increase page write count
+  writeCount++;
+  pthread_mutex_unlock(&cacheLock);
+
   // if the written pid >= end pid, update the end pid
   if (pid >= epid) epid = pid + 1;
 
-  // increase page write count
-  writeCount++;
+  return 0;
+}
+
+// log a page written in a transaction and keep it until the
+// transaction commits. the change is logged against the page as it was
+// before, except the first time the page is written since the last
+// checkpoint, when its whole image is logged
+RC PageFile::logWrite(PageId pid, const void* buffer)
+{
+  RC rc;
+  WriteAheadLog& log = WriteAheadLog::instance();
+  char page[PAGE_SIZE];
+  const char* before = NULL;
 
+  if (dirtyPids.empty()) txnEpid = epid;
+  if (loggedEpoch != log.getEpoch()) {
+    logged.clear();
+    loggedEpoch = log.getEpoch();
+  }
+  if (pid >= (PageId) dirtySlots.size()) {
+    dirtySlots.resize(pid + 1, -1);
+    logged.resize(pid + 1, false);
+  }
+  int slot = dirtySlots[pid];
+  if (logged[pid]) {
+    if (slot >= 0) {
+      before = &dirtyPages[slot * PAGE_SIZE];
+    } else if (read(pid, page) == 0) {
+      before = page;
+    }
+  }
+  if ((rc = log.append(*this, pid, before, (const char*) buffer)) < 0) return rc;
+
+  logged[pid] = true;
+  if (slot < 0) {
+    slot = dirtySlots[pid] = dirtyPids.size();
+    dirtyPids.push_back(pid);
+    dirtyPages.resize(dirtyPages.size() + PAGE_SIZE);
+  }
+  memcpy(&dirtyPages[slot * PAGE_SIZE], buffer, PAGE_SIZE);
+  inLog = true;
+
+  if (pid >= epid) epid = pid + 1;
   return 0;
 }
 
-RC PageFile::read(PageId pid, void* buffer) const
+// write the pages of a committed transaction to the disk, in the order
+// of their ids. with discard, drop them instead, and the file ends where
+// it did before the transaction
+RC PageFile::writeBack(bool discard)
+{
+  RC rc = 0;
+  vector<PageId> pids;
+
+  if (discard) {
+    if (!dirtyPids.empty()) epid = txnEpid;
+    logged.clear();
+    dropWrites = true;
+  }
+  pids.swap(dirtyPids);
+  std::sort(pids.begin(), pids.end());
+  for (unsigned i = 0; i < pids.size(); i++) {
+    int slot = dirtySlots[pids[i]];
+    dirtySlots[pids[i]] = -1;
+    if (rc == 0 && !discard) rc = writePage(pids[i], &dirtyPages[slot * PAGE_SIZE]);
+  }
+  dirtyPages.clear();
+  return rc;
+}
+
+// make what was written to the file durable: the map of a compressed
+// file, then the pages
+RC PageFile::sync()
 {
   RC rc;
+  if (compressed && mapDirty && (rc = writeMap()) < 0) return rc;
+  return (::fdatasync(fd) < 0) ? RC_FILE_WRITE_FAILED : 0;
+}
 
+RC PageFile::read(PageId pid, void* buffer) const
+{
   if (pid < 0 || pid >= epid) return RC_INVALID_PID; 
 
+  // the pages of the running transaction are in memory
+  if (pid < (PageId) dirtySlots.size() && dirtySlots[pid] >= 0) {
+    memcpy(buffer, &dirtyPages[dirtySlots[pid] * PAGE_SIZE], PAGE_SIZE);
+    return 0;
+  }
+
   //
   // if the page is in cache, read it from there
   //
+  pthread_mutex_lock(&cacheLock);
   for (int i = 0; i < CACHE_COUNT; i++) {
     if (readCache[i].fd == fd && readCache[i].pid == pid && 
         readCache[i].lastAccessed != 0) {
        memcpy(buffer, readCache[i].buffer, PAGE_SIZE);
        readCache[i].lastAccessed = ++cacheClock;
+       hitCount++;
+       if (this == watchedIndex || this == watchedHeap) watchedHits++;
+       pthread_mutex_unlock(&cacheLock);
        return 0;
     }
   }
+  pthread_mutex_unlock(&cacheLock);
+
+  // read the page without holding the lock so that
+  // other threads can read their pages at the same time
+  if (compressed) {
+    RC rc = readImage(pid, buffer);
+    if (rc < 0) return rc;
+  } else if (::pread(fd, buffer, PAGE_SIZE, (off_t) pid * PAGE_SIZE) < 0) {
+    return RC_FILE_READ_FAILED;
+  }
+
+  pthread_mutex_lock(&cacheLock);
 
-  // seek to the page
-  if ((rc = seek(pid)) < 0) return rc;
-  
-  // find the cache slot to evict
+  // find the cache slot to evict, unless another thread
+  // has cached the page while we were reading it
   int toEvict = 0; 
   for (int i = 0; i < CACHE_COUNT; i++) {
+    if (readCache[i].fd == fd && readCache[i].pid == pid &&
+        readCache[i].lastAccessed != 0) {
+      toEvict = i;
+      break;
+    }
     if (readCache[i].lastAccessed == 0) {
       toEvict = i;
       break;
@@ -166,15 +467,248 @@ RC PageFile::read(PageId pid, void* buffer) const
   readCache[toEvict].fd = fd;
   readCache[toEvict].pid = pid;
   readCache[toEvict].lastAccessed = ++cacheClock;
- 
-  // read the page to cache first and copy it to the buffer
-  if (::read(fd, readCache[toEvict].buffer, PAGE_SIZE) < 0) {
-    return RC_FILE_READ_FAILED;
-  }
-  memcpy(buffer, readCache[toEvict].buffer, PAGE_SIZE);
+  memcpy(readCache[toEvict].buffer, buffer, PAGE_SIZE);
 
   // increase the page read count
   readCount++;
+  threadReads++;
+  if (this == watchedIndex) {
+    indexReads++;
+  } else if (this == watchedHeap) {
+    heapReads++;
+  }
+
+  pthread_mutex_unlock(&cacheLock);
+
+  return 0;
+}
+
+// read the image of a page of a compressed file and decompress it
+RC PageFile::readImage(PageId pid, void* buffer) const
+{
+  // a page never written reads as zeros, as in a sparse file
+  if (pid >= (PageId) extents.size() || extents[pid].length == 0) {
+    memset(buffer, 0, PAGE_SIZE);
+    return 0;
+  }
 
+  const Extent& extent = extents[pid];
+  off_t offset = (off_t) extent.offset * UNIT_SIZE;
+  char image[PAGE_SIZE];
+
+  if (extent.length == PAGE_SIZE) {
+    return (::pread(fd, buffer, PAGE_SIZE, offset) < 0) ? RC_FILE_READ_FAILED : 0;
+  }
+  if (::pread(fd, image, extent.length, offset) != extent.length) return RC_FILE_READ_FAILED;
+  return PageCodec::decompress(image, extent.length, (char*) buffer, PAGE_SIZE);
+}
+
+// compress a page and write its image in its place, or in a new place
+// if it does not fit. a page that does not compress is stored as it is
+RC PageFile::writeImage(PageId pid, const void* buffer)
+{
+  char image[PAGE_SIZE];
+  const char* data = image;
+  int length = PageCodec::compress((const char*) buffer, PAGE_SIZE, image, PAGE_SIZE - 1);
+  if (length == 0) {
+    data = (const char*) buffer;
+    length = PAGE_SIZE;
+  }
+
+  if (pid >= (PageId) extents.size()) {
+    Extent none = { 0, 0, 0 };
+    extents.resize(pid + 1, none);
+  }
+  Extent& extent = extents[pid];
+  int units = unitCount(length);
+  bool moved = (extent.units < units);
+  if (moved) {
+    // a page that grew is likely to grow again. it gets a unit to spare
+    int capacity = units;
+    if (extent.units > 0) {
+      leave(extent.offset, extent.units);
+      capacity = std::min(units + 1, PAGE_UNITS);
+    }
+    extent.offset = allocate(capacity);
+    extent.units = capacity;
+  } else if (extent.units > units + 1) {
+    leave(extent.offset + units, extent.units - units);
+    extent.units = units;
+  }
+  extent.length = length;
+  mapDirty = true;
+
+  if (::pwrite(fd, data, length, (off_t) extent.offset * UNIT_SIZE) < 0) {
+    return RC_FILE_WRITE_FAILED;
+  }
+
+  // let the places left behind be reused once there are many of them
+  int mapUnits = unitCount(extents.size() * sizeof(Extent));
+  if (moved && pendingUnits > std::max(MIN_PENDING_UNITS, MAP_WRITE_RATIO * mapUnits)) {
+    return writeMap();
+  }
   return 0;
 }
+
+// write the map to a free place, then the header pointing to it. the
+// places left since the last map was written, and that map, are free
+// from then on. the map is on the disk before the header points to it,
+// and the header before the places the old map names are reused, so
+// that a crash leaves a map whose pages are all in their places
+RC PageFile::writeMap()
+{
+  CompressedHeader header;
+  char unit[UNIT_SIZE];
+  int length = extents.size() * sizeof(Extent);
+  int offset = (length > 0) ? allocateBefore(unitCount(length), dataEnd) : dataEnd;
+  if (offset < 0) offset = allocate(unitCount(length));
+
+  if (length > 0 && ::pwrite(fd, &extents[0], length, (off_t) offset * UNIT_SIZE) < 0) {
+    return RC_FILE_WRITE_FAILED;
+  }
+  if (::fdatasync(fd) < 0) return RC_FILE_WRITE_FAILED;
+  for (unsigned i = 0; i < pending.size(); i++) release(pending[i].first, pending[i].second);
+  pending.clear();
+  pendingUnits = 0;
+
+  header.format = COMPRESSED_FORMAT;
+  header.endPid = extents.size();
+  header.dataEnd = dataEnd;
+  header.mapOffset = offset;
+  header.mapLength = length;
+  memset(unit, 0, sizeof(unit));
+  memcpy(unit, &header, sizeof(header));
+  if (::pwrite(fd, unit, UNIT_SIZE, 0) < 0 || ::fdatasync(fd) < 0) return RC_FILE_WRITE_FAILED;
+
+  if (mapLength > 0) {
+    pending.push_back(pair<int, int>(mapOffset, unitCount(mapLength)));
+    pendingUnits = unitCount(mapLength);
+  }
+
+  mapOffset = offset;
+  mapLength = length;
+  mapDirty = false;
+  return 0;
+}
+
+// move the pages at the end of the file into the first free places before
+// them so that the file can be cut short. a page only moves to a place
+// that the map on disk does not name, and the map is written after
+// each round so that the places left in it can be taken by the next
+RC PageFile::compact()
+{
+  RC rc;
+  char image[PAGE_SIZE];
+
+  for (int round = 0; ; round++) {
+    if ((rc = writeMap()) < 0) return rc;
+
+    // stop when little would be gained
+    int freeUnits = 0;
+    for (std::map<int, int>::iterator it = freeSpace.begin(); it != freeSpace.end(); ++it) {
+      freeUnits += it->second;
+    }
+    if (round == MAX_COMPACT_ROUNDS || freeUnits * COMPACT_RATIO < dataEnd) return 0;
+
+    // the pages from the end of the file backward
+    vector<pair<int, PageId> > order;
+    for (PageId pid = 0; pid < (PageId) extents.size(); pid++) {
+      if (extents[pid].units > 0) order.push_back(pair<int, PageId>(extents[pid].offset, pid));
+    }
+    std::sort(order.rbegin(), order.rend());
+
+    int moved = 0;
+    for (unsigned i = 0; i < order.size(); i++) {
+      Extent& extent = extents[order[i].second];
+      int units = unitCount(extent.length);
+      int offset = allocateBefore(units, extent.offset);
+      if (offset < 0) continue;
+
+      if (::pread(fd, image, extent.length, (off_t) extent.offset * UNIT_SIZE) != extent.length) {
+        return RC_FILE_READ_FAILED;
+      }
+      if (::pwrite(fd, image, extent.length, (off_t) offset * UNIT_SIZE) < 0) {
+        return RC_FILE_WRITE_FAILED;
+      }
+      leave(extent.offset, extent.units);
+      extent.offset = offset;
+      extent.units = units;
+      mapDirty = true;
+      moved++;
+    }
+    // the place of the map before the one this round wrote is free
+    // once the map is written again
+    if (moved == 0) return writeMap();
+  }
+}
+
+// take a place of the given # units from the smallest free place that
+// holds it, or from the end of the file
+int PageFile::allocate(int units)
+{
+  std::set<pair<int, int> >::iterator it = freeBySize.lower_bound(pair<int, int>(units, 0));
+  if (it == freeBySize.end()) {
+    int offset = dataEnd;
+    dataEnd += units;
+    return offset;
+  }
+  return take(it->second, it->first, units);
+}
+
+// take a place of the given # units from the first free place before
+// limit that holds it. -1 if there is none
+int PageFile::allocateBefore(int units, int limit)
+{
+  for (std::map<int, int>::iterator it = freeSpace.begin();
+       it != freeSpace.end() && it->first < limit; ++it) {
+    if (it->second >= units) return take(it->first, it->second, units);
+  }
+  return -1;
+}
+
+// take the first units of the free place at offset of the given size
+int PageFile::take(int offset, int size, int units)
+{
+  freeBySize.erase(pair<int, int>(size, offset));
+  freeSpace.erase(offset);
+  if (size > units) {
+    freeSpace[offset + units] = size - units;
+    freeBySize.insert(pair<int, int>(size - units, offset + units));
+  }
+  return offset;
+}
+
+// give up a place. it is free once the map is written again
+void PageFile::leave(int offset, int units)
+{
+  pending.push_back(pair<int, int>(offset, units));
+  pendingUnits += units;
+}
+
+// make a place free, merging it with the free places next to it. free
+// space at the end of the file is given back to it
+void PageFile::release(int offset, int units)
+{
+  std::map<int, int>::iterator next = freeSpace.lower_bound(offset);
+  if (next != freeSpace.end() && next->first == offset + units) {
+    units += next->second;
+    freeBySize.erase(pair<int, int>(next->second, next->first));
+    freeSpace.erase(next++);
+  }
+  if (next != freeSpace.begin()) {
+    std::map<int, int>::iterator prev = next;
+    --prev;
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      units += prev->second;
+      freeBySize.erase(pair<int, int>(prev->second, prev->first));
+      freeSpace.erase(prev);
+    }
+  }
+  if (offset + units == dataEnd) {
+    dataEnd = offset;
+    return;
+  }
+  freeSpace[offset] = units;
+  freeBySize.insert(pair<int, int>(units, offset));
+}
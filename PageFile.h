@@ -10,36 +10,78 @@
 #ifndef PAGEFILE_H
 #define PAGEFILE_H
 
+#include <pthread.h>
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 #include "Bruinbase.h"
 
 typedef int PageId;
 
 /**
- * read/write a file in the unit of a page
+ * read/write a file in the unit of a page.
+ * pages are read and written with pread/pwrite and the shared read cache
+ * is protected by a mutex, so that several threads may read the same
+ * file at the same time.
+ *
+ * A file may store its pages compressed (see PageCodec). The compressed
+ * images of the pages are then packed back to back in units of
+ * UNIT_SIZE bytes, so that one disk block holds several pages, and an
+ * indirection map gives the place and the length of the image of each
+ * page. The map is kept in memory while the file is open and written
+ * to the file by close(). A page whose new image does not fit in its
+ * place moves to free space, and a page that shrinks gives back the end
+ * of its place. The space left is reused only after the map is written
+ * again, so a place named by the map in the file holds no other page
+ * until the new map replaces it. The map is also written while the
+ * file is open once the space waiting to be reused adds up to a few
+ * times its size. read() returns the page decompressed and write()
+ * takes it uncompressed, so the callers see PAGE_SIZE pages either way.
+ *
+ * A page written by a thread in a WriteAheadLog transaction is logged
+ * and kept in memory, where read() finds it, until the transaction
+ * commits. A file written in a transaction is written only in
+ * transactions until it is closed. Once a transaction that wrote the
+ * file aborts, the file ends where it ended before the transaction,
+ * and the pages written to it until it is closed are dropped: they
+ * would point to the pages of the aborted transaction.
  */
 class PageFile {
  public:
 
   static const int PAGE_SIZE = 1024;    // the size of a page is 1KB
 
+  // the unit of the space taken by a compressed page
+  static const int UNIT_SIZE = 64;
+
   PageFile();
   PageFile(const std::string& filename, char mode);
 
   /**
    * open a file in read or write mode.
    * when opened in 'w' mode, if the file does not exist, it is created.
+   * a file that exists keeps the format it was created in.
    * @param filename[IN] the name of the file to open
    * @param mode[IN] 'r' for read, 'w' for write
+   * @param compress[IN] whether a file created by this call stores its
+   *                     pages compressed
    * @return error code. 0 if no error
    */
-  RC open(const std::string& filename, char mode);
+  RC open(const std::string& filename, char mode, bool compress = false);
 
   /**
-   * close the file.
+   * close the file. a compressed file that changed is compacted, by
+   * moving the pages at its end into the free space before them, and
+   * its indirection map is written first.
    * @return error code. 0 if no error
    */
   RC close();
+
+  /**
+   * @return whether the pages of the file are stored compressed
+   */
+  bool isCompressed() const { return compressed; }
   
   /**
    * read a disk page into memory buffer.
@@ -52,7 +94,8 @@ class PageFile {
   /**
    * write the memory buffer to the disk page.
    * if (pid >= endPid()), the file is expanded such that
-   * endPid() becomes (pid + 1).
+   * endPid() becomes (pid + 1). in a transaction, the page is written
+   * to the disk when the transaction commits.
    * @param pid[IN] page to write to
    * @param buffer[IN] the content to write
    * @return error code. 0 if no error
@@ -66,28 +109,119 @@ class PageFile {
    */
   PageId endPid() const;
 
+  /**
+   * tell the OS that pages [pid, pid + count) will be read soon, so that
+   * it can read them ahead while the caller works on the earlier ones.
+   * this is only a hint; the pages are not put in the read cache.
+   * @param pid[IN] the first page to be read
+   * @param count[IN] # pages to be read
+   */
+  void prefetch(PageId pid, int count) const;
+
   /**
    * @return the total # of disk reads
    */
   static int getPageReadCount()  { return readCount; }
+
+  /**
+   * @return the # of disk reads made by the calling thread, including
+   *         those of the parallel scans it ran
+   */
+  static int getThreadReadCount() { return threadReads; }
+
+  /**
+   * charge disk reads made for the calling thread by another one
+   * @param n[IN] the # of reads
+   */
+  static void addThreadReadCount(int n) { threadReads += n; }
   
   /**
    * @return the total # of disk writes
    */
   static int getPageWriteCount() { return writeCount; }
 
- protected:
   /**
-   * move the file cursor to the beginning of a page.
-   * this is an internal function not exposed to public.
-   * @param pid[IN] page to seek to
-   * @return error code. 0 if no error
+   * @return the total # of page reads served from the cache
+   */
+  static int getCacheHitCount() { return hitCount; }
+
+  /**
+   * count the reads of two files made by the calling thread, for the
+   * statistics of an operator (see getWatchedReads()). the files may be
+   * read by other threads at the same time; their reads are not counted.
+   * @param index[IN] the index file to count the reads of. NULL if none
+   * @param heap[IN] the table file to count the reads of. NULL if none
+   */
+  static void watchFiles(const PageFile* index, const PageFile* heap);
+
+  /**
+   * get the # reads the calling thread made from the files it watched
+   * since it started. the counts only grow, so an operator takes their
+   * difference.
+   * @param indexReads[OUT] # disk reads of the watched index files
+   * @param heapReads[OUT] # disk reads of the watched table files
+   * @param hits[OUT] # page reads of the watched files served from the cache
    */
-  RC seek(PageId pid) const;
+  static void getWatchedReads(int& indexReads, int& heapReads, int& hits);
 
  private:
+  friend class WriteAheadLog;
+
   int     fd;     // file descriptor of the associated unix file
   PageId  epid;   // (last page id + 1) of the file
+  std::string name;  // the name the file was opened with
+
+  std::vector<PageId> dirtyPids;  // the pages written by the running
+                                  //   transaction
+  std::vector<char> dirtyPages;   // their images, in the same order
+  std::vector<int> dirtySlots;    // the index of each page in dirtyPids.
+                                  //   -1 if it was not written
+  std::vector<bool> logged;  // the pages whose whole image is in the log
+  int loggedEpoch;           // the log epoch (see WriteAheadLog) of logged
+  bool inLog;                // whether a transaction wrote the file
+  PageId txnEpid;            // epid before the running transaction
+                             //   wrote the file
+  bool dropWrites;           // whether a transaction that wrote the
+                             //   file aborted
+
+  // the place of the compressed image of a page
+  struct Extent {
+    int offset;              // the first unit of the image
+    unsigned short length;   // # bytes of the image. 0 if the page was
+                             //   never written. PAGE_SIZE if it is
+                             //   stored uncompressed
+    unsigned short units;    // # units reserved for the image
+  };
+
+  bool compressed;              // whether the pages are compressed
+  bool mapDirty;                // whether the map changed since written
+  std::vector<Extent> extents;  // the indirection map of the pages
+  std::map<int, int> freeSpace;              // the free places: their
+                                             //   first unit and # units
+  std::set<std::pair<int, int> > freeBySize; // the free places by size:
+                                             //   # units and first unit
+  std::vector<std::pair<int, int> > pending; // the places left since the
+                                             //   map was written, and
+                                             //   their # units
+  int pendingUnits;             // # units of the places in pending
+  int dataEnd;                  // the unit after the last one used
+  int mapOffset;                // the first unit of the map in the file
+  int mapLength;                // # bytes of the map in the file
+
+  RC openCompressed(bool create, bool writable);
+  RC readImage(PageId pid, void* buffer) const;
+  RC writeImage(PageId pid, const void* buffer);
+  RC writePage(PageId pid, const void* buffer);
+  RC logWrite(PageId pid, const void* buffer);
+  RC writeBack(bool discard);
+  RC sync();
+  RC writeMap();
+  RC compact();
+  int allocate(int units);
+  int allocateBefore(int units, int limit);
+  int take(int offset, int size, int units);
+  void leave(int offset, int units);
+  void release(int offset, int units);
 
   //
   // the following set of members implement LRU caching 
@@ -95,6 +229,7 @@ class PageFile {
   static const int CACHE_COUNT = 10;
 
   static int cacheClock; // clock tick counter for LRU policy
+  static pthread_mutex_t cacheLock; // protects the cache and the counters
 
   // the actual cache data structure
   static struct cacheStruct {
@@ -107,6 +242,15 @@ class PageFile {
 
   static int readCount;  // total # of page reads 
   static int writeCount; // total # of page writes 
+  static int hitCount;   // total # of cache hits
+  static __thread int threadReads; // # page reads of this thread
+
+  // the files watched by the thread and the # reads of them
+  static __thread const PageFile* watchedIndex;
+  static __thread const PageFile* watchedHeap;
+  static __thread int indexReads;
+  static __thread int heapReads;
+  static __thread int watchedHits;
 };
   
 #endif // PAGEFILE_H
@@ -0,0 +1,191 @@
+/*
+ * Compiled WHERE-clause conditions.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include "Predicate.h"
+
+using namespace std;
+
+//
+// comparison functions, instantiated for each comparator
+//
+
+template <SelCond::Comparator C>
+static inline bool compare(int a, int b);
+
+template <> inline bool compare<SelCond::EQ>(int a, int b) { return a == b; }
+template <> inline bool compare<SelCond::NE>(int a, int b) { return a != b; }
+template <> inline bool compare<SelCond::LT>(int a, int b) { return a < b; }
+template <> inline bool compare<SelCond::GT>(int a, int b) { return a > b; }
+template <> inline bool compare<SelCond::LE>(int a, int b) { return a <= b; }
+template <> inline bool compare<SelCond::GE>(int a, int b) { return a >= b; }
+
+template <class Term, SelCond::Comparator C>
+static bool testKey(const Term& t, int key, const char*)
+{
+  return compare<C>(key, t.ikey);
+}
+
+template <class Term, SelCond::Comparator C>
+static bool testValue(const Term& t, int, const char* value)
+{
+  return compare<C>(strcmp(value, t.str.c_str()), 0);
+}
+
+// clear mask[i] for the keys not meeting the condition.
+// written as a plain loop over the column for the compiler to vectorize.
+template <SelCond::Comparator C>
+static void keyKernel(const int* __restrict keys, int n, int c,
+                      unsigned char* __restrict mask)
+{
+  for (int i = 0; i < n; i++) {
+    mask[i] &= compare<C>(keys[i], c);
+  }
+}
+
+// the estimated fraction of tuples meeting a key condition
+static double keySelectivity(SelCond::Comparator comp, int k, const TableStats* stats)
+{
+  if (stats == NULL || stats->rowCount == 0) {
+    switch (comp) {
+    case SelCond::EQ: return 0.005;
+    case SelCond::NE: return 0.995;
+    default:          return 0.33;
+    }
+  }
+
+  switch (comp) {
+  case SelCond::EQ: return stats->selectivity(k, k);
+  case SelCond::NE: return 1 - stats->selectivity(k, k);
+  case SelCond::LT: return (k == INT_MIN) ? 0 : stats->selectivity(INT_MIN, k - 1);
+  case SelCond::LE: return stats->selectivity(INT_MIN, k);
+  case SelCond::GT: return (k == INT_MAX) ? 0 : stats->selectivity(k + 1, INT_MAX);
+  case SelCond::GE: return stats->selectivity(k, INT_MAX);
+  }
+  return 1;
+}
+
+// the guessed fraction of tuples meeting a value condition
+static double valueSelectivity(SelCond::Comparator comp)
+{
+  switch (comp) {
+  case SelCond::EQ: return 0.005;
+  case SelCond::NE: return 0.995;
+  default:          return 0.33;
+  }
+}
+
+// a key comparison is cheaper than a string comparison
+static const double KEY_COST = 1;
+static const double VALUE_COST = 4;
+
+void Predicate::compile(const vector<SelCond>& conds, const TableStats* stats)
+{
+  terms.clear();
+  keyTerms = valueTerms = 0;
+
+  for (unsigned i = 0; i < conds.size(); i++) {
+    Term t;
+    double sel, cost;
+
+    t.attr = conds[i].attr;
+    t.comp = conds[i].comp;
+    t.ikey = 0;
+    t.kernel = NULL;
+
+    if (t.attr == 1) {
+      t.ikey = atoi(conds[i].value);
+      switch (t.comp) {
+      case SelCond::EQ: t.test = testKey<Term, SelCond::EQ>; t.kernel = keyKernel<SelCond::EQ>; break;
+      case SelCond::NE: t.test = testKey<Term, SelCond::NE>; t.kernel = keyKernel<SelCond::NE>; break;
+      case SelCond::LT: t.test = testKey<Term, SelCond::LT>; t.kernel = keyKernel<SelCond::LT>; break;
+      case SelCond::GT: t.test = testKey<Term, SelCond::GT>; t.kernel = keyKernel<SelCond::GT>; break;
+      case SelCond::LE: t.test = testKey<Term, SelCond::LE>; t.kernel = keyKernel<SelCond::LE>; break;
+      case SelCond::GE: t.test = testKey<Term, SelCond::GE>; t.kernel = keyKernel<SelCond::GE>; break;
+      }
+      sel = keySelectivity(t.comp, t.ikey, stats);
+      cost = KEY_COST;
+      keyTerms++;
+    } else {
+      t.str = conds[i].value;
+      switch (t.comp) {
+      case SelCond::EQ: t.test = testValue<Term, SelCond::EQ>; break;
+      case SelCond::NE: t.test = testValue<Term, SelCond::NE>; break;
+      case SelCond::LT: t.test = testValue<Term, SelCond::LT>; break;
+      case SelCond::GT: t.test = testValue<Term, SelCond::GT>; break;
+      case SelCond::LE: t.test = testValue<Term, SelCond::LE>; break;
+      case SelCond::GE: t.test = testValue<Term, SelCond::GE>; break;
+      }
+      sel = valueSelectivity(t.comp);
+      cost = VALUE_COST;
+      valueTerms++;
+    }
+
+    // the condition that rejects the most tuples per unit of cost
+    // is checked first
+    t.rank = (1 - sel) / cost;
+    terms.push_back(t);
+  }
+
+  // keep the original order among conditions of the same rank
+  for (unsigned i = 1; i < terms.size(); i++) {
+    for (unsigned j = i; j > 0 && terms[j].rank > terms[j - 1].rank; j--) {
+      swap(terms[j], terms[j - 1]);
+    }
+  }
+}
+
+void Predicate::filter(TupleBatch& batch) const
+{
+  int n = batch.selSize;
+
+  if (keyTerms > 0) {
+    // run each key condition over the whole key column
+    unsigned char mask[TupleBatch::CAPACITY];
+    memset(mask, 0, batch.size);
+    for (int j = 0; j < n; j++) mask[batch.sel[j]] = 1;
+
+    for (unsigned t = 0; t < terms.size(); t++) {
+      if (terms[t].attr == 1)
+        terms[t].kernel(batch.keys, batch.size, terms[t].ikey, mask);
+    }
+
+    // turn the mask back into a selection vector without branches
+    n = 0;
+    for (int i = 0; i < batch.size; i++) {
+      batch.sel[n] = i;
+      n += mask[i];
+    }
+  }
+
+  // check the value conditions one at a time on the tuples left
+  for (unsigned t = 0; t < terms.size() && n > 0; t++) {
+    if (terms[t].attr == 1) continue;
+    int m = 0;
+    for (int j = 0; j < n; j++) {
+      int i = batch.sel[j];
+      batch.sel[m] = i;
+      m += terms[t].test(terms[t], batch.keys[i], batch.values[i]);
+    }
+    n = m;
+  }
+
+  batch.selSize = n;
+}
+
+void Predicate::print(FILE* out) const
+{
+  static const char* ops[] = { "=", "<>", "<", ">", "<=", ">=" };
+
+  for (unsigned i = 0; i < terms.size(); i++) {
+    if (i > 0) fprintf(out, " and ");
+    if (terms[i].attr == 1)
+      fprintf(out, "key %s %d", ops[terms[i].comp], terms[i].ikey);
+    else
+      fprintf(out, "value %s '%s'", ops[terms[i].comp], terms[i].str.c_str());
+  }
+}
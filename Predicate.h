@@ -0,0 +1,87 @@
+/*
+ * Compiled WHERE-clause conditions.
+ */
+
+#ifndef PREDICATE_H
+#define PREDICATE_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "SqlEngine.h"
+#include "TableStats.h"
+#include "TupleBatch.h"
+
+/**
+ * A list of ANDed conditions compiled once per statement.
+ * The constants are parsed up front, each condition is bound to a
+ * comparison function instantiated for its attribute and comparator,
+ * and the conditions are ordered so that the cheap and selective ones
+ * are checked first.
+ */
+class Predicate {
+ public:
+  /**
+   * compile a list of conditions.
+   * @param conds[IN] the conditions ANDed together
+   * @param stats[IN] the table statistics to estimate the selectivity
+   *                  of key conditions. NULL if there are none
+   */
+  void compile(const std::vector<SelCond>& conds, const TableStats* stats);
+
+  /**
+   * @return true if there is no condition to check
+   */
+  bool empty() const { return terms.empty(); }
+
+  /**
+   * @return true if every condition is on the key column
+   */
+  bool keyOnly() const { return valueTerms == 0; }
+
+  /**
+   * check whether a tuple meets all the conditions.
+   * @param key[IN] the key of the tuple
+   * @param value[IN] the value of the tuple. may be NULL if keyOnly()
+   * @return true if all conditions are met
+   */
+  bool eval(int key, const char* value) const
+  {
+    for (unsigned i = 0; i < terms.size(); i++) {
+      if (!terms[i].test(terms[i], key, value)) return false;
+    }
+    return true;
+  }
+
+  /**
+   * check the selected tuples of a batch and keep only those meeting
+   * all the conditions in the selection. each key condition is checked
+   * over the whole key column in one tight loop; the value conditions
+   * are then checked on the tuples left.
+   * @param batch[IN/OUT] the batch to filter
+   */
+  void filter(TupleBatch& batch) const;
+
+  /**
+   * print the conditions in the order they are checked.
+   * @param out[IN] the stream to print to
+   */
+  void print(FILE* out) const;
+
+ private:
+  struct Term {
+    bool (*test)(const Term& t, int key, const char* value);
+    void (*kernel)(const int* keys, int n, int c, unsigned char* mask);
+    int  attr;          // 1: key, 2: value
+    SelCond::Comparator comp;
+    int  ikey;          // the constant of a key condition
+    std::string str;    // the constant of a value condition
+    double rank;        // conditions with higher rank are checked first
+  };
+
+  std::vector<Term> terms;
+  int keyTerms;         // # conditions on the key column
+  int valueTerms;       // # conditions on the value column
+};
+
+#endif /* PREDICATE_H */
@@ -0,0 +1,102 @@
+/*
+ * The protocol between the Bruinbase server and its clients.
+ */
+
+#include <cstring>
+#include <errno.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "Protocol.h"
+
+using namespace std;
+
+// read exactly size bytes. returns the # bytes read before the end of
+// the stream, or -1 on error.
+static ssize_t readFully(int fd, char* buf, size_t size)
+{
+  size_t done = 0;
+
+  while (done < size) {
+    ssize_t n = ::read(fd, buf + done, size - done);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    if (n == 0) break;
+    done += n;
+  }
+  return done;
+}
+
+RC writeFrame(int fd, const string& data)
+{
+  uint32_t length = htonl(data.size());
+  struct iovec iov[2];
+
+  iov[0].iov_base = &length;
+  iov[0].iov_len = sizeof(length);
+  iov[1].iov_base = (void*) data.data();
+  iov[1].iov_len = data.size();
+
+  // the length and the data with one writev() unless it writes short
+  int first = 0;
+  while (first < 2) {
+    ssize_t n = ::writev(fd, iov + first, 2 - first);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return RC_FILE_WRITE_FAILED;
+    }
+    while (first < 2 && (size_t) n >= iov[first].iov_len) {
+      n -= iov[first++].iov_len;
+    }
+    if (n > 0) {
+      iov[first].iov_base = (char*) iov[first].iov_base + n;
+      iov[first].iov_len -= n;
+    }
+  }
+  return 0;
+}
+
+RC readFrame(int fd, string& data)
+{
+  uint32_t length;
+  ssize_t  n;
+
+  if ((n = readFully(fd, (char*) &length, sizeof(length))) == 0) return RC_END_OF_SCAN;
+  if (n != sizeof(length)) return RC_FILE_READ_FAILED;
+
+  length = ntohl(length);
+  if (length > MAX_FRAME_SIZE) return RC_FILE_READ_FAILED;
+
+  data.resize(length);
+  if (length > 0 && readFully(fd, &data[0], length) != (ssize_t) length) {
+    return RC_FILE_READ_FAILED;
+  }
+  return 0;
+}
+
+void appendFrame(string& output, const string& data)
+{
+  uint32_t length = htonl(data.size());
+
+  output.reserve(output.size() + sizeof(length) + data.size());
+  output.append((const char*) &length, sizeof(length));
+  output += data;
+}
+
+RC takeFrame(string& input, string& data)
+{
+  uint32_t length;
+
+  if (input.size() < sizeof(length)) return RC_END_OF_SCAN;
+  memcpy(&length, input.data(), sizeof(length));
+  length = ntohl(length);
+  if (length > MAX_FRAME_SIZE) return RC_FILE_READ_FAILED;
+  if (input.size() - sizeof(length) < length) return RC_END_OF_SCAN;
+
+  data.assign(input, sizeof(length), length);
+  input.erase(0, sizeof(length) + length);
+  return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * The protocol between the Bruinbase server and its clients.
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <string>
+#include "Bruinbase.h"
+
+/**
+ * A client sends one statement per request and the server answers each
+ * request with one response, in order:
+ *
+ *   request:  <length> <statement>
+ *   response: <length> <status> <data>
+ *
+ * <length> is a 32-bit integer in network byte order: the # bytes that
+ * follow it. <status> is one byte. With STATUS_OK, <data> is the output
+ * of the statement as the command line prints it; with STATUS_ERROR, it
+ * is the error message. The server closes the session after QUIT.
+ */
+const char STATUS_OK    = 'O';
+const char STATUS_ERROR = 'E';
+
+// the largest frame accepted
+const unsigned MAX_FRAME_SIZE = 1u << 30;
+
+/**
+ * write a frame.
+ * @param fd[IN] the socket
+ * @param data[IN] the content of the frame
+ * @return error code. 0 if no error
+ */
+RC writeFrame(int fd, const std::string& data);
+
+/**
+ * read a frame.
+ * @param fd[IN] the socket
+ * @param data[OUT] the content of the frame
+ * @return error code. 0 if no error. RC_END_OF_SCAN if the peer closed
+ *         the connection before the frame.
+ */
+RC readFrame(int fd, std::string& data);
+
+/**
+ * append a frame to the bytes to send, for a socket that is written
+ * without blocking.
+ * @param output[IN/OUT] the bytes to send
+ * @param data[IN] the content of the frame
+ */
+void appendFrame(std::string& output, const std::string& data);
+
+/**
+ * take the frame at the front of the bytes received, for a socket that
+ * is read without blocking.
+ * @param input[IN/OUT] the bytes received. the frame is removed
+ * @param data[OUT] the content of the frame
+ * @return error code. 0 if a frame was taken. RC_END_OF_SCAN if input
+ *         does not hold a whole frame yet.
+ */
+RC takeFrame(std::string& input, std::string& data);
+
+#endif /* PROTOCOL_H */
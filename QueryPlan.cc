@@ -0,0 +1,419 @@
+/*
+ * Access path selection for SELECT statements.
+ */
+
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include "QueryPlan.h"
+
+using namespace std;
+
+// narrow [min_key, max_key] with a key condition.
+// return false if the condition cannot be met within the range.
+static bool narrowRange(const SelCond& sc, int& min_key, int& max_key)
+{
+  int key = atoi(sc.value);
+
+  switch (sc.comp) {
+  case SelCond::EQ:
+    if (key < min_key || key > max_key) return false;
+    min_key = max_key = key;
+    break;
+  case SelCond::GT:
+    if (max_key <= key) return false;
+    if (min_key < key + 1) min_key = key + 1;
+    break;
+  case SelCond::LT:
+    if (min_key >= key) return false;
+    if (max_key > key - 1) max_key = key - 1;
+    break;
+  case SelCond::GE:
+    if (max_key < key) return false;
+    if (min_key < key) min_key = key;
+    break;
+  case SelCond::LE:
+    if (min_key > key) return false;
+    if (max_key > key) max_key = key;
+    break;
+  case SelCond::NE:
+    break;
+  }
+  return true;
+}
+
+// raise the lower bound of a value range to v
+static void raiseMin(ValueRange& range, const string& v, bool inclusive)
+{
+  if (range.hasMin) {
+    int c = v.compare(range.minValue);
+    if (c < 0 || (c == 0 && inclusive)) return;
+  }
+  range.hasMin = true;
+  range.minValue = v;
+  range.minInclusive = inclusive;
+}
+
+// lower the upper bound of a value range to v
+static void lowerMax(ValueRange& range, const string& v, bool inclusive)
+{
+  if (range.hasMax) {
+    int c = v.compare(range.maxValue);
+    if (c > 0 || (c == 0 && inclusive)) return;
+  }
+  range.hasMax = true;
+  range.maxValue = v;
+  range.maxInclusive = inclusive;
+}
+
+// narrow a value range with a value condition
+static void narrowValueRange(const SelCond& sc, ValueRange& range)
+{
+  switch (sc.comp) {
+  case SelCond::EQ:
+    raiseMin(range, sc.value, true);
+    lowerMax(range, sc.value, true);
+    break;
+  case SelCond::GT: raiseMin(range, sc.value, false); break;
+  case SelCond::GE: raiseMin(range, sc.value, true); break;
+  case SelCond::LT: lowerMax(range, sc.value, false); break;
+  case SelCond::LE: lowerMax(range, sc.value, true); break;
+  case SelCond::NE: break;
+  }
+}
+
+// compute the key range and split off the conditions that are checked
+// on each tuple. return false if the conditions conflict.
+bool QueryPlan::deriveRange(const vector<SelCond>& conds, bool& bounded)
+{
+  bounded = false;
+  pointLookup = true;
+  minKey = INT_MIN;
+  maxKey = INT_MAX;
+  keyConds.clear();
+  valueConds.clear();
+  valueRange.hasMin = valueRange.hasMax = false;
+  valueRange.minInclusive = valueRange.maxInclusive = true;
+  valueRange.minValue.clear();
+  valueRange.maxValue.clear();
+
+  for (unsigned i = 0; i < conds.size(); i++) {
+    if (conds[i].attr != 1) {
+      valueConds.push_back(conds[i]);
+      narrowValueRange(conds[i], valueRange);
+    } else if (conds[i].comp == SelCond::NE) {
+      keyConds.push_back(conds[i]);
+    } else {
+      bounded = true;
+      if (conds[i].comp != SelCond::EQ) pointLookup = false;
+      if (!narrowRange(conds[i], minKey, maxKey)) return false;
+    }
+  }
+  if (!bounded) pointLookup = false;
+  return true;
+}
+
+void QueryPlan::build(int attr, const vector<SelCond>& conds, const TableHandle& table)
+{
+  bool bounded;  // whether any condition bounds the key
+  const BTreeIndex* bt = table.hasIndex ? &table.bt : NULL;
+  const TableStats* stats = table.hasStats ? &table.stats : NULL;
+
+  columnar = table.columnar;
+  bloomFilter = false;
+  columnRange = false;
+  hasStats = (stats != NULL);
+  estRows = estPages = 0;
+
+  if (!deriveRange(conds, bounded)) {
+    path = EMPTY_RESULT;
+    return;
+  }
+
+  bool needValue = (attr == 2 || attr == 3 || !valueConds.empty());
+
+  // # pages read by a sequential scan. it skips the pages (the segments
+  // of a columnar table) whose keys are all outside [minKey, maxKey],
+  // and the pages whose Bloom filter rules out a value looked for.
+  // the scan of a columnar table reads the value column only if needed
+  int pages = 0;
+  if (columnar) {
+    pages = table.cf.scanPageCount(minKey, maxKey, needValue);
+  } else {
+    const ZoneMap& zones = table.rf.getZoneMap();
+    const BloomFilter& blooms = table.rf.getBloomFilter();
+    const char* probe = valueProbe();
+    unsigned hash = (probe != NULL) ? BloomFilter::hash(probe, strlen(probe)) : 0;
+    bool filtered = (probe != NULL && blooms.isValid());
+
+    PageId heapPages = table.rf.endRid().pid + (table.rf.endRid().sid > 0);
+    for (PageId pid = 0; pid < heapPages; pid++) {
+      if (zones.mayContain(pid, minKey, maxKey) &&
+          (!filtered || blooms.mayContain(pid, hash))) pages++;
+    }
+  }
+
+  if (bt == NULL || !bounded || bt->getTreeHeight() == 0 || (columnar && needValue)) {
+    path = SEQ_SCAN;
+  } else if (stats == NULL) {
+    path = needValue ? BITMAP_HEAP_SCAN : INDEX_ONLY_SCAN;
+  } else {
+    //
+    // compare the # page reads of the access paths
+    //
+    double sel = stats->selectivity(minKey, maxKey);
+    double tablePages = (stats->pageCount > 0) ? stats->pageCount : 1;
+    estRows = sel * stats->rowCount;
+
+    // descend the tree and read the qualifying part of the leaf level
+    double indexPages = bt->getTreeHeight() - 1 + ceil(sel * bt->getPageCount());
+    // each record fetch in key order may read a page
+    double indexCost = indexPages + estRows;
+    // every table page is read at most once. # distinct pages
+    // touched by estRows random records (Cardenas' formula)
+    double bitmapCost = indexPages +
+      tablePages * (1 - pow(1 - 1 / tablePages, estRows));
+    double seqCost = pages;
+
+    if (!needValue) {
+      path = (indexPages < seqCost) ? INDEX_ONLY_SCAN : SEQ_SCAN;
+      estPages = (path == SEQ_SCAN) ? seqCost : indexPages;
+    } else if (indexCost <= bitmapCost && indexCost < seqCost) {
+      path = INDEX_SCAN;
+      estPages = indexCost;
+    } else if (bitmapCost < seqCost) {
+      path = BITMAP_HEAP_SCAN;
+      estPages = bitmapCost;
+    } else {
+      path = SEQ_SCAN;
+      estPages = seqCost;
+    }
+  }
+
+  // the value index pays off when the value conditions are selective.
+  // an index missing some tuples of the table is not used
+  if (table.hasValueIndex && !columnar && table.vi.getTreeHeight() > 0 &&
+      stats != NULL && table.vi.getEntryCount() == stats->rowCount &&
+      (valueRange.hasMin || valueRange.hasMax)) {
+    double rows;
+    double cost = valueIndexCost(table, rows);
+    if ((path == SEQ_SCAN) ? cost < pages : (stats != NULL && cost < estPages)) {
+      path = VALUE_INDEX_SCAN;
+      estRows = rows;
+      estPages = cost;
+    }
+  }
+
+  if (path == VALUE_INDEX_SCAN) {
+    // the records fetched are checked against every condition
+    keyConds.clear();
+    valueConds = conds;
+  } else if (path == SEQ_SCAN) {
+    // the sequential scan checks every condition on each tuple. the
+    // scan of a columnar table checks the value range itself
+    columnRange = columnar && (valueRange.hasMin || valueRange.hasMax);
+    keyConds.clear();
+    valueConds.clear();
+    for (unsigned i = 0; i < conds.size(); i++) {
+      if (conds[i].attr == 1)
+        keyConds.push_back(conds[i]);
+      else if (!columnRange || conds[i].comp == SelCond::NE)
+        valueConds.push_back(conds[i]);
+    }
+    if (stats != NULL) {
+      estRows = stats->rowCount * stats->selectivity(minKey, maxKey);
+      estPages = pages;
+    }
+  }
+
+  keyFilter.compile(keyConds, stats);
+  valueFilter.compile(valueConds, stats);
+  bloomFilter = (path == SEQ_SCAN && !columnar && valueProbe() != NULL &&
+                 table.rf.getBloomFilter().isValid());
+}
+
+// the # page reads of reading valueRange from the value index and
+// fetching the records. rows is set to the estimated # entries read
+double QueryPlan::valueIndexCost(const TableHandle& table, double& rows) const
+{
+  const ValueIndex& vi = table.vi;
+  double sel = vi.selectivity(valueRange);
+  double tablePages = table.rf.endRid().pid + 1;
+  rows = sel * vi.getEntryCount();
+
+  // descend the tree and read the qualifying part of the leaf level.
+  // the records of each batch of entries are fetched page by page
+  double indexPages = vi.getTreeHeight() - 1 + ceil(sel * vi.getPageCount());
+  return indexPages + tablePages * (1 - pow(1 - 1 / tablePages, rows));
+}
+
+bool QueryPlan::isGeneric() const
+{
+  return pointLookup && (path == INDEX_ONLY_SCAN || path == INDEX_SCAN);
+}
+
+const char* QueryPlan::valueProbe() const
+{
+  for (unsigned i = 0; i < valueConds.size(); i++) {
+    if (valueConds[i].comp == SelCond::EQ) return valueConds[i].value;
+  }
+  return NULL;
+}
+
+void QueryPlan::rebind(const vector<SelCond>& conds, const TableStats* stats)
+{
+  bool bounded;
+
+  if (!deriveRange(conds, bounded)) {
+    path = EMPTY_RESULT;
+    return;
+  }
+  keyFilter.compile(keyConds, stats);
+  valueFilter.compile(valueConds, stats);
+}
+
+// the names of the access paths for EXPLAIN
+static const char* pathName(QueryPlan::AccessPath path)
+{
+  switch (path) {
+  case QueryPlan::EMPTY_RESULT:     return "Empty Result";
+  case QueryPlan::SEQ_SCAN:         return "Seq Scan";
+  case QueryPlan::INDEX_ONLY_SCAN:  return "Index Only Scan";
+  case QueryPlan::INDEX_SCAN:       return "Index Scan";
+  case QueryPlan::BITMAP_HEAP_SCAN: return "Bitmap Heap Scan";
+  case QueryPlan::VALUE_INDEX_SCAN: return "Value Index Scan";
+  }
+  return "?";
+}
+
+// print the value range of a value index scan or a column scan
+static void printValueRange(FILE* out, const ValueRange& range)
+{
+  const char* lo = range.minValue.c_str();
+  const char* hi = range.maxValue.c_str();
+
+  fprintf(out, "  Value Range: ");
+  if (range.hasMin && range.hasMax && range.minInclusive && range.maxInclusive &&
+      range.minValue == range.maxValue)
+    fprintf(out, "value = '%s'\n", lo);
+  else if (range.hasMin && range.hasMax)
+    fprintf(out, "'%s' %s value %s '%s'\n", lo, range.minInclusive ? "<=" : "<",
+            range.maxInclusive ? "<=" : "<", hi);
+  else if (range.hasMin)
+    fprintf(out, "value %s '%s'\n", range.minInclusive ? ">=" : ">", lo);
+  else
+    fprintf(out, "value %s '%s'\n", range.maxInclusive ? "<=" : "<", hi);
+}
+
+// print a filter of the plan
+static void printFilter(FILE* out, const char* label, const Predicate& filter)
+{
+  if (filter.empty()) return;
+  fprintf(out, "  %s: ", label);
+  filter.print(out);
+  fprintf(out, "\n");
+}
+
+void QueryPlan::print(FILE* out, const string& table) const
+{
+  fprintf(out, "%s on %s\n", (path == SEQ_SCAN && columnar) ? "Column Scan" : pathName(path),
+          table.c_str());
+  if (path == EMPTY_RESULT) {
+    fprintf(out, "  Conflicting key conditions. No page is read.\n");
+    return;
+  }
+
+  // a sequential scan skips the pages outside the key range
+  bool bounded = (minKey != INT_MIN || maxKey != INT_MAX);
+  if (path == VALUE_INDEX_SCAN) {
+    printValueRange(out, valueRange);
+  } else if (path != SEQ_SCAN || bounded) {
+    fprintf(out, (path == SEQ_SCAN) ? "  Key Range: " : "  Index Range: ");
+    if (minKey == INT_MIN && maxKey == INT_MAX)
+      fprintf(out, "all keys\n");
+    else if (minKey == maxKey)
+      fprintf(out, "key = %d\n", minKey);
+    else if (minKey == INT_MIN)
+      fprintf(out, "key <= %d\n", maxKey);
+    else if (maxKey == INT_MAX)
+      fprintf(out, "key >= %d\n", minKey);
+    else
+      fprintf(out, "%d <= key <= %d\n", minKey, maxKey);
+  }
+  // the column scan selects the value range by dictionary codes
+  if (columnRange) printValueRange(out, valueRange);
+  printFilter(out, (path == SEQ_SCAN) ? "Filter" : "Index Filter", keyFilter);
+  printFilter(out, (path == SEQ_SCAN && keyFilter.empty()) ? "Filter" : "Tuple Filter", valueFilter);
+  if (bloomFilter) fprintf(out, "  Bloom Filter: value = '%s'\n", valueProbe());
+
+  if (hasStats)
+    fprintf(out, "  Estimated: rows=%.0f page reads=%.0f\n", estRows, estPages);
+  else
+    fprintf(out, "  Estimated: no statistics (run ANALYZE %s)\n", table.c_str());
+}
+
+void QueryPlan::printStats(FILE* out, const vector<OperatorStats>& ops, int count)
+{
+  fprintf(out, "  %-24s %9s %9s %9s %9s %9s %9s\n",
+          "Operator", "Rows", "IdxPages", "TblPages", "CacheHits", "Wall(s)", "CPU(s)");
+  for (unsigned i = 0; i < ops.size(); i++) {
+    fprintf(out, "  %-24s %9d %9d %9d %9d %9.4f %9.4f\n", ops[i].name.c_str(),
+            ops[i].rows, ops[i].indexReads, ops[i].heapReads, ops[i].cacheHits,
+            ops[i].wallTime, ops[i].cpuTime);
+  }
+  fprintf(out, "  Result: %d rows\n", count);
+}
+
+// the current wall-clock time in seconds
+static double wallClock()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// the CPU time used by the calling thread in seconds
+static double cpuClock()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_THREAD, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+         ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+OperatorStats::OperatorStats(const string& name)
+  : name(name), rows(0), indexReads(0), heapReads(0), cacheHits(0),
+    wallTime(0), cpuTime(0)
+{
+}
+
+void OperatorStats::start(const PageFile* index, const PageFile* heap)
+{
+  PageFile::watchFiles(index, heap);
+  PageFile::getWatchedReads(indexReads0, heapReads0, hits0);
+  wall0 = wallClock();
+  cpu0 = cpuClock();
+}
+
+void OperatorStats::stop()
+{
+  int indexReads1, heapReads1, hits1;
+
+  wallTime += wallClock() - wall0;
+  cpuTime += cpuClock() - cpu0;
+  PageFile::getWatchedReads(indexReads1, heapReads1, hits1);
+  indexReads += indexReads1 - indexReads0;
+  heapReads += heapReads1 - heapReads0;
+  cacheHits += hits1 - hits0;
+}
+
+void OperatorStats::addPart(const OperatorStats& part)
+{
+  indexReads += part.indexReads;
+  heapReads += part.heapReads;
+  cacheHits += part.cacheHits;
+  cpuTime += part.cpuTime;
+}
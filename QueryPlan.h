@@ -0,0 +1,164 @@
+/*
+ * Access path selection for SELECT statements.
+ */
+
+#ifndef QUERYPLAN_H
+#define QUERYPLAN_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "SqlEngine.h"
+#include "TableHandle.h"
+#include "Predicate.h"
+
+/**
+ * Run-time statistics of one operator of a plan, reported by
+ * EXPLAIN ANALYZE. start() and stop() may be called repeatedly;
+ * the statistics accumulate.
+ */
+class OperatorStats {
+ public:
+  std::string name;  // the name of the operator
+  int rows;          // # tuples produced by the operator
+  int indexReads;    // # index pages read from disk
+  int heapReads;     // # table pages read from disk
+  int cacheHits;     // # page reads served from the page cache
+  double wallTime;   // elapsed time in seconds
+  double cpuTime;    // user + system CPU time in seconds
+
+  OperatorStats(const std::string& name = "");
+
+  /**
+   * start measuring the operator. only the reads and the CPU time of
+   * the calling thread are counted: the other threads may read the same
+   * files for other statements.
+   * @param index[IN] the index file read by the operator. NULL if none
+   * @param heap[IN] the table file read by the operator. NULL if none
+   */
+  void start(const PageFile* index, const PageFile* heap);
+
+  /**
+   * stop measuring the operator and add up the statistics.
+   */
+  void stop();
+
+  /**
+   * add the reads and the CPU time of a part of the operator run by
+   * another thread. the rows and the wall time are not added.
+   * @param part[IN] the statistics of the part
+   */
+  void addPart(const OperatorStats& part);
+
+ private:
+  int    indexReads0, heapReads0, hits0;
+  double wall0, cpu0;
+};
+
+/**
+ * The plan of a SELECT statement: how the table is accessed and
+ * which conditions are left to be checked on each tuple.
+ */
+class QueryPlan {
+ public:
+  enum AccessPath {
+    EMPTY_RESULT,      // the conditions conflict. nothing to read
+    SEQ_SCAN,          // read the whole table
+    INDEX_ONLY_SCAN,   // read [minKey, maxKey] from the index only
+    INDEX_SCAN,        // read [minKey, maxKey] from the index and fetch
+                       //   the records of each batch of entries
+    BITMAP_HEAP_SCAN,  // read [minKey, maxKey] from the index and fetch
+                       //   the records in heap-page order
+    VALUE_INDEX_SCAN   // read valueRange from the value index and fetch
+                       //   the records of each batch of entries
+  };
+
+  AccessPath path;
+  bool columnar;     // whether the table is in the columnar format. its
+                     //   sequential scan reads only the columns needed
+                     //   and its records cannot be fetched by rid
+  int minKey;        // the smallest key to read from the index (inclusive)
+  int maxKey;        // the largest key to read from the index (inclusive)
+  ValueRange valueRange;  // the values the value conditions allow
+  std::vector<SelCond> keyConds;    // key conditions checked on each tuple
+  std::vector<SelCond> valueConds;  // value conditions checked on each tuple
+  Predicate keyFilter;              // keyConds compiled
+  Predicate valueFilter;            // valueConds compiled
+  bool   bloomFilter; // whether the sequential scan skips the pages whose
+                     //   Bloom filter rules out the value of valueProbe()
+  bool   columnRange; // whether the scan of a columnar table selects the
+                     //   tuples in valueRange itself, by their dictionary
+                     //   codes where it can. valueConds then keeps only
+                     //   the "value <>" conditions
+
+  bool   pointLookup; // whether only key equalities bound the key range
+  bool   hasStats;   // whether the table statistics were available
+  double estRows;    // estimated # tuples in [minKey, maxKey]
+  double estPages;   // estimated # page reads of the chosen path
+
+  /**
+   * choose the cheapest access path for a SELECT statement.
+   * without statistics, the index is used whenever the conditions
+   * bound the key.
+   * @param attr[IN] attribute in the SELECT clause (see SqlEngine::select())
+   * @param conds[IN] list of conditions in the WHERE clause
+   * @param table[IN] the table, with its index and statistics if any
+   */
+  void build(int attr, const std::vector<SelCond>& conds, const TableHandle& table);
+
+  /**
+   * @return whether the plan can be reused for other values of the
+   *         same conditions (see rebind()): it looks up a single key
+   *         through the index, whose cost hardly depends on the key.
+   */
+  bool isGeneric() const;
+
+  /**
+   * @param attr[IN] attribute in the SELECT clause
+   * @return whether the statement looks at the values of the tuples:
+   *         it selects them or has a condition on them. if not, the
+   *         scans leave the value column of their batches unset.
+   */
+  bool needsValues(int attr) const
+  {
+    return attr == 2 || attr == 3 || !valueFilter.empty() || columnRange;
+  }
+
+  /**
+   * @return the value of the first "value = " condition checked on each
+   *         tuple. the sequential scan of a table in the slotted format
+   *         only returns the records that may hold it. NULL if none
+   */
+  const char* valueProbe() const;
+
+  /**
+   * reuse the access path of a generic plan for new values of the same
+   * conditions. the key range and the filters are derived again; the
+   * costs are not.
+   * @param conds[IN] list of conditions in the WHERE clause
+   * @param stats[IN] the table statistics. NULL if there are none
+   */
+  void rebind(const std::vector<SelCond>& conds, const TableStats* stats);
+
+  /**
+   * print the plan for EXPLAIN.
+   * @param out[IN] the stream to print to
+   * @param table[IN] the table name in the FROM clause
+   */
+  void print(FILE* out, const std::string& table) const;
+
+  /**
+   * print the run-time statistics for EXPLAIN ANALYZE.
+   * @param out[IN] the stream to print to
+   * @param ops[IN] the statistics of the operators of the plan
+   * @param count[IN] # tuples in the result
+   */
+  static void printStats(FILE* out, const std::vector<OperatorStats>& ops, int count);
+
+ private:
+  bool deriveRange(const std::vector<SelCond>& conds, bool& bounded);
+  double valueIndexCost(const TableHandle& table, double& rows) const;
+};
+
+#endif /* QUERYPLAN_H */
@@ -9,22 +9,66 @@
 
 #include "Bruinbase.h"
 #include "RecordFile.h"
+#include <climits>
 #include <cstring>
+#include <algorithm>
 
 using std::string;
+using std::min;
 
 //
 // helper functions for page manipultation
 //
+// a heap page:
+//   int    count      # records in the page
+//   ushort dataStart  the offset of the lowest value in the page
+//   ushort format     PAGE_FORMAT
+//   Slot   slots[count]
+//   ... free space ...
+//   the values, from dataStart to the end of the page
+//
+// an overflow page:
+//   int    count      OVERFLOW_PAGE
+//   PageId next       the next page of the value. -1 for the last one
+//   PageId heap       the heap page holding the slot of the value
+//   the bytes of the value
+//
 
-// compute the pointer to the n'th slot in a page
-static char* slotPtr(char* page, int n);
-
-// read the record in the n'th slot in the page
-static void readSlot(const char* page, int n, int& key, std::string& value);
-
-// write the record to the n'th slot in the page
-static void writeSlot(char* page, int n, int key, const std::string& value);
+// a record in the slot directory
+struct Slot {
+  int key;
+  unsigned short offset;  // the value in the page
+  unsigned short length;  // # bytes of the value (the low 8 bits) and its
+                          // fingerprint (the next 7 bits, 0 if unknown).
+                          // LONG_VALUE if it is on overflow pages
+};
+
+// the value of a slot whose value is on overflow pages
+struct LongValueRef {
+  PageId first;  // the first overflow page
+  int    length; // # bytes of the value
+};
+
+static const int OVERFLOW_PAGE = -1;
+static const int OVERFLOW_HEADER_SIZE = 3 * sizeof(int);
+static const int OVERFLOW_DATA_SIZE = PageFile::PAGE_SIZE - OVERFLOW_HEADER_SIZE;
+static const unsigned short PAGE_FORMAT = 0x5342;
+static const unsigned short LONG_VALUE = 0xffff;
+static const unsigned short LENGTH_MASK = 0xff;
+static const int FINGERPRINT_SHIFT = 8;
+
+// the fingerprint of a value stored in its slot: 1-127
+static int fingerprint(unsigned hash);
+
+// initialize an empty heap page
+static void initPage(char* page);
+
+// the file next to a table file with another extension:
+// "table.tbl" -> "table.zone"
+static string sideFileName(const string& filename, const char* ext);
+
+// whether a page is a heap page in the slotted format
+static bool isHeapPage(const char* page);
 
 // get # records stored in the page
 static int getRecordCount(const char* page);
@@ -32,6 +76,17 @@ static int getRecordCount(const char* page);
 // update # records stored in the page
 static void setRecordCount(char* page, int count);
 
+// get and set the start of the value area of the page
+static int getDataStart(const char* page);
+static void setDataStart(char* page, int offset);
+
+// read and write the n'th slot of the slot directory
+static void getSlot(const char* page, int n, Slot& slot);
+static void setSlot(char* page, int n, const Slot& slot);
+
+// # free bytes between the slot directory and the values
+static int getFreeSpace(const char* page);
+
 
 //
 // helper functions for RecordId manipulation
@@ -104,65 +159,141 @@ bool operator != (const RecordId& r1, const RecordId& r2)
 
 
 RecordFile::RecordFile()
+  : writable(false)
 {
   erid.pid = 0;
   erid.sid = 0;
 }
 
 RecordFile::RecordFile(const string& filename, char mode)
+  : writable(false)
 {
   open(filename, mode);
 }
 
-RC RecordFile::open(const string& filename, char mode)
+RC RecordFile::open(const string& filename, char mode, bool compress)
 {
   RC   rc;
   char page[PageFile::PAGE_SIZE];
 
   // open the page file
-  if ((rc = pf.open(filename, mode)) < 0) return rc;
+  if ((rc = pf.open(filename, mode, compress)) < 0) return rc;
+  writable = (mode == 'w' || mode == 'W');
+  zoneFile = sideFileName(filename, ".zone");
+  bloomFile = sideFileName(filename, ".bloom");
   
   //
   // in the rest of this function, we set the end record id
   //
-
-  // get the end pid of the file
-  erid.pid = pf.endPid();
+  erid.pid = erid.sid = 0;
 
   // if the end pid is zero, the file is empty.
   // set the end record id to (0, 0).
-  if (erid.pid == 0) {
-    erid.sid = 0;
+  if (pf.endPid() == 0) {
+    zones.clear();
+    blooms.invalidate();
     return 0;
   }
 
-  // obtain # records in the last page to set sid of the end record id.
-  // read the last page of the file and get # records in the page.
-  // remeber that the id of the last page is endPid()-1 not endPid().
-  if ((rc = pf.read(--erid.pid, page)) < 0) {
+  // the first page is always a heap page. check its format.
+  if ((rc = pf.read(0, page)) < 0 || !isHeapPage(page)) {
+    pf.close();
+    return (rc < 0) ? rc : RC_INVALID_FILE_FORMAT;
+  }
+
+  // the last page of the file is the last heap page, or an overflow
+  // page written after it. remeber that the id of the last page is
+  // endPid()-1 not endPid().
+  PageId pid = pf.endPid() - 1;
+  if ((rc = pf.read(pid, page)) == 0 && getRecordCount(page) == OVERFLOW_PAGE) {
+    memcpy(&pid, page + 2 * sizeof(int), sizeof(PageId));
+    rc = pf.read(pid, page);
+  }
+  if (rc < 0) {
     // an error occurred during page read
-    erid.pid = erid.sid = 0;
     pf.close();
     return rc;
   }
 
-  // get # records in the last page
+  // the records of the last heap page end the file
+  erid.pid = pid;
   erid.sid = getRecordCount(page);
-  if (erid.sid >= RECORDS_PER_PAGE) {
-    // the last page is full. advance the end record id to the next page.
-    erid.pid++;
-    erid.sid = 0;
+
+  // a zone map that does not match the file is not used. appending
+  // needs one, so it is built again from the pages.
+  if (zones.load(zoneFile, erid.pid, erid.sid) < 0 && writable &&
+      (rc = buildZoneMap()) < 0) {
+    pf.close();
+    return rc;
+  }
+
+  // the Bloom filters are optional. filters that do not match the file
+  // are not used, but they are built again when appending.
+  if (blooms.load(bloomFile, erid.pid, erid.sid) == RC_INVALID_FILE_FORMAT && writable &&
+      (rc = buildBloomFilter()) < 0) {
+    pf.close();
+    return rc;
   }
-  
   return 0;
 }
 
 RC RecordFile::close()
 {
+  RC rc = 0;
+
+  if (writable && (rc = zones.save(zoneFile, erid.pid, erid.sid)) == 0) {
+    rc = blooms.save(bloomFile, erid.pid, erid.sid);
+  }
+  zones.invalidate();
+  blooms.invalidate();
+  writable = false;
   erid.pid = 0;
   erid.sid = 0;
 
-  return pf.close();
+  RC closed = pf.close();
+  return (rc < 0) ? rc : closed;
+}
+
+// read the keys of every heap page into the zone map
+RC RecordFile::buildZoneMap()
+{
+  RC rc;
+  char page[PageFile::PAGE_SIZE];
+  PageId pid;
+  int count;
+
+  zones.clear();
+  Scanner scanner(*this);
+  while ((rc = scanner.nextPage(page, pid, count)) == 0) {
+    for (int sid = 0; sid < count; sid++) {
+      zones.add(pid, recordKey(page, sid));
+    }
+  }
+  return (rc == RC_END_OF_SCAN) ? 0 : rc;
+}
+
+RC RecordFile::buildBloomFilter()
+{
+  RC rc;
+  char page[PageFile::PAGE_SIZE];
+  PageId pid;
+  int count;
+  std::deque<string> longValues;
+
+  if (!writable) return RC_INVALID_FILE_MODE;
+
+  blooms.clear();
+  Scanner scanner(*this);
+  while ((rc = scanner.nextPage(page, pid, count)) == 0) {
+    for (int sid = 0; sid < count; sid++) {
+      int key;
+      const char* value;
+      if ((rc = recordValue(page, sid, key, value, longValues)) < 0) return rc;
+      blooms.add(pid, BloomFilter::hash(value, strlen(value)));
+    }
+    longValues.clear();
+  }
+  return (rc == RC_END_OF_SCAN) ? 0 : rc;
 }
 
 RC RecordFile::read(const RecordId& rid, int& key, string& value) const
@@ -177,45 +308,193 @@ RC RecordFile::read(const RecordId& rid, int& key, string& value) const
   
   // read the page containing the record
   if ((rc = pf.read(rid.pid, page)) < 0) return rc;
+  if (rid.sid >= recordCount(page)) return RC_INVALID_RID;
 
   // read the record from the slot in the page
-  readSlot(page, rid.sid, key, value);
+  return readRecord(page, rid.sid, key, value);
+}
+
+RC RecordFile::readPage(PageId pid, char* page) const
+{
+  // check whether the pid is in the valid range
+  if (pid < 0 || pid > erid.pid) return RC_INVALID_PID;
+  if (pid == erid.pid && erid.sid == 0) return RC_INVALID_PID;
+
+  return pf.read(pid, page);
+}
+
+int RecordFile::recordCount(const char* page)
+{
+  int count = getRecordCount(page);
+  return (count == OVERFLOW_PAGE) ? 0 : count;
+}
+
+RC RecordFile::readRecord(const char* page, int sid, int& key, string& value) const
+{
+  Slot slot;
+
+  getSlot(page, sid, slot);
+  key = slot.key;
+  if (slot.length == LONG_VALUE) return readLongValue(page + slot.offset, value);
+  value.assign(page + slot.offset, slot.length & LENGTH_MASK);
+  return 0;
+}
 
+const char* RecordFile::recordValue(const char* page, int sid, int& key)
+{
+  Slot slot;
+
+  getSlot(page, sid, slot);
+  key = slot.key;
+  return (slot.length == LONG_VALUE) ? NULL : page + slot.offset;
+}
+
+RC RecordFile::recordValue(const char* page, int sid, int& key, const char*& value,
+                           std::deque<std::string>& longValues) const
+{
+  Slot slot;
+  RC   rc;
+
+  getSlot(page, sid, slot);
+  key = slot.key;
+  if (slot.length != LONG_VALUE) {
+    value = page + slot.offset;
+    return 0;
+  }
+
+  longValues.push_back(string());
+  if ((rc = readLongValue(page + slot.offset, longValues.back())) < 0) return rc;
+  value = longValues.back().c_str();
   return 0;
 }
 
+bool RecordFile::mayHoldValue(const char* page, int sid, int length, unsigned hash)
+{
+  Slot slot;
+
+  getSlot(page, sid, slot);
+  if (slot.length == LONG_VALUE) return length > MAX_INLINE_LENGTH;
+  if ((slot.length & LENGTH_MASK) != length) return false;
+
+  // pages written before the fingerprints were kept have none
+  int print = slot.length >> FINGERPRINT_SHIFT;
+  return print == 0 || print == fingerprint(hash);
+}
+
+int RecordFile::recordKey(const char* page, int sid)
+{
+  int key;
+
+  memcpy(&key, page + PAGE_HEADER_SIZE + sid * SLOT_SIZE, sizeof(int));
+  return key;
+}
+
 RC RecordFile::append(int key, const std::string& value, RecordId& rid)
+{
+  return appendBatch(1, &key, &value, &rid);
+}
+
+RC RecordFile::appendBatch(int n, const int* keys, const std::string* values, RecordId* rids)
 {
   RC   rc;
   char page[PageFile::PAGE_SIZE];
 
-  // unless we are writing to the the first slot of an empty page,
-  // we have to read the page first
+  if (n <= 0) return 0;
+
+  // unless the file is empty, we continue the last heap page
   if (erid.sid > 0) {
     if ((rc = pf.read(erid.pid, page)) < 0) return rc;
   } else {
-    // if this is the first slot of an empty page
-    // we can simply initialize the page with zeros
-    memset(page, 0, PageFile::PAGE_SIZE);
+    initPage(page);
   }
-    
-  // write the record to the first empty slot 
-  writeSlot(page, erid.sid, key, value);
 
-  // the first four bytes in the page stores # records in the page.
-  // update this number.
-  setRecordCount(page, erid.sid + 1);
+  for (int i = 0; i < n; i++) {
+    const string& value = values[i];
+    bool isLong = ((int) value.size() > MAX_INLINE_LENGTH);
+    int  size = isLong ? (int) sizeof(LongValueRef) : (int) value.size() + 1;
+
+    // if the record does not fit, write the full page and start a new
+    // heap page at the end of the file (after the overflow pages, if any)
+    if (getFreeSpace(page) < SLOT_SIZE + size) {
+      if ((rc = pf.write(erid.pid, page)) < 0) return rc;
+      erid.pid = pf.endPid();
+      erid.sid = 0;
+      initPage(page);
+    }
+
+    // write the value at the bottom of the free space, and the slot
+    // right after the last one
+    Slot slot;
+    slot.key = keys[i];
+    slot.offset = getDataStart(page) - size;
+    if (isLong) {
+      slot.length = LONG_VALUE;
+      if ((rc = writeLongValue(value, erid.pid, page + slot.offset)) < 0) return rc;
+    } else {
+      unsigned h = BloomFilter::hash(value.data(), value.size());
+      slot.length = value.size() | (fingerprint(h) << FINGERPRINT_SHIFT);
+      memcpy(page + slot.offset, value.c_str(), size);
+    }
+    setSlot(page, erid.sid, slot);
+    setDataStart(page, slot.offset);
+
+    // the first four bytes in the page stores # records in the page.
+    // update this number.
+    setRecordCount(page, erid.sid + 1);
+
+    // we need to output the rid of the record slot, and advance the
+    // end record id by one to the next empty slot
+    rids[i] = erid;
+    zones.add(erid.pid, keys[i]);
+    if (blooms.isValid()) blooms.add(erid.pid, BloomFilter::hash(value.data(), value.size()));
+    erid.sid++;
+  }
+
+  // write the last page to the disk
+  return pf.write(erid.pid, page);
+}
 
-  // write the page to the disk
-  if ((rc = pf.write(erid.pid, page)) < 0) return rc;
-    
-  // we need to output the rid of the record slot
-  rid = erid;
+RecordFile::Scanner::Scanner(const RecordFile& rf)
+  : rf(rf), nextPid(0), endPid(rf.endRid().pid + 1), prefetched(0),
+    minKey(INT_MIN), maxKey(INT_MAX), probe(false), valueHash(0)
+{
+}
 
-  // advance the end record id by one to the next empty slot
-  ++erid;
+RecordFile::Scanner::Scanner(const RecordFile& rf, PageId beginPid, PageId endPid)
+  : rf(rf), nextPid(beginPid), endPid(endPid), prefetched(beginPid),
+    minKey(INT_MIN), maxKey(INT_MAX), probe(false), valueHash(0)
+{
+}
 
-  return 0;
+RC RecordFile::Scanner::nextPage(char* page, PageId& pid, int& count)
+{
+  RC rc;
+  const RecordId& end = rf.endRid();
+
+  // the last heap page holds records unless the file is empty
+  endPid = min(endPid, end.pid + (end.sid > 0));
+
+  for (; nextPid < endPid; nextPid++) {
+    // ask for the next pages once the scan reaches the ones asked before
+    if (nextPid >= prefetched) {
+      prefetched = min(nextPid + PREFETCH_PAGES, endPid);
+      rf.pf.prefetch(nextPid, prefetched - nextPid);
+    }
+
+    // skip the pages without a record in the key range, or without the
+    // value wanted, unread
+    if (!rf.zones.mayContain(nextPid, minKey, maxKey)) continue;
+    if (probe && !rf.blooms.mayContain(nextPid, valueHash)) continue;
+
+    if ((rc = rf.readPage(nextPid, page)) < 0) return rc;
+
+    // skip the overflow pages
+    if ((count = recordCount(page)) > 0) {
+      pid = nextPid++;
+      return 0;
+    }
+  }
+  return RC_END_OF_SCAN;
 }
 
 const RecordId& RecordFile::endRid() const
@@ -223,6 +502,93 @@ const RecordId& RecordFile::endRid() const
   return erid;
 }
 
+// read a value from its overflow pages
+RC RecordFile::readLongValue(const char* slotValue, string& value) const
+{
+  RC   rc;
+  char page[PageFile::PAGE_SIZE];
+  LongValueRef ref;
+
+  memcpy(&ref, slotValue, sizeof(ref));
+  value.clear();
+  value.reserve(ref.length);
+
+  PageId pid = ref.first;
+  while ((int) value.size() < ref.length) {
+    if ((rc = pf.read(pid, page)) < 0) return rc;
+    if (getRecordCount(page) != OVERFLOW_PAGE) return RC_INVALID_FILE_FORMAT;
+
+    int n = ref.length - value.size();
+    value.append(page + OVERFLOW_HEADER_SIZE, (n < OVERFLOW_DATA_SIZE) ? n : OVERFLOW_DATA_SIZE);
+    memcpy(&pid, page + sizeof(int), sizeof(PageId));
+  }
+  return 0;
+}
+
+// write a value to new overflow pages at the end of the file and put
+// the reference to them in slotValue
+RC RecordFile::writeLongValue(const string& value, PageId heapPid, char* slotValue)
+{
+  RC   rc;
+  char page[PageFile::PAGE_SIZE];
+  LongValueRef ref;
+
+  // the heap page may not be written yet
+  ref.first = (pf.endPid() > heapPid) ? pf.endPid() : heapPid + 1;
+  ref.length = value.size();
+
+  PageId pid = ref.first;
+  for (int done = 0; done < ref.length; done += OVERFLOW_DATA_SIZE, pid++) {
+    int n = ref.length - done;
+    if (n > OVERFLOW_DATA_SIZE) n = OVERFLOW_DATA_SIZE;
+    PageId next = (done + n < ref.length) ? pid + 1 : -1;
+    int count = OVERFLOW_PAGE;
+
+    memset(page, 0, PageFile::PAGE_SIZE);
+    memcpy(page, &count, sizeof(int));
+    memcpy(page + sizeof(int), &next, sizeof(PageId));
+    memcpy(page + 2 * sizeof(int), &heapPid, sizeof(PageId));
+    memcpy(page + OVERFLOW_HEADER_SIZE, value.data() + done, n);
+    if ((rc = pf.write(pid, page)) < 0) return rc;
+  }
+
+  memcpy(slotValue, &ref, sizeof(ref));
+  return 0;
+}
+
+static int fingerprint(unsigned hash)
+{
+  return 1 + (hash >> 24) % 127;
+}
+
+static string sideFileName(const string& filename, const char* ext)
+{
+  string::size_type dot = filename.rfind('.');
+  string::size_type slash = filename.rfind('/');
+  if (dot == string::npos || (slash != string::npos && dot < slash)) {
+    return filename + ext;
+  }
+  return filename.substr(0, dot) + ext;
+}
+
+static void initPage(char* page)
+{
+  unsigned short format = PAGE_FORMAT;
+
+  memset(page, 0, PageFile::PAGE_SIZE);
+  setRecordCount(page, 0);
+  setDataStart(page, PageFile::PAGE_SIZE);
+  memcpy(page + sizeof(int) + sizeof(short), &format, sizeof(short));
+}
+
+static bool isHeapPage(const char* page)
+{
+  unsigned short format;
+
+  memcpy(&format, page + sizeof(int) + sizeof(short), sizeof(short));
+  return getRecordCount(page) >= 0 && format == PAGE_FORMAT;
+}
+
 static int getRecordCount(const char* page)
 {
   int count;
@@ -238,41 +604,33 @@ static void setRecordCount(char* page, int count)
   memcpy(page, &count, sizeof(int));
 }
 
-static char* slotPtr(char* page, int n) 
+static int getDataStart(const char* page)
 {
-  // compute the location of the n'th slot in a page.
-  // remember that the first four bytes in a page is used to store
-  // # records in the page and each slot consists of an integer and
-  // a string of length MAX_VALUE_LENGTH
-  return (page+sizeof(int)) + (sizeof(int)+RecordFile::MAX_VALUE_LENGTH)*n;
+  unsigned short offset;
+
+  memcpy(&offset, page + sizeof(int), sizeof(short));
+  return offset;
 }
 
-static void readSlot(const char* page, int n, int& key, std::string& value)
+static void setDataStart(char* page, int offset)
 {
-  // compute the location of the record
-  char *ptr = slotPtr(const_cast<char*>(page), n);
+  unsigned short value = offset;
 
-  // read the key 
-  memcpy(&key, ptr, sizeof(int));
-
-  // read the value
-  value.assign(ptr + sizeof(int));
+  memcpy(page + sizeof(int), &value, sizeof(short));
 }
 
-static void writeSlot(char* page, int n, int key, const std::string& value)
+static void getSlot(const char* page, int n, Slot& slot)
 {
-  // compute the location of the record
-  char *ptr = slotPtr(page, n);
+  memcpy(&slot, page + RecordFile::PAGE_HEADER_SIZE + n * RecordFile::SLOT_SIZE, sizeof(Slot));
+}
 
-  // store the key
-  memcpy(ptr, &key, sizeof(int));
+static void setSlot(char* page, int n, const Slot& slot)
+{
+  memcpy(page + RecordFile::PAGE_HEADER_SIZE + n * RecordFile::SLOT_SIZE, &slot, sizeof(Slot));
+}
 
-  // store the value. 
-  if ((int)value.size() >= RecordFile::MAX_VALUE_LENGTH) {
-    // when the string is longer than MAX_VALUE_LENGTH, truncate it.
-    memcpy(ptr + sizeof(int), value.c_str(), RecordFile::MAX_VALUE_LENGTH -1);
-    *(ptr + sizeof(int) + RecordFile::MAX_VALUE_LENGTH - 1) = 0;
-  } else {
-    strcpy(ptr + sizeof(int), value.c_str());
-  }
+static int getFreeSpace(const char* page)
+{
+  return getDataStart(page) - RecordFile::PAGE_HEADER_SIZE -
+         getRecordCount(page) * RecordFile::SLOT_SIZE;
 }
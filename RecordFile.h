@@ -10,8 +10,11 @@
 #ifndef RECORDFILE_H
 #define RECORDFILE_H
 
+#include <deque>
 #include <string>
 #include "PageFile.h"
+#include "ZoneMap.h"
+#include "BloomFilter.h"
 
 /**
  * The data structure for pointing to a particular record in a RecordFile.
@@ -40,17 +43,39 @@ bool operator!= (const RecordId& r1, const RecordId& r2);
 
 /**
  * read/write a record to a file
+ *
+ * The records are kept in slotted pages. A page starts with a header
+ * (# records, the start of the value area, the format tag) followed by
+ * the slot directory: the key, offset and length of each record. The
+ * values are stored NUL-terminated from the end of the page toward the
+ * directory, so a page holds as many records as their values allow.
+ * A value longer than MAX_INLINE_LENGTH is stored on a chain of
+ * overflow pages; its slot points to the first one. Overflow pages are
+ * placed after the heap page holding their slot and hold no records.
+ *
+ * The key range of each page is kept in a zone map next to the file
+ * (see ZoneMap). It is updated by append() and written by close(); a
+ * file opened for writing without a matching zone map gets a new one.
+ * The file may also have Bloom filters over the values of each page
+ * (see BloomFilter), kept up to date the same way once they are built.
+ *
+ * The slot of a value stored in the page also holds a 7-bit
+ * fingerprint of the value, so a scan for one value rejects most other
+ * records by their slot alone (see mayHoldValue()).
  */
 class RecordFile {
  public:
 
-  // maximum length of the value field
-  static const int MAX_VALUE_LENGTH = 100;  
+  // the size of the page header and of a slot in the slot directory
+  static const int PAGE_HEADER_SIZE = 8;
+  static const int SLOT_SIZE = 8;
+
+  // the longest value stored in a heap page. longer values are stored
+  // on overflow pages
+  static const int MAX_INLINE_LENGTH = 255;
 
-  // number of record slots per page
-  static const int RECORDS_PER_PAGE = (PageFile::PAGE_SIZE - sizeof(int))/ (sizeof(int) + MAX_VALUE_LENGTH);  
-    // Note that we subtract sizeof(int) from PAGE_SIZE because the first
-    // four bytes in the page is used to store # records in the page.
+  // the largest number of records in a page (when the values are empty)
+  static const int RECORDS_PER_PAGE = (PageFile::PAGE_SIZE - PAGE_HEADER_SIZE) / (SLOT_SIZE + 1);
 
   RecordFile();
   RecordFile(const std::string& filename, char mode);
@@ -60,12 +85,16 @@ class RecordFile {
    * when opened in 'w' mode, if the file does not exist, it is created.
    * @param filename[IN] the name of the file to open
    * @param mode[IN] 'r' for read, 'w' for write
-   * @return error code. 0 if no error
+   * @param compress[IN] whether a file created by this call stores its
+   *                     pages compressed (see PageFile)
+   * @return error code. 0 if no error. RC_INVALID_FILE_FORMAT if the
+   *         file is not in the slotted-page format
    */
-  RC open(const std::string& filename, char mode);
+  RC open(const std::string& filename, char mode, bool compress = false);
 
   /**
-   * close the file.
+   * close the file. the zone map and the Bloom filters of a file opened
+   * for writing are saved.
    * @return error code. 0 if no error
    */
   RC close();
@@ -79,6 +108,75 @@ class RecordFile {
    */
   RC read(const RecordId& rid, int& key, std::string& value) const;
 
+  /**
+   * read a whole page of the file so that all records in the page
+   * can be obtained with a single page read (see recordValue()).
+   * @param pid[IN] the page to read
+   * @param page[OUT] memory buffer of PageFile::PAGE_SIZE bytes
+   * @return error code. 0 if no error
+   */
+  RC readPage(PageId pid, char* page) const;
+
+  /**
+   * @param page[IN] the page content returned by readPage()
+   * @return # records in the page. 0 for an overflow page
+   */
+  static int recordCount(const char* page);
+
+  /**
+   * read a record from a page obtained by readPage().
+   * @param page[IN] the page content returned by readPage()
+   * @param sid[IN] the slot number of the record in the page
+   * @param key[OUT] the record key
+   * @param value[OUT] the record value
+   * @return error code. 0 if no error
+   */
+  RC readRecord(const char* page, int sid, int& key, std::string& value) const;
+
+  /**
+   * read a record from a page obtained by readPage() without copying
+   * its value.
+   * @param page[IN] the page content returned by readPage()
+   * @param sid[IN] the slot number of the record in the page
+   * @param key[OUT] the record key
+   * @return the NUL-terminated value inside page. NULL if the value is
+   *         stored on overflow pages (see recordValue() below)
+   */
+  static const char* recordValue(const char* page, int sid, int& key);
+
+  /**
+   * read a record from a page obtained by readPage(). a value stored in
+   * the page is not copied; a value on overflow pages is read into a
+   * new string at the end of longValues.
+   * @param page[IN] the page content returned by readPage()
+   * @param sid[IN] the slot number of the record in the page
+   * @param key[OUT] the record key
+   * @param value[OUT] the NUL-terminated value, inside page or longValues
+   * @param longValues[IN/OUT] the long values read so far
+   * @return error code. 0 if no error
+   */
+  RC recordValue(const char* page, int sid, int& key, const char*& value,
+                 std::deque<std::string>& longValues) const;
+
+  /**
+   * compare a record of a page obtained by readPage() with a value by
+   * its length and fingerprint, without reading the record's value.
+   * @param page[IN] the page content returned by readPage()
+   * @param sid[IN] the slot number of the record in the page
+   * @param length[IN] # bytes of the value
+   * @param hash[IN] the hash of the value (BloomFilter::hash())
+   * @return false if the record certainly does not hold the value
+   */
+  static bool mayHoldValue(const char* page, int sid, int length, unsigned hash);
+
+  /**
+   * read only the key of a record from a page obtained by readPage().
+   * @param page[IN] the page content returned by readPage()
+   * @param sid[IN] the slot id of the record in the page
+   * @return the key of the record
+   */
+  static int recordKey(const char* page, int sid);
+
   /**
    * append a new record at the end of the file.
    * note that RecordFile does not have write() function.
@@ -91,14 +189,124 @@ class RecordFile {
   RC append(int key, const std::string& value, RecordId& rid);
 
   /**
-   * note the +1 part. The rid of the last record is endRid()-1.
+   * append n records at the end of the file. the pages are filled in
+   * memory and each page is written once, so loading a page of records
+   * costs one page write instead of one read and one write per record.
+   * @param n[IN] # records to append
+   * @param keys[IN] the keys of the records
+   * @param values[IN] the values of the records
+   * @param rids[OUT] the locations of the stored records
+   * @return error code. 0 if no error
+   */
+  RC appendBatch(int n, const int* keys, const std::string* values, RecordId* rids);
+
+  /**
+   * note the +1 part. The rid of the last record is (endRid().pid,
+   * endRid().sid - 1). the records are in the heap pages up to
+   * endRid().pid; the number of records of a page is recordCount().
    * @return (last record id + 1) of the RecordFile
    */
   const RecordId& endRid() const;
 
+  /**
+   * @return the PageFile storing the records (for its read statistics)
+   */
+  const PageFile& getPageFile() const { return pf; }
+
+  /**
+   * @return the key range of each page of the file
+   */
+  const ZoneMap& getZoneMap() const { return zones; }
+
+  /**
+   * @return the Bloom filters over the values of each page. not valid
+   *         if the file has none
+   */
+  const BloomFilter& getBloomFilter() const { return blooms; }
+
+  /**
+   * give the file Bloom filters over its values, built from its pages.
+   * they are kept up to date by append() and saved by close(). the
+   * file must be open for writing.
+   * @return error code. 0 if no error
+   */
+  RC buildBloomFilter();
+
+  /**
+   * Reads the heap pages of a file, or a range of its pages, in order.
+   * Each page is read once and its records are then taken from the page
+   * with recordCount(), recordKey() and recordValue(). Overflow pages are
+   * skipped, and the pages ahead of the scan are prefetched. Given a key
+   * range, the pages that the zone map rules out are not read; given a
+   * value, so are the pages that the Bloom filters rule out.
+   */
+  class Scanner {
+   public:
+    // # pages hinted to the OS at a time
+    static const int PREFETCH_PAGES = 32;
+
+    /**
+     * read all heap pages of the file.
+     * @param rf[IN] the file to read
+     */
+    Scanner(const RecordFile& rf);
+
+    /**
+     * read only the heap pages in [beginPid, endPid) of the file.
+     * @param rf[IN] the file to read
+     * @param beginPid[IN] the first page to read
+     * @param endPid[IN] the page after the last page to read
+     */
+    Scanner(const RecordFile& rf, PageId beginPid, PageId endPid);
+
+    /**
+     * read only the pages that may hold keys in [lo, hi]. the pages
+     * read may still hold other keys.
+     * @param lo[IN] the smallest key wanted (inclusive)
+     * @param hi[IN] the largest key wanted (inclusive)
+     */
+    void setKeyRange(int lo, int hi) { minKey = lo; maxKey = hi; }
+
+    /**
+     * read only the pages that may hold a value. the pages read may
+     * still hold other values.
+     * @param hash[IN] the hash of the value wanted (BloomFilter::hash())
+     */
+    void setValue(unsigned hash) { valueHash = hash; probe = true; }
+
+    /**
+     * read the next heap page.
+     * @param page[OUT] memory buffer of PageFile::PAGE_SIZE bytes
+     * @param pid[OUT] the id of the page read
+     * @param count[OUT] # records in the page. at least one
+     * @return 0 if a page was read. RC_END_OF_SCAN after the last page.
+     *         Otherwise an error code.
+     */
+    RC nextPage(char* page, PageId& pid, int& count);
+
+   private:
+    const RecordFile& rf;  // the file read
+    PageId nextPid;        // the next page to read
+    PageId endPid;         // the page after the last page to read
+    PageId prefetched;     // the page after the last page prefetched
+    int minKey;            // the key range wanted
+    int maxKey;
+    bool probe;            // whether a value is wanted
+    unsigned valueHash;    // the hash of the value wanted
+  };
+
  private:
   PageFile pf;     // the PageFile used to store the records
   RecordId erid;   // the last record id of the file + 1
+  ZoneMap zones;   // the key range of each page
+  std::string zoneFile;  // the file of the zone map
+  BloomFilter blooms;    // the values of each page, if the file has filters
+  std::string bloomFile; // the file of the Bloom filters
+  bool writable;   // whether the file is open for writing
+
+  RC readLongValue(const char* slotValue, std::string& value) const;
+  RC writeLongValue(const std::string& value, PageId heapPid, char* slotValue);
+  RC buildZoneMap();
 };
 
 #endif // RECORDFILE_H
@@ -0,0 +1,251 @@
+/*
+ * Output of the result of a SELECT statement.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "ResultSink.h"
+
+using namespace std;
+
+// "00" "01" ... "99": two digits are converted at a time
+static const char DIGITS[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+// write the decimal form of v at p and return the end of it.
+// p must have room for 11 characters.
+static char* formatInt(char* p, int v)
+{
+  char tmp[12];
+  char* q = tmp + sizeof(tmp);
+  unsigned u = (v < 0) ? 0u - (unsigned) v : (unsigned) v;
+
+  while (u >= 100) {
+    unsigned d = (u % 100) * 2;
+    u /= 100;
+    *--q = DIGITS[d + 1];
+    *--q = DIGITS[d];
+  }
+  if (u >= 10) {
+    *--q = DIGITS[u * 2 + 1];
+    *--q = DIGITS[u * 2];
+  } else {
+    *--q = (char) ('0' + u);
+  }
+  if (v < 0) *--q = '-';
+
+  int n = tmp + sizeof(tmp) - q;
+  memcpy(p, q, n);
+  return p + n;
+}
+
+// write v at p as a little-endian 32-bit integer
+static char* formatInt32(char* p, unsigned v)
+{
+  p[0] = (char) v;
+  p[1] = (char) (v >> 8);
+  p[2] = (char) (v >> 16);
+  p[3] = (char) (v >> 24);
+  return p + 4;
+}
+
+ResultSink::ResultSink(int fd, Format format)
+  : fd(fd), file(NULL), format(format), pending(0), error(0)
+{
+}
+
+ResultSink::ResultSink(FILE* out, Format format)
+  : fd(out == stdout ? STDOUT_FILENO : -1), file(out), format(format), pending(0), error(0)
+{
+}
+
+ResultSink::~ResultSink()
+{
+  flush();
+}
+
+void ResultSink::formatTuples(int attr, const TupleBatch& batch, Format format, string& out)
+{
+  int lengths[TupleBatch::CAPACITY];
+  unsigned size = 0;
+
+  // the most bytes a tuple may take besides its value
+  const unsigned extra = (format == TEXT) ? 16 : 12;
+
+  // SELECT count(*) prints no tuples
+  if (attr < 1 || attr > 3) return;
+
+  // find out how much room the tuples need and make it
+  for (int j = 0; j < batch.selSize; j++) {
+    int i = batch.sel[j];
+    lengths[j] = (attr == 1) ? 0 : strlen(batch.values[i]);
+    size += extra + lengths[j];
+  }
+  unsigned begin = out.size();
+  out.resize(begin + size);
+
+  char* start = &out[0] + begin;
+  char* p = start;
+  for (int j = 0; j < batch.selSize; j++) {
+    int i = batch.sel[j];
+    const char* value = batch.values[i];
+    int len = lengths[j];
+
+    if (format == TEXT) {
+      switch (attr) {
+      case 1:  // SELECT key
+        p = formatInt(p, batch.keys[i]);
+        break;
+      case 2:  // SELECT value
+        memcpy(p, value, len);
+        p += len;
+        break;
+      case 3:  // SELECT *
+        p = formatInt(p, batch.keys[i]);
+        *p++ = ' ';
+        *p++ = '\'';
+        memcpy(p, value, len);
+        p += len;
+        *p++ = '\'';
+        break;
+      }
+      *p++ = '\n';
+    } else {
+      switch (attr) {
+      case 1:  // SELECT key
+        p = formatInt32(p, 4);
+        p = formatInt32(p, batch.keys[i]);
+        break;
+      case 2:  // SELECT value
+        p = formatInt32(p, 4 + len);
+        p = formatInt32(p, len);
+        memcpy(p, value, len);
+        p += len;
+        break;
+      case 3:  // SELECT *
+        p = formatInt32(p, 8 + len);
+        p = formatInt32(p, batch.keys[i]);
+        p = formatInt32(p, len);
+        memcpy(p, value, len);
+        p += len;
+        break;
+      }
+    }
+  }
+
+  out.resize(begin + (p - start));
+}
+
+void ResultSink::add(int attr, const TupleBatch& batch)
+{
+  unsigned before = buffer.size();
+  if (buffer.capacity() == 0) buffer.reserve(FLUSH_SIZE + FLUSH_SIZE / 4);
+
+  formatTuples(attr, batch, format, buffer);
+  pending += buffer.size() - before;
+  if (pending >= FLUSH_SIZE) flush();
+}
+
+void ResultSink::addCount(int count)
+{
+  char  line[16];
+  char* p = line;
+
+  if (format == TEXT) {
+    p = formatInt(p, count);
+    *p++ = '\n';
+  } else {
+    p = formatInt32(p, 4);
+    p = formatInt32(p, count);
+  }
+  buffer.append(line, p - line);
+  pending += p - line;
+}
+
+// move the buffer behind the chunks
+void ResultSink::addBuffer()
+{
+  if (buffer.empty()) return;
+  chunks.push_back(string());
+  chunks.back().swap(buffer);
+}
+
+void ResultSink::addFormatted(string& chunk)
+{
+  if (chunk.empty()) return;
+
+  addBuffer();
+  pending += chunk.size();
+  chunks.push_back(string());
+  chunks.back().swap(chunk);
+  if (pending >= FLUSH_SIZE) flush();
+}
+
+// write the chunks to fd with as few writev() calls as possible
+RC ResultSink::writeChunks()
+{
+  // the command line prints through stdio. keep the order of the output.
+  if (fd == STDOUT_FILENO) fflush(stdout);
+
+  vector<struct iovec> iov(chunks.size());
+  for (unsigned i = 0; i < chunks.size(); i++) {
+    iov[i].iov_base = &chunks[i][0];
+    iov[i].iov_len = chunks[i].size();
+  }
+
+  unsigned first = 0;
+  while (first < iov.size()) {
+    int count = iov.size() - first;
+    if (count > IOV_MAX) count = IOV_MAX;
+
+    ssize_t n = ::writev(fd, &iov[first], count);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return RC_FILE_WRITE_FAILED;
+    }
+
+    // skip what was written. a short write leaves part of a chunk.
+    while (first < iov.size() && (size_t) n >= iov[first].iov_len) {
+      n -= iov[first++].iov_len;
+    }
+    if (n > 0) {
+      iov[first].iov_base = (char*) iov[first].iov_base + n;
+      iov[first].iov_len -= n;
+    }
+  }
+  return 0;
+}
+
+RC ResultSink::flush()
+{
+  RC rc = 0;
+
+  addBuffer();
+  if (chunks.empty()) return error;
+
+  if (error < 0) {
+    rc = error;
+  } else if (fd < 0) {
+    for (unsigned i = 0; i < chunks.size() && rc == 0; i++) {
+      if (fwrite(chunks[i].data(), 1, chunks[i].size(), file) != chunks[i].size()) {
+        rc = RC_FILE_WRITE_FAILED;
+      }
+    }
+  } else {
+    rc = writeChunks();
+  }
+
+  // keep the first chunk as the buffer for the next tuples
+  chunks[0].clear();
+  buffer.swap(chunks[0]);
+  chunks.clear();
+  pending = 0;
+  if (rc < 0) error = rc;
+  return rc;
+}
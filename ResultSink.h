@@ -0,0 +1,110 @@
+/*
+ * Output of the result of a SELECT statement.
+ */
+
+#ifndef RESULTSINK_H
+#define RESULTSINK_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "TupleBatch.h"
+
+/**
+ * Writes the tuples of a result to a file descriptor or a stdio stream.
+ * The tuples are formatted into large buffers that are written with
+ * one writev() call (one fwrite() per buffer for a stream) once about
+ * FLUSH_SIZE bytes are pending, instead of one stdio call per tuple.
+ *
+ * In TEXT format each tuple is a line, as printed by the command line:
+ *   SELECT key:      <key>
+ *   SELECT value:    <value>
+ *   SELECT *:        <key> '<value>'
+ *   SELECT count(*): <count>
+ * In BINARY format, for programs reading the result, each tuple is a
+ * 32-bit length followed by that many bytes holding the columns: a key
+ * (or count) is a 32-bit integer, and a value is a 32-bit length
+ * followed by its bytes. All integers are little-endian.
+ */
+class ResultSink {
+ public:
+  enum Format { TEXT, BINARY };
+
+  // the buffered output is written once this many bytes are pending
+  static const unsigned FLUSH_SIZE = 1 << 20;
+
+  /**
+   * @param fd[IN] the file descriptor to write to
+   * @param format[IN] the format of the tuples
+   */
+  ResultSink(int fd, Format format);
+
+  /**
+   * @param out[IN] the stream to write to. stdout is written to with
+   *                writev() on its file descriptor, like ResultSink(fd)
+   * @param format[IN] the format of the tuples
+   */
+  ResultSink(FILE* out, Format format);
+
+  /**
+   * write the rest of the output.
+   */
+  ~ResultSink();
+
+  /**
+   * @return the format of the tuples
+   */
+  Format getFormat() const { return format; }
+
+  /**
+   * add the selected tuples of a batch to the output.
+   * @param attr[IN] attribute in the SELECT clause (1: key, 2: value, 3: *)
+   * @param batch[IN] the tuples to add
+   */
+  void add(int attr, const TupleBatch& batch);
+
+  /**
+   * add the result of SELECT count(*) to the output.
+   * @param count[IN] the # matching tuples
+   */
+  void addCount(int count);
+
+  /**
+   * add tuples already formatted by formatTuples() to the output.
+   * the string is taken over without copying and left empty.
+   * @param chunk[IN/OUT] the formatted tuples
+   */
+  void addFormatted(std::string& chunk);
+
+  /**
+   * write all the pending output.
+   * @return error code. 0 if no error. an error of a write made while
+   *         tuples were added (e.g., the client closed the socket) is
+   *         returned as well
+   */
+  RC flush();
+
+  /**
+   * format the selected tuples of a batch and append them to out.
+   * @param attr[IN] attribute in the SELECT clause (1: key, 2: value, 3: *)
+   * @param batch[IN] the tuples to format
+   * @param format[IN] the format of the tuples
+   * @param out[IN/OUT] the string to append to
+   */
+  static void formatTuples(int attr, const TupleBatch& batch, Format format, std::string& out);
+
+ private:
+  int    fd;     // -1 if writing to file
+  FILE*  file;
+  Format format;
+  std::string buffer;               // the tuples added by add()
+  std::vector<std::string> chunks;  // the output not yet written, in order
+  unsigned pending;                 // # bytes in buffer and chunks
+  RC     error;  // the first write error. the output after it is dropped
+
+  void addBuffer();
+  RC writeChunks();
+};
+
+#endif /* RESULTSINK_H */
@@ -0,0 +1,222 @@
+/*
+ * Pull-based execution of SELECT statements.
+ */
+
+#include <new>
+#include "SelectCursor.h"
+
+using namespace std;
+
+SelectCursor::SelectCursor()
+  : attr(0), table(NULL), arena(NULL), tableScan(NULL), columnScan(NULL), indexScan(NULL),
+    valueScan(NULL), heapScan(NULL), heapOpen(false)
+{
+}
+
+SelectCursor::~SelectCursor()
+{
+  close();
+}
+
+RC SelectCursor::open(int attr, const string& table, const vector<SelCond>& conds)
+{
+  RC rc;
+  TableHandle* handle;
+
+  close();
+
+  // the table file, the index and the statistics
+  if ((rc = Catalog::instance().open(table, handle)) < 0) {
+    return rc;
+  }
+  return open(attr, *handle, conds, NULL);
+}
+
+RC SelectCursor::open(int attr, TableHandle& handle, const vector<SelCond>& conds,
+                      const QueryPlan* generic, Arena* arena)
+{
+  close();
+  this->attr = attr;
+  this->arena = arena;
+  table = &handle;
+
+  RecordFile& rf = table->rf;
+  BTreeIndex& bt = table->bt;
+  const TableStats* stats = table->hasStats ? &table->stats : NULL;
+
+  if (generic != NULL) {
+    plan = *generic;
+    plan.rebind(conds, stats);
+  } else {
+    plan.build(attr, conds, *table);
+  }
+
+  switch (plan.path) {
+  case QueryPlan::EMPTY_RESULT:
+    break;
+  case QueryPlan::SEQ_SCAN:
+    if (plan.columnar) {
+      columnScan = new (allocate(sizeof(ColumnBatchScan))) ColumnBatchScan(table->cf);
+      if (!plan.needsValues(attr)) columnScan->skipValues();
+      columnScan->setKeyRange(plan.minKey, plan.maxKey);
+      if (plan.columnRange) columnScan->setValueRange(plan.valueRange);
+      ops.push_back(OperatorStats("Column Scan"));
+      break;
+    }
+    tableScan = new (allocate(sizeof(TableBatchScan))) TableBatchScan(rf, arena);
+    if (!plan.needsValues(attr)) tableScan->skipValues();
+    tableScan->setKeyRange(plan.minKey, plan.maxKey);
+    if (plan.valueProbe() != NULL) tableScan->setValue(plan.valueProbe());
+    ops.push_back(OperatorStats("Seq Scan"));
+    break;
+  case QueryPlan::INDEX_ONLY_SCAN:
+    indexScan = new (allocate(sizeof(IndexBatchScan))) IndexBatchScan(bt, plan.minKey, plan.maxKey);
+    ops.push_back(OperatorStats("Index Only Scan"));
+    break;
+  case QueryPlan::INDEX_SCAN:
+    indexScan = new (allocate(sizeof(IndexBatchScan))) IndexBatchScan(bt, plan.minKey, plan.maxKey);
+    heapScan = new (allocate(sizeof(BitmapHeapScan))) BitmapHeapScan(rf, arena);
+    ops.push_back(OperatorStats("Index Scan"));
+    break;
+  case QueryPlan::BITMAP_HEAP_SCAN:
+    indexScan = new (allocate(sizeof(IndexBatchScan))) IndexBatchScan(bt, plan.minKey, plan.maxKey);
+    heapScan = new (allocate(sizeof(BitmapHeapScan))) BitmapHeapScan(rf, arena);
+    ops.push_back(OperatorStats("Bitmap Index Scan"));
+    ops.push_back(OperatorStats("Bitmap Heap Scan"));
+    break;
+  case QueryPlan::VALUE_INDEX_SCAN:
+    valueScan = new (allocate(sizeof(ValueIndexScan))) ValueIndexScan(table->vi, plan.valueRange);
+    heapScan = new (allocate(sizeof(BitmapHeapScan))) BitmapHeapScan(rf, arena);
+    ops.push_back(OperatorStats("Value Index Scan"));
+    break;
+  }
+  return 0;
+}
+
+// memory for an operator: from the arena of the statement if there is one
+void* SelectCursor::allocate(size_t size)
+{
+  return (arena != NULL) ? arena->allocate(size) : ::operator new(size);
+}
+
+// destruct an operator made with allocate()
+template<class T> void SelectCursor::destroy(T*& op)
+{
+  if (op == NULL) return;
+  op->~T();
+  if (arena == NULL) ::operator delete(op);
+  op = NULL;
+}
+
+void SelectCursor::close()
+{
+  destroy(tableScan);
+  destroy(columnScan);
+  destroy(indexScan);
+  destroy(valueScan);
+  destroy(heapScan);
+  heapOpen = false;
+  ops.clear();
+
+  if (table != NULL) table->release();
+  table = NULL;
+}
+
+// collect the rids of the qualifying index entries of a bitmap heap scan
+RC SelectCursor::collectRids()
+{
+  RC rc;
+  OperatorStats& op = ops[0];
+
+  op.start(&table->bt.getPageFile(), NULL);
+  while ((rc = indexScan->next(batch)) == 0) {
+    plan.keyFilter.filter(batch);
+    heapScan->add(batch);
+  }
+  heapScan->open();
+  op.rows = heapScan->size();
+  op.stop();
+
+  heapOpen = true;
+  return (rc == RC_END_OF_SCAN) ? 0 : rc;
+}
+
+RC SelectCursor::next(const TupleBatch*& result)
+{
+  RC rc = RC_END_OF_SCAN;
+
+  if (table == NULL) return RC_END_OF_SCAN;
+  const PageFile& table_pf = table->getPageFile();
+  const PageFile& index_pf = (valueScan != NULL) ? table->vi.getPageFile()
+                                                 : table->bt.getPageFile();
+
+  switch (plan.path) {
+  case QueryPlan::EMPTY_RESULT:
+    return RC_END_OF_SCAN;
+
+  case QueryPlan::SEQ_SCAN:
+    // read the whole table and check every condition on each tuple
+    ops[0].start(NULL, &table_pf);
+    while ((rc = (columnScan != NULL) ? columnScan->next(batch) : tableScan->next(batch)) == 0) {
+      plan.keyFilter.filter(batch);
+      plan.valueFilter.filter(batch);
+      if (batch.selSize > 0) break;
+    }
+    ops[0].rows += (rc == 0) ? batch.selSize : 0;
+    ops[0].stop();
+    result = &batch;
+    return rc;
+
+  case QueryPlan::INDEX_ONLY_SCAN:
+    // the index alone answers the query
+    ops[0].start(&index_pf, NULL);
+    while ((rc = indexScan->next(batch)) == 0) {
+      plan.keyFilter.filter(batch);
+      if (batch.selSize > 0) break;
+    }
+    ops[0].rows += (rc == 0) ? batch.selSize : 0;
+    ops[0].stop();
+    result = &batch;
+    return rc;
+
+  case QueryPlan::INDEX_SCAN:
+  case QueryPlan::VALUE_INDEX_SCAN:
+    // fetch the records of each batch of index entries in heap order
+    ops[0].start(&index_pf, &table_pf);
+    for (;;) {
+      if (heapOpen) {
+        if ((rc = heapScan->next(records)) == 0) {
+          plan.valueFilter.filter(records);
+          if (records.selSize > 0) break;
+          continue;
+        }
+        if (rc != RC_END_OF_SCAN) break;
+        heapOpen = false;
+      }
+      if ((rc = (valueScan != NULL) ? valueScan->next(batch) : indexScan->next(batch)) < 0) break;
+      plan.keyFilter.filter(batch);
+      heapScan->clear();
+      heapScan->add(batch);
+      heapScan->open();
+      heapOpen = true;
+    }
+    ops[0].rows += (rc == 0) ? records.selSize : 0;
+    ops[0].stop();
+    result = &records;
+    return rc;
+
+  case QueryPlan::BITMAP_HEAP_SCAN:
+    // fetch the records of all qualifying index entries page by page
+    if (!heapOpen && (rc = collectRids()) < 0) return rc;
+    ops[1].start(NULL, &table_pf);
+    while ((rc = heapScan->next(batch)) == 0) {
+      plan.valueFilter.filter(batch);
+      if (batch.selSize > 0) break;
+    }
+    ops[1].rows += (rc == 0) ? batch.selSize : 0;
+    ops[1].stop();
+    result = &batch;
+    return rc;
+  }
+  return rc;
+}
@@ -0,0 +1,115 @@
+/*
+ * Pull-based execution of SELECT statements.
+ */
+
+#ifndef SELECTCURSOR_H
+#define SELECTCURSOR_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "Arena.h"
+#include "SqlEngine.h"
+#include "Catalog.h"
+#include "QueryPlan.h"
+#include "TupleBatch.h"
+#include "BatchScan.h"
+#include "BitmapHeapScan.h"
+
+/**
+ * Runs the plan of a SELECT statement one batch at a time.
+ * open() gets the table, its index and statistics from the catalog and
+ * plans the statement; each next() returns the next batch with matching tuples.
+ * The operators of the plan keep their state between the calls, so the
+ * caller decides how fast the result is pulled.
+ */
+class SelectCursor {
+ public:
+  SelectCursor();
+  ~SelectCursor();
+
+  /**
+   * get the open table from the catalog and plan the statement.
+   * @param attr[IN] attribute in the SELECT clause
+   * @param table[IN] the table name in the FROM clause
+   * @param conds[IN] list of conditions in the WHERE clause
+   * @return error code. 0 if no error
+   */
+  RC open(int attr, const std::string& table, const std::vector<SelCond>& conds);
+
+  /**
+   * plan the statement on a table the caller got from the catalog.
+   * the cursor takes over the caller's use of the handle and releases
+   * it when it is closed.
+   * @param attr[IN] attribute in the SELECT clause
+   * @param handle[IN] the open table
+   * @param conds[IN] list of conditions in the WHERE clause
+   * @param generic[IN] a generic plan of the same statement to rebind
+   *                    instead of planning it again. NULL if there is none
+   * @param arena[IN] the arena of the statement to put the operators and
+   *                  their buffers in. it must not be reset before the
+   *                  cursor is closed. NULL to allocate them on the heap
+   * @return error code. 0 if no error
+   */
+  RC open(int attr, TableHandle& handle, const std::vector<SelCond>& conds,
+          const QueryPlan* generic, Arena* arena = NULL);
+
+  /**
+   * read the next batch of the result.
+   * @param batch[OUT] the batch. the selected tuples match the statement
+   *                   and there is at least one of them. the batch and
+   *                   its values stay valid until the next call.
+   * @return 0 if a batch was read. RC_END_OF_SCAN at the end of the
+   *         result. Otherwise an error code.
+   */
+  RC next(const TupleBatch*& batch);
+
+  /**
+   * release the table.
+   */
+  void close();
+
+  int getAttr() const { return attr; }
+  const QueryPlan& getPlan() const { return plan; }
+  const RecordFile& getTable() const { return table->rf; }
+
+  /**
+   * @return the table if it is in the columnar format. NULL otherwise
+   */
+  const ColumnFile* getColumnFile() const { return table->columnar ? &table->cf : NULL; }
+
+  /**
+   * @return the index on the table. NULL if there is none
+   */
+  BTreeIndex* getIndex() { return table->hasIndex ? &table->bt : NULL; }
+
+  /**
+   * @return the statistics of the operators run so far
+   */
+  std::vector<OperatorStats>& getOperatorStats() { return ops; }
+
+ private:
+  int  attr;
+  TableHandle* table;   // the table read. NULL if the cursor is closed
+  QueryPlan  plan;
+  Arena* arena;         // where the operators are. NULL for the heap
+
+  TableBatchScan* tableScan;  // SEQ_SCAN
+  ColumnBatchScan* columnScan;  // SEQ_SCAN of a columnar table
+  IndexBatchScan* indexScan;  // the index paths
+  ValueIndexScan* valueScan;  // VALUE_INDEX_SCAN
+  BitmapHeapScan* heapScan;   // INDEX_SCAN, BITMAP_HEAP_SCAN and
+                              //   VALUE_INDEX_SCAN
+  bool heapOpen;              // whether heapScan holds rids to fetch
+  TupleBatch batch;           // the batch read from the table or index
+  TupleBatch records;         // the records fetched for an index scan
+  std::vector<OperatorStats> ops;
+
+  RC collectRids();
+  void* allocate(size_t size);
+  template<class T> void destroy(T*& op);
+  SelectCursor(const SelectCursor&);
+  SelectCursor& operator=(const SelectCursor&);
+};
+
+#endif /* SELECTCURSOR_H */
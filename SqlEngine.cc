@@ -14,342 +14,611 @@
 #include <climits>
 #include <iostream>
 #include <fstream>
+#include <pthread.h>
+#include <unistd.h>
 #include "Bruinbase.h"
 #include "SqlEngine.h"
 #include "BTreeIndex.h"
+#include "ValueIndex.h"
+#include "BitmapHeapScan.h"
+#include "BatchScan.h"
+#include "QueryPlan.h"
+#include "SelectCursor.h"
+#include "Catalog.h"
+#include "ResultSink.h"
+#include "TableStats.h"
+#include "ThreadPool.h"
+#include "WriteAheadLog.h"
 
 using namespace std;
 
-// external functions and variables for load file and sql command parsing 
-extern FILE* sqlin;
-int sqlparse(void);
+// # tuples LOAD appends to the table at a time
+static const int LOAD_BATCH = 1024;
 
+// the worker threads of parallel scans, started on first use. one
+// statement at a time uses them; the others scan serially. the pool
+// is resized, with poolLock held, for a statement of a session whose
+// parallelism differs.
+static ThreadPool* pool = NULL;
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
 
-RC SqlEngine::run(FILE* commandline)
+/*
+ * the state of a running SELECT statement
+ */
+struct SelectRun {
+  int attr;                  // attribute in the SELECT clause
+  const RecordFile* rf;      // the table
+  const ColumnFile* cf;      // the table if it is columnar. NULL otherwise
+  BTreeIndex* bt;            // the index on the table. NULL if none
+  const QueryPlan* plan;     // the plan to run
+  const SqlEngine::Settings* settings;  // the settings of the session
+  bool print;                // print the matching tuples
+  int  count;                // # matching tuples
+  ResultSink* sink;          // where the matching tuples are printed
+  vector<OperatorStats> ops; // statistics of the operators run
+};
+
+// the selected tuples of a batch are in the result: count them and
+// print them for "SELECT attr"
+static void emitBatch(SelectRun& run, const TupleBatch& batch)
 {
-  fprintf(stdout, "Bruinbase> ");
+  run.count += batch.selSize;
+  if (run.print) run.sink->add(run.attr, batch);
+}
 
-  // set the command line input and start parsing user input
-  sqlin = commandline;
-  sqlparse();  // sqlparse() is defined in SqlParser.tab.c generated from
-               // SqlParser.y by bison (bison is GNU equivalent of yacc)
+// # worker threads of a parallel scan
+static int workerCount(const SqlEngine::Settings& settings)
+{
+  if (settings.parallelism > 0) return settings.parallelism;
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? (int) n : 1;
+}
 
-  return 0;
+/*
+ * the state of a parallel scan. the input is cut into parts (morsels of
+ * MORSEL_PAGES table pages or MORSEL_SEGMENTS segments of a columnar
+ * table, or sub-ranges of the index keys) that the
+ * worker threads scan independently. each part counts and prints its
+ * own tuples; the counts are added up and the output of the parts is
+ * written in table or key order (or, if the output need not be
+ * ordered, as soon as a part is done).
+ */
+struct ParallelScan {
+  // # pages of a morsel
+  static const int MORSEL_PAGES = 8 * TableBatchScan::BATCH_PAGES;
+
+  // # segments of a morsel of a columnar table
+  static const int MORSEL_SEGMENTS = 4;
+
+  // # tuples worth running in parallel
+  static const int MIN_ROWS = 16 * TupleBatch::CAPACITY;
+
+  struct Part {
+    RC     rc;       // error code of the part
+    int    count;    // # matching tuples of the part
+    int    reads;    // # disk page reads of the part
+    OperatorStats stats;  // the reads and CPU time of the part
+    string out;      // the printed tuples of the part
+    bool   done;     // whether the part has been scanned
+  };
+
+  // scan part m: count the matching tuples and print them to out
+  RC (*scan)(const ParallelScan& ps, int m, int& count, string& out);
+
+  SelectRun* run;
+  const PageFile* index;    // the files read by the parts, as given to
+  const PageFile* heap;     //   OperatorStats::start()
+  PageId endPid;            // the page after the last page of the table
+  int endSegment;           // the segment after the last segment of a
+                            //   columnar table
+  vector<int> lowKeys;      // part m of an index scan reads
+  vector<int> highKeys;     //   [lowKeys[m], highKeys[m]]
+  vector<Part> parts;
+  pthread_mutex_t lock;     // protects the parts and stdout
+  pthread_cond_t  ready;    // signaled when a part is done
+};
+
+// scan morsel m of a columnar table
+static RC scanSegments(const ParallelScan& ps, int m, int& count, string& out)
+{
+  RC     rc;
+  const SelectRun& run = *ps.run;
+  const QueryPlan& plan = *run.plan;
+  int    begin = m * ParallelScan::MORSEL_SEGMENTS;
+  int    end = begin + ParallelScan::MORSEL_SEGMENTS;
+  ColumnBatchScan scan(*run.cf, begin, (end < ps.endSegment) ? end : ps.endSegment);
+  TupleBatch batch;
+
+  if (!plan.needsValues(run.attr)) scan.skipValues();
+  scan.setKeyRange(plan.minKey, plan.maxKey);
+  if (plan.columnRange) scan.setValueRange(plan.valueRange);
+
+  while ((rc = scan.next(batch)) == 0) {
+    plan.keyFilter.filter(batch);
+    plan.valueFilter.filter(batch);
+    count += batch.selSize;
+    if (run.print) ResultSink::formatTuples(run.attr, batch, run.sink->getFormat(), out);
+  }
+  return (rc == RC_END_OF_SCAN) ? 0 : rc;
 }
 
-RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
+// scan morsel m of the table
+static RC scanMorsel(const ParallelScan& ps, int m, int& count, string& out)
 {
-  RecordFile rf;   // RecordFile containing the table
-  RecordId   rid;  // record cursor for table scanning
+  RC     rc;
+  const SelectRun& run = *ps.run;
+  const QueryPlan& plan = *run.plan;
+  PageId begin = m * ParallelScan::MORSEL_PAGES;
+  PageId end = begin + ParallelScan::MORSEL_PAGES;
+  TableBatchScan scan(*run.rf, begin, (end < ps.endPid) ? end : ps.endPid);
+  TupleBatch batch;
+
+  if (!plan.needsValues(run.attr)) scan.skipValues();
+  scan.setKeyRange(plan.minKey, plan.maxKey);
+  if (plan.valueProbe() != NULL) scan.setValue(plan.valueProbe());
+
+  while ((rc = scan.next(batch)) == 0) {
+    plan.keyFilter.filter(batch);
+    plan.valueFilter.filter(batch);
+    count += batch.selSize;
+    if (run.print) ResultSink::formatTuples(run.attr, batch, run.sink->getFormat(), out);
+  }
+  return (rc == RC_END_OF_SCAN) ? 0 : rc;
+}
 
-  vector<SelCond> remaining_conds;
+// scan key range m of the index, fetching the records of each batch of
+// index entries in heap order unless the index alone answers the query
+static RC scanKeyRange(const ParallelScan& ps, int m, int& count, string& out)
+{
   RC     rc;
-  int    key;     
-  string value;
-  int    count;
-  int    diff;
+  const SelectRun& run = *ps.run;
+  const QueryPlan& plan = *run.plan;
+  bool   fetch = (plan.path == QueryPlan::INDEX_SCAN);
+  IndexBatchScan scan(*run.bt, ps.lowKeys[m], ps.highKeys[m]);
+  BitmapHeapScan heap_scan(*run.rf);
+  TupleBatch batch;
+  TupleBatch records;
+
+  while ((rc = scan.next(batch)) == 0) {
+    plan.keyFilter.filter(batch);
+    if (!fetch) {
+      count += batch.selSize;
+      if (run.print) ResultSink::formatTuples(run.attr, batch, run.sink->getFormat(), out);
+      continue;
+    }
 
-  int min_key;
-  int max_key;
-  bool conflicting_conditions;
+    heap_scan.clear();
+    heap_scan.add(batch);
+    heap_scan.open();
+    while ((rc = heap_scan.next(records)) == 0) {
+      plan.valueFilter.filter(records);
+      count += records.selSize;
+      if (run.print) ResultSink::formatTuples(run.attr, records, run.sink->getFormat(), out);
+    }
+    if (rc != RC_END_OF_SCAN) break;
+  }
+  return (rc == RC_END_OF_SCAN) ? 0 : rc;
+}
 
-  IndexCursor ic;
-  BTLeafNode leaf;
+// run part m of a parallel scan (on a worker thread)
+static void runPart(void* arg, int m)
+{
+  ParallelScan& ps = *(ParallelScan*) arg;
+  string out;
+  int    count = 0;
+  int    reads = PageFile::getThreadReadCount();
+  OperatorStats stats;
+
+  stats.start(ps.index, ps.heap);
+  RC rc = ps.scan(ps, m, count, out);
+  stats.stop();
+
+  pthread_mutex_lock(&ps.lock);
+  ParallelScan::Part& part = ps.parts[m];
+  part.rc = rc;
+  part.count = count;
+  part.reads = PageFile::getThreadReadCount() - reads;
+  part.stats = stats;
+  if (ps.run->settings->ordered) {
+    part.out.swap(out);
+  } else if (rc == 0) {
+    ps.run->sink->addFormatted(out);
+  }
+  part.done = true;
+  pthread_cond_broadcast(&ps.ready);
+  pthread_mutex_unlock(&ps.lock);
+}
 
-  // open the table file
-  if ((rc = rf.open(table + ".tbl", 'r')) < 0) {
-    return rc;
+// run the n parts of a parallel scan with the worker threads and
+// collect their results in order. called with poolLock held
+static RC parallelScan(SelectRun& run, ParallelScan& ps, int n, OperatorStats& op)
+{
+  RC rc = 0;
+
+  ps.run = &run;
+  ps.parts.resize(n);
+  for (int m = 0; m < n; m++) {
+    ps.parts[m].rc = 0;
+    ps.parts[m].count = 0;
+    ps.parts[m].reads = 0;
+    ps.parts[m].done = false;
   }
+  pthread_mutex_init(&ps.lock, NULL);
+  pthread_cond_init(&ps.ready, NULL);
 
-  // open the BTreeIndex. 
-  BTreeIndex bt;
-  rc = bt.open(table + ".idx", 'r');
-  if (rc < 0) {
-    goto read_all;
+  pool->start(n, runPart, &ps);
+
+  for (int m = 0; m < n; m++) {
+    pthread_mutex_lock(&ps.lock);
+    while (!ps.parts[m].done) {
+      pthread_cond_wait(&ps.ready, &ps.lock);
+    }
+    ParallelScan::Part& part = ps.parts[m];
+    if (part.rc < 0 && rc == 0) rc = part.rc;
+    run.count += part.count;
+    op.rows += part.count;
+    op.addPart(part.stats);
+    PageFile::addThreadReadCount(part.reads);
+    if (run.settings->ordered && rc == 0) {
+      run.sink->addFormatted(part.out);
+    }
+    string().swap(part.out);
+    pthread_mutex_unlock(&ps.lock);
   }
+  pool->wait();
 
-  // the new stuff. if we do in fact find that there is an index. 
-  // TODO figure out how to initialize these values? 
+  pthread_cond_destroy(&ps.ready);
+  pthread_mutex_destroy(&ps.lock);
+  return rc;
+}
 
-  // save the min/max value of the key (inclusive)
-  min_key = INT_MIN;
-  max_key = INT_MAX;
-  conflicting_conditions = false;
+// run the statement with the worker threads when it reads a large
+// table or a large key range. returns false if it was not run.
+static bool parallelSelect(SelectRun& run, RC& rc)
+{
+  const QueryPlan& plan = *run.plan;
+  int    workers = workerCount(*run.settings);
+  ParallelScan ps;
+  vector<int> splits;
+
+  if (workers <= 1) return false;
+  if (pthread_mutex_trylock(&poolLock) != 0) return false;
+
+  // the pool has the workers of the session running the statement
+  if (pool != NULL && pool->size() != workers) {
+    delete pool;
+    pool = NULL;
+  }
+  if (pool == NULL) pool = new ThreadPool(workers);
+
+  // scan large columnar tables a few segments at a time
+  if (plan.path == QueryPlan::SEQ_SCAN && run.cf != NULL &&
+      run.cf->segmentCount() >= 2 * ParallelScan::MORSEL_SEGMENTS) {
+    OperatorStats op("Parallel Column Scan");
+
+    ps.scan = scanSegments;
+    ps.endSegment = run.cf->segmentCount();
+    int n = (ps.endSegment + ParallelScan::MORSEL_SEGMENTS - 1) / ParallelScan::MORSEL_SEGMENTS;
+
+    ps.index = NULL;
+    ps.heap = &run.cf->getPageFile();
+    op.start(ps.index, ps.heap);
+    rc = parallelScan(run, ps, n, op);
+    op.stop();
+    run.ops.push_back(op);
+    pthread_mutex_unlock(&poolLock);
+    return true;
+  }
 
-  //=======================================
-  // finding upper and lower bounds
-  for (unsigned i = 0; i < cond.size(); i++)
-  {
-    SelCond sc = cond[i];
-    if (sc.attr != 1) {
-      remaining_conds.push_back(sc);
-    } else if (sc.attr == 1) {
-        // this flag indicates whether or not the condition was used to constrain
-        // the min/max key bounds. This is useful for determining if we can 
-        // remove the condition from the cond vector
-        
-        key = atoi(cond[i].value);
-        switch(sc.comp) {
-        case SelCond::EQ:
-          if (key < min_key || key > max_key) {
-              // constraint conflict. No need to check any more conditions
-              conflicting_conditions = true;
-              goto end_bounds_constraint;
-          } else {
-              min_key = key;
-              max_key = min_key;
-          }
-          break;
-        case SelCond::NE:
-			    remaining_conds.push_back(sc);
-          break;
-        case SelCond::GT:
-          if (max_key <= key) {
-              // constraint conflict. No need to check any more conditions
-              conflicting_conditions = true;
-              goto end_bounds_constraint;
-            }
-            else if (min_key < key + 1)
-              min_key = key + 1;
-          break;
-        case SelCond::LT:
-            if (min_key >= key) {
-                // constraint conflict. No need to check any more conditions
-                conflicting_conditions = true;
-                goto end_bounds_constraint;
-            }
-            else if (max_key > key - 1)
-              max_key = key - 1;
-            break;
-        case SelCond::GE:
-            if (max_key < key) {
-                // constraint conflict. No need to check any more conditions
-                conflicting_conditions = true;
-                goto end_bounds_constraint;
-            }
-            else if (min_key < key)
-              min_key = key;
-            break;
-        case SelCond::LE:
-            if (min_key > key) {
-                // constraint conflict. No need to check any more conditions
-                conflicting_conditions = true;
-                goto end_bounds_constraint;
-            }
-            else if (max_key > key)
-              max_key = key;
-            break;
-        }
-    }
+  // scan large tables a morsel at a time
+  if (plan.path == QueryPlan::SEQ_SCAN && run.cf == NULL &&
+      run.rf->endRid().pid >= 2 * ParallelScan::MORSEL_PAGES) {
+    OperatorStats op("Parallel Seq Scan");
+
+    ps.scan = scanMorsel;
+    ps.endPid = run.rf->endRid().pid + 1;
+    int n = (ps.endPid + ParallelScan::MORSEL_PAGES - 1) / ParallelScan::MORSEL_PAGES;
+
+    ps.index = NULL;
+    ps.heap = &run.rf->getPageFile();
+    op.start(ps.index, ps.heap);
+    rc = parallelScan(run, ps, n, op);
+    op.stop();
+    run.ops.push_back(op);
+    pthread_mutex_unlock(&poolLock);
+    return true;
   }
-  
-end_bounds_constraint:
-  // if all conditions require a read of the full table, read_all
-  if (remaining_conds.size() == cond.size())
-	  goto read_all;
-  if (conflicting_conditions)
-    goto exit_select;
-
-  rc = bt.locate(min_key, ic);
-  //fprintf(stdout, "cursor.pid: %d, cursor.eid: %d\n", ic.pid, ic.eid);
-  rc = bt.readForward(ic, key, rid);
-  //fprintf(stdout, "cursor.pid: %d, cursor.eid: %d, key: %d\n", ic.pid, ic.eid, key);
-  count = 0;
-
-  while (!rc && (key <= max_key)) {
-    for (unsigned i = 0; i < remaining_conds.size(); i++) {
-      // compute the difference between the tuple value and the condition value
-      switch (remaining_conds[i].attr) {
-      case 1:
-        diff = key - atoi(remaining_conds[i].value);
-        break;
-      case 2:
-        diff = strcmp(value.c_str(), remaining_conds[i].value);
-        break;
-      }
 
-      // skip the leaf if any condition is not met
-      switch (remaining_conds[i].comp) {
-      case SelCond::EQ:
-        if (diff != 0) goto next_leaf;
-        break;
-      case SelCond::NE:
-        if (diff == 0) goto next_leaf;
-        break;
-      case SelCond::GT:
-        if (diff <= 0) goto next_leaf;
-        break;
-      case SelCond::LT:
-        if (diff >= 0) goto next_leaf;
-        break;
-      case SelCond::GE:
-        if (diff < 0) goto next_leaf;
-        break;
-      case SelCond::LE:
-        if (diff > 0) goto next_leaf;
-        break;
-      }
+  // split large ranges by the separator keys of the index and read
+  // the sub-ranges
+  if ((plan.path == QueryPlan::INDEX_SCAN || plan.path == QueryPlan::INDEX_ONLY_SCAN) &&
+      (!plan.hasStats || plan.estRows >= ParallelScan::MIN_ROWS) &&
+      run.bt->partition(plan.minKey, plan.maxKey, 4 * workers, splits) == 0 &&
+      !splits.empty()) {
+    bool fetch = (plan.path == QueryPlan::INDEX_SCAN);
+    OperatorStats op(fetch ? "Parallel Index Scan" : "Parallel Index Only Scan");
+
+    ps.scan = scanKeyRange;
+    ps.lowKeys.push_back(plan.minKey);
+    for (unsigned i = 0; i < splits.size(); i++) {
+      ps.highKeys.push_back(splits[i] - 1);
+      ps.lowKeys.push_back(splits[i]);
     }
+    ps.highKeys.push_back(plan.maxKey);
+
+    ps.index = &run.bt->getPageFile();
+    ps.heap = fetch ? &run.rf->getPageFile() : NULL;
+    op.start(ps.index, ps.heap);
+    rc = parallelScan(run, ps, ps.lowKeys.size(), op);
+    op.stop();
+    run.ops.push_back(op);
+    pthread_mutex_unlock(&poolLock);
+    return true;
+  }
 
-    // the condition is met for the tuple. 
-    // increase matching tuple counter
-    count++;
+  pthread_mutex_unlock(&poolLock);
+  return false;
+}
 
-    switch (attr) {
-    case 1:  // SELECT key
-      // do not need a read, since we have the key. 
-      fprintf(stdout, "%d\n", key);
-      break;
-    case 2:  // SELECT value
-      // do a read to get the value. 
-      rf.read(rid, key, value);
-      fprintf(stdout, "%s\n", value.c_str());
-      break;
-    case 3:  // SELECT *
-      rf.read(rid, key, value);
-      fprintf(stdout, "%d '%s'\n", key, value.c_str());
-      break;
-    }
+// plan a SELECT statement and run it (unless only explained)
+static RC runSelect(int attr, const string& table, const vector<SelCond>& cond,
+                    bool explain, bool analyze)
+{
+  SelectCursor cursor;
+  RC rc;
 
-    next_leaf:
-    rc = bt.readForward(ic, key, rid); 
-//    fprintf(stdout, "cursor.pid: %d, cursor.eid: %d, key: %d, iteration: %d\n", ic.pid, ic.eid, key, count);
-  }
-    
-  // print matching tuple count if "select count(*)"
-  if (attr == 4) {
-    fprintf(stdout, "%d\n", count);
+  // open the table, its index and statistics, and plan the statement
+  if ((rc = cursor.open(attr, table, cond)) < 0) {
+    return rc;
   }
-  
-  //TODO define an exit select? 
-  return rc;
-
-  
-  //    DESTINATION OF GOTO
-  //===================================================================
-  //    OLD CODE!!!!!!!!!
-  read_all: 
-
-  // scan the table file from the beginning
-  rid.pid = rid.sid = 0;
-  count = 0;
-  while (rid < rf.endRid()) {
-    // read the tuple
-    if ((rc = rf.read(rid, key, value)) < 0) {
-      fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
-      goto exit_select;
-    }
-    // check the conditions on the tuple
-    for (unsigned i = 0; i < cond.size(); i++) {
-      // compute the difference between the tuple value and the condition value
-      switch (cond[i].attr) {
-      case 1:
-        diff = key - atoi(cond[i].value);
-        break;
-      case 2:
-        diff = strcmp(value.c_str(), cond[i].value);
-        break;
-      }
+  return SqlEngine::select(cursor, table, explain, analyze, stdout, SqlEngine::Settings());
+}
 
-      // skip the tuple if any condition is not met
-      switch (cond[i].comp) {
-      case SelCond::EQ:
-        if (diff != 0) goto next_tuple;
-        break;
-      case SelCond::NE:
-        if (diff == 0) goto next_tuple;
-        break;
-      case SelCond::GT:
-        if (diff <= 0) goto next_tuple;
-        break;
-      case SelCond::LT:
-        if (diff >= 0) goto next_tuple;
-        break;
-      case SelCond::GE:
-        if (diff < 0) goto next_tuple;
-        break;
-      case SelCond::LE:
-        if (diff > 0) goto next_tuple;
-        break;
+RC SqlEngine::select(SelectCursor& cursor, const string& table, bool explain, bool analyze,
+                     FILE* out, const Settings& settings)
+{
+  int    attr = cursor.getAttr();
+  SelectRun  run;
+  ResultSink sink(out, settings.binary ? ResultSink::BINARY : ResultSink::TEXT);
+  RC     rc = 0;
+
+  if (explain) cursor.getPlan().print(out, table);
+
+  run.attr = attr;
+  run.rf = &cursor.getTable();
+  run.cf = cursor.getColumnFile();
+  run.bt = cursor.getIndex();
+  run.plan = &cursor.getPlan();
+  run.settings = &settings;
+  run.print = !explain && attr != 4;
+  run.sink = &sink;
+  run.count = 0;
+
+  if (!explain || analyze) {
+    if (!parallelSelect(run, rc)) {
+      const TupleBatch* batch;
+      while ((rc = cursor.next(batch)) == 0) {
+        emitBatch(run, *batch);
       }
+      if (rc == RC_END_OF_SCAN) rc = 0;
+      if (explain) run.ops = cursor.getOperatorStats();
     }
 
-    // the condition is met for the tuple. 
-    // increase matching tuple counter
-    count++;
-
-    // print the tuple 
-    switch (attr) {
-    case 1:  // SELECT key
-      fprintf(stdout, "%d\n", key);
-      break;
-    case 2:  // SELECT value
-      fprintf(stdout, "%s\n", value.c_str());
-      break;
-    case 3:  // SELECT *
-      fprintf(stdout, "%d '%s'\n", key, value.c_str());
-      break;
+    if (rc < 0) {
+      fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+    } else if (explain) {
+      QueryPlan::printStats(out, run.ops, run.count);
+    } else if (attr == 4) {
+      // print matching tuple count if "select count(*)"
+      sink.addCount(run.count);
     }
 
-    // move to the next tuple
-    next_tuple:
-    ++rid;
+    // the output may fail to be written, e.g., if the client went away
+    RC flushed = sink.flush();
+    if (rc == 0) rc = flushed;
   }
 
-  // print matching tuple count if "select count(*)"
-  if (attr == 4) {
-    fprintf(stdout, "%d\n", count);
+  // the owner of the cursor closes the table file
+  return rc;
+}
+
+RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
+{
+  return runSelect(attr, table, cond, false, false);
+}
+
+RC SqlEngine::explain(int attr, const string& table, const vector<SelCond>& cond, bool analyze)
+{
+  return runSelect(attr, table, cond, true, analyze);
+}
+
+RC SqlEngine::set(const string& name, int value, Settings& settings)
+{
+  if (strcasecmp(name.c_str(), "parallelism") == 0 && value >= 0) {
+    settings.parallelism = value;
+    return 0;
+  }
+  if (strcasecmp(name.c_str(), "ordered") == 0) {
+    settings.ordered = (value != 0);
+    return 0;
   }
-  rc = 0;
+  if (strcasecmp(name.c_str(), "binary") == 0) {
+    settings.binary = (value != 0);
+    return 0;
+  }
+  return RC_INVALID_ATTRIBUTE;
+}
+
+RC SqlEngine::analyze(const string& table)
+{
+  RC rc;
+  TableStats stats;
+  Catalog& catalog = Catalog::instance();
+
+  if ((rc = catalog.lockTable(table)) < 0) return rc;
+  if ((rc = stats.analyze(table)) == 0) rc = stats.save(table);
 
-  // close the table file and return
-  exit_select:
-  rf.close();
+  // the open table has the old statistics
+  catalog.invalidate(table);
+  catalog.unlockTable(table);
   return rc;
 }
 
-RC SqlEngine::load(const string& table, const string& loadfile, bool index)
+RC SqlEngine::load(const string& table, const string& loadfile, bool index, bool columns,
+                   bool bloom, bool valueIndex, bool dictionary, bool compress)
 {
   /* your code here */
   RC rc; 
   BTreeIndex bt;  
+  ValueIndex vi;
 
   fstream myfile;
   myfile.open(loadfile.c_str());
   if (!myfile.is_open()) 
     return RC_FILE_OPEN_FAILED; // something went wrong with the IO. 
 
+  // wait for the statements reading the table and close the open
+  // table before its files change. the catalog opens it again for the
+  // next statement. a cursor of this thread still reading the table
+  // would wait for the load forever.
+  Catalog& catalog = Catalog::instance();
+  if ((rc = catalog.lockTable(table)) < 0) return rc;
+  catalog.invalidate(table);
   
+  // a table that exists keeps the format it was loaded in
   RecordFile rfile; 
-  rc = rfile.open((table + ".tbl"), 'w');
-  if (rc < 0)
+  ColumnFile cfile;
+  columns = columns || dictionary;
+  rc = columns ? cfile.open(table + ".tbl", 'w', compress)
+               : rfile.open(table + ".tbl", 'w', compress);
+  if (rc == RC_INVALID_FILE_FORMAT) {
+    columns = !columns;
+    rc = columns ? cfile.open(table + ".tbl", 'w') : rfile.open(table + ".tbl", 'w');
+  }
+  // the records of a columnar table cannot be fetched by their rids
+  if (rc == 0 && columns && valueIndex) {
+    cfile.close();
+    rc = RC_INVALID_STATEMENT;
+  }
+  if (rc == 0 && columns && dictionary) cfile.setDictionary(true);
+  // the Bloom filters are built from the records already in the table
+  if (rc == 0 && bloom && !columns && !rfile.getBloomFilter().isValid() &&
+      (rc = rfile.buildBloomFilter()) < 0) {
+    rfile.close();
+  }
+  if (rc < 0) {
+    catalog.unlockTable(table);
     return rc;
+  }
 
+  // the indexes made by an earlier load are kept up to date by every
+  // load, as the zone maps and the Bloom filters are
+  if (!index && bt.open(table + ".idx", 'r') == 0) {
+    bt.close();
+    index = true;
+  }
   if (index)
   {
-    rc = bt.open((table + ".idx"), 'w');
-    if (rc < 0)
+    rc = bt.open((table + ".idx"), 'w', compress);
+    if (rc < 0) {
+      if (columns)
+        cfile.close();
+      else
+        rfile.close();
+      catalog.unlockTable(table);
       return rc;
+    }
   }
 
+  if (!valueIndex && !columns && vi.open(table + ".vidx", 'r') == 0) {
+    vi.close();
+    valueIndex = true;
+  }
+  if (valueIndex && (rc = vi.open(table + ".vidx", 'w', compress)) < 0) {
+    rfile.close();
+    if (index)
+      bt.close();
+    catalog.unlockTable(table);
+    return rc;
+  }
+
+  // collect the statistics while loading into an empty table.
+  // otherwise the whole table is analyzed after the load.
+  TableStats stats;
+  bool fresh = columns ? (cfile.rowCount() == 0)
+                       : (rfile.endRid().pid == 0 && rfile.endRid().sid == 0);
+
+  // append the tuples a batch at a time, then index them
+  WriteAheadLog& log = WriteAheadLog::instance();
+  RC failed = 0;  // the error of the batch that could not commit
   string line;
-  int key;
-  string value;
-  RecordId rid; 
-  while (getline(myfile, line))
+  vector<int>      keys(LOAD_BATCH);
+  vector<string>   values(LOAD_BATCH);
+  vector<RecordId> rids(LOAD_BATCH);
+  int n = 0;
+  bool more = true;
+  while (more)
   {
-    rc = parseLoadLine(line, key, value);
-    rfile.append(key, value, rid); 
-    // figure out what to do with rid? is that for the index? 
-    if (index)
-      bt.insert(key, rid);
+    more = getline(myfile, line) ? true : false;
+    if (more) {
+      rc = parseLoadLine(line, keys[n], values[n]);
+      if (++n < LOAD_BATCH) continue;
+    }
+    if (n == 0) break;
+
+    // each batch is a transaction of the log. it commits with the
+    // headers of the files that point to its pages
+    if ((failed = log.begin()) < 0)
+      break;
+    if (columns)
+      failed = cfile.appendBatch(n, &keys[0], &values[0], &rids[0]);
+    else
+      failed = rfile.appendBatch(n, &keys[0], &values[0], &rids[0]);
+    for (int i = 0; i < n && failed == 0; i++) {
+      if (index && (failed = bt.insert(keys[i], rids[i])) < 0)
+        break;
+      if (valueIndex && (failed = vi.insert(values[i], rids[i])) < 0)
+        break;
+      if (fresh)
+        stats.add(keys[i]);
+    }
+    if (failed == 0 && columns)
+      failed = cfile.flush();
+    if (failed == 0 && index)
+      failed = bt.flush();
+    if (failed == 0 && valueIndex)
+      failed = vi.flush();
+    if (failed < 0 || (failed = log.commit()) < 0)
+      break;
+    n = 0;
   }
   
+  // the batch that failed is aborted before the files are closed. its
+  // files drop the pages they write on close, such as the headers, which
+  // would point to the pages of the batch (see PageFile)
+  if (failed < 0 && WriteAheadLog::inTransaction())
+    log.abort();
   myfile.close();
-  rfile.close();
+  if (fresh && columns)
+    stats.finish(cfile.endPid());
+  else if (fresh)
+    stats.finish(rfile.endRid().pid + (rfile.endRid().sid > 0));
+  if (columns)
+    cfile.close();
+  else
+    rfile.close();
   if (index)
     bt.close();
-  return 0;
+  if (valueIndex)
+    vi.close();
+
+  if (failed < 0)
+    rc = failed;
+  else if (fresh || (rc = stats.analyze(table)) == 0)
+    rc = stats.save(table);
+  catalog.invalidate(table);
+  catalog.unlockTable(table);
+  return rc;
 }
 
 RC SqlEngine::parseLoadLine(const string& line, int& key, string& value)
@@ -10,6 +10,7 @@
 #ifndef SQLENGINE_H
 #define SQLENGINE_H
 
+#include <cstdio>
 #include <vector>
 #include "Bruinbase.h"
 #include "RecordFile.h"
@@ -18,6 +19,8 @@
 /**
  * data structure to represent a condition in the WHERE clause
  */
+class SelectCursor;
+
 struct SelCond {
   int attr;     // attribute: 1 - key column,  2 - value column
   enum Comparator { EQ, NE, LT, GT, LE, GE } comp;
@@ -25,19 +28,22 @@ struct SelCond {
 };
 
 /**
- * the class that takes, parses, and executes the user commands.
+ * the class that executes the user commands.
+ * the commands are parsed into Statements and run by Database.
  */
 class SqlEngine {
  public:
-    
   /**
-   * takes the user commands from commandline and executes them.
-   * when user issues SELECT or LOAD from commandline, this function
-   * calls SqlEngine::select() or SqlEngine::load() functions.
-   * @param commandline[IN] the input stream to get user commands
-   * @return error code. 0 if no error
+   * the settings changed by the SET command. each session (Database)
+   * has its own.
    */
-  static RC run(FILE* commandline);
+  struct Settings {
+    int  parallelism;  // # worker threads. 0: one per CPU
+    bool ordered;      // print parallel results in table order
+    bool binary;       // print results in the binary format
+
+    Settings() : parallelism(0), ordered(true), binary(false) {}
+  };
 
   /**
    * executes a SELECT statement.
@@ -51,14 +57,89 @@ class SqlEngine {
    */
   static RC select(int attr, const std::string& table, const std::vector<SelCond>& conds);
 
+  /**
+   * print the plan of a SELECT statement (EXPLAIN). with analyze,
+   * the statement is also run (without printing its result) and the
+   * rows, page reads and time of each operator are printed
+   * (EXPLAIN ANALYZE).
+   * @param attr[IN] attribute in the SELECT clause
+   * @param table[IN] the table name in the FROM clause
+   * @param conds[IN] list of conditions in the WHERE clause
+   * @param analyze[IN] true to run the statement as well
+   * @return error code. 0 if no error
+   */
+  static RC explain(int attr, const std::string& table, const std::vector<SelCond>& conds, bool analyze);
+
+  /**
+   * run a SELECT statement opened and planned by a cursor, as select()
+   * or (with explain) as explain().
+   * @param cursor[IN] the open cursor of the statement
+   * @param table[IN] the table name for EXPLAIN
+   * @param explain[IN] true to print the plan instead of the result
+   * @param analyze[IN] true to run an explained statement as well
+   * @param out[IN] the stream to print the result or the plan to
+   * @param settings[IN] the settings of the session
+   * @return error code. 0 if no error
+   */
+  static RC select(SelectCursor& cursor, const std::string& table, bool explain, bool analyze,
+                   FILE* out, const Settings& settings);
+
+  /**
+   * change a setting of a session (SET command):
+   *   parallelism - # worker threads of a sequential scan of a large
+   *                 table or an index scan of a large key range.
+   *                 0 (the default) uses one per CPU and 1 turns
+   *                 parallel scans off.
+   *   ordered     - 1 (the default) prints the result of a parallel
+   *                 scan in table (or key) order. 0 prints each part
+   *                 as soon as it is ready.
+   *   binary      - 1 prints the result of a SELECT in the binary
+   *                 format of ResultSink instead of text lines.
+   * @param name[IN] the name of the setting
+   * @param value[IN] the new value
+   * @param settings[IN/OUT] the settings of the session
+   * @return error code. 0 if no error
+   */
+  static RC set(const std::string& name, int value, Settings& settings);
+
+  /**
+   * collect the statistics of a table for the query planner
+   * and store them in "table.stat".
+   * @param table[IN] the table name in the ANALYZE command
+   * @return error code. 0 if no error
+   */
+  static RC analyze(const std::string& table);
+
   /**
    * load a table from a load file.
+   * a new table is stored in the columnar format (see ColumnFile) if
+   * "WITH COLUMNS" was specified. a table that exists keeps its format.
+   * "WITH INDEX" indexes the keys of the table in "table.idx"; once the
+   * table has the index, it is kept up to date by every load.
+   * "WITH BLOOM" gives a table in the slotted format Bloom filters over
+   * its values (see BloomFilter); once it has them, they are kept up
+   * to date by every load. "WITH INDEX ON value" indexes the values of
+   * the table in "table.vidx" (see ValueIndex); once it has the index,
+   * it is kept up to date by every load. a table in the columnar format
+   * cannot have a value index. "WITH DICTIONARY" stores a new
+   * table in the columnar format with its values encoded by a dictionary
+   * per segment; a columnar table loaded so keeps encoding its values.
+   * "WITH COMPRESS" stores the pages of the files of a new table and of
+   * its new indexes compressed (see PageFile).
    * @param table[IN] the table name in the LOAD command
    * @param loadfile[IN] the file name of the load file
    * @param index[IN] true if "WITH INDEX" option was specified
-   * @return error code. 0 if no error
+   * @param columns[IN] true if "WITH COLUMNS" option was specified
+   * @param bloom[IN] true if "WITH BLOOM" option was specified
+   * @param valueIndex[IN] true if "WITH INDEX ON value" option was specified
+   * @param dictionary[IN] true if "WITH DICTIONARY" option was specified
+   * @param compress[IN] true if "WITH COMPRESS" option was specified
+   * @return error code. 0 if no error. RC_INVALID_STATEMENT if a value
+   *         index is asked for a table in the columnar format
    */
-  static RC load(const std::string& table, const std::string& loadfile, bool index);
+  static RC load(const std::string& table, const std::string& loadfile, bool index,
+                 bool columns = false, bool bloom = false, bool valueIndex = false,
+                 bool dictionary = false, bool compress = false);
 
   /**
    * parse a line from the load file into the (key, value) pair.
@@ -1,8 +1,9 @@
-/* A Bison parser, made by GNU Bison 3.0.2.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison implementation for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2013 Free Software Foundation, Inc.
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
 
    This program is free software: you can redistribute it and/or modify
    it under the terms of the GNU General Public License as published by
@@ -15,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -33,6 +34,10 @@
 /* C LALR(1) parser skeleton written by Richard Stallman, by
    simplifying the original so-called "semantic" parser.  */
 
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
 /* All symbols defined below should begin with yy or YY, to avoid
    infringing on user name space.  This should be done even for local
    variables, as they might otherwise be expanded by user macros.
@@ -40,17 +45,17 @@
    define necessary library symbols; they are noted "INFRINGES ON
    USER NAME SPACE" below.  */
 
-/* Identify Bison output.  */
-#define YYBISON 1
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
 
-/* Bison version.  */
-#define YYBISON_VERSION "3.0.2"
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
 
 /* Skeleton name.  */
 #define YYSKELETON_NAME "yacc.c"
 
 /* Pure parsers.  */
-#define YYPURE 0
+#define YYPURE 2
 
 /* Push parsers.  */
 #define YYPUSH 0
@@ -66,157 +71,285 @@
 #define yydebug         sqldebug
 #define yynerrs         sqlnerrs
 
-#define yylval          sqllval
-#define yychar          sqlchar
-
-/* Copy the first part of user declarations.  */
-#line 1 "SqlParser.y" /* yacc.c:339  */
+/* First part of user prologue.  */
+#line 1 "SqlParser.y"
 
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
-#include <sys/times.h>
-#include <unistd.h>
-#include <climits>
 #include <string>
+#include <vector>
 #include "Bruinbase.h"
 #include "SqlEngine.h" 
-#include "PageFile.h"
+#include "Statement.h"
+#include "Arena.h"
+
+// the scanner of SqlParser.l. it keeps its state in a yyscan_t.
+typedef void* yyscan_t;
+typedef struct yy_buffer_state* YY_BUFFER_STATE;
+int  sqllex_init(yyscan_t* scanner);
+int  sqllex_destroy(yyscan_t scanner);
+YY_BUFFER_STATE sql_scan_buffer(char* base, size_t size, yyscan_t scanner);
+void sql_delete_buffer(YY_BUFFER_STATE buffer, yyscan_t scanner);
+char* sqlget_text(yyscan_t scanner);
+int   sqlget_leng(yyscan_t scanner);
+
+/*
+ * the conditions of a WHERE clause and the values of EXECUTE ... USING,
+ * as lists allocated from the arena
+ */
+struct CondNode {
+  SelCond cond;
+  CondNode* next;
+};
 
-int  sqllex(void);  
-void sqlerror(const char *str) { fprintf(stderr, "Error: %s\n", str); }
-extern "C" { int  sqlwrap() { return 1; } }
+struct ValueNode {
+  char* value;  // NULL for a placeholder
+  ValueNode* next;
+};
 
-static void runSelect(int attr, const char* table, const std::vector<SelCond>& conds)
-{
-  struct tms tmsbuf;
-  clock_t btime, etime;
-  int     bpagecnt, epagecnt;
+struct CondList {
+  CondNode* first;
+  CondNode* last;
+};
 
-  btime = times(&tmsbuf);
-  bpagecnt = PageFile::getPageReadCount();
-  SqlEngine::select(attr, table, conds);
-  etime = times(&tmsbuf);
-  epagecnt = PageFile::getPageReadCount();
+struct ValueList {
+  ValueNode* first;
+  ValueNode* last;
+};
 
-  fprintf(stderr, "  -- %.3f seconds to run the select command. Read %d pages\n", ((float)(etime - btime))/sysconf(_SC_CLK_TCK), epagecnt - bpagecnt);
-}
+/*
+ * the state of one parse. a StatementParser keeps its own, so
+ * sessions parse at the same time.
+ */
+struct ParseContext {
+  yyscan_t scanner;                // the scanner of the statement
+  Arena arena;                     // the line, the tokens and the lists
+  std::vector<Statement*> parsed;  // the statements parsed
+  std::string error;               // the first error
+};
 
+// the options of LOAD ... WITH
+enum { LOAD_INDEX = 1, LOAD_COLUMNS = 2, LOAD_BLOOM = 4, LOAD_VALUE_INDEX = 8, LOAD_DICTIONARY = 16,
+       LOAD_COMPRESS = 32 };
 
-#line 106 "SqlParser.tab.c" /* yacc.c:339  */
 
+#line 138 "SqlParser.tab.c"
+
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
 # ifndef YY_NULLPTR
-#  if defined __cplusplus && 201103L <= __cplusplus
-#   define YY_NULLPTR nullptr
+#  if defined __cplusplus
+#   if 201103L <= __cplusplus
+#    define YY_NULLPTR nullptr
+#   else
+#    define YY_NULLPTR 0
+#   endif
 #  else
-#   define YY_NULLPTR 0
+#   define YY_NULLPTR ((void*)0)
 #  endif
 # endif
 
-/* Enabling verbose error messages.  */
-#ifdef YYERROR_VERBOSE
-# undef YYERROR_VERBOSE
-# define YYERROR_VERBOSE 1
-#else
-# define YYERROR_VERBOSE 0
-#endif
-
-/* In a future release of Bison, this section will be replaced
-   by #include "SqlParser.tab.h".  */
-#ifndef YY_SQL_SQLPARSER_TAB_H_INCLUDED
-# define YY_SQL_SQLPARSER_TAB_H_INCLUDED
-/* Debug traces.  */
-#ifndef YYDEBUG
-# define YYDEBUG 0
-#endif
-#if YYDEBUG
-extern int sqldebug;
-#endif
-
-/* Token type.  */
-#ifndef YYTOKENTYPE
-# define YYTOKENTYPE
-  enum yytokentype
-  {
-    SELECT = 258,
-    FROM = 259,
-    WHERE = 260,
-    LOAD = 261,
-    WITH = 262,
-    INDEX = 263,
-    QUIT = 264,
-    COUNT = 265,
-    AND = 266,
-    OR = 267,
-    COMMA = 268,
-    STAR = 269,
-    LF = 270,
-    INTEGER = 271,
-    STRING = 272,
-    ID = 273,
-    EQUAL = 274,
-    NEQUAL = 275,
-    LESS = 276,
-    LESSEQUAL = 277,
-    GREATER = 278,
-    GREATEREQUAL = 279
-  };
-#endif
-
-/* Value type.  */
-#if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-typedef union YYSTYPE YYSTYPE;
-union YYSTYPE
+#include "SqlParser.tab.h"
+/* Symbol kind.  */
+enum yysymbol_kind_t
 {
-#line 33 "SqlParser.y" /* yacc.c:355  */
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_SELECT = 3,                     /* SELECT  */
+  YYSYMBOL_FROM = 4,                       /* FROM  */
+  YYSYMBOL_WHERE = 5,                      /* WHERE  */
+  YYSYMBOL_LOAD = 6,                       /* LOAD  */
+  YYSYMBOL_WITH = 7,                       /* WITH  */
+  YYSYMBOL_INDEX = 8,                      /* INDEX  */
+  YYSYMBOL_QUIT = 9,                       /* QUIT  */
+  YYSYMBOL_COUNT = 10,                     /* COUNT  */
+  YYSYMBOL_AND = 11,                       /* AND  */
+  YYSYMBOL_OR = 12,                        /* OR  */
+  YYSYMBOL_COMMA = 13,                     /* COMMA  */
+  YYSYMBOL_STAR = 14,                      /* STAR  */
+  YYSYMBOL_LF = 15,                        /* LF  */
+  YYSYMBOL_ANALYZE = 16,                   /* ANALYZE  */
+  YYSYMBOL_EXPLAIN = 17,                   /* EXPLAIN  */
+  YYSYMBOL_SET = 18,                       /* SET  */
+  YYSYMBOL_PREPARE = 19,                   /* PREPARE  */
+  YYSYMBOL_EXECUTE = 20,                   /* EXECUTE  */
+  YYSYMBOL_DEALLOCATE = 21,                /* DEALLOCATE  */
+  YYSYMBOL_AS = 22,                        /* AS  */
+  YYSYMBOL_USING = 23,                     /* USING  */
+  YYSYMBOL_ON = 24,                        /* ON  */
+  YYSYMBOL_PARAM = 25,                     /* PARAM  */
+  YYSYMBOL_INTEGER = 26,                   /* INTEGER  */
+  YYSYMBOL_STRING = 27,                    /* STRING  */
+  YYSYMBOL_ID = 28,                        /* ID  */
+  YYSYMBOL_EQUAL = 29,                     /* EQUAL  */
+  YYSYMBOL_NEQUAL = 30,                    /* NEQUAL  */
+  YYSYMBOL_LESS = 31,                      /* LESS  */
+  YYSYMBOL_LESSEQUAL = 32,                 /* LESSEQUAL  */
+  YYSYMBOL_GREATER = 33,                   /* GREATER  */
+  YYSYMBOL_GREATEREQUAL = 34,              /* GREATEREQUAL  */
+  YYSYMBOL_YYACCEPT = 35,                  /* $accept  */
+  YYSYMBOL_commands = 36,                  /* commands  */
+  YYSYMBOL_command = 37,                   /* command  */
+  YYSYMBOL_quit_command = 38,              /* quit_command  */
+  YYSYMBOL_load_command = 39,              /* load_command  */
+  YYSYMBOL_load_options = 40,              /* load_options  */
+  YYSYMBOL_load_option = 41,               /* load_option  */
+  YYSYMBOL_analyze_command = 42,           /* analyze_command  */
+  YYSYMBOL_set_command = 43,               /* set_command  */
+  YYSYMBOL_select_command = 44,            /* select_command  */
+  YYSYMBOL_explain_command = 45,           /* explain_command  */
+  YYSYMBOL_prepare_command = 46,           /* prepare_command  */
+  YYSYMBOL_execute_command = 47,           /* execute_command  */
+  YYSYMBOL_deallocate_command = 48,        /* deallocate_command  */
+  YYSYMBOL_values = 49,                    /* values  */
+  YYSYMBOL_where_clause = 50,              /* where_clause  */
+  YYSYMBOL_conditions = 51,                /* conditions  */
+  YYSYMBOL_condition = 52,                 /* condition  */
+  YYSYMBOL_attributes = 53,                /* attributes  */
+  YYSYMBOL_attribute = 54,                 /* attribute  */
+  YYSYMBOL_value = 55,                     /* value  */
+  YYSYMBOL_table = 56,                     /* table  */
+  YYSYMBOL_comparator = 57                 /* comparator  */
+};
+typedef enum yysymbol_kind_t yysymbol_kind_t;
 
-  int integer;
-  char* string;
-  SelCond* cond;
-  std::vector<SelCond>* conds;
 
-#line 178 "SqlParser.tab.c" /* yacc.c:355  */
-};
-# define YYSTYPE_IS_TRIVIAL 1
-# define YYSTYPE_IS_DECLARED 1
-#endif
 
+/* Unqualified %code blocks.  */
+#line 75 "SqlParser.y"
+
+  int sqlscan(YYSTYPE* lval, yyscan_t scanner);
+  static int  sqllex(YYSTYPE* lval, ParseContext* ctx);
+  static void sqlerror(ParseContext* ctx, const char* str);
 
-extern YYSTYPE sqllval;
+  static Statement* newStatement(Statement::Kind kind)
+  {
+    Statement* stmt = new Statement;
+    stmt->kind = kind;
+    return stmt;
+  }
 
-int sqlparse (void);
+  // a SELECT statement with the given clauses. the placeholders ('?')
+  // of the WHERE clause are its parameters.
+  static Statement* newSelect(Statement::Kind kind, int attr, const char* table,
+                              const CondList* conds)
+  {
+    Statement* stmt = newStatement(kind);
+    stmt->attr = attr;
+    stmt->table = table;
+    for (CondNode* node = conds->first; node != NULL; node = node->next) {
+      if (node->cond.value == NULL) stmt->params.push_back(stmt->conds.size());
+      stmt->conds.push_back(node->cond);
+    }
 
-#endif /* !YY_SQL_SQLPARSER_TAB_H_INCLUDED  */
+    // the values are in the arena. copy them to the statement at once
+    stmt->keepValues();
+    return stmt;
+  }
 
-/* Copy the second part of user declarations.  */
+  // a node of a list in the arena
+  template<class T> static T* newNode(ParseContext* ctx)
+  {
+    return (T*) ctx->arena.allocate(sizeof(T));
+  }
 
-#line 193 "SqlParser.tab.c" /* yacc.c:358  */
+#line 267 "SqlParser.tab.c"
 
 #ifdef short
 # undef short
 #endif
 
-#ifdef YYTYPE_UINT8
-typedef YYTYPE_UINT8 yytype_uint8;
-#else
-typedef unsigned char yytype_uint8;
+/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
+   <limits.h> and (if available) <stdint.h> are included
+   so that the code can choose integer types of a good width.  */
+
+#ifndef __PTRDIFF_MAX__
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
 #endif
 
-#ifdef YYTYPE_INT8
-typedef YYTYPE_INT8 yytype_int8;
+/* Narrow types that promote to a signed type and that can represent a
+   signed or unsigned integer of at least N bits.  In tables they can
+   save space and decrease cache pressure.  Promoting to a signed type
+   helps avoid bugs in integer arithmetic.  */
+
+#ifdef __INT_LEAST8_MAX__
+typedef __INT_LEAST8_TYPE__ yytype_int8;
+#elif defined YY_STDINT_H
+typedef int_least8_t yytype_int8;
 #else
 typedef signed char yytype_int8;
 #endif
 
-#ifdef YYTYPE_UINT16
-typedef YYTYPE_UINT16 yytype_uint16;
+#ifdef __INT_LEAST16_MAX__
+typedef __INT_LEAST16_TYPE__ yytype_int16;
+#elif defined YY_STDINT_H
+typedef int_least16_t yytype_int16;
+#else
+typedef short yytype_int16;
+#endif
+
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
+#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST8_TYPE__ yytype_uint8;
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
+typedef uint_least8_t yytype_uint8;
+#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
+typedef unsigned char yytype_uint8;
 #else
-typedef unsigned short int yytype_uint16;
+typedef short yytype_uint8;
 #endif
 
-#ifdef YYTYPE_INT16
-typedef YYTYPE_INT16 yytype_int16;
+#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST16_TYPE__ yytype_uint16;
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
+typedef uint_least16_t yytype_uint16;
+#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
+typedef unsigned short yytype_uint16;
 #else
-typedef short int yytype_int16;
+typedef int yytype_uint16;
+#endif
+
+#ifndef YYPTRDIFF_T
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
 #endif
 
 #ifndef YYSIZE_T
@@ -224,15 +357,28 @@ typedef short int yytype_int16;
 #  define YYSIZE_T __SIZE_TYPE__
 # elif defined size_t
 #  define YYSIZE_T size_t
-# elif ! defined YYSIZE_T
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
 #  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
 #  define YYSIZE_T size_t
 # else
-#  define YYSIZE_T unsigned int
+#  define YYSIZE_T unsigned
 # endif
 #endif
 
-#define YYSIZE_MAXIMUM ((YYSIZE_T) -1)
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
+
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
+
+
+/* Stored state numbers (used for stacks). */
+typedef yytype_int8 yy_state_t;
+
+/* State numbers in computations.  */
+typedef int yy_state_fast_t;
 
 #ifndef YY_
 # if defined YYENABLE_NLS && YYENABLE_NLS
@@ -246,47 +392,43 @@ typedef short int yytype_int16;
 # endif
 #endif
 
-#ifndef YY_ATTRIBUTE
-# if (defined __GNUC__                                               \
-      && (2 < __GNUC__ || (__GNUC__ == 2 && 96 <= __GNUC_MINOR__)))  \
-     || defined __SUNPRO_C && 0x5110 <= __SUNPRO_C
-#  define YY_ATTRIBUTE(Spec) __attribute__(Spec)
-# else
-#  define YY_ATTRIBUTE(Spec) /* empty */
-# endif
-#endif
 
 #ifndef YY_ATTRIBUTE_PURE
-# define YY_ATTRIBUTE_PURE   YY_ATTRIBUTE ((__pure__))
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
+# else
+#  define YY_ATTRIBUTE_PURE
+# endif
 #endif
 
 #ifndef YY_ATTRIBUTE_UNUSED
-# define YY_ATTRIBUTE_UNUSED YY_ATTRIBUTE ((__unused__))
-#endif
-
-#if !defined _Noreturn \
-     && (!defined __STDC_VERSION__ || __STDC_VERSION__ < 201112)
-# if defined _MSC_VER && 1200 <= _MSC_VER
-#  define _Noreturn __declspec (noreturn)
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
 # else
-#  define _Noreturn YY_ATTRIBUTE ((__noreturn__))
+#  define YY_ATTRIBUTE_UNUSED
 # endif
 #endif
 
 /* Suppress unused-variable warnings by "using" E.  */
 #if ! defined lint || defined __GNUC__
-# define YYUSE(E) ((void) (E))
+# define YY_USE(E) ((void) (E))
 #else
-# define YYUSE(E) /* empty */
+# define YY_USE(E) /* empty */
 #endif
 
-#if defined __GNUC__ && 407 <= __GNUC__ * 100 + __GNUC_MINOR__
 /* Suppress an incorrect diagnostic about yylval being uninitialized.  */
-# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN \
-    _Pragma ("GCC diagnostic push") \
-    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")\
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
     _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
-# define YY_IGNORE_MAYBE_UNINITIALIZED_END \
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
     _Pragma ("GCC diagnostic pop")
 #else
 # define YY_INITIAL_VALUE(Value) Value
@@ -299,8 +441,22 @@ typedef short int yytype_int16;
 # define YY_INITIAL_VALUE(Value) /* Nothing. */
 #endif
 
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
+#endif
+#ifndef YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
+#endif
+
+
+#define YY_ASSERT(E) ((void) (0 && (E)))
 
-#if ! defined yyoverflow || YYERROR_VERBOSE
+#if !defined yyoverflow
 
 /* The parser invokes alloca or malloc; define the necessary symbols.  */
 
@@ -365,8 +521,7 @@ void free (void *); /* INFRINGES ON USER NAME SPACE */
 #   endif
 #  endif
 # endif
-#endif /* ! defined yyoverflow || YYERROR_VERBOSE */
-
+#endif /* !defined yyoverflow */
 
 #if (! defined yyoverflow \
      && (! defined __cplusplus \
@@ -375,17 +530,17 @@ void free (void *); /* INFRINGES ON USER NAME SPACE */
 /* A type that is properly aligned for any stack member.  */
 union yyalloc
 {
-  yytype_int16 yyss_alloc;
+  yy_state_t yyss_alloc;
   YYSTYPE yyvs_alloc;
 };
 
 /* The size of the maximum gap between one aligned stack and the next.  */
-# define YYSTACK_GAP_MAXIMUM (sizeof (union yyalloc) - 1)
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
 
 /* The size of an array large to enough to hold all stacks, each with
    N elements.  */
 # define YYSTACK_BYTES(N) \
-     ((N) * (sizeof (yytype_int16) + sizeof (YYSTYPE)) \
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
       + YYSTACK_GAP_MAXIMUM)
 
 # define YYCOPY_NEEDED 1
@@ -398,11 +553,11 @@ union yyalloc
 # define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
     do                                                                  \
       {                                                                 \
-        YYSIZE_T yynewbytes;                                            \
+        YYPTRDIFF_T yynewbytes;                                         \
         YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
         Stack = &yyptr->Stack_alloc;                                    \
-        yynewbytes = yystacksize * sizeof (*Stack) + YYSTACK_GAP_MAXIMUM; \
-        yyptr += yynewbytes / sizeof (*yyptr);                          \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
       }                                                                 \
     while (0)
 
@@ -414,12 +569,12 @@ union yyalloc
 # ifndef YYCOPY
 #  if defined __GNUC__ && 1 < __GNUC__
 #   define YYCOPY(Dst, Src, Count) \
-      __builtin_memcpy (Dst, Src, (Count) * sizeof (*(Src)))
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
 #  else
 #   define YYCOPY(Dst, Src, Count)              \
       do                                        \
         {                                       \
-          YYSIZE_T yyi;                         \
+          YYPTRDIFF_T yyi;                      \
           for (yyi = 0; yyi < (Count); yyi++)   \
             (Dst)[yyi] = (Src)[yyi];            \
         }                                       \
@@ -431,28 +586,31 @@ union yyalloc
 /* YYFINAL -- State number of the termination state.  */
 #define YYFINAL  2
 /* YYLAST -- Last index in YYTABLE.  */
-#define YYLAST   33
+#define YYLAST   83
 
 /* YYNTOKENS -- Number of terminals.  */
-#define YYNTOKENS  25
+#define YYNTOKENS  35
 /* YYNNTS -- Number of nonterminals.  */
-#define YYNNTS  13
+#define YYNNTS  23
 /* YYNRULES -- Number of rules.  */
-#define YYNRULES  29
+#define YYNRULES  52
 /* YYNSTATES -- Number of states.  */
-#define YYNSTATES  46
+#define YYNSTATES  103
+
+/* YYMAXUTOK -- Last valid token kind.  */
+#define YYMAXUTOK   289
 
-/* YYTRANSLATE[YYX] -- Symbol number corresponding to YYX as returned
-   by yylex, with out-of-bounds checking.  */
-#define YYUNDEFTOK  2
-#define YYMAXUTOK   279
 
-#define YYTRANSLATE(YYX)                                                \
-  ((unsigned int) (YYX) <= YYMAXUTOK ? yytranslate[YYX] : YYUNDEFTOK)
+/* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex, with out-of-bounds checking.  */
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
 
 /* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
-   as returned by yylex, without out-of-bounds checking.  */
-static const yytype_uint8 yytranslate[] =
+   as returned by yylex.  */
+static const yytype_int8 yytranslate[] =
 {
        0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
@@ -481,171 +639,218 @@ static const yytype_uint8 yytranslate[] =
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
        5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
-      15,    16,    17,    18,    19,    20,    21,    22,    23,    24
+      15,    16,    17,    18,    19,    20,    21,    22,    23,    24,
+      25,    26,    27,    28,    29,    30,    31,    32,    33,    34
 };
 
 #if YYDEBUG
-  /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
-static const yytype_uint8 yyrline[] =
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+static const yytype_int16 yyrline[] =
 {
-       0,    52,    52,    53,    57,    58,    59,    60,    61,    65,
-      69,    74,    82,    87,    98,   104,   112,   122,   123,   124,
-     128,   136,   137,   141,   145,   146,   147,   148,   149,   150
+       0,   141,   141,   142,   146,   147,   148,   149,   150,   151,
+     152,   153,   154,   155,   156,   160,   164,   169,   186,   187,
+     191,   192,   193,   206,   213,   221,   227,   230,   237,   244,
+     248,   262,   269,   276,   287,   291,   295,   302,   313,   323,
+     324,   325,   329,   336,   337,   338,   342,   346,   347,   348,
+     349,   350,   351
 };
 #endif
 
-#if YYDEBUG || YYERROR_VERBOSE || 0
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if YYDEBUG || 0
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
 /* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
    First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
 static const char *const yytname[] =
 {
-  "$end", "error", "$undefined", "SELECT", "FROM", "WHERE", "LOAD",
-  "WITH", "INDEX", "QUIT", "COUNT", "AND", "OR", "COMMA", "STAR", "LF",
-  "INTEGER", "STRING", "ID", "EQUAL", "NEQUAL", "LESS", "LESSEQUAL",
-  "GREATER", "GREATEREQUAL", "$accept", "commands", "command",
-  "quit_command", "load_command", "select_command", "conditions",
-  "condition", "attributes", "attribute", "value", "table", "comparator", YY_NULLPTR
+  "\"end of file\"", "error", "\"invalid token\"", "SELECT", "FROM",
+  "WHERE", "LOAD", "WITH", "INDEX", "QUIT", "COUNT", "AND", "OR", "COMMA",
+  "STAR", "LF", "ANALYZE", "EXPLAIN", "SET", "PREPARE", "EXECUTE",
+  "DEALLOCATE", "AS", "USING", "ON", "PARAM", "INTEGER", "STRING", "ID",
+  "EQUAL", "NEQUAL", "LESS", "LESSEQUAL", "GREATER", "GREATEREQUAL",
+  "$accept", "commands", "command", "quit_command", "load_command",
+  "load_options", "load_option", "analyze_command", "set_command",
+  "select_command", "explain_command", "prepare_command",
+  "execute_command", "deallocate_command", "values", "where_clause",
+  "conditions", "condition", "attributes", "attribute", "value", "table",
+  "comparator", YY_NULLPTR
 };
-#endif
 
-# ifdef YYPRINT
-/* YYTOKNUM[NUM] -- (External) token number corresponding to the
-   (internal) symbol number NUM (which must be that of a token).  */
-static const yytype_uint16 yytoknum[] =
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
 {
-       0,   256,   257,   258,   259,   260,   261,   262,   263,   264,
-     265,   266,   267,   268,   269,   270,   271,   272,   273,   274,
-     275,   276,   277,   278,   279
-};
-# endif
+  return yytname[yysymbol];
+}
+#endif
 
-#define YYPACT_NINF -14
+#define YYPACT_NINF (-64)
 
-#define yypact_value_is_default(Yystate) \
-  (!!((Yystate) == (-14)))
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
 
-#define YYTABLE_NINF -1
+#define YYTABLE_NINF (-1)
 
-#define yytable_value_is_error(Yytable_value) \
+#define yytable_value_is_error(Yyn) \
   0
 
-  /* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
-     STATE-NUM.  */
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
 static const yytype_int8 yypact[] =
 {
-     -14,     0,   -14,    -5,     3,     2,   -14,   -14,   -14,   -14,
-     -14,   -14,   -14,   -14,   -14,   -14,    10,   -14,   -14,    14,
-       2,     5,    -3,     1,    11,   -14,    22,   -14,    -4,   -14,
-       4,    16,    11,   -14,   -14,   -14,   -14,   -14,   -14,   -14,
-     -12,   -14,   -14,   -14,   -14,   -14
+     -64,    20,   -64,    -1,    32,    -4,   -64,   -64,    -4,     2,
+       6,    16,    17,    26,   -64,   -64,   -64,   -64,   -64,   -64,
+     -64,   -64,   -64,   -64,   -64,   -64,   -64,   -64,    52,   -64,
+     -64,    54,    15,    32,    56,    33,    39,   -11,    48,    -4,
+      37,   -64,    61,    32,    41,    63,   -64,   -17,   -64,    64,
+       4,    -4,    66,    53,    32,   -64,   -64,   -64,     0,   -64,
+      43,    58,    -6,   -64,    64,    -4,   -64,    70,   -17,   -64,
+      65,   -64,    18,   -64,    51,   -64,    40,   -64,    62,    64,
+      -4,   -64,    43,   -64,   -64,   -64,   -64,   -64,   -64,   -17,
+      43,    -6,   -64,   -64,    67,    64,   -64,   -64,   -64,   -64,
+     -64,    68,   -64
 };
 
-  /* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
-     Performed when YYTABLE does not specify something else to do.  Zero
-     means the default is an error.  */
-static const yytype_uint8 yydefact[] =
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
+static const yytype_int8 yydefact[] =
 {
-       3,     0,     1,     0,     0,     0,     9,     8,     2,     6,
-       4,     5,     7,    19,    18,    20,     0,    17,    23,     0,
-       0,     0,     0,     0,     0,    12,     0,    10,     0,    14,
-       0,     0,     0,    13,    24,    25,    26,    28,    27,    29,
-       0,    11,    15,    21,    22,    16
+       3,     0,     1,     0,     0,     0,    15,    14,     0,     0,
+       0,     0,     0,     0,     2,    12,     4,     6,     8,     5,
+       7,     9,    10,    11,    13,    41,    40,    42,     0,    39,
+      46,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,    23,     0,     0,     0,     0,    29,     0,    31,    34,
+       0,     0,     0,     0,     0,    45,    43,    44,     0,    32,
+       0,     0,     0,    16,    34,     0,    24,     0,     0,    30,
+      35,    36,     0,    25,    20,    22,     0,    18,     0,    34,
+       0,    33,     0,    47,    48,    49,    51,    50,    52,     0,
+       0,     0,    17,    26,     0,    34,    37,    38,    21,    19,
+      27,     0,    28
 };
 
-  /* YYPGOTO[NTERM-NUM].  */
+/* YYPGOTO[NTERM-NUM].  */
 static const yytype_int8 yypgoto[] =
 {
-     -14,   -14,   -14,   -14,   -14,   -14,   -14,   -13,   -14,    28,
-     -14,    13,   -14
+     -64,   -64,   -64,   -64,   -64,   -64,   -13,   -64,   -64,   -64,
+     -64,   -64,   -64,   -64,   -64,   -63,   -64,    -3,   -26,   -57,
+     -62,    -8,   -64
 };
 
-  /* YYDEFGOTO[NTERM-NUM].  */
+/* YYDEFGOTO[NTERM-NUM].  */
 static const yytype_int8 yydefgoto[] =
 {
-      -1,     1,     8,     9,    10,    11,    28,    29,    16,    30,
-      45,    19,    40
+       0,     1,    14,    15,    16,    76,    77,    17,    18,    19,
+      20,    21,    22,    23,    58,    61,    70,    71,    28,    29,
+      59,    31,    89
 };
 
-  /* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
-     positive, shift that token.  If negative, reduce the rule whose
-     number is the opposite.  If YYTABLE_NINF, syntax error.  */
-static const yytype_uint8 yytable[] =
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
+static const yytype_int8 yytable[] =
 {
-       2,     3,    24,     4,    43,    44,     5,    32,    26,     6,
-      12,    33,    25,    13,    20,     7,    27,    14,    21,    42,
-      18,    15,    23,    34,    35,    36,    37,    38,    39,    15,
-      31,    41,    17,    22
+      32,    78,    74,    72,    46,    33,    81,    42,    55,    56,
+      57,    62,    47,    68,    24,    69,    94,    52,    34,    63,
+       2,     3,    75,     4,    30,    72,     5,    97,    67,     6,
+      41,    49,   101,    98,    35,     7,     8,     9,    10,    11,
+      12,    13,    25,    64,    36,    37,    26,    83,    84,    85,
+      86,    87,    88,    91,    38,    92,    39,    79,    40,    43,
+      27,    45,    44,    48,    50,    51,    54,    53,    66,    60,
+      65,    27,    95,    73,    80,    90,    82,    93,    99,    96,
+       0,     0,   100,   102
 };
 
-static const yytype_uint8 yycheck[] =
+static const yytype_int8 yycheck[] =
 {
-       0,     1,     5,     3,    16,    17,     6,    11,     7,     9,
-      15,    15,    15,    10,     4,    15,    15,    14,     4,    32,
-      18,    18,    17,    19,    20,    21,    22,    23,    24,    18,
-       8,    15,     4,    20
+       8,    64,     8,    60,    15,     3,    68,    33,    25,    26,
+      27,     7,    23,    13,    15,    15,    79,    43,    16,    15,
+       0,     1,    28,     3,    28,    82,     6,    89,    54,     9,
+      15,    39,    95,    90,    28,    15,    16,    17,    18,    19,
+      20,    21,    10,    51,    28,    28,    14,    29,    30,    31,
+      32,    33,    34,    13,    28,    15,     4,    65,     4,     3,
+      28,    22,    29,    15,    27,     4,     3,    26,    15,     5,
+       4,    28,    80,    15,     4,    24,    11,    15,    91,    82,
+      -1,    -1,    15,    15
 };
 
-  /* YYSTOS[STATE-NUM] -- The (internal number of the) accessing
-     symbol of state STATE-NUM.  */
-static const yytype_uint8 yystos[] =
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
 {
-       0,    26,     0,     1,     3,     6,     9,    15,    27,    28,
-      29,    30,    15,    10,    14,    18,    33,    34,    18,    36,
-       4,     4,    36,    17,     5,    15,     7,    15,    31,    32,
-      34,     8,    11,    15,    19,    20,    21,    22,    23,    24,
-      37,    15,    32,    16,    17,    35
+       0,    36,     0,     1,     3,     6,     9,    15,    16,    17,
+      18,    19,    20,    21,    37,    38,    39,    42,    43,    44,
+      45,    46,    47,    48,    15,    10,    14,    28,    53,    54,
+      28,    56,    56,     3,    16,    28,    28,    28,    28,     4,
+       4,    15,    53,     3,    29,    22,    15,    23,    15,    56,
+      27,     4,    53,    26,     3,    25,    26,    27,    49,    55,
+       5,    50,     7,    15,    56,     4,    15,    53,    13,    15,
+      51,    52,    54,    15,     8,    28,    40,    41,    50,    56,
+       4,    55,    11,    29,    30,    31,    32,    33,    34,    57,
+      24,    13,    15,    15,    50,    56,    52,    55,    54,    41,
+      15,    50,    15
 };
 
-  /* YYR1[YYN] -- Symbol number of symbol that rule YYN derives.  */
-static const yytype_uint8 yyr1[] =
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
 {
-       0,    25,    26,    26,    27,    27,    27,    27,    27,    28,
-      29,    29,    30,    30,    31,    31,    32,    33,    33,    33,
-      34,    35,    35,    36,    37,    37,    37,    37,    37,    37
+       0,    35,    36,    36,    37,    37,    37,    37,    37,    37,
+      37,    37,    37,    37,    37,    38,    39,    39,    40,    40,
+      41,    41,    41,    42,    43,    44,    45,    45,    46,    47,
+      47,    48,    49,    49,    50,    50,    51,    51,    52,    53,
+      53,    53,    54,    55,    55,    55,    56,    57,    57,    57,
+      57,    57,    57
 };
 
-  /* YYR2[YYN] -- Number of symbols on the right hand side of rule YYN.  */
-static const yytype_uint8 yyr2[] =
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
 {
-       0,     2,     2,     0,     1,     1,     1,     2,     1,     1,
-       5,     7,     5,     7,     1,     3,     3,     1,     1,     1,
-       1,     1,     1,     1,     1,     1,     1,     1,     1,     1
+       0,     2,     2,     0,     1,     1,     1,     1,     1,     1,
+       1,     1,     1,     2,     1,     1,     5,     7,     1,     3,
+       1,     3,     1,     3,     5,     6,     7,     8,     9,     3,
+       5,     3,     1,     3,     0,     2,     1,     3,     3,     1,
+       1,     1,     1,     1,     1,     1,     1,     1,     1,     1,
+       1,     1,     1
 };
 
 
+enum { YYENOMEM = -2 };
+
 #define yyerrok         (yyerrstatus = 0)
 #define yyclearin       (yychar = YYEMPTY)
-#define YYEMPTY         (-2)
-#define YYEOF           0
 
 #define YYACCEPT        goto yyacceptlab
 #define YYABORT         goto yyabortlab
 #define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
 
 
 #define YYRECOVERING()  (!!yyerrstatus)
 
-#define YYBACKUP(Token, Value)                                  \
-do                                                              \
-  if (yychar == YYEMPTY)                                        \
-    {                                                           \
-      yychar = (Token);                                         \
-      yylval = (Value);                                         \
-      YYPOPSTACK (yylen);                                       \
-      yystate = *yyssp;                                         \
-      goto yybackup;                                            \
-    }                                                           \
-  else                                                          \
-    {                                                           \
-      yyerror (YY_("syntax error: cannot back up")); \
-      YYERROR;                                                  \
-    }                                                           \
-while (0)
-
-/* Error token number */
-#define YYTERROR        1
-#define YYERRCODE       256
-
+#define YYBACKUP(Token, Value)                                    \
+  do                                                              \
+    if (yychar == YYEMPTY)                                        \
+      {                                                           \
+        yychar = (Token);                                         \
+        yylval = (Value);                                         \
+        YYPOPSTACK (yylen);                                       \
+        yystate = *yyssp;                                         \
+        goto yybackup;                                            \
+      }                                                           \
+    else                                                          \
+      {                                                           \
+        yyerror (ctx, YY_("syntax error: cannot back up")); \
+        YYERROR;                                                  \
+      }                                                           \
+  while (0)
+
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
 
 
 /* Enable debugging if requested.  */
@@ -662,55 +867,53 @@ do {                                            \
     YYFPRINTF Args;                             \
 } while (0)
 
-/* This macro is provided for backward compatibility. */
-#ifndef YY_LOCATION_PRINT
-# define YY_LOCATION_PRINT(File, Loc) ((void) 0)
-#endif
 
 
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)                    \
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
 do {                                                                      \
   if (yydebug)                                                            \
     {                                                                     \
       YYFPRINTF (stderr, "%s ", Title);                                   \
       yy_symbol_print (stderr,                                            \
-                  Type, Value); \
+                  Kind, Value, ctx); \
       YYFPRINTF (stderr, "\n");                                           \
     }                                                                     \
 } while (0)
 
 
-/*----------------------------------------.
-| Print this symbol's value on YYOUTPUT.  |
-`----------------------------------------*/
+/*-----------------------------------.
+| Print this symbol's value on YYO.  |
+`-----------------------------------*/
 
 static void
-yy_symbol_value_print (FILE *yyoutput, int yytype, YYSTYPE const * const yyvaluep)
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, ParseContext* ctx)
 {
-  FILE *yyo = yyoutput;
-  YYUSE (yyo);
+  FILE *yyoutput = yyo;
+  YY_USE (yyoutput);
+  YY_USE (ctx);
   if (!yyvaluep)
     return;
-# ifdef YYPRINT
-  if (yytype < YYNTOKENS)
-    YYPRINT (yyoutput, yytoknum[yytype], *yyvaluep);
-# endif
-  YYUSE (yytype);
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
 
-/*--------------------------------.
-| Print this symbol on YYOUTPUT.  |
-`--------------------------------*/
+/*---------------------------.
+| Print this symbol on YYO.  |
+`---------------------------*/
 
 static void
-yy_symbol_print (FILE *yyoutput, int yytype, YYSTYPE const * const yyvaluep)
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, ParseContext* ctx)
 {
-  YYFPRINTF (yyoutput, "%s %s (",
-             yytype < YYNTOKENS ? "token" : "nterm", yytname[yytype]);
+  YYFPRINTF (yyo, "%s %s (",
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
 
-  yy_symbol_value_print (yyoutput, yytype, yyvaluep);
-  YYFPRINTF (yyoutput, ")");
+  yy_symbol_value_print (yyo, yykind, yyvaluep, ctx);
+  YYFPRINTF (yyo, ")");
 }
 
 /*------------------------------------------------------------------.
@@ -719,7 +922,7 @@ yy_symbol_print (FILE *yyoutput, int yytype, YYSTYPE const * const yyvaluep)
 `------------------------------------------------------------------*/
 
 static void
-yy_stack_print (yytype_int16 *yybottom, yytype_int16 *yytop)
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
 {
   YYFPRINTF (stderr, "Stack now");
   for (; yybottom <= yytop; yybottom++)
@@ -742,21 +945,21 @@ do {                                                            \
 `------------------------------------------------*/
 
 static void
-yy_reduce_print (yytype_int16 *yyssp, YYSTYPE *yyvsp, int yyrule)
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule, ParseContext* ctx)
 {
-  unsigned long int yylno = yyrline[yyrule];
+  int yylno = yyrline[yyrule];
   int yynrhs = yyr2[yyrule];
   int yyi;
-  YYFPRINTF (stderr, "Reducing stack by rule %d (line %lu):\n",
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
              yyrule - 1, yylno);
   /* The symbols being reduced.  */
   for (yyi = 0; yyi < yynrhs; yyi++)
     {
       YYFPRINTF (stderr, "   $%d = ", yyi + 1);
       yy_symbol_print (stderr,
-                       yystos[yyssp[yyi + 1 - yynrhs]],
-                       &(yyvsp[(yyi + 1) - (yynrhs)])
-                                              );
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)], ctx);
       YYFPRINTF (stderr, "\n");
     }
 }
@@ -764,15 +967,15 @@ yy_reduce_print (yytype_int16 *yyssp, YYSTYPE *yyvsp, int yyrule)
 # define YY_REDUCE_PRINT(Rule)          \
 do {                                    \
   if (yydebug)                          \
-    yy_reduce_print (yyssp, yyvsp, Rule); \
+    yy_reduce_print (yyssp, yyvsp, Rule, ctx); \
 } while (0)
 
 /* Nonzero means print parse trace.  It is left uninitialized so that
    multiple parsers can coexist.  */
 int yydebug;
 #else /* !YYDEBUG */
-# define YYDPRINTF(Args)
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
 # define YY_STACK_PRINT(Bottom, Top)
 # define YY_REDUCE_PRINT(Rule)
 #endif /* !YYDEBUG */
@@ -795,255 +998,32 @@ int yydebug;
 #endif
 
 
-#if YYERROR_VERBOSE
-
-# ifndef yystrlen
-#  if defined __GLIBC__ && defined _STRING_H
-#   define yystrlen strlen
-#  else
-/* Return the length of YYSTR.  */
-static YYSIZE_T
-yystrlen (const char *yystr)
-{
-  YYSIZE_T yylen;
-  for (yylen = 0; yystr[yylen]; yylen++)
-    continue;
-  return yylen;
-}
-#  endif
-# endif
-
-# ifndef yystpcpy
-#  if defined __GLIBC__ && defined _STRING_H && defined _GNU_SOURCE
-#   define yystpcpy stpcpy
-#  else
-/* Copy YYSRC to YYDEST, returning the address of the terminating '\0' in
-   YYDEST.  */
-static char *
-yystpcpy (char *yydest, const char *yysrc)
-{
-  char *yyd = yydest;
-  const char *yys = yysrc;
-
-  while ((*yyd++ = *yys++) != '\0')
-    continue;
-
-  return yyd - 1;
-}
-#  endif
-# endif
-
-# ifndef yytnamerr
-/* Copy to YYRES the contents of YYSTR after stripping away unnecessary
-   quotes and backslashes, so that it's suitable for yyerror.  The
-   heuristic is that double-quoting is unnecessary unless the string
-   contains an apostrophe, a comma, or backslash (other than
-   backslash-backslash).  YYSTR is taken from yytname.  If YYRES is
-   null, do not copy; instead, return the length of what the result
-   would have been.  */
-static YYSIZE_T
-yytnamerr (char *yyres, const char *yystr)
-{
-  if (*yystr == '"')
-    {
-      YYSIZE_T yyn = 0;
-      char const *yyp = yystr;
-
-      for (;;)
-        switch (*++yyp)
-          {
-          case '\'':
-          case ',':
-            goto do_not_strip_quotes;
-
-          case '\\':
-            if (*++yyp != '\\')
-              goto do_not_strip_quotes;
-            /* Fall through.  */
-          default:
-            if (yyres)
-              yyres[yyn] = *yyp;
-            yyn++;
-            break;
-
-          case '"':
-            if (yyres)
-              yyres[yyn] = '\0';
-            return yyn;
-          }
-    do_not_strip_quotes: ;
-    }
-
-  if (! yyres)
-    return yystrlen (yystr);
-
-  return yystpcpy (yyres, yystr) - yyres;
-}
-# endif
 
-/* Copy into *YYMSG, which is of size *YYMSG_ALLOC, an error message
-   about the unexpected token YYTOKEN for the state stack whose top is
-   YYSSP.
-
-   Return 0 if *YYMSG was successfully written.  Return 1 if *YYMSG is
-   not large enough to hold the message.  In that case, also set
-   *YYMSG_ALLOC to the required number of bytes.  Return 2 if the
-   required number of bytes is too large to store.  */
-static int
-yysyntax_error (YYSIZE_T *yymsg_alloc, char **yymsg,
-                yytype_int16 *yyssp, int yytoken)
-{
-  YYSIZE_T yysize0 = yytnamerr (YY_NULLPTR, yytname[yytoken]);
-  YYSIZE_T yysize = yysize0;
-  enum { YYERROR_VERBOSE_ARGS_MAXIMUM = 5 };
-  /* Internationalized format string. */
-  const char *yyformat = YY_NULLPTR;
-  /* Arguments of yyformat. */
-  char const *yyarg[YYERROR_VERBOSE_ARGS_MAXIMUM];
-  /* Number of reported tokens (one for the "unexpected", one per
-     "expected"). */
-  int yycount = 0;
-
-  /* There are many possibilities here to consider:
-     - If this state is a consistent state with a default action, then
-       the only way this function was invoked is if the default action
-       is an error action.  In that case, don't check for expected
-       tokens because there are none.
-     - The only way there can be no lookahead present (in yychar) is if
-       this state is a consistent state with a default action.  Thus,
-       detecting the absence of a lookahead is sufficient to determine
-       that there is no unexpected or expected token to report.  In that
-       case, just report a simple "syntax error".
-     - Don't assume there isn't a lookahead just because this state is a
-       consistent state with a default action.  There might have been a
-       previous inconsistent state, consistent state with a non-default
-       action, or user semantic action that manipulated yychar.
-     - Of course, the expected token list depends on states to have
-       correct lookahead information, and it depends on the parser not
-       to perform extra reductions after fetching a lookahead from the
-       scanner and before detecting a syntax error.  Thus, state merging
-       (from LALR or IELR) and default reductions corrupt the expected
-       token list.  However, the list is correct for canonical LR with
-       one exception: it will still contain any token that will not be
-       accepted due to an error action in a later state.
-  */
-  if (yytoken != YYEMPTY)
-    {
-      int yyn = yypact[*yyssp];
-      yyarg[yycount++] = yytname[yytoken];
-      if (!yypact_value_is_default (yyn))
-        {
-          /* Start YYX at -YYN if negative to avoid negative indexes in
-             YYCHECK.  In other words, skip the first -YYN actions for
-             this state because they are default actions.  */
-          int yyxbegin = yyn < 0 ? -yyn : 0;
-          /* Stay within bounds of both yycheck and yytname.  */
-          int yychecklim = YYLAST - yyn + 1;
-          int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
-          int yyx;
-
-          for (yyx = yyxbegin; yyx < yyxend; ++yyx)
-            if (yycheck[yyx + yyn] == yyx && yyx != YYTERROR
-                && !yytable_value_is_error (yytable[yyx + yyn]))
-              {
-                if (yycount == YYERROR_VERBOSE_ARGS_MAXIMUM)
-                  {
-                    yycount = 1;
-                    yysize = yysize0;
-                    break;
-                  }
-                yyarg[yycount++] = yytname[yyx];
-                {
-                  YYSIZE_T yysize1 = yysize + yytnamerr (YY_NULLPTR, yytname[yyx]);
-                  if (! (yysize <= yysize1
-                         && yysize1 <= YYSTACK_ALLOC_MAXIMUM))
-                    return 2;
-                  yysize = yysize1;
-                }
-              }
-        }
-    }
 
-  switch (yycount)
-    {
-# define YYCASE_(N, S)                      \
-      case N:                               \
-        yyformat = S;                       \
-      break
-      YYCASE_(0, YY_("syntax error"));
-      YYCASE_(1, YY_("syntax error, unexpected %s"));
-      YYCASE_(2, YY_("syntax error, unexpected %s, expecting %s"));
-      YYCASE_(3, YY_("syntax error, unexpected %s, expecting %s or %s"));
-      YYCASE_(4, YY_("syntax error, unexpected %s, expecting %s or %s or %s"));
-      YYCASE_(5, YY_("syntax error, unexpected %s, expecting %s or %s or %s or %s"));
-# undef YYCASE_
-    }
 
-  {
-    YYSIZE_T yysize1 = yysize + yystrlen (yyformat);
-    if (! (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM))
-      return 2;
-    yysize = yysize1;
-  }
-
-  if (*yymsg_alloc < yysize)
-    {
-      *yymsg_alloc = 2 * yysize;
-      if (! (yysize <= *yymsg_alloc
-             && *yymsg_alloc <= YYSTACK_ALLOC_MAXIMUM))
-        *yymsg_alloc = YYSTACK_ALLOC_MAXIMUM;
-      return 1;
-    }
-
-  /* Avoid sprintf, as that infringes on the user's name space.
-     Don't have undefined behavior even if the translation
-     produced a string with the wrong number of "%s"s.  */
-  {
-    char *yyp = *yymsg;
-    int yyi = 0;
-    while ((*yyp = *yyformat) != '\0')
-      if (*yyp == '%' && yyformat[1] == 's' && yyi < yycount)
-        {
-          yyp += yytnamerr (yyp, yyarg[yyi++]);
-          yyformat += 2;
-        }
-      else
-        {
-          yyp++;
-          yyformat++;
-        }
-  }
-  return 0;
-}
-#endif /* YYERROR_VERBOSE */
 
 /*-----------------------------------------------.
 | Release the memory associated to this symbol.  |
 `-----------------------------------------------*/
 
 static void
-yydestruct (const char *yymsg, int yytype, YYSTYPE *yyvaluep)
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, ParseContext* ctx)
 {
-  YYUSE (yyvaluep);
+  YY_USE (yyvaluep);
+  YY_USE (ctx);
   if (!yymsg)
     yymsg = "Deleting";
-  YY_SYMBOL_PRINT (yymsg, yytype, yyvaluep, yylocationp);
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
 
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YYUSE (yytype);
+  YY_USE (yykind);
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
 
 
 
-/* The lookahead symbol.  */
-int yychar;
-
-/* The semantic value of the lookahead symbol.  */
-YYSTYPE yylval;
-/* Number of syntax errors so far.  */
-int yynerrs;
 
 
 /*----------.
@@ -1051,45 +1031,51 @@ int yynerrs;
 `----------*/
 
 int
-yyparse (void)
+yyparse (ParseContext* ctx)
 {
-    int yystate;
-    /* Number of tokens to shift before error messages enabled.  */
-    int yyerrstatus;
+/* Lookahead token kind.  */
+int yychar;
 
-    /* The stacks and their tools:
-       'yyss': related to states.
-       'yyvs': related to semantic values.
 
-       Refer to the stacks through separate pointers, to allow yyoverflow
+/* The semantic value of the lookahead symbol.  */
+/* Default value used for initialization, for pacifying older GCCs
+   or non-GCC compilers.  */
+YY_INITIAL_VALUE (static YYSTYPE yyval_default;)
+YYSTYPE yylval YY_INITIAL_VALUE (= yyval_default);
+
+    /* Number of syntax errors so far.  */
+    int yynerrs = 0;
+
+    yy_state_fast_t yystate = 0;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus = 0;
+
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
        to reallocate them elsewhere.  */
 
-    /* The state stack.  */
-    yytype_int16 yyssa[YYINITDEPTH];
-    yytype_int16 *yyss;
-    yytype_int16 *yyssp;
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
 
-    /* The semantic value stack.  */
-    YYSTYPE yyvsa[YYINITDEPTH];
-    YYSTYPE *yyvs;
-    YYSTYPE *yyvsp;
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
 
-    YYSIZE_T yystacksize;
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
 
   int yyn;
+  /* The return value of yyparse.  */
   int yyresult;
-  /* Lookahead token as an internal (translated) token number.  */
-  int yytoken = 0;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
   /* The variables used to return semantic value and location from the
      action routines.  */
   YYSTYPE yyval;
 
-#if YYERROR_VERBOSE
-  /* Buffer for error messages, and its allocated size.  */
-  char yymsgbuf[128];
-  char *yymsg = yymsgbuf;
-  YYSIZE_T yymsg_alloc = sizeof yymsgbuf;
-#endif
+
 
 #define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
 
@@ -1097,71 +1083,75 @@ yyparse (void)
      Keep to zero when no symbol should be popped.  */
   int yylen = 0;
 
-  yyssp = yyss = yyssa;
-  yyvsp = yyvs = yyvsa;
-  yystacksize = YYINITDEPTH;
-
   YYDPRINTF ((stderr, "Starting parse\n"));
 
-  yystate = 0;
-  yyerrstatus = 0;
-  yynerrs = 0;
   yychar = YYEMPTY; /* Cause a token to be read.  */
+
   goto yysetstate;
 
+
 /*------------------------------------------------------------.
-| yynewstate -- Push a new state, which is found in yystate.  |
+| yynewstate -- push a new state, which is found in yystate.  |
 `------------------------------------------------------------*/
- yynewstate:
+yynewstate:
   /* In all cases, when you get here, the value and location stacks
      have just been pushed.  So pushing a state here evens the stacks.  */
   yyssp++;
 
- yysetstate:
-  *yyssp = yystate;
+
+/*--------------------------------------------------------------------.
+| yysetstate -- set current state (the top of the stack) to yystate.  |
+`--------------------------------------------------------------------*/
+yysetstate:
+  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
+  YY_IGNORE_USELESS_CAST_BEGIN
+  *yyssp = YY_CAST (yy_state_t, yystate);
+  YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
 
   if (yyss + yystacksize - 1 <= yyssp)
+#if !defined yyoverflow && !defined YYSTACK_RELOCATE
+    YYNOMEM;
+#else
     {
       /* Get the current used size of the three stacks, in elements.  */
-      YYSIZE_T yysize = yyssp - yyss + 1;
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
 
-#ifdef yyoverflow
+# if defined yyoverflow
       {
         /* Give user a chance to reallocate the stack.  Use copies of
            these so that the &'s don't force the real ones into
            memory.  */
+        yy_state_t *yyss1 = yyss;
         YYSTYPE *yyvs1 = yyvs;
-        yytype_int16 *yyss1 = yyss;
 
         /* Each stack pointer address is followed by the size of the
            data in use in that stack, in bytes.  This used to be a
            conditional around just the two extra args, but that might
            be undefined if yyoverflow is a macro.  */
         yyoverflow (YY_("memory exhausted"),
-                    &yyss1, yysize * sizeof (*yyssp),
-                    &yyvs1, yysize * sizeof (*yyvsp),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
                     &yystacksize);
-
         yyss = yyss1;
         yyvs = yyvs1;
       }
-#else /* no yyoverflow */
-# ifndef YYSTACK_RELOCATE
-      goto yyexhaustedlab;
-# else
+# else /* defined YYSTACK_RELOCATE */
       /* Extend the stack our own way.  */
       if (YYMAXDEPTH <= yystacksize)
-        goto yyexhaustedlab;
+        YYNOMEM;
       yystacksize *= 2;
       if (YYMAXDEPTH < yystacksize)
         yystacksize = YYMAXDEPTH;
 
       {
-        yytype_int16 *yyss1 = yyss;
+        yy_state_t *yyss1 = yyss;
         union yyalloc *yyptr =
-          (union yyalloc *) YYSTACK_ALLOC (YYSTACK_BYTES (yystacksize));
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
         if (! yyptr)
-          goto yyexhaustedlab;
+          YYNOMEM;
         YYSTACK_RELOCATE (yyss_alloc, yyss);
         YYSTACK_RELOCATE (yyvs_alloc, yyvs);
 #  undef YYSTACK_RELOCATE
@@ -1169,30 +1159,31 @@ yyparse (void)
           YYSTACK_FREE (yyss1);
       }
 # endif
-#endif /* no yyoverflow */
 
       yyssp = yyss + yysize - 1;
       yyvsp = yyvs + yysize - 1;
 
-      YYDPRINTF ((stderr, "Stack size increased to %lu\n",
-                  (unsigned long int) yystacksize));
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
 
       if (yyss + yystacksize - 1 <= yyssp)
         YYABORT;
     }
+#endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
 
-  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
 
   if (yystate == YYFINAL)
     YYACCEPT;
 
   goto yybackup;
 
+
 /*-----------.
 | yybackup.  |
 `-----------*/
 yybackup:
-
   /* Do appropriate processing given the current state.  Read a
      lookahead token if we need one and don't already have one.  */
 
@@ -1203,18 +1194,29 @@ yybackup:
 
   /* Not known => get a lookahead token if don't already have one.  */
 
-  /* YYCHAR is either YYEMPTY or YYEOF or a valid lookahead symbol.  */
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
   if (yychar == YYEMPTY)
     {
-      YYDPRINTF ((stderr, "Reading a token: "));
-      yychar = yylex ();
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yylex (&yylval, ctx);
     }
 
   if (yychar <= YYEOF)
     {
-      yychar = yytoken = YYEOF;
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
       YYDPRINTF ((stderr, "Now at end of input.\n"));
     }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
   else
     {
       yytoken = YYTRANSLATE (yychar);
@@ -1242,15 +1244,13 @@ yybackup:
 
   /* Shift the lookahead token.  */
   YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
-
-  /* Discard the shifted token.  */
-  yychar = YYEMPTY;
-
   yystate = yyn;
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
   *++yyvsp = yylval;
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 
+  /* Discard the shifted token.  */
+  yychar = YYEMPTY;
   goto yynewstate;
 
 
@@ -1265,7 +1265,7 @@ yydefault:
 
 
 /*-----------------------------.
-| yyreduce -- Do a reduction.  |
+| yyreduce -- do a reduction.  |
 `-----------------------------*/
 yyreduce:
   /* yyn is the number of a rule to reduce with.  */
@@ -1285,197 +1285,353 @@ yyreduce:
   YY_REDUCE_PRINT (yyn);
   switch (yyn)
     {
-        case 4:
-#line 57 "SqlParser.y" /* yacc.c:1646  */
-    { fprintf(stdout, "Bruinbase> "); }
-#line 1292 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 2: /* commands: commands command  */
+#line 141 "SqlParser.y"
+                         { if ((yyvsp[0].stmt) != NULL) ctx->parsed.push_back((yyvsp[0].stmt)); }
+#line 1292 "SqlParser.tab.c"
+    break;
+
+  case 13: /* command: error LF  */
+#line 155 "SqlParser.y"
+                   { (yyval.stmt) = NULL; }
+#line 1298 "SqlParser.tab.c"
+    break;
+
+  case 14: /* command: LF  */
+#line 156 "SqlParser.y"
+             { (yyval.stmt) = NULL; }
+#line 1304 "SqlParser.tab.c"
+    break;
+
+  case 15: /* quit_command: QUIT  */
+#line 160 "SqlParser.y"
+             { (yyval.stmt) = newStatement(Statement::QUIT); }
+#line 1310 "SqlParser.tab.c"
+    break;
+
+  case 16: /* load_command: LOAD table FROM STRING LF  */
+#line 164 "SqlParser.y"
+                                  { 
+	  (yyval.stmt) = newStatement(Statement::LOAD);
+	  (yyval.stmt)->table = (yyvsp[-3].string);
+	  (yyval.stmt)->file = (yyvsp[-1].string);
+	}
+#line 1320 "SqlParser.tab.c"
+    break;
+
+  case 17: /* load_command: LOAD table FROM STRING WITH load_options LF  */
+#line 169 "SqlParser.y"
+                                                      { 
+	  (yyval.stmt) = newStatement(Statement::LOAD);
+	  (yyval.stmt)->table = (yyvsp[-5].string);
+	  (yyval.stmt)->file = (yyvsp[-3].string);
+	  (yyval.stmt)->index = ((yyvsp[-1].integer) & LOAD_INDEX) != 0;
+	  (yyval.stmt)->columns = ((yyvsp[-1].integer) & LOAD_COLUMNS) != 0;
+	  (yyval.stmt)->bloom = ((yyvsp[-1].integer) & LOAD_BLOOM) != 0;
+	  (yyval.stmt)->valueIndex = ((yyvsp[-1].integer) & LOAD_VALUE_INDEX) != 0;
+	  (yyval.stmt)->dictionary = ((yyvsp[-1].integer) & LOAD_DICTIONARY) != 0;
+	  (yyval.stmt)->compress = ((yyvsp[-1].integer) & LOAD_COMPRESS) != 0;
+	  if ((yyval.stmt)->valueIndex && ((yyval.stmt)->columns || (yyval.stmt)->dictionary)) {
+	    sqlerror(ctx, "a columnar table cannot have an index on value");
+	  }
+	}
+#line 1339 "SqlParser.tab.c"
     break;
 
-  case 5:
-#line 58 "SqlParser.y" /* yacc.c:1646  */
-    { fprintf(stdout, "Bruinbase> "); }
-#line 1298 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 18: /* load_options: load_option  */
+#line 186 "SqlParser.y"
+                    { (yyval.integer) = (yyvsp[0].integer); }
+#line 1345 "SqlParser.tab.c"
     break;
 
-  case 7:
-#line 60 "SqlParser.y" /* yacc.c:1646  */
-    { fprintf(stdout, "Bruinbase> "); }
-#line 1304 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 19: /* load_options: load_options COMMA load_option  */
+#line 187 "SqlParser.y"
+                                         { (yyval.integer) = (yyvsp[-2].integer) | (yyvsp[0].integer); }
+#line 1351 "SqlParser.tab.c"
     break;
 
-  case 8:
-#line 61 "SqlParser.y" /* yacc.c:1646  */
-    { fprintf(stdout, "Bruinbase> "); }
-#line 1310 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 20: /* load_option: INDEX  */
+#line 191 "SqlParser.y"
+              { (yyval.integer) = LOAD_INDEX; }
+#line 1357 "SqlParser.tab.c"
     break;
 
-  case 9:
-#line 65 "SqlParser.y" /* yacc.c:1646  */
-    { return 0; }
-#line 1316 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 21: /* load_option: INDEX ON attribute  */
+#line 192 "SqlParser.y"
+                             { (yyval.integer) = ((yyvsp[0].integer) == 2) ? LOAD_VALUE_INDEX : LOAD_INDEX; }
+#line 1363 "SqlParser.tab.c"
     break;
 
-  case 10:
-#line 69 "SqlParser.y" /* yacc.c:1646  */
-    { 
-	  SqlEngine::load(std::string((yyvsp[-3].string)), std::string((yyvsp[-1].string)), false); 
-	  free((yyvsp[-3].string));
-	  free((yyvsp[-1].string));
+  case 22: /* load_option: ID  */
+#line 193 "SqlParser.y"
+             {
+		if (strcasecmp((yyvsp[0].string), "columns") == 0) (yyval.integer) = LOAD_COLUMNS;
+		else if (strcasecmp((yyvsp[0].string), "bloom") == 0) (yyval.integer) = LOAD_BLOOM;
+		else if (strcasecmp((yyvsp[0].string), "dictionary") == 0) (yyval.integer) = LOAD_DICTIONARY;
+		else if (strcasecmp((yyvsp[0].string), "compress") == 0) (yyval.integer) = LOAD_COMPRESS;
+		else {
+		  sqlerror(ctx, "unknown load option. not index, columns, bloom, dictionary or compress");
+		  (yyval.integer) = 0;
+		}
 	}
-#line 1326 "SqlParser.tab.c" /* yacc.c:1646  */
+#line 1378 "SqlParser.tab.c"
     break;
 
-  case 11:
-#line 74 "SqlParser.y" /* yacc.c:1646  */
-    { 
-	  SqlEngine::load(std::string((yyvsp[-5].string)), std::string((yyvsp[-3].string)), true); 
-	  free((yyvsp[-5].string));
-	  free((yyvsp[-3].string));
+  case 23: /* analyze_command: ANALYZE table LF  */
+#line 206 "SqlParser.y"
+                         {
+	  (yyval.stmt) = newStatement(Statement::ANALYZE);
+	  (yyval.stmt)->table = (yyvsp[-1].string);
 	}
-#line 1336 "SqlParser.tab.c" /* yacc.c:1646  */
+#line 1387 "SqlParser.tab.c"
     break;
 
-  case 12:
-#line 82 "SqlParser.y" /* yacc.c:1646  */
-    {
-   	        std::vector<SelCond> conds;
-		runSelect((yyvsp[-3].integer), (yyvsp[-1].string), conds);
-		free((yyvsp[-1].string));
+  case 24: /* set_command: SET ID EQUAL INTEGER LF  */
+#line 213 "SqlParser.y"
+                                {
+	  (yyval.stmt) = newStatement(Statement::SET);
+	  (yyval.stmt)->name = (yyvsp[-3].string);
+	  (yyval.stmt)->value = atoi((yyvsp[-1].string));
 	}
-#line 1346 "SqlParser.tab.c" /* yacc.c:1646  */
+#line 1397 "SqlParser.tab.c"
     break;
 
-  case 13:
-#line 87 "SqlParser.y" /* yacc.c:1646  */
-    {
-	        runSelect((yyvsp[-5].integer), (yyvsp[-3].string), *(yyvsp[-1].conds));
-	  	free((yyvsp[-3].string));
-	  	for (unsigned i = 0; i < (yyvsp[-1].conds)->size(); i++) {
-		    free((*(yyvsp[-1].conds))[i].value);
-		}
-	  	delete (yyvsp[-1].conds);
+  case 25: /* select_command: SELECT attributes FROM table where_clause LF  */
+#line 221 "SqlParser.y"
+                                                     {
+	  (yyval.stmt) = newSelect(Statement::SELECT, (yyvsp[-4].integer), (yyvsp[-2].string), (yyvsp[-1].conds));
 	}
-#line 1359 "SqlParser.tab.c" /* yacc.c:1646  */
+#line 1405 "SqlParser.tab.c"
     break;
 
-  case 14:
-#line 98 "SqlParser.y" /* yacc.c:1646  */
-    {
-	  std::vector<SelCond>* v = new std::vector<SelCond>;
-	  v->push_back(*(yyvsp[0].cond));
-	  (yyval.conds) = v;
-          delete (yyvsp[0].cond);
+  case 26: /* explain_command: EXPLAIN SELECT attributes FROM table where_clause LF  */
+#line 227 "SqlParser.y"
+                                                             {
+	  (yyval.stmt) = newSelect(Statement::EXPLAIN, (yyvsp[-4].integer), (yyvsp[-2].string), (yyvsp[-1].conds));
 	}
-#line 1370 "SqlParser.tab.c" /* yacc.c:1646  */
+#line 1413 "SqlParser.tab.c"
     break;
 
-  case 15:
-#line 104 "SqlParser.y" /* yacc.c:1646  */
-    {
-	  (yyvsp[-2].conds)->push_back(*(yyvsp[0].cond));
+  case 27: /* explain_command: EXPLAIN ANALYZE SELECT attributes FROM table where_clause LF  */
+#line 230 "SqlParser.y"
+                                                                       {
+	  (yyval.stmt) = newSelect(Statement::EXPLAIN, (yyvsp[-4].integer), (yyvsp[-2].string), (yyvsp[-1].conds));
+	  (yyval.stmt)->analyze = true;
+	}
+#line 1422 "SqlParser.tab.c"
+    break;
+
+  case 28: /* prepare_command: PREPARE ID AS SELECT attributes FROM table where_clause LF  */
+#line 237 "SqlParser.y"
+                                                                   {
+	  (yyval.stmt) = newSelect(Statement::PREPARE, (yyvsp[-4].integer), (yyvsp[-2].string), (yyvsp[-1].conds));
+	  (yyval.stmt)->name = (yyvsp[-7].string);
+	}
+#line 1431 "SqlParser.tab.c"
+    break;
+
+  case 29: /* execute_command: EXECUTE ID LF  */
+#line 244 "SqlParser.y"
+                      {
+	  (yyval.stmt) = newStatement(Statement::EXECUTE);
+	  (yyval.stmt)->name = (yyvsp[-1].string);
+	}
+#line 1440 "SqlParser.tab.c"
+    break;
+
+  case 30: /* execute_command: EXECUTE ID USING values LF  */
+#line 248 "SqlParser.y"
+                                     {
+	  (yyval.stmt) = newStatement(Statement::EXECUTE);
+	  (yyval.stmt)->name = (yyvsp[-3].string);
+	  for (ValueNode* node = (yyvsp[-1].values)->first; node != NULL; node = node->next) {
+	    if (node->value == NULL) {
+	      sqlerror(ctx, "a placeholder is not a parameter value");
+	      continue;
+	    }
+	    (yyval.stmt)->args.push_back(node->value);
+	  }
+	}
+#line 1456 "SqlParser.tab.c"
+    break;
+
+  case 31: /* deallocate_command: DEALLOCATE ID LF  */
+#line 262 "SqlParser.y"
+                         {
+	  (yyval.stmt) = newStatement(Statement::DEALLOCATE);
+	  (yyval.stmt)->name = (yyvsp[-1].string);
+	}
+#line 1465 "SqlParser.tab.c"
+    break;
+
+  case 32: /* values: value  */
+#line 269 "SqlParser.y"
+              {
+	  ValueNode* node = newNode<ValueNode>(ctx);
+	  node->value = (yyvsp[0].string);
+	  node->next = NULL;
+	  (yyval.values) = newNode<ValueList>(ctx);
+	  (yyval.values)->first = (yyval.values)->last = node;
+	}
+#line 1477 "SqlParser.tab.c"
+    break;
+
+  case 33: /* values: values COMMA value  */
+#line 276 "SqlParser.y"
+                             {
+	  ValueNode* node = newNode<ValueNode>(ctx);
+	  node->value = (yyvsp[0].string);
+	  node->next = NULL;
+	  (yyvsp[-2].values)->last->next = node;
+	  (yyvsp[-2].values)->last = node;
+	  (yyval.values) = (yyvsp[-2].values);
+	}
+#line 1490 "SqlParser.tab.c"
+    break;
+
+  case 34: /* where_clause: %empty  */
+#line 287 "SqlParser.y"
+                    {
+	  (yyval.conds) = newNode<CondList>(ctx);
+	  (yyval.conds)->first = (yyval.conds)->last = NULL;
+	}
+#line 1499 "SqlParser.tab.c"
+    break;
+
+  case 35: /* where_clause: WHERE conditions  */
+#line 291 "SqlParser.y"
+                           { (yyval.conds) = (yyvsp[0].conds); }
+#line 1505 "SqlParser.tab.c"
+    break;
+
+  case 36: /* conditions: condition  */
+#line 295 "SqlParser.y"
+                  {
+	  CondNode* node = newNode<CondNode>(ctx);
+	  node->cond = *(yyvsp[0].cond);
+	  node->next = NULL;
+	  (yyval.conds) = newNode<CondList>(ctx);
+	  (yyval.conds)->first = (yyval.conds)->last = node;
+	}
+#line 1517 "SqlParser.tab.c"
+    break;
+
+  case 37: /* conditions: conditions AND condition  */
+#line 302 "SqlParser.y"
+                                   {
+	  CondNode* node = newNode<CondNode>(ctx);
+	  node->cond = *(yyvsp[0].cond);
+	  node->next = NULL;
+	  (yyvsp[-2].conds)->last->next = node;
+	  (yyvsp[-2].conds)->last = node;
 	  (yyval.conds) = (yyvsp[-2].conds);
-          delete (yyvsp[0].cond);
 	}
-#line 1380 "SqlParser.tab.c" /* yacc.c:1646  */
+#line 1530 "SqlParser.tab.c"
     break;
 
-  case 16:
-#line 112 "SqlParser.y" /* yacc.c:1646  */
-    { 
-	  SelCond* c = new SelCond;
+  case 38: /* condition: attribute comparator value  */
+#line 313 "SqlParser.y"
+                                   { 
+	  SelCond* c = newNode<SelCond>(ctx);
 	  c->attr = (yyvsp[-2].integer);
 	  c->comp = static_cast<SelCond::Comparator>((yyvsp[-1].integer));
 	  c->value = (yyvsp[0].string);
 	  (yyval.cond) = c;
         }
-#line 1392 "SqlParser.tab.c" /* yacc.c:1646  */
+#line 1542 "SqlParser.tab.c"
     break;
 
-  case 17:
-#line 122 "SqlParser.y" /* yacc.c:1646  */
-    { (yyval.integer) = (yyvsp[0].integer); }
-#line 1398 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 39: /* attributes: attribute  */
+#line 323 "SqlParser.y"
+                  { (yyval.integer) = (yyvsp[0].integer); }
+#line 1548 "SqlParser.tab.c"
     break;
 
-  case 18:
-#line 123 "SqlParser.y" /* yacc.c:1646  */
-    { (yyval.integer) = 3; }
-#line 1404 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 40: /* attributes: STAR  */
+#line 324 "SqlParser.y"
+                { (yyval.integer) = 3; }
+#line 1554 "SqlParser.tab.c"
     break;
 
-  case 19:
-#line 124 "SqlParser.y" /* yacc.c:1646  */
-    { (yyval.integer) = 4; }
-#line 1410 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 41: /* attributes: COUNT  */
+#line 325 "SqlParser.y"
+                { (yyval.integer) = 4; }
+#line 1560 "SqlParser.tab.c"
     break;
 
-  case 20:
-#line 128 "SqlParser.y" /* yacc.c:1646  */
-    { 
+  case 42: /* attribute: ID  */
+#line 329 "SqlParser.y"
+           { 
 		if (strcasecmp((yyvsp[0].string), "key") == 0) (yyval.integer)=1;
 		else if (strcasecmp((yyvsp[0].string), "value") == 0) (yyval.integer)=2;
-		else sqlerror("wrong attribute name. neither key or value");
-		free((yyvsp[0].string));
+		else { sqlerror(ctx, "wrong attribute name. neither key or value"); (yyval.integer)=0; }
 	}
-#line 1421 "SqlParser.tab.c" /* yacc.c:1646  */
+#line 1570 "SqlParser.tab.c"
+    break;
+
+  case 43: /* value: INTEGER  */
+#line 336 "SqlParser.y"
+                 { (yyval.string) = (yyvsp[0].string); }
+#line 1576 "SqlParser.tab.c"
     break;
 
-  case 21:
-#line 136 "SqlParser.y" /* yacc.c:1646  */
-    { (yyval.string) = (yyvsp[0].string); }
-#line 1427 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 44: /* value: STRING  */
+#line 337 "SqlParser.y"
+                 { (yyval.string) = (yyvsp[0].string); }
+#line 1582 "SqlParser.tab.c"
     break;
 
-  case 22:
-#line 137 "SqlParser.y" /* yacc.c:1646  */
-    { (yyval.string) = (yyvsp[0].string); }
-#line 1433 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 45: /* value: PARAM  */
+#line 338 "SqlParser.y"
+                 { (yyval.string) = NULL; }
+#line 1588 "SqlParser.tab.c"
     break;
 
-  case 23:
-#line 141 "SqlParser.y" /* yacc.c:1646  */
-    { (yyval.string) = (yyvsp[0].string); }
-#line 1439 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 46: /* table: ID  */
+#line 342 "SqlParser.y"
+           { (yyval.string) = (yyvsp[0].string); }
+#line 1594 "SqlParser.tab.c"
     break;
 
-  case 24:
-#line 145 "SqlParser.y" /* yacc.c:1646  */
-    { (yyval.integer) = SelCond::EQ; }
-#line 1445 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 47: /* comparator: EQUAL  */
+#line 346 "SqlParser.y"
+                       { (yyval.integer) = SelCond::EQ; }
+#line 1600 "SqlParser.tab.c"
     break;
 
-  case 25:
-#line 146 "SqlParser.y" /* yacc.c:1646  */
-    { (yyval.integer) = SelCond::NE; }
-#line 1451 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 48: /* comparator: NEQUAL  */
+#line 347 "SqlParser.y"
+                       { (yyval.integer) = SelCond::NE; }
+#line 1606 "SqlParser.tab.c"
     break;
 
-  case 26:
-#line 147 "SqlParser.y" /* yacc.c:1646  */
-    { (yyval.integer) = SelCond::LT; }
-#line 1457 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 49: /* comparator: LESS  */
+#line 348 "SqlParser.y"
+                       { (yyval.integer) = SelCond::LT; }
+#line 1612 "SqlParser.tab.c"
     break;
 
-  case 27:
-#line 148 "SqlParser.y" /* yacc.c:1646  */
-    { (yyval.integer) = SelCond::GT; }
-#line 1463 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 50: /* comparator: GREATER  */
+#line 349 "SqlParser.y"
+                       { (yyval.integer) = SelCond::GT; }
+#line 1618 "SqlParser.tab.c"
     break;
 
-  case 28:
-#line 149 "SqlParser.y" /* yacc.c:1646  */
-    { (yyval.integer) = SelCond::LE; }
-#line 1469 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 51: /* comparator: LESSEQUAL  */
+#line 350 "SqlParser.y"
+                       { (yyval.integer) = SelCond::LE; }
+#line 1624 "SqlParser.tab.c"
     break;
 
-  case 29:
-#line 150 "SqlParser.y" /* yacc.c:1646  */
-    { (yyval.integer) = SelCond::GE; }
-#line 1475 "SqlParser.tab.c" /* yacc.c:1646  */
+  case 52: /* comparator: GREATEREQUAL  */
+#line 351 "SqlParser.y"
+                       { (yyval.integer) = SelCond::GE; }
+#line 1630 "SqlParser.tab.c"
     break;
 
 
-#line 1479 "SqlParser.tab.c" /* yacc.c:1646  */
+#line 1634 "SqlParser.tab.c"
+
       default: break;
     }
   /* User semantic actions sometimes alter yychar, and that requires
@@ -1489,25 +1645,23 @@ yyreduce:
      case of YYERROR or YYBACKUP, subsequent parser actions might lead
      to an incorrect destructor call or verbose syntax error message
      before the lookahead is translated.  */
-  YY_SYMBOL_PRINT ("-> $$ =", yyr1[yyn], &yyval, &yyloc);
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
 
   YYPOPSTACK (yylen);
   yylen = 0;
-  YY_STACK_PRINT (yyss, yyssp);
 
   *++yyvsp = yyval;
 
   /* Now 'shift' the result of the reduction.  Determine what state
      that goes to, based on the state we popped back to and the rule
      number reduced by.  */
-
-  yyn = yyr1[yyn];
-
-  yystate = yypgoto[yyn - YYNTOKENS] + *yyssp;
-  if (0 <= yystate && yystate <= YYLAST && yycheck[yystate] == *yyssp)
-    yystate = yytable[yystate];
-  else
-    yystate = yydefgoto[yyn - YYNTOKENS];
+  {
+    const int yylhs = yyr1[yyn] - YYNTOKENS;
+    const int yyi = yypgoto[yylhs] + *yyssp;
+    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
+               ? yytable[yyi]
+               : yydefgoto[yylhs]);
+  }
 
   goto yynewstate;
 
@@ -1518,50 +1672,14 @@ yyreduce:
 yyerrlab:
   /* Make sure we have latest lookahead translation.  See comments at
      user semantic actions for why this is necessary.  */
-  yytoken = yychar == YYEMPTY ? YYEMPTY : YYTRANSLATE (yychar);
-
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
   /* If not already recovering from an error, report this error.  */
   if (!yyerrstatus)
     {
       ++yynerrs;
-#if ! YYERROR_VERBOSE
-      yyerror (YY_("syntax error"));
-#else
-# define YYSYNTAX_ERROR yysyntax_error (&yymsg_alloc, &yymsg, \
-                                        yyssp, yytoken)
-      {
-        char const *yymsgp = YY_("syntax error");
-        int yysyntax_error_status;
-        yysyntax_error_status = YYSYNTAX_ERROR;
-        if (yysyntax_error_status == 0)
-          yymsgp = yymsg;
-        else if (yysyntax_error_status == 1)
-          {
-            if (yymsg != yymsgbuf)
-              YYSTACK_FREE (yymsg);
-            yymsg = (char *) YYSTACK_ALLOC (yymsg_alloc);
-            if (!yymsg)
-              {
-                yymsg = yymsgbuf;
-                yymsg_alloc = sizeof yymsgbuf;
-                yysyntax_error_status = 2;
-              }
-            else
-              {
-                yysyntax_error_status = YYSYNTAX_ERROR;
-                yymsgp = yymsg;
-              }
-          }
-        yyerror (yymsgp);
-        if (yysyntax_error_status == 2)
-          goto yyexhaustedlab;
-      }
-# undef YYSYNTAX_ERROR
-#endif
+      yyerror (ctx, YY_("syntax error"));
     }
 
-
-
   if (yyerrstatus == 3)
     {
       /* If just tried and failed to reuse lookahead token after an
@@ -1576,7 +1694,7 @@ yyerrlab:
       else
         {
           yydestruct ("Error: discarding",
-                      yytoken, &yylval);
+                      yytoken, &yylval, ctx);
           yychar = YYEMPTY;
         }
     }
@@ -1590,12 +1708,11 @@ yyerrlab:
 | yyerrorlab -- error raised explicitly by YYERROR.  |
 `---------------------------------------------------*/
 yyerrorlab:
-
-  /* Pacify compilers like GCC when the user code never invokes
-     YYERROR and the label yyerrorlab therefore never appears in user
-     code.  */
-  if (/*CONSTCOND*/ 0)
-     goto yyerrorlab;
+  /* Pacify compilers when the user code never invokes YYERROR and the
+     label yyerrorlab therefore never appears in user code.  */
+  if (0)
+    YYERROR;
+  ++yynerrs;
 
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYERROR.  */
@@ -1612,13 +1729,14 @@ yyerrorlab:
 yyerrlab1:
   yyerrstatus = 3;      /* Each real token shifted decrements this.  */
 
+  /* Pop stack until we find a state that shifts the error token.  */
   for (;;)
     {
       yyn = yypact[yystate];
       if (!yypact_value_is_default (yyn))
         {
-          yyn += YYTERROR;
-          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYTERROR)
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
             {
               yyn = yytable[yyn];
               if (0 < yyn)
@@ -1632,7 +1750,7 @@ yyerrlab1:
 
 
       yydestruct ("Error: popping",
-                  yystos[yystate], yyvsp);
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, ctx);
       YYPOPSTACK (1);
       yystate = *yyssp;
       YY_STACK_PRINT (yyss, yyssp);
@@ -1644,7 +1762,7 @@ yyerrlab1:
 
 
   /* Shift the error token.  */
-  YY_SYMBOL_PRINT ("Shifting", yystos[yyn], yyvsp, yylsp);
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
 
   yystate = yyn;
   goto yynewstate;
@@ -1655,33 +1773,37 @@ yyerrlab1:
 `-------------------------------------*/
 yyacceptlab:
   yyresult = 0;
-  goto yyreturn;
+  goto yyreturnlab;
+
 
 /*-----------------------------------.
 | yyabortlab -- YYABORT comes here.  |
 `-----------------------------------*/
 yyabortlab:
   yyresult = 1;
-  goto yyreturn;
+  goto yyreturnlab;
 
-#if !defined yyoverflow || YYERROR_VERBOSE
-/*-------------------------------------------------.
-| yyexhaustedlab -- memory exhaustion comes here.  |
-`-------------------------------------------------*/
+
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
 yyexhaustedlab:
-  yyerror (YY_("memory exhausted"));
+  yyerror (ctx, YY_("memory exhausted"));
   yyresult = 2;
-  /* Fall through.  */
-#endif
+  goto yyreturnlab;
 
-yyreturn:
+
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
   if (yychar != YYEMPTY)
     {
       /* Make sure we have latest lookahead translation.  See comments at
          user semantic actions for why this is necessary.  */
       yytoken = YYTRANSLATE (yychar);
       yydestruct ("Cleanup: discarding lookahead",
-                  yytoken, &yylval);
+                  yytoken, &yylval, ctx);
     }
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYABORT or YYACCEPT.  */
@@ -1690,16 +1812,139 @@ yyreturn:
   while (yyssp != yyss)
     {
       yydestruct ("Cleanup: popping",
-                  yystos[*yyssp], yyvsp);
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, ctx);
       YYPOPSTACK (1);
     }
 #ifndef yyoverflow
   if (yyss != yyssa)
     YYSTACK_FREE (yyss);
 #endif
-#if YYERROR_VERBOSE
-  if (yymsg != yymsgbuf)
-    YYSTACK_FREE (yymsg);
-#endif
+
   return yyresult;
 }
+
+#line 353 "SqlParser.y"
+
+
+char* strlower(char* s);
+
+/*
+ * keywords that the scanner returns as identifiers.
+ * sqlIdToken() turns them into their tokens.
+ */
+static const struct {
+  const char* name;
+  int token;
+} keywords[] = {
+  { "analyze", ANALYZE },
+  { "as", AS },
+  { "deallocate", DEALLOCATE },
+  { "execute", EXECUTE },
+  { "explain", EXPLAIN },
+  { "on", ON },
+  { "prepare", PREPARE },
+  { "set", SET },
+  { "using", USING },
+};
+
+int sqlIdToken(const char* text)
+{
+  for (unsigned i = 0; i < sizeof(keywords)/sizeof(keywords[0]); i++) {
+    if (strcasecmp(text, keywords[i].name) == 0) return keywords[i].token;
+  }
+  return ID;
+}
+
+int sqlCharToken(char c)
+{
+  // a placeholder for a parameter of a prepared statement
+  if (c == '?') return PARAM;
+
+  // no rule matches the character. let the parser report it.
+  return YYUNDEF;
+}
+
+// the parser reads the tokens from the scanner of the context
+static int sqllex(YYSTYPE* lval, ParseContext* ctx)
+{
+  int   kind = sqlscan(lval, ctx->scanner);
+  char* text = sqlget_text(ctx->scanner);
+  int   n = sqlget_leng(ctx->scanner);
+
+  // the scanner reuses its text. the arena keeps that of INTEGER, STRING and ID
+  switch (kind) {
+  case INTEGER:
+    lval->string = ctx->arena.copy(text, n);
+    break;
+  case STRING:
+    // without the quotes
+    lval->string = ctx->arena.copy(text + 1, n - 2);
+    break;
+  case ID:
+    lval->string = strlower(ctx->arena.copy(text, n));
+    break;
+  default:
+    lval->string = NULL;
+  }
+  return kind;
+}
+
+static void sqlerror(ParseContext* ctx, const char* str)
+{
+  if (ctx->error.empty()) ctx->error = str;
+}
+
+StatementParser::StatementParser()
+  : ctx(new ParseContext)
+{
+  sqllex_init(&ctx->scanner);
+}
+
+StatementParser::~StatementParser()
+{
+  sqllex_destroy(ctx->scanner);
+  delete ctx;
+}
+
+RC StatementParser::parse(const std::string& text, Statement& stmt, std::string& error)
+{
+  RC rc = 0;
+
+  ctx->parsed.clear();
+  ctx->error.clear();
+
+  // every statement of the grammar ends with a line feed. the scanner
+  // reads the line in place; it wants two NULs at the end.
+  size_t n = text.size();
+  char* line = (char*) ctx->arena.allocate(n + 3);
+  memcpy(line, text.data(), n);
+  if (n == 0 || line[n - 1] != '\n') line[n++] = '\n';
+  line[n] = line[n + 1] = 0;
+
+  YY_BUFFER_STATE buffer = sql_scan_buffer(line, n + 2, ctx->scanner);
+  int result = sqlparse(ctx);
+  sql_delete_buffer(buffer, ctx->scanner);
+
+  if (result != 0 || !ctx->error.empty()) {
+    error = ctx->error.empty() ? "syntax error" : ctx->error;
+    rc = RC_SYNTAX_ERROR;
+  } else if (ctx->parsed.size() > 1) {
+    error = "more than one statement";
+    rc = RC_SYNTAX_ERROR;
+  }
+
+  stmt.clear();
+  if (rc == 0 && ctx->parsed.size() == 1) stmt.swap(*ctx->parsed[0]);
+  for (unsigned i = 0; i < ctx->parsed.size(); i++) {
+    delete ctx->parsed[i];
+  }
+  ctx->parsed.clear();
+  ctx->arena.reset();
+  return rc;
+}
+
+RC parseStatement(const std::string& text, Statement& stmt, std::string& error)
+{
+  StatementParser parser;
+  return parser.parse(text, stmt, error);
+}
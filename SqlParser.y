@@ -1,116 +1,317 @@
 %{
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
-#include <sys/times.h>
-#include <unistd.h>
-#include <climits>
 #include <string>
+#include <vector>
 #include "Bruinbase.h"
 #include "SqlEngine.h" 
-#include "PageFile.h"
+#include "Statement.h"
+#include "Arena.h"
 
-int  sqllex(void);  
-void sqlerror(const char *str) { fprintf(stderr, "Error: %s\n", str); }
-extern "C" { int  sqlwrap() { return 1; } }
+// the scanner of SqlParser.l. it keeps its state in a yyscan_t.
+typedef void* yyscan_t;
+typedef struct yy_buffer_state* YY_BUFFER_STATE;
+int  sqllex_init(yyscan_t* scanner);
+int  sqllex_destroy(yyscan_t scanner);
+YY_BUFFER_STATE sql_scan_buffer(char* base, size_t size, yyscan_t scanner);
+void sql_delete_buffer(YY_BUFFER_STATE buffer, yyscan_t scanner);
+char* sqlget_text(yyscan_t scanner);
+int   sqlget_leng(yyscan_t scanner);
 
-static void runSelect(int attr, const char* table, const std::vector<SelCond>& conds)
-{
-  struct tms tmsbuf;
-  clock_t btime, etime;
-  int     bpagecnt, epagecnt;
+/*
+ * the conditions of a WHERE clause and the values of EXECUTE ... USING,
+ * as lists allocated from the arena
+ */
+struct CondNode {
+  SelCond cond;
+  CondNode* next;
+};
 
-  btime = times(&tmsbuf);
-  bpagecnt = PageFile::getPageReadCount();
-  SqlEngine::select(attr, table, conds);
-  etime = times(&tmsbuf);
-  epagecnt = PageFile::getPageReadCount();
+struct ValueNode {
+  char* value;  // NULL for a placeholder
+  ValueNode* next;
+};
 
-  fprintf(stderr, "  -- %.3f seconds to run the select command. Read %d pages\n", ((float)(etime - btime))/sysconf(_SC_CLK_TCK), epagecnt - bpagecnt);
-}
+struct CondList {
+  CondNode* first;
+  CondNode* last;
+};
+
+struct ValueList {
+  ValueNode* first;
+  ValueNode* last;
+};
+
+/*
+ * the state of one parse. a StatementParser keeps its own, so
+ * sessions parse at the same time.
+ */
+struct ParseContext {
+  yyscan_t scanner;                // the scanner of the statement
+  Arena arena;                     // the line, the tokens and the lists
+  std::vector<Statement*> parsed;  // the statements parsed
+  std::string error;               // the first error
+};
+
+// the options of LOAD ... WITH
+enum { LOAD_INDEX = 1, LOAD_COLUMNS = 2, LOAD_BLOOM = 4, LOAD_VALUE_INDEX = 8, LOAD_DICTIONARY = 16,
+       LOAD_COMPRESS = 32 };
 
 %}
 
+%code requires {
+  class Statement;
+  struct ParseContext;
+  struct CondList;
+  struct ValueList;
+}
+
+%code provides {
+  int sqlIdToken(const char* text);
+  int sqlCharToken(char c);
+}
+
+%code {
+  int sqlscan(YYSTYPE* lval, yyscan_t scanner);
+  static int  sqllex(YYSTYPE* lval, ParseContext* ctx);
+  static void sqlerror(ParseContext* ctx, const char* str);
+
+  static Statement* newStatement(Statement::Kind kind)
+  {
+    Statement* stmt = new Statement;
+    stmt->kind = kind;
+    return stmt;
+  }
+
+  // a SELECT statement with the given clauses. the placeholders ('?')
+  // of the WHERE clause are its parameters.
+  static Statement* newSelect(Statement::Kind kind, int attr, const char* table,
+                              const CondList* conds)
+  {
+    Statement* stmt = newStatement(kind);
+    stmt->attr = attr;
+    stmt->table = table;
+    for (CondNode* node = conds->first; node != NULL; node = node->next) {
+      if (node->cond.value == NULL) stmt->params.push_back(stmt->conds.size());
+      stmt->conds.push_back(node->cond);
+    }
+
+    // the values are in the arena. copy them to the statement at once
+    stmt->keepValues();
+    return stmt;
+  }
+
+  // a node of a list in the arena
+  template<class T> static T* newNode(ParseContext* ctx)
+  {
+    return (T*) ctx->arena.allocate(sizeof(T));
+  }
+}
+
+%define api.pure full
+%param {ParseContext* ctx}
+
 %union {
   int integer;
   char* string;
   SelCond* cond;
-  std::vector<SelCond>* conds;
+  CondList* conds;
+  ValueList* values;
+  Statement* stmt;
 }
 
 %token SELECT FROM WHERE LOAD WITH INDEX QUIT COUNT AND OR 
 %token COMMA STAR LF
+%token ANALYZE EXPLAIN SET PREPARE EXECUTE DEALLOCATE AS USING ON PARAM
 %token <string> INTEGER STRING ID
 %token EQUAL NEQUAL LESS LESSEQUAL GREATER GREATEREQUAL 
 
-%type <integer> attributes attribute comparator
+%type <integer> attributes attribute comparator load_options load_option
 %type <string> table value
 %type <cond> condition
-%type <conds> conditions
+%type <conds> conditions where_clause
+%type <values> values
+%type <stmt> command load_command select_command analyze_command
+%type <stmt> explain_command set_command quit_command
+%type <stmt> prepare_command execute_command deallocate_command
 %%
 
 commands:
-	commands command
+	commands command { if ($2 != NULL) ctx->parsed.push_back($2); }
 	|
 	;
 
 command:
-        load_command { fprintf(stdout, "Bruinbase> "); }
-	| select_command { fprintf(stdout, "Bruinbase> "); }
+        load_command
+	| select_command
+	| analyze_command
+	| explain_command
+	| set_command
+	| prepare_command
+	| execute_command
+	| deallocate_command
 	| quit_command
-	| error LF { fprintf(stdout, "Bruinbase> "); }
-	| LF { fprintf(stdout, "Bruinbase> "); }
+	| error LF { $$ = NULL; }
+	| LF { $$ = NULL; }
 	;
 
 quit_command:
-	QUIT { return 0; }
+	QUIT { $$ = newStatement(Statement::QUIT); }
 	;
 
 load_command:
 	LOAD table FROM STRING LF { 
-	  SqlEngine::load(std::string($2), std::string($4), false); 
-	  free($2);
-	  free($4);
+	  $$ = newStatement(Statement::LOAD);
+	  $$->table = $2;
+	  $$->file = $4;
 	}
-	| LOAD table FROM STRING WITH INDEX LF { 
-	  SqlEngine::load(std::string($2), std::string($4), true); 
-	  free($2);
-	  free($4);
+	| LOAD table FROM STRING WITH load_options LF { 
+	  $$ = newStatement(Statement::LOAD);
+	  $$->table = $2;
+	  $$->file = $4;
+	  $$->index = ($6 & LOAD_INDEX) != 0;
+	  $$->columns = ($6 & LOAD_COLUMNS) != 0;
+	  $$->bloom = ($6 & LOAD_BLOOM) != 0;
+	  $$->valueIndex = ($6 & LOAD_VALUE_INDEX) != 0;
+	  $$->dictionary = ($6 & LOAD_DICTIONARY) != 0;
+	  $$->compress = ($6 & LOAD_COMPRESS) != 0;
+	  if ($$->valueIndex && ($$->columns || $$->dictionary)) {
+	    sqlerror(ctx, "a columnar table cannot have an index on value");
+	  }
 	}
 	;
 
-select_command:
-	SELECT attributes FROM table LF {
-   	        std::vector<SelCond> conds;
-		runSelect($2, $4, conds);
-		free($4);
-	}
-	| SELECT attributes FROM table WHERE conditions LF {
-	        runSelect($2, $4, *$6);
-	  	free($4);
-	  	for (unsigned i = 0; i < $6->size(); i++) {
-		    free((*$6)[i].value);
+load_options:
+	load_option { $$ = $1; }
+	| load_options COMMA load_option { $$ = $1 | $3; }
+	;
+
+load_option:
+	INDEX { $$ = LOAD_INDEX; }
+	| INDEX ON attribute { $$ = ($3 == 2) ? LOAD_VALUE_INDEX : LOAD_INDEX; }
+	| ID {
+		if (strcasecmp($1, "columns") == 0) $$ = LOAD_COLUMNS;
+		else if (strcasecmp($1, "bloom") == 0) $$ = LOAD_BLOOM;
+		else if (strcasecmp($1, "dictionary") == 0) $$ = LOAD_DICTIONARY;
+		else if (strcasecmp($1, "compress") == 0) $$ = LOAD_COMPRESS;
+		else {
+		  sqlerror(ctx, "unknown load option. not index, columns, bloom, dictionary or compress");
+		  $$ = 0;
 		}
-	  	delete $6;
 	}
 	;
 
+analyze_command:
+	ANALYZE table LF {
+	  $$ = newStatement(Statement::ANALYZE);
+	  $$->table = $2;
+	}
+	;
+
+set_command:
+	SET ID EQUAL INTEGER LF {
+	  $$ = newStatement(Statement::SET);
+	  $$->name = $2;
+	  $$->value = atoi($4);
+	}
+	;
+
+select_command:
+	SELECT attributes FROM table where_clause LF {
+	  $$ = newSelect(Statement::SELECT, $2, $4, $5);
+	}
+	;
+
+explain_command:
+	EXPLAIN SELECT attributes FROM table where_clause LF {
+	  $$ = newSelect(Statement::EXPLAIN, $3, $5, $6);
+	}
+	| EXPLAIN ANALYZE SELECT attributes FROM table where_clause LF {
+	  $$ = newSelect(Statement::EXPLAIN, $4, $6, $7);
+	  $$->analyze = true;
+	}
+	;
+
+prepare_command:
+	PREPARE ID AS SELECT attributes FROM table where_clause LF {
+	  $$ = newSelect(Statement::PREPARE, $5, $7, $8);
+	  $$->name = $2;
+	}
+	;
+
+execute_command:
+	EXECUTE ID LF {
+	  $$ = newStatement(Statement::EXECUTE);
+	  $$->name = $2;
+	}
+	| EXECUTE ID USING values LF {
+	  $$ = newStatement(Statement::EXECUTE);
+	  $$->name = $2;
+	  for (ValueNode* node = $4->first; node != NULL; node = node->next) {
+	    if (node->value == NULL) {
+	      sqlerror(ctx, "a placeholder is not a parameter value");
+	      continue;
+	    }
+	    $$->args.push_back(node->value);
+	  }
+	}
+	;
+
+deallocate_command:
+	DEALLOCATE ID LF {
+	  $$ = newStatement(Statement::DEALLOCATE);
+	  $$->name = $2;
+	}
+	;
+
+values:
+	value {
+	  ValueNode* node = newNode<ValueNode>(ctx);
+	  node->value = $1;
+	  node->next = NULL;
+	  $$ = newNode<ValueList>(ctx);
+	  $$->first = $$->last = node;
+	}
+	| values COMMA value {
+	  ValueNode* node = newNode<ValueNode>(ctx);
+	  node->value = $3;
+	  node->next = NULL;
+	  $1->last->next = node;
+	  $1->last = node;
+	  $$ = $1;
+	}
+	;
+
+where_clause:
+	/* empty */ {
+	  $$ = newNode<CondList>(ctx);
+	  $$->first = $$->last = NULL;
+	}
+	| WHERE conditions { $$ = $2; }
+	;
+
 conditions:
 	condition {
-	  std::vector<SelCond>* v = new std::vector<SelCond>;
-	  v->push_back(*$1);
-	  $$ = v;
-          delete $1;
+	  CondNode* node = newNode<CondNode>(ctx);
+	  node->cond = *$1;
+	  node->next = NULL;
+	  $$ = newNode<CondList>(ctx);
+	  $$->first = $$->last = node;
 	}
 	| conditions AND condition {
-	  $1->push_back(*$3);
+	  CondNode* node = newNode<CondNode>(ctx);
+	  node->cond = *$3;
+	  node->next = NULL;
+	  $1->last->next = node;
+	  $1->last = node;
 	  $$ = $1;
-          delete $3;
 	}
 	;
 
 condition:
 	attribute comparator value { 
-	  SelCond* c = new SelCond;
+	  SelCond* c = newNode<SelCond>(ctx);
 	  c->attr = $1;
 	  c->comp = static_cast<SelCond::Comparator>($2);
 	  c->value = $3;
@@ -128,13 +329,13 @@ attribute:
 	ID { 
 		if (strcasecmp($1, "key") == 0) $$=1;
 		else if (strcasecmp($1, "value") == 0) $$=2;
-		else sqlerror("wrong attribute name. neither key or value");
-		free($1);
+		else { sqlerror(ctx, "wrong attribute name. neither key or value"); $$=0; }
 	}
 
 value:
 	INTEGER  { $$ = $1; }
         | STRING { $$ = $1; }
+	| PARAM  { $$ = NULL; }
 	;
 
 table:
@@ -149,3 +350,127 @@ comparator:
 	| LESSEQUAL    { $$ = SelCond::LE; }
 	| GREATEREQUAL { $$ = SelCond::GE; }
 	;
+%%
+
+char* strlower(char* s);
+
+/*
+ * keywords that the scanner returns as identifiers.
+ * sqlIdToken() turns them into their tokens.
+ */
+static const struct {
+  const char* name;
+  int token;
+} keywords[] = {
+  { "analyze", ANALYZE },
+  { "as", AS },
+  { "deallocate", DEALLOCATE },
+  { "execute", EXECUTE },
+  { "explain", EXPLAIN },
+  { "on", ON },
+  { "prepare", PREPARE },
+  { "set", SET },
+  { "using", USING },
+};
+
+int sqlIdToken(const char* text)
+{
+  for (unsigned i = 0; i < sizeof(keywords)/sizeof(keywords[0]); i++) {
+    if (strcasecmp(text, keywords[i].name) == 0) return keywords[i].token;
+  }
+  return ID;
+}
+
+int sqlCharToken(char c)
+{
+  // a placeholder for a parameter of a prepared statement
+  if (c == '?') return PARAM;
+
+  // no rule matches the character. let the parser report it.
+  return YYUNDEF;
+}
+
+// the parser reads the tokens from the scanner of the context
+static int sqllex(YYSTYPE* lval, ParseContext* ctx)
+{
+  int   kind = sqlscan(lval, ctx->scanner);
+  char* text = sqlget_text(ctx->scanner);
+  int   n = sqlget_leng(ctx->scanner);
+
+  // the scanner reuses its text. the arena keeps that of INTEGER, STRING and ID
+  switch (kind) {
+  case INTEGER:
+    lval->string = ctx->arena.copy(text, n);
+    break;
+  case STRING:
+    // without the quotes
+    lval->string = ctx->arena.copy(text + 1, n - 2);
+    break;
+  case ID:
+    lval->string = strlower(ctx->arena.copy(text, n));
+    break;
+  default:
+    lval->string = NULL;
+  }
+  return kind;
+}
+
+static void sqlerror(ParseContext* ctx, const char* str)
+{
+  if (ctx->error.empty()) ctx->error = str;
+}
+
+StatementParser::StatementParser()
+  : ctx(new ParseContext)
+{
+  sqllex_init(&ctx->scanner);
+}
+
+StatementParser::~StatementParser()
+{
+  sqllex_destroy(ctx->scanner);
+  delete ctx;
+}
+
+RC StatementParser::parse(const std::string& text, Statement& stmt, std::string& error)
+{
+  RC rc = 0;
+
+  ctx->parsed.clear();
+  ctx->error.clear();
+
+  // every statement of the grammar ends with a line feed. the scanner
+  // reads the line in place; it wants two NULs at the end.
+  size_t n = text.size();
+  char* line = (char*) ctx->arena.allocate(n + 3);
+  memcpy(line, text.data(), n);
+  if (n == 0 || line[n - 1] != '\n') line[n++] = '\n';
+  line[n] = line[n + 1] = 0;
+
+  YY_BUFFER_STATE buffer = sql_scan_buffer(line, n + 2, ctx->scanner);
+  int result = sqlparse(ctx);
+  sql_delete_buffer(buffer, ctx->scanner);
+
+  if (result != 0 || !ctx->error.empty()) {
+    error = ctx->error.empty() ? "syntax error" : ctx->error;
+    rc = RC_SYNTAX_ERROR;
+  } else if (ctx->parsed.size() > 1) {
+    error = "more than one statement";
+    rc = RC_SYNTAX_ERROR;
+  }
+
+  stmt.clear();
+  if (rc == 0 && ctx->parsed.size() == 1) stmt.swap(*ctx->parsed[0]);
+  for (unsigned i = 0; i < ctx->parsed.size(); i++) {
+    delete ctx->parsed[i];
+  }
+  ctx->parsed.clear();
+  ctx->arena.reset();
+  return rc;
+}
+
+RC parseStatement(const std::string& text, Statement& stmt, std::string& error)
+{
+  StatementParser parser;
+  return parser.parse(text, stmt, error);
+}
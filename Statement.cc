@@ -0,0 +1,185 @@
+/*
+ * Parsed SQL statements.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "Statement.h"
+
+using namespace std;
+
+// the condition values of a statement, one after the other with their
+// terminating NULs. the copies of a statement share the buffer and the
+// last one deletes it. a shared buffer does not change; the statement
+// that holds a buffer alone rebuilds it in place.
+struct Statement::Values {
+  int refs;
+  string bytes;
+  string spare;  // the space of the bytes before they were last rebuilt
+};
+
+Statement::Statement()
+  : kind(EMPTY), attr(0), analyze(false), index(false), columns(false), bloom(false), valueIndex(false), dictionary(false), compress(false), value(0),
+    values(NULL)
+{
+}
+
+Statement::Statement(const Statement& other)
+  : kind(EMPTY), attr(0), analyze(false), index(false), columns(false), bloom(false), valueIndex(false), dictionary(false), compress(false), value(0),
+    values(NULL)
+{
+  *this = other;
+}
+
+Statement& Statement::operator=(const Statement& other)
+{
+  if (this == &other) return *this;
+  clear();
+
+  kind = other.kind;
+  attr = other.attr;
+  table = other.table;
+  conds = other.conds;
+  values = other.values;
+  if (values != NULL) __sync_fetch_and_add(&values->refs, 1);
+  params = other.params;
+  analyze = other.analyze;
+  file = other.file;
+  index = other.index;
+  columns = other.columns;
+  bloom = other.bloom;
+  valueIndex = other.valueIndex;
+  dictionary = other.dictionary;
+  compress = other.compress;
+  name = other.name;
+  value = other.value;
+  args = other.args;
+  text = other.text;
+  return *this;
+}
+
+Statement::~Statement()
+{
+  clear();
+}
+
+void Statement::clear()
+{
+  releaseValues();
+  conds.clear();
+  params.clear();
+
+  kind = EMPTY;
+  attr = 0;
+  table.clear();
+  analyze = false;
+  file.clear();
+  index = false;
+  columns = false;
+  bloom = false;
+  valueIndex = false;
+  dictionary = false;
+  compress = false;
+  name.clear();
+  value = 0;
+  args.clear();
+  text.clear();
+}
+
+void Statement::swap(Statement& other)
+{
+  std::swap(kind, other.kind);
+  std::swap(attr, other.attr);
+  table.swap(other.table);
+  conds.swap(other.conds);
+  std::swap(values, other.values);
+  std::swap(analyze, other.analyze);
+  file.swap(other.file);
+  std::swap(index, other.index);
+  std::swap(columns, other.columns);
+  std::swap(bloom, other.bloom);
+  std::swap(valueIndex, other.valueIndex);
+  std::swap(dictionary, other.dictionary);
+  std::swap(compress, other.compress);
+  name.swap(other.name);
+  std::swap(value, other.value);
+  params.swap(other.params);
+  args.swap(other.args);
+  text.swap(other.text);
+}
+
+RC Statement::bind(int i, const string& value)
+{
+  if (i < 1 || i > (int) params.size()) return RC_INVALID_ATTRIBUTE;
+
+  // the buffer is copied with the value if it is shared
+  conds[params[i - 1]].value = (char*) value.c_str();
+  keepValues();
+  return 0;
+}
+
+RC Statement::bind(int i, int value)
+{
+  char buf[16];
+  sprintf(buf, "%d", value);
+  return bind(i, string(buf));
+}
+
+bool Statement::isBound() const
+{
+  for (unsigned i = 0; i < params.size(); i++) {
+    if (conds[params[i]].value == NULL) return false;
+  }
+  return true;
+}
+
+void Statement::keepValues()
+{
+  // the size first: the values are pointed to once they are all copied
+  size_t size = 0;
+  for (unsigned i = 0; i < conds.size(); i++) {
+    if (conds[i].value != NULL) size += strlen(conds[i].value) + 1;
+  }
+  if (size == 0) {
+    releaseValues();
+    return;
+  }
+
+  // the values are copied to the spare space of a buffer the statement
+  // holds alone, which then takes the place of the bytes
+  Values* kept = values;
+  if (kept == NULL || kept->refs > 1) {
+    kept = new Values;
+    kept->refs = 1;
+  }
+  kept->spare.clear();
+  kept->spare.reserve(size);
+  for (unsigned i = 0; i < conds.size(); i++) {
+    if (conds[i].value != NULL) kept->spare.append(conds[i].value, strlen(conds[i].value) + 1);
+  }
+  kept->bytes.swap(kept->spare);
+
+  size_t offset = 0;
+  for (unsigned i = 0; i < conds.size(); i++) {
+    if (conds[i].value == NULL) continue;
+    char* value = &kept->bytes[offset];
+    offset += strlen(value) + 1;
+    conds[i].value = value;
+  }
+
+  if (kept != values) {
+    releaseValues();
+    values = kept;
+  }
+}
+
+// stop using the buffer of the condition values
+void Statement::releaseValues()
+{
+  if (values != NULL && __sync_sub_and_fetch(&values->refs, 1) == 0) {
+    delete values;
+  }
+  values = NULL;
+}
@@ -0,0 +1,137 @@
+/*
+ * Parsed SQL statements.
+ */
+
+#ifndef STATEMENT_H
+#define STATEMENT_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "SqlEngine.h"
+
+/**
+ * A statement parsed from one line of SQL. Which fields are set depends
+ * on the kind of the statement. The condition values are kept in one
+ * buffer that the copies of the statement share, so copying a statement
+ * (e.g., from the statement cache) does not copy them.
+ * A placeholder ('?') in the WHERE clause leaves the value of its
+ * condition NULL until a value is bound to it with bind().
+ */
+class Statement {
+ public:
+  enum Kind {
+    EMPTY,     // a blank line
+    QUIT,      // QUIT or EXIT
+    SELECT,    // SELECT attr FROM table [WHERE conds]
+    EXPLAIN,   // EXPLAIN [ANALYZE] SELECT attr FROM table [WHERE conds]
+    LOAD,      // LOAD table FROM 'file' [WITH options]
+    ANALYZE,   // ANALYZE table
+    SET,       // SET name = value
+    PREPARE,   // PREPARE name AS SELECT attr FROM table [WHERE conds]
+    EXECUTE,   // EXECUTE name [USING values]
+    DEALLOCATE // DEALLOCATE name
+  };
+
+  Kind kind;
+  int  attr;                   // attribute in the SELECT clause
+                               // (1: key, 2: value, 3: *, 4: count(*))
+  std::string table;           // the table of the statement
+  std::vector<SelCond> conds;  // conditions in the WHERE clause
+  std::vector<int> params;     // the conditions with a placeholder, in order
+  bool analyze;                // EXPLAIN ANALYZE
+  std::string file;            // the load file of LOAD
+  bool index;                  // LOAD ... WITH INDEX
+  bool columns;                // LOAD ... WITH COLUMNS
+  bool bloom;                  // LOAD ... WITH BLOOM
+  bool valueIndex;             // LOAD ... WITH INDEX ON value
+  bool dictionary;             // LOAD ... WITH DICTIONARY
+  bool compress;               // LOAD ... WITH COMPRESS
+  std::string name;            // the setting of SET or the name of
+                               // a prepared statement
+  int  value;                  // the new value of the setting
+  std::vector<std::string> args;  // the parameter values of EXECUTE
+  std::string text;            // the normalized text of the statement
+                               // if it came from the statement cache
+
+  Statement();
+  Statement(const Statement& other);
+  Statement& operator=(const Statement& other);
+  ~Statement();
+
+  /**
+   * reset the statement to EMPTY.
+   */
+  void clear();
+
+  /**
+   * exchange the contents of two statements.
+   * @param other[IN/OUT] the statement to exchange with
+   */
+  void swap(Statement& other);
+
+  /**
+   * bind a value to a placeholder of the WHERE clause.
+   * @param i[IN] the placeholder, counted from 1 in the order of the text
+   * @param value[IN] the value
+   * @return error code. 0 if no error
+   */
+  RC bind(int i, const std::string& value);
+  RC bind(int i, int value);
+
+  /**
+   * @return whether a value is bound to every placeholder
+   */
+  bool isBound() const;
+
+  /**
+   * copy the condition values into the buffer of the statement. called
+   * by the parser once the values in conds point to its own memory.
+   */
+  void keepValues();
+
+ private:
+  struct Values;
+  Values* values;  // the buffer of the condition values. NULL if none
+
+  void releaseValues();
+};
+
+struct ParseContext;
+
+/**
+ * A parser of SQL statements (defined in SqlParser.y). The parser keeps
+ * its state and the memory of the statement being parsed to itself, so
+ * each session parses with its own parser at the same time as others.
+ */
+class StatementParser {
+ public:
+  StatementParser();
+  ~StatementParser();
+
+  /**
+   * parse one line of SQL.
+   * @param text[IN] the SQL text
+   * @param stmt[OUT] the statement parsed. EMPTY for a blank line
+   * @param error[OUT] the error message if the text cannot be parsed
+   * @return error code. 0 if no error
+   */
+  RC parse(const std::string& text, Statement& stmt, std::string& error);
+
+ private:
+  ParseContext* ctx;
+
+  StatementParser(const StatementParser&);
+  StatementParser& operator=(const StatementParser&);
+};
+
+/**
+ * parse one line of SQL with a parser of its own.
+ * @param text[IN] the SQL text
+ * @param stmt[OUT] the statement parsed. EMPTY for a blank line
+ * @param error[OUT] the error message if the text cannot be parsed
+ * @return error code. 0 if no error
+ */
+RC parseStatement(const std::string& text, Statement& stmt, std::string& error);
+
+#endif /* STATEMENT_H */
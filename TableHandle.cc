@@ -0,0 +1,101 @@
+/*
+ * Open tables shared by the statements that read them.
+ */
+
+#include "TableHandle.h"
+#include "Catalog.h"
+
+using namespace std;
+
+unsigned long TableHandle::openCount = 0;
+pthread_mutex_t TableHandle::userLock = PTHREAD_MUTEX_INITIALIZER;
+
+TableHandle::TableHandle()
+  : columnar(false), hasIndex(false), hasValueIndex(false), hasStats(false), opened(false), version(0), users(0), stale(false),
+    tableLock(NULL)
+{
+}
+
+TableHandle::~TableHandle()
+{
+  close();
+}
+
+RC TableHandle::open(const string& table)
+{
+  RC rc;
+
+  close();
+
+  // open the table file in the format it was loaded in
+  if ((rc = rf.open(table + ".tbl", 'r')) == RC_INVALID_FILE_FORMAT &&
+      cf.open(table + ".tbl", 'r') == 0) {
+    columnar = true;
+    rc = 0;
+  }
+  if (rc < 0) {
+    return rc;
+  }
+  opened = true;
+
+  pthread_mutex_lock(&userLock);
+  version = ++openCount;
+  pthread_mutex_unlock(&userLock);
+
+  // open the indexes and the statistics. all are optional.
+  hasIndex = (bt.open(table + ".idx", 'r') == 0);
+  hasValueIndex = (vi.open(table + ".vidx", 'r') == 0);
+  hasStats = (stats.load(table) == 0);
+  return 0;
+}
+
+void TableHandle::close()
+{
+  if (!opened) return;
+  if (hasIndex) bt.close();
+  if (hasValueIndex) vi.close();
+  if (columnar)
+    cf.close();
+  else
+    rf.close();
+  columnar = false;
+  hasIndex = false;
+  hasValueIndex = false;
+  hasStats = false;
+  opened = false;
+}
+
+void TableHandle::acquire(pthread_rwlock_t* tableLock)
+{
+  pthread_mutex_lock(&userLock);
+  users++;
+  this->tableLock = tableLock;
+  pthread_mutex_unlock(&userLock);
+}
+
+void TableHandle::release()
+{
+  pthread_mutex_lock(&userLock);
+  pthread_rwlock_t* lock = tableLock;
+  bool unused = (--users == 0 && stale);
+  pthread_mutex_unlock(&userLock);
+  if (unused) delete this;
+  if (lock != NULL) Catalog::unlockShared(lock);
+}
+
+void TableHandle::invalidate()
+{
+  pthread_mutex_lock(&userLock);
+  stale = true;
+  bool unused = (users == 0);
+  pthread_mutex_unlock(&userLock);
+  if (unused) delete this;
+}
+
+bool TableHandle::inUse() const
+{
+  pthread_mutex_lock(&userLock);
+  bool used = (users > 0);
+  pthread_mutex_unlock(&userLock);
+  return used;
+}
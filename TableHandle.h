@@ -0,0 +1,109 @@
+/*
+ * Open tables shared by the statements that read them.
+ */
+
+#ifndef TABLEHANDLE_H
+#define TABLEHANDLE_H
+
+#include <string>
+#include <pthread.h>
+#include "Bruinbase.h"
+#include "RecordFile.h"
+#include "ColumnFile.h"
+#include "BTreeIndex.h"
+#include "ValueIndex.h"
+#include "TableStats.h"
+
+/**
+ * A table opened for reading: its record file (or column file, for a
+ * table in the columnar format), its indexes and its statistics. A handle is shared by the statements that read the
+ * table (see Catalog), so repeated statements do not reopen the files.
+ * The handle counts its users. A handle that was invalidated (the table
+ * was loaded or analyzed again) is deleted when its last user releases it.
+ */
+class TableHandle {
+ public:
+  RecordFile rf;     // the table
+  ColumnFile cf;     // the table, if it is in the columnar format
+  bool columnar;
+  BTreeIndex bt;     // the index on the table, if any
+  bool hasIndex;
+  ValueIndex vi;     // the index on the values of the table, if any
+  bool hasValueIndex;
+  TableStats stats;  // the statistics of the table, if any
+  bool hasStats;
+
+  TableHandle();
+  ~TableHandle();
+
+  /**
+   * open the table, its indexes and statistics. the indexes and the
+   * statistics are optional.
+   * @param table[IN] the table name
+   * @return error code. 0 if no error
+   */
+  RC open(const std::string& table);
+
+  /**
+   * close the table and the indexes.
+   */
+  void close();
+
+  /**
+   * @return the file storing the tuples of the table
+   */
+  const PageFile& getPageFile() const
+  {
+    return columnar ? cf.getPageFile() : rf.getPageFile();
+  }
+
+  /**
+   * @return whether the table is open
+   */
+  bool isOpen() const { return opened; }
+
+  /**
+   * @return a number that differs for every open() in the process.
+   *         what was derived from the table (e.g., a plan) is valid
+   *         as long as the version of its handle is the same.
+   */
+  unsigned long getVersion() const { return version; }
+
+  /**
+   * @return whether a statement uses the handle
+   */
+  bool inUse() const;
+
+  /**
+   * start using the handle.
+   * @param tableLock[IN] the lock of the table, held shared by the caller
+   */
+  void acquire(pthread_rwlock_t* tableLock);
+
+  /**
+   * stop using the handle and unlock the lock given to acquire(). an
+   * invalidated handle is deleted with its last user.
+   */
+  void release();
+
+  /**
+   * mark the handle out of date. it is deleted right away if nobody
+   * uses it, otherwise when its last user releases it.
+   */
+  void invalidate();
+
+ private:
+  bool opened;
+  unsigned long version;
+  int  users;  // # statements using the handle
+  bool stale;  // whether the handle is out of date
+  pthread_rwlock_t* tableLock;  // the lock of the table, held by the users
+
+  static unsigned long openCount;   // # open() calls so far
+  static pthread_mutex_t userLock;  // protects users, stale and openCount
+
+  TableHandle(const TableHandle&);
+  TableHandle& operator=(const TableHandle&);
+};
+
+#endif /* TABLEHANDLE_H */
@@ -0,0 +1,195 @@
+/*
+ * Table statistics used by the query planner.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include "TableStats.h"
+#include "RecordFile.h"
+#include "ColumnFile.h"
+
+using namespace std;
+
+/*
+ * the layout of the "table.stat" page
+ */
+typedef struct {
+  int rowCount;
+  int pageCount;
+  int minKey;
+  int maxKey;
+  int bucketCount;
+  int bounds[TableStats::HISTOGRAM_BUCKETS + 1];
+} StatsPage;
+
+TableStats::TableStats()
+{
+  reset();
+}
+
+void TableStats::reset()
+{
+  rowCount = 0;
+  pageCount = 0;
+  minKey = INT_MAX;
+  maxKey = INT_MIN;
+  bucketCount = 0;
+  sample.clear();
+  seed = 1;
+}
+
+void TableStats::add(int key)
+{
+  if (key < minKey) minKey = key;
+  if (key > maxKey) maxKey = key;
+  rowCount++;
+
+  // reservoir sampling: the n'th key replaces a random sampled key
+  // with probability SAMPLE_SIZE/n
+  if ((int) sample.size() < SAMPLE_SIZE) {
+    sample.push_back(key);
+  } else {
+    int i = rand_r(&seed) % rowCount;
+    if (i < SAMPLE_SIZE) sample[i] = key;
+  }
+}
+
+void TableStats::finish(int pages)
+{
+  pageCount = pages;
+  bucketCount = min((int) sample.size(), (int) HISTOGRAM_BUCKETS);
+  if (bucketCount == 0) return;
+
+  // the bucket boundaries are the quantiles of the sample
+  sort(sample.begin(), sample.end());
+  int n = sample.size();
+  for (int i = 0; i <= bucketCount; i++) {
+    bounds[i] = sample[(long long) i * (n - 1) / bucketCount];
+  }
+  bounds[0] = minKey;
+  bounds[bucketCount] = maxKey;
+  sample.clear();
+}
+
+double TableStats::selectivity(int lo, int hi) const
+{
+  if (hi < lo || bucketCount == 0) return 0;
+  if (hi < minKey || lo > maxKey) return 0;
+
+  // sum up the overlap of [lo, hi] with each bucket assuming that
+  // the keys are uniformly distributed inside a bucket
+  double sel = 0;
+  for (int i = 0; i < bucketCount; i++) {
+    double blo = bounds[i];
+    double bhi = bounds[i + 1];
+    double olo = max((double) lo, blo);
+    double ohi = min((double) hi, bhi);
+    if (ohi < olo) continue;
+    sel += (ohi - olo + 1) / (bhi - blo + 1);
+  }
+  sel /= bucketCount;
+
+  return (sel > 1) ? 1 : sel;
+}
+
+RC TableStats::load(const string& table)
+{
+  RC rc;
+  PageFile pf;
+  char page[PageFile::PAGE_SIZE];
+
+  if ((rc = pf.open(table + ".stat", 'r')) < 0) return rc;
+  rc = pf.read(0, page);
+  pf.close();
+  if (rc < 0) return rc;
+
+  StatsPage* sp = (StatsPage*) page;
+  if (sp->bucketCount < 0 || sp->bucketCount > HISTOGRAM_BUCKETS)
+    return RC_INVALID_FILE_FORMAT;
+
+  rowCount = sp->rowCount;
+  pageCount = sp->pageCount;
+  minKey = sp->minKey;
+  maxKey = sp->maxKey;
+  bucketCount = sp->bucketCount;
+  memcpy(bounds, sp->bounds, sizeof(bounds));
+  return 0;
+}
+
+RC TableStats::save(const string& table) const
+{
+  RC rc;
+  PageFile pf;
+  char page[PageFile::PAGE_SIZE];
+
+  memset(page, 0, PageFile::PAGE_SIZE);
+  StatsPage* sp = (StatsPage*) page;
+  sp->rowCount = rowCount;
+  sp->pageCount = pageCount;
+  sp->minKey = minKey;
+  sp->maxKey = maxKey;
+  sp->bucketCount = bucketCount;
+  memcpy(sp->bounds, bounds, sizeof(bounds));
+
+  if ((rc = pf.open(table + ".stat", 'w')) < 0) return rc;
+  rc = pf.write(0, page);
+  pf.close();
+  return rc;
+}
+
+RC TableStats::analyze(const string& table)
+{
+  RC rc;
+  RecordFile rf;
+  PageId pid;
+  int    count;
+  char   page[PageFile::PAGE_SIZE];
+
+  if ((rc = rf.open(table + ".tbl", 'r')) == RC_INVALID_FILE_FORMAT) {
+    return analyzeColumns(table);
+  }
+  if (rc < 0) return rc;
+
+  reset();
+  RecordFile::Scanner scanner(rf);
+  while ((rc = scanner.nextPage(page, pid, count)) == 0) {
+    for (int sid = 0; sid < count; sid++) {
+      add(RecordFile::recordKey(page, sid));
+    }
+  }
+  if (rc != RC_END_OF_SCAN) {
+    rf.close();
+    return rc;
+  }
+  finish(rf.endRid().pid + (rf.endRid().sid > 0));
+
+  rf.close();
+  return 0;
+}
+
+// analyze a table in the columnar format from its key column
+RC TableStats::analyzeColumns(const string& table)
+{
+  RC rc;
+  ColumnFile cf;
+  vector<int> keys(ColumnFile::SEGMENT_ROWS);
+
+  if ((rc = cf.open(table + ".tbl", 'r')) < 0) return rc;
+
+  reset();
+  for (int s = 0; s < cf.segmentCount(); s++) {
+    if ((rc = cf.readKeys(s, &keys[0])) < 0) {
+      cf.close();
+      return rc;
+    }
+    for (int i = 0; i < cf.getSegment(s).rowCount; i++) {
+      add(keys[i]);
+    }
+  }
+  finish(cf.endPid());
+
+  cf.close();
+  return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * Table statistics used by the query planner.
+ */
+
+#ifndef TABLESTATS_H
+#define TABLESTATS_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "PageFile.h"
+
+/**
+ * Statistics of a table: # rows, # pages, key range and an equi-depth
+ * histogram over the key column. The statistics are stored in the
+ * single-page file "table.stat" next to the table.
+ * They are collected by LOAD and by the ANALYZE command.
+ */
+class TableStats {
+ public:
+  static const int HISTOGRAM_BUCKETS = 64;  // # buckets of the histogram
+  static const int SAMPLE_SIZE = 10000;     // # keys sampled for the histogram
+
+  int rowCount;     // # tuples in the table
+  int pageCount;    // # pages of the table file
+  int minKey;       // the smallest key in the table
+  int maxKey;       // the largest key in the table
+  int bucketCount;  // # histogram buckets actually used
+  int bounds[HISTOGRAM_BUCKETS + 1];
+    // bucket i covers the keys in [bounds[i], bounds[i+1]] and holds
+    // about rowCount/bucketCount tuples
+
+  TableStats();
+
+  /**
+   * start collecting statistics from scratch.
+   */
+  void reset();
+
+  /**
+   * add a key of the table to the statistics being collected.
+   * @param key[IN] the key of a tuple
+   */
+  void add(int key);
+
+  /**
+   * build the histogram from the keys added since reset().
+   * @param pages[IN] # pages of the table file
+   */
+  void finish(int pages);
+
+  /**
+   * estimate the fraction of the tuples whose key is in [lo, hi].
+   * @param lo[IN] the smallest key of the range (inclusive)
+   * @param hi[IN] the largest key of the range (inclusive)
+   * @return the estimated selectivity between 0 and 1
+   */
+  double selectivity(int lo, int hi) const;
+
+  /**
+   * read the statistics of a table from "table.stat".
+   * @param table[IN] the table name
+   * @return error code. 0 if no error
+   */
+  RC load(const std::string& table);
+
+  /**
+   * write the statistics of a table to "table.stat".
+   * @param table[IN] the table name
+   * @return error code. 0 if no error
+   */
+  RC save(const std::string& table) const;
+
+  /**
+   * scan a table and collect its statistics.
+   * @param table[IN] the table name
+   * @return error code. 0 if no error
+   */
+  RC analyze(const std::string& table);
+
+ private:
+  std::vector<int> sample;  // reservoir sample of the keys
+  unsigned seed;            // random seed for the reservoir sampling
+
+  RC analyzeColumns(const std::string& table);
+};
+
+#endif /* TABLESTATS_H */
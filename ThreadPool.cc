@@ -0,0 +1,148 @@
+/*
+ * A work-stealing pool of worker threads.
+ */
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int threads)
+{
+  nthreads = (threads < 1) ? 1 : threads;
+  generation = 0;
+  pending = 0;
+  active = 0;
+  stopping = false;
+  task = 0;
+  arg = 0;
+
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&wake, NULL);
+  pthread_cond_init(&done, NULL);
+
+  workers = new Worker[nthreads];
+  for (int i = 0; i < nthreads; i++) {
+    workers[i].pool = this;
+    workers[i].id = i;
+    workers[i].next = workers[i].end = 0;
+    pthread_mutex_init(&workers[i].lock, NULL);
+  }
+  for (int i = 0; i < nthreads; i++) {
+    pthread_create(&workers[i].thread, NULL, workerMain, &workers[i]);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  pthread_mutex_lock(&lock);
+  stopping = true;
+  pthread_cond_broadcast(&wake);
+  pthread_mutex_unlock(&lock);
+
+  for (int i = 0; i < nthreads; i++) {
+    pthread_join(workers[i].thread, NULL);
+    pthread_mutex_destroy(&workers[i].lock);
+  }
+  delete [] workers;
+
+  pthread_cond_destroy(&done);
+  pthread_cond_destroy(&wake);
+  pthread_mutex_destroy(&lock);
+}
+
+void ThreadPool::start(int n, Task task, void* arg)
+{
+  pthread_mutex_lock(&lock);
+
+  // a worker still looking for tasks of the last job would run the new
+  // tasks with the old task and arg. deal them out once it has stopped.
+  while (active > 0) {
+    pthread_cond_wait(&done, &lock);
+  }
+  this->task = task;
+  this->arg = arg;
+  pending = n;
+
+  // deal out one contiguous range of tasks to each worker
+  for (int i = 0; i < nthreads; i++) {
+    pthread_mutex_lock(&workers[i].lock);
+    workers[i].next = (int) ((long long) n * i / nthreads);
+    workers[i].end = (int) ((long long) n * (i + 1) / nthreads);
+    pthread_mutex_unlock(&workers[i].lock);
+  }
+
+  generation++;
+  pthread_cond_broadcast(&wake);
+  pthread_mutex_unlock(&lock);
+}
+
+void ThreadPool::wait()
+{
+  pthread_mutex_lock(&lock);
+  while (pending > 0) {
+    pthread_cond_wait(&done, &lock);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+bool ThreadPool::grab(int self, int& i)
+{
+  // take the next task of our own range
+  Worker& w = workers[self];
+  pthread_mutex_lock(&w.lock);
+  if (w.next < w.end) {
+    i = w.next++;
+    pthread_mutex_unlock(&w.lock);
+    return true;
+  }
+  pthread_mutex_unlock(&w.lock);
+
+  // steal the last task of another worker
+  for (int k = 1; k < nthreads; k++) {
+    Worker& v = workers[(self + k) % nthreads];
+    pthread_mutex_lock(&v.lock);
+    if (v.next < v.end) {
+      i = --v.end;
+      pthread_mutex_unlock(&v.lock);
+      return true;
+    }
+    pthread_mutex_unlock(&v.lock);
+  }
+  return false;
+}
+
+void* ThreadPool::workerMain(void* p)
+{
+  Worker* w = (Worker*) p;
+  ThreadPool* pool = w->pool;
+  int seen = 0;
+
+  for (;;) {
+    // wait for a new job
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stopping && pool->generation == seen) {
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    if (pool->stopping) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    seen = pool->generation;
+    Task task = pool->task;
+    void* arg = pool->arg;
+    pool->active++;
+    pthread_mutex_unlock(&pool->lock);
+
+    // run tasks until there is nothing left to take or steal
+    int i;
+    while (pool->grab(w->id, i)) {
+      task(arg, i);
+
+      pthread_mutex_lock(&pool->lock);
+      if (--pool->pending == 0) pthread_cond_broadcast(&pool->done);
+      pthread_mutex_unlock(&pool->lock);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->active == 0) pthread_cond_broadcast(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
@@ -0,0 +1,84 @@
+/*
+ * A work-stealing pool of worker threads.
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <pthread.h>
+
+/**
+ * A fixed set of worker threads running the tasks 0..n-1 of a job.
+ * The tasks are split into one contiguous range per worker. A worker
+ * takes tasks from the front of its own range and, once the range is
+ * empty, steals tasks from the back of the other workers' ranges, so
+ * that uneven tasks still keep every worker busy.
+ * Only one job runs at a time.
+ */
+class ThreadPool {
+ public:
+  /**
+   * a task of a job.
+   * @param arg[IN] the argument given to start()
+   * @param i[IN] the task number between 0 and n-1
+   */
+  typedef void (*Task)(void* arg, int i);
+
+  /**
+   * start the worker threads.
+   * @param threads[IN] # worker threads
+   */
+  ThreadPool(int threads);
+
+  /**
+   * stop and join the worker threads.
+   */
+  ~ThreadPool();
+
+  /**
+   * @return # worker threads
+   */
+  int size() const { return nthreads; }
+
+  /**
+   * start running task(arg, i) for i = 0..n-1 on the workers.
+   * returns immediately; call wait() for the job to finish.
+   * @param n[IN] # tasks
+   * @param task[IN] the function to run for each task
+   * @param arg[IN] the argument passed to task
+   */
+  void start(int n, Task task, void* arg);
+
+  /**
+   * wait until every task of the current job has finished.
+   */
+  void wait();
+
+ private:
+  struct Worker {
+    ThreadPool* pool;
+    int id;
+    pthread_t thread;
+    pthread_mutex_t lock;  // protects next and end
+    int next;              // the next task of the worker's range
+    int end;               // the end of the worker's range
+  };
+
+  static void* workerMain(void* arg);
+  bool grab(int self, int& i);
+
+  int nthreads;
+  Worker* workers;
+
+  pthread_mutex_t lock;  // protects the members below
+  pthread_cond_t  wake;  // signaled when a job starts or the pool stops
+  pthread_cond_t  done;  // signaled when the last task finishes
+  int  generation;       // incremented for every job
+  int  pending;          // # tasks of the current job not finished
+  int  active;           // # workers taking tasks of the current job
+  bool stopping;
+  Task task;
+  void* arg;
+};
+
+#endif /* THREADPOOL_H */
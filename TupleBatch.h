@@ -0,0 +1,38 @@
+/*
+ * Batches of tuples passed between the operators of a SELECT.
+ */
+
+#ifndef TUPLEBATCH_H
+#define TUPLEBATCH_H
+
+#include "RecordFile.h"
+
+/**
+ * A batch of up to CAPACITY tuples stored column by column.
+ * values[i] points into a page held by the operator that produced the
+ * batch and stays valid until the next call to that operator. It is
+ * NULL when the operator does not read the table (e.g., an index-only
+ * scan). sel[0..selSize) lists the tuples that passed the filters so
+ * far; producers start with every tuple selected.
+ */
+struct TupleBatch {
+  static const int CAPACITY = 1024;
+
+  int size;                       // # tuples in the batch
+  int keys[CAPACITY];             // the key column
+  const char* values[CAPACITY];   // the value column
+  RecordId rids[CAPACITY];        // the location of each tuple
+  int selSize;                    // # selected tuples
+  int sel[CAPACITY];              // positions of the selected tuples
+
+  /**
+   * select every tuple of the batch.
+   */
+  void selectAll()
+  {
+    for (int i = 0; i < size; i++) sel[i] = i;
+    selSize = size;
+  }
+};
+
+#endif /* TUPLEBATCH_H */
@@ -0,0 +1,525 @@
+/*
+ * A B+tree index on the value column.
+ */
+
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include "ValueIndex.h"
+
+using namespace std;
+
+//
+// page 0 of the index file: the header below
+//
+// a node page:
+//   int    count      # keys in the node
+//   ushort dataStart  the offset of the lowest key in the page
+//   ushort kind       LEAF_NODE or INTERNAL_NODE
+//   PageId link       a leaf: the next leaf. -1 for the last one
+//                     an internal node: the child in front of the first key
+//   Slot   slots[count]
+//   ... free space ...
+//   the keys, from dataStart to the end of the page
+//
+// the slot of a leaf is (offset, length, rid). the slot of an internal
+// node also holds the child behind its key, which holds the keys from
+// that separator up to the next one.
+//
+typedef struct {
+  int    format;      // INDEX_FORMAT
+  PageId rootPid;     // the root node
+  int    treeHeight;  // the height of the tree. 0 if empty
+  int    entryCount;  // # entries in the tree
+} IndexHeader;
+
+struct NodeHeader {
+  int    count;
+  unsigned short dataStart;
+  unsigned short kind;
+  PageId link;
+};
+
+struct Slot {
+  unsigned short offset;  // the key in the page
+  unsigned short length;  // # bytes of the key
+  RecordId rid;           // the record of the key in a leaf; with the
+                          // key, the smallest entry behind a separator
+  PageId child;           // internal nodes only
+};
+
+// a key taken out of a node, to be put back in order with a new one
+struct Entry {
+  string   key;
+  RecordId rid;
+  PageId   child;
+};
+
+static const int INDEX_FORMAT = 0x58444956;
+static const unsigned short LEAF_NODE = 1;
+static const unsigned short INTERNAL_NODE = 2;
+static const int LEAF_SLOT_SIZE = 12;
+static const int INTERNAL_SLOT_SIZE = 16;
+
+// below and above every RecordId: separators cut to a prefix come
+// before all entries of their key, and a search for a key without a
+// RecordId finds the first or the last of its entries
+static const RecordId MIN_RID = { -1, -1 };
+static const RecordId MAX_RID = { INT_MAX, INT_MAX };
+
+// the part of a value that is indexed
+static string indexKey(const string& value)
+{
+  return (value.size() > (size_t) ValueIndex::MAX_KEY_LENGTH)
+    ? value.substr(0, ValueIndex::MAX_KEY_LENGTH) : value;
+}
+
+// compare two keys byte by byte, as strcmp() does
+static int compareValues(const char* a, int alen, const char* b, int blen)
+{
+  int c = memcmp(a, b, min(alen, blen));
+  if (c != 0) return c;
+  return (alen < blen) ? -1 : (alen > blen);
+}
+
+// compare two (key, rid) entries
+static int compareKeys(const char* a, int alen, const RecordId& arid,
+                       const char* b, int blen, const RecordId& brid)
+{
+  int c = compareValues(a, alen, b, blen);
+  if (c != 0) return c;
+  if (arid.pid != brid.pid) return (arid.pid < brid.pid) ? -1 : 1;
+  if (arid.sid != brid.sid) return (arid.sid < brid.sid) ? -1 : 1;
+  return 0;
+}
+
+static void getHeader(const char* page, NodeHeader& header)
+{
+  memcpy(&header, page, sizeof(header));
+}
+
+static int slotSize(unsigned short kind)
+{
+  return (kind == LEAF_NODE) ? LEAF_SLOT_SIZE : INTERNAL_SLOT_SIZE;
+}
+
+static void getSlot(const char* page, int i, Slot& slot)
+{
+  NodeHeader header;
+  getHeader(page, header);
+  int size = slotSize(header.kind);
+  memcpy(&slot, page + sizeof(NodeHeader) + i * size, size);
+  if (header.kind == LEAF_NODE) slot.child = -1;
+}
+
+// the first slot of a node whose entry is above (key, rid) if upper is
+// set, or not below (key, rid) otherwise
+static int search(const char* page, const string& key, const RecordId& rid, bool upper)
+{
+  NodeHeader header;
+  Slot slot;
+  int lo = 0;
+
+  getHeader(page, header);
+  int hi = header.count;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    getSlot(page, mid, slot);
+    int c = compareKeys(page + slot.offset, slot.length, slot.rid, key.data(), key.size(), rid);
+    if (c < 0 || (upper && c == 0))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// the child in front of the i-th separator of an internal node.
+// the last child for i == # keys
+static PageId childAt(const char* page, int i)
+{
+  NodeHeader header;
+  Slot slot;
+
+  getHeader(page, header);
+  if (i == 0) return header.link;
+  getSlot(page, i - 1, slot);
+  return slot.child;
+}
+
+// take the entries out of a node
+static void decode(const char* page, vector<Entry>& entries, PageId& link)
+{
+  NodeHeader header;
+  Slot slot;
+
+  getHeader(page, header);
+  link = header.link;
+  entries.resize(header.count);
+  for (int i = 0; i < header.count; i++) {
+    getSlot(page, i, slot);
+    entries[i].key.assign(page + slot.offset, slot.length);
+    entries[i].rid = slot.rid;
+    entries[i].child = slot.child;
+  }
+}
+
+// put an entry into the slot pos of a node, moving the slots behind it.
+// false if the node is full
+static bool insertSlot(char* page, int pos, const Entry& entry)
+{
+  NodeHeader header;
+  Slot slot;
+
+  getHeader(page, header);
+  int size = slotSize(header.kind);
+  int length = entry.key.size();
+  int free = header.dataStart - sizeof(NodeHeader) - header.count * size;
+  if (free < size + length) return false;
+
+  header.dataStart -= length;
+  memcpy(page + header.dataStart, entry.key.data(), length);
+
+  char* slots = page + sizeof(NodeHeader);
+  memmove(slots + (pos + 1) * size, slots + pos * size, (header.count - pos) * size);
+  slot.offset = header.dataStart;
+  slot.length = length;
+  slot.rid = entry.rid;
+  slot.child = entry.child;
+  memcpy(slots + pos * size, &slot, size);
+
+  header.count++;
+  memcpy(page, &header, sizeof(header));
+  return true;
+}
+
+// # bytes an entry takes in a node
+static int entrySize(unsigned short kind, const Entry& entry)
+{
+  return slotSize(kind) + entry.key.size();
+}
+
+// write the entries into a node. false if they do not fit
+static bool encode(char* page, unsigned short kind, PageId link, const vector<Entry>& entries)
+{
+  NodeHeader header;
+  int size = slotSize(kind);
+  int need = sizeof(NodeHeader);
+
+  for (unsigned i = 0; i < entries.size(); i++) need += entrySize(kind, entries[i]);
+  if (need > PageFile::PAGE_SIZE) return false;
+
+  memset(page, 0, PageFile::PAGE_SIZE);
+  int dataStart = PageFile::PAGE_SIZE;
+  for (unsigned i = 0; i < entries.size(); i++) {
+    Slot slot;
+    dataStart -= entries[i].key.size();
+    memcpy(page + dataStart, entries[i].key.data(), entries[i].key.size());
+    slot.offset = dataStart;
+    slot.length = entries[i].key.size();
+    slot.rid = entries[i].rid;
+    slot.child = entries[i].child;
+    memcpy(page + sizeof(NodeHeader) + i * size, &slot, size);
+  }
+
+  header.count = entries.size();
+  header.dataStart = dataStart;
+  header.kind = kind;
+  header.link = link;
+  memcpy(page, &header, sizeof(header));
+  return true;
+}
+
+// where to split a full node: the first entry of the right half of a
+// leaf, or the entry of an internal node that moves up to the parent.
+// pos is the entry just inserted. a full leaf appended to at its end
+// (e.g., while loading a table in rid order) is left full.
+static int splitPoint(unsigned short kind, const vector<Entry>& entries, int pos)
+{
+  int n = entries.size();
+  if (kind == LEAF_NODE && pos == n - 1) return n - 1;
+
+  int total = 0;
+  for (int i = 0; i < n; i++) total += entrySize(kind, entries[i]);
+
+  int m = 0;
+  for (int half = 0; m < n && half < total / 2; m++) half += entrySize(kind, entries[m]);
+  if (kind == INTERNAL_NODE) m--;
+
+  int lowest = 1;
+  int highest = (kind == LEAF_NODE) ? n - 1 : n - 2;
+  return max(lowest, min(m, highest));
+}
+
+// the separator of two neighboring leaves: the shortest prefix of the
+// first key of right that is above the last key of left. when the two
+// keys are equal, the separator also needs the RecordId of right.
+static Entry separator(const Entry& left, const Entry& right)
+{
+  Entry sep;
+  const string& a = left.key;
+  const string& b = right.key;
+
+  if (a == b) {
+    sep.key = b;
+    sep.rid = right.rid;
+    return sep;
+  }
+
+  size_t i = 0;
+  while (i < a.size() && i < b.size() && a[i] == b[i]) i++;
+  sep.key = b.substr(0, i + 1);
+  sep.rid = MIN_RID;
+  return sep;
+}
+
+ValueIndex::ValueIndex()
+  : rootPid(-1), treeHeight(0), entryCount(0), writable(false)
+{
+}
+
+RC ValueIndex::open(const string& indexname, char mode, bool compress)
+{
+  RC rc;
+  char page[PageFile::PAGE_SIZE];
+  IndexHeader header;
+
+  if ((rc = pf.open(indexname, mode, compress)) < 0) return rc;
+  writable = (mode == 'w' || mode == 'W');
+  rootPid = -1;
+  treeHeight = 0;
+  entryCount = 0;
+  if (pf.endPid() == 0) return 0;
+
+  if ((rc = pf.read(0, page)) < 0) {
+    pf.close();
+    return rc;
+  }
+  memcpy(&header, page, sizeof(header));
+  if (header.format != INDEX_FORMAT) {
+    pf.close();
+    return RC_INVALID_FILE_FORMAT;
+  }
+  rootPid = header.rootPid;
+  treeHeight = header.treeHeight;
+  entryCount = header.entryCount;
+  return 0;
+}
+
+RC ValueIndex::flush()
+{
+  char page[PageFile::PAGE_SIZE];
+  char old[PageFile::PAGE_SIZE];
+  IndexHeader header;
+
+  if (!writable) return 0;
+  header.format = INDEX_FORMAT;
+  header.rootPid = rootPid;
+  header.treeHeight = treeHeight;
+  header.entryCount = entryCount;
+  memset(page, 0, sizeof(page));
+  memcpy(page, &header, sizeof(header));
+
+  // the header is written only if it changed
+  if (pf.endPid() > 0 && pf.read(0, old) == 0 && memcmp(old, page, sizeof(page)) == 0) return 0;
+  return pf.write(0, page);
+}
+
+RC ValueIndex::close()
+{
+  RC rc = flush();
+  writable = false;
+
+  RC closed = pf.close();
+  return (rc < 0) ? rc : closed;
+}
+
+RC ValueIndex::insert(const string& value, const RecordId& rid)
+{
+  RC rc;
+  char page[PageFile::PAGE_SIZE];
+  vector<PageId> path;
+  vector<Entry> entries, right;
+  PageId link;
+  Entry entry;
+
+  entry.key = indexKey(value);
+  entry.rid = rid;
+  entry.child = -1;
+
+  // the first entry makes a root leaf behind the header page
+  if (treeHeight == 0) {
+    entries.push_back(entry);
+    encode(page, LEAF_NODE, -1, entries);
+    rootPid = 1;
+    treeHeight = 1;
+    entryCount = 1;
+    return pf.write(rootPid, page);
+  }
+
+  // descend to the leaf, remembering the path
+  PageId pid = rootPid;
+  for (int level = 1; level < treeHeight; level++) {
+    if ((rc = pf.read(pid, page)) < 0) return rc;
+    path.push_back(pid);
+    pid = childAt(page, search(page, entry.key, entry.rid, true));
+  }
+  if ((rc = pf.read(pid, page)) < 0) return rc;
+
+  int pos = search(page, entry.key, entry.rid, true);
+  entryCount++;
+  if (insertSlot(page, pos, entry)) return pf.write(pid, page);
+
+  // split the leaf. the upper half moves to a new leaf after it
+  decode(page, entries, link);
+  entries.insert(entries.begin() + pos, entry);
+  int m = splitPoint(LEAF_NODE, entries, pos);
+  right.assign(entries.begin() + m, entries.end());
+  entries.resize(m);
+
+  PageId rightPid = pf.endPid();
+  Entry sep = separator(entries.back(), right.front());
+  sep.child = rightPid;
+  encode(page, LEAF_NODE, link, right);
+  if ((rc = pf.write(rightPid, page)) < 0) return rc;
+  encode(page, LEAF_NODE, rightPid, entries);
+  if ((rc = pf.write(pid, page)) < 0) return rc;
+
+  // insert the separator into the parents, splitting the full ones
+  while (!path.empty()) {
+    PageId parentPid = path.back();
+    path.pop_back();
+    if ((rc = pf.read(parentPid, page)) < 0) return rc;
+
+    pos = search(page, sep.key, sep.rid, true);
+    if (insertSlot(page, pos, sep)) return pf.write(parentPid, page);
+
+    // the middle separator moves up; the child behind it starts the
+    // new node
+    decode(page, entries, link);
+    entries.insert(entries.begin() + pos, sep);
+    m = splitPoint(INTERNAL_NODE, entries, pos);
+    Entry middle = entries[m];
+    right.assign(entries.begin() + m + 1, entries.end());
+    entries.resize(m);
+
+    rightPid = pf.endPid();
+    encode(page, INTERNAL_NODE, middle.child, right);
+    if ((rc = pf.write(rightPid, page)) < 0) return rc;
+    encode(page, INTERNAL_NODE, link, entries);
+    if ((rc = pf.write(parentPid, page)) < 0) return rc;
+
+    sep = middle;
+    sep.child = rightPid;
+    pid = parentPid;
+  }
+
+  // the root was split. create a new root above it
+  entries.assign(1, sep);
+  encode(page, INTERNAL_NODE, pid, entries);
+  rootPid = pf.endPid();
+  treeHeight++;
+  return pf.write(rootPid, page);
+}
+
+RC ValueIndex::locate(const ValueRange& range, IndexCursor& cursor) const
+{
+  RC rc;
+  char page[PageFile::PAGE_SIZE];
+  string lo = range.hasMin ? indexKey(range.minValue) : string();
+
+  cursor.pid = -1;
+  cursor.eid = 0;
+  if (treeHeight == 0) return 0;
+
+  PageId pid = rootPid;
+  for (int level = 1; level < treeHeight; level++) {
+    if ((rc = pf.read(pid, page)) < 0) return rc;
+    pid = childAt(page, search(page, lo, MIN_RID, true));
+  }
+  if ((rc = pf.read(pid, page)) < 0) return rc;
+
+  cursor.pid = pid;
+  cursor.eid = search(page, lo, MIN_RID, false);
+  return 0;
+}
+
+RC ValueIndex::readBatch(const ValueRange& range, IndexCursor& cursor, int n, RecordId rids[],
+                         int& count) const
+{
+  RC rc;
+  char page[PageFile::PAGE_SIZE];
+  NodeHeader header;
+  Slot slot;
+
+  // a key of MAX_KEY_LENGTH bytes may be cut from a longer value, so it
+  // is read even if it equals an excluded bound
+  string lo = indexKey(range.minValue);
+  string hi = indexKey(range.maxValue);
+  bool skipMin = range.hasMin && !range.minInclusive &&
+                 range.minValue.size() < (size_t) MAX_KEY_LENGTH;
+  bool stopAtMax = range.hasMax && !range.maxInclusive &&
+                   range.maxValue.size() < (size_t) MAX_KEY_LENGTH;
+
+  count = 0;
+  while (count < n) {
+    if (cursor.pid < 0) return RC_END_OF_TREE;
+    if ((rc = pf.read(cursor.pid, page)) < 0) return rc;
+    getHeader(page, header);
+
+    for (; cursor.eid < header.count && count < n; cursor.eid++) {
+      getSlot(page, cursor.eid, slot);
+      const char* key = page + slot.offset;
+      if (range.hasMax) {
+        int c = compareValues(key, slot.length, hi.data(), hi.size());
+        if (c > 0 || (c == 0 && stopAtMax)) {
+          cursor.pid = -1;
+          return RC_END_OF_TREE;
+        }
+      }
+      if (skipMin && compareValues(key, slot.length, lo.data(), lo.size()) == 0) continue;
+      rids[count++] = slot.rid;
+    }
+    if (cursor.eid >= header.count) {
+      cursor.pid = header.link;
+      cursor.eid = 0;
+    }
+  }
+  return 0;
+}
+
+double ValueIndex::selectivity(const ValueRange& range) const
+{
+  char page[PageFile::PAGE_SIZE];
+  NodeHeader header;
+  string lo = indexKey(range.minValue);
+  string hi = indexKey(range.maxValue);
+  double fraction = 1;
+
+  if (treeHeight == 0) return 0;
+
+  PageId pid = rootPid;
+  for (int level = 1; ; level++) {
+    if (pf.read(pid, page) < 0) return fraction;
+    getHeader(page, header);
+
+    // the entries of the range in a leaf
+    if (level == treeHeight) {
+      if (header.count == 0) return 0;
+      int first = range.hasMin ? search(page, lo, MIN_RID, false) : 0;
+      int last = range.hasMax ? search(page, hi, MAX_RID, true) : header.count;
+      return fraction * max(last - first, 0) / header.count;
+    }
+
+    // the children holding the two ends of the range. once they differ,
+    // the range is taken to cover them and the children in between
+    int first = range.hasMin ? search(page, lo, MIN_RID, true) : 0;
+    int last = range.hasMax ? search(page, hi, MAX_RID, true) : header.count;
+    int children = header.count + 1;
+    if (first != last) return fraction * max(last - first + 1, 0) / children;
+
+    fraction /= children;
+    pid = childAt(page, first);
+  }
+}
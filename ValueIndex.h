@@ -0,0 +1,147 @@
+/*
+ * A B+tree index on the value column.
+ */
+
+#ifndef VALUEINDEX_H
+#define VALUEINDEX_H
+
+#include <string>
+#include "Bruinbase.h"
+#include "PageFile.h"
+#include "RecordFile.h"
+#include "BTreeIndex.h"
+
+/**
+ * A range of values to read from a ValueIndex. A side without a bound
+ * is open.
+ */
+struct ValueRange {
+  bool hasMin;            // whether the range has a lower bound
+  bool hasMax;            // whether the range has an upper bound
+  std::string minValue;   // the lower bound
+  std::string maxValue;   // the upper bound
+  bool minInclusive;      // whether minValue is in the range
+  bool maxInclusive;      // whether maxValue is in the range
+};
+
+/**
+ * A B+tree on the values of a table, mapping each value to the
+ * RecordIds of its records. The nodes hold variable-length keys: a
+ * node is a slot directory (the offset, length and RecordId of each
+ * key, and the child behind it in an internal node) followed by free
+ * space and the key bytes, stored from the end of the page. The
+ * separators of the internal nodes are cut to the shortest prefix that
+ * still tells their two children apart.
+ *
+ * The entries are ordered by (value, RecordId), so the duplicates of a
+ * value are kept in the order of their records. Only the first
+ * MAX_KEY_LENGTH bytes of a value are indexed: a lookup of a longer
+ * value returns the records sharing its prefix, which the caller checks
+ * against the full value.
+ *
+ * The index is kept in the file "table.vidx". Page 0 holds the root,
+ * the height and the # entries of the tree.
+ */
+class ValueIndex {
+ public:
+  // the longest key stored in the index. longer values are cut
+  static const int MAX_KEY_LENGTH = 120;
+
+  ValueIndex();
+
+  /**
+   * open the index file in read or write mode.
+   * under 'w' mode, the index file is created if it does not exist.
+   * @param indexname[IN] the name of the index file
+   * @param mode[IN] 'r' for read, 'w' for write
+   * @param compress[IN] whether a file created by this call stores its
+   *                     pages compressed (see PageFile)
+   * @return error code. 0 if no error. RC_INVALID_FILE_FORMAT if the
+   *         file is not a value index
+   */
+  RC open(const std::string& indexname, char mode, bool compress = false);
+
+  /**
+   * write the header of an index opened for writing if it changed.
+   * @return error code. 0 if no error
+   */
+  RC flush();
+
+  /**
+   * write the header of an index opened for writing and close the file.
+   * @return error code. 0 if no error
+   */
+  RC close();
+
+  /**
+   * insert a (value, RecordId) pair into the index.
+   * @param value[IN] the value of the record
+   * @param rid[IN] the RecordId of the record
+   * @return error code. 0 if no error
+   */
+  RC insert(const std::string& value, const RecordId& rid);
+
+  /**
+   * find the first entry of a range.
+   * @param range[IN] the values wanted
+   * @param cursor[OUT] the cursor pointing to the first entry whose key
+   *                    is not below the lower bound of range
+   * @return error code. 0 if no error
+   */
+  RC locate(const ValueRange& range, IndexCursor& cursor) const;
+
+  /**
+   * read the RecordIds of up to n entries of a range starting at the
+   * cursor, and move the cursor behind them. a value longer than
+   * MAX_KEY_LENGTH may be read although it is outside the range.
+   * @param range[IN] the values wanted
+   * @param cursor[IN/OUT] the cursor returned by locate()
+   * @param n[IN] the maximum # entries to read
+   * @param rids[OUT] the RecordIds read
+   * @param count[OUT] # entries read
+   * @return 0 if n entries were read. RC_END_OF_TREE if the end of the
+   *         range was reached. Otherwise an error code.
+   */
+  RC readBatch(const ValueRange& range, IndexCursor& cursor, int n, RecordId rids[],
+               int& count) const;
+
+  /**
+   * estimate the fraction of the entries in a range by descending the
+   * tree toward both ends of the range until they part.
+   * @param range[IN] the values wanted
+   * @return the estimated fraction of the entries in range
+   */
+  double selectivity(const ValueRange& range) const;
+
+  /**
+   * @return the height of the tree. 0 if the tree is empty
+   */
+  int getTreeHeight() const { return treeHeight; }
+
+  /**
+   * @return # entries in the index
+   */
+  int getEntryCount() const { return entryCount; }
+
+  /**
+   * @return the # of pages in the index file
+   */
+  PageId getPageCount() const { return pf.endPid(); }
+
+  /**
+   * @return the PageFile storing the tree (for its read statistics)
+   */
+  const PageFile& getPageFile() const { return pf; }
+
+ private:
+  PageFile pf;       // the PageFile storing the tree
+  PageId rootPid;    // the root node
+  int treeHeight;    // the height of the tree. 0 if empty
+  int entryCount;    // # entries in the tree
+  bool writable;     // whether the file is open for writing
+
+  ValueIndex(const ValueIndex&);
+  ValueIndex& operator=(const ValueIndex&);
+};
+
+#endif /* VALUEINDEX_H */
@@ -0,0 +1,493 @@
+/*
+ * The write-ahead log of the changes LOAD makes to the table files.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "WriteAheadLog.h"
+
+using namespace std;
+
+//
+// a log record: the header below, the name of the file and the changes
+// to the page, a PageOp each. the bytes set by an op follow it
+//
+typedef struct {
+  int      length;      // # bytes of the record, this header included
+  unsigned checksum;    // of the record, computed with this field 0
+  int      type;        // PAGE_RECORD or COMMIT_RECORD
+  int      txn;         // the transaction of the record
+  PageId   pid;         // the page changed
+  int      size;        // # bytes of the changes
+  short    nameLength;  // # bytes of the file name
+  short    compressed;  // whether the file stores its pages compressed
+} LogRecord;
+
+//
+// a change to a page: set count bytes at offset to the bytes after the
+// op, or move the count bytes at source to offset
+//
+typedef struct {
+  short offset;  // the first byte changed
+  short count;   // # bytes changed
+  short source;  // the first byte moved. SET_BYTES to set them
+} PageOp;
+
+static const int PAGE_RECORD = 1;
+static const int COMMIT_RECORD = 2;
+static const short SET_BYTES = -1;
+
+// the runs of changed bytes closer than this are logged as one
+static const int MIN_GAP = sizeof(PageOp);
+
+// the fewest changed bytes looked for as moved rather than set
+static const int MIN_MOVE = 4 * sizeof(PageOp);
+
+// the farthest a run of bytes is looked for as moved. the entries of a
+// sorted page move by the size of the one inserted or removed
+static const int MAX_SHIFT = 64;
+
+__thread WriteAheadLog::Transaction* WriteAheadLog::current = NULL;
+
+// FNV-1a of n bytes, taken 4 bytes at a time, continuing from h
+static unsigned checksum(const char* p, int n, unsigned h = 2166136261u)
+{
+  int i = 0;
+  for (unsigned w; i + 4 <= n; i += 4) {
+    memcpy(&w, p + i, sizeof(w));
+    h = (h ^ w) * 16777619u;
+  }
+  for (; i < n; i++) h = (h ^ (unsigned char) p[i]) * 16777619u;
+  return h;
+}
+
+// the checksum of a record: its header, with the checksum 0, then the
+// file name and the changes
+static unsigned checksum(const LogRecord& record, const char* name, const char* changes)
+{
+  LogRecord header = record;
+  header.checksum = 0;
+  unsigned h = checksum((const char*) &header, sizeof(header));
+  h = checksum(name, record.nameLength, h);
+  return checksum(changes, record.size, h);
+}
+
+// append an op to ops
+static void addOp(string& ops, int offset, int count, int source, const char* bytes)
+{
+  PageOp op;
+  op.offset = offset;
+  op.count = count;
+  op.source = source;
+  ops.append((const char*) &op, sizeof(op));
+  if (source == SET_BYTES) ops.append(bytes, count);
+}
+
+// log the changed bytes [first, last) as a move of the bytes of before
+// by up to MAX_SHIFT and the few bytes set next to them, as when an
+// entry is inserted into or removed from a sorted page.
+// false if the bytes did not move
+static bool addMove(string& ops, const char* before, const char* after, int first, int last)
+{
+  // a shift is checked in full only if the first 4 bytes match
+  unsigned head, tail, x;
+  int n = last - first;
+  memcpy(&head, before + first, sizeof(head));
+  memcpy(&tail, after + first, sizeof(tail));
+  for (int k = 1; k < MAX_SHIFT && k + (int) sizeof(x) <= n; k++) {
+    memcpy(&x, after + first + k, sizeof(x));
+    if (x == head && memcmp(after + first + k, before + first, n - k) == 0) {
+      addOp(ops, first + k, n - k, first, NULL);
+      addOp(ops, first, k, SET_BYTES, after + first);
+      return true;
+    }
+    memcpy(&x, before + first + k, sizeof(x));
+    if (x == tail && memcmp(after + first, before + first + k, n - k) == 0) {
+      addOp(ops, first, n - k, first + k, NULL);
+      addOp(ops, last - k, k, SET_BYTES, after + last - k);
+      return true;
+    }
+  }
+  return false;
+}
+
+// the ops that turn before into after. the whole page if before is NULL
+static void encodeChanges(const char* before, const char* after, string& ops)
+{
+  const int n = PageFile::PAGE_SIZE;
+  if (before == NULL) {
+    addOp(ops, 0, n, SET_BYTES, after);
+    return;
+  }
+
+  // the bytes that did not change are passed over a word at a time
+  unsigned long x, y;
+  const int w = sizeof(x);
+
+  // the end of the bytes that changed
+  int end = n;
+  for (; end >= w; end -= w) {
+    memcpy(&x, before + end - w, w);
+    memcpy(&y, after + end - w, w);
+    if (x != y) break;
+  }
+  while (end > 0 && before[end - 1] == after[end - 1]) end--;
+
+  int i = 0;
+  while (i < end) {
+    for (; i + w <= end; i += w) {
+      memcpy(&x, before + i, w);
+      memcpy(&y, after + i, w);
+      if (x != y) break;
+    }
+    while (before[i] == after[i]) i++;
+
+    // the rest may have moved
+    if (end - i >= MIN_MOVE && addMove(ops, before, after, i, end)) break;
+
+    // else the run ends where MIN_GAP bytes in a row did not change
+    int first = i, last = i;
+    while (i < end && i - last < MIN_GAP) {
+      if (before[i] != after[i]) last = i + 1;
+      i++;
+    }
+    addOp(ops, first, last - first, SET_BYTES, after + first);
+  }
+}
+
+// apply the changes of a record to a page. false if they are not valid
+static bool applyChanges(char* page, const char* ops, int size)
+{
+  PageOp op;
+  for (int pos = 0; pos < size; ) {
+    if (size - pos < (int) sizeof(op)) return false;
+    memcpy(&op, ops + pos, sizeof(op));
+    pos += sizeof(op);
+    if (op.offset < 0 || op.count < 0 || op.offset + op.count > PageFile::PAGE_SIZE) return false;
+    if (op.source == SET_BYTES) {
+      if (size - pos < op.count) return false;
+      memcpy(page + op.offset, ops + pos, op.count);
+      pos += op.count;
+    } else {
+      if (op.source < 0 || op.source + op.count > PageFile::PAGE_SIZE) return false;
+      memmove(page + op.offset, page + op.source, op.count);
+    }
+  }
+  return true;
+}
+
+// sync a file by its name. a file deleted since it was written has
+// nothing to sync
+static RC syncFile(const string& name)
+{
+  int fd = ::open(name.c_str(), O_RDONLY);
+  if (fd < 0) return (errno == ENOENT) ? 0 : RC_FILE_OPEN_FAILED;
+  RC rc = (::fdatasync(fd) < 0) ? RC_FILE_WRITE_FAILED : 0;
+  ::close(fd);
+  return rc;
+}
+
+WriteAheadLog& WriteAheadLog::instance()
+{
+  static WriteAheadLog log;
+  return log;
+}
+
+WriteAheadLog::WriteAheadLog()
+{
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&flushed, NULL);
+  pthread_cond_init(&idle, NULL);
+  fd = -1;
+  appended = durable = 0;
+  flushing = checkpointing = false;
+  active = 0;
+  nextId = 1;
+  epoch = 0;
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+  // a process that ends with no transaction running leaves an empty log
+  if (fd >= 0) {
+    pthread_mutex_lock(&lock);
+    if (active == 0 && appended > 0) checkpoint();
+    pthread_mutex_unlock(&lock);
+    ::close(fd);
+  }
+  pthread_cond_destroy(&idle);
+  pthread_cond_destroy(&flushed);
+  pthread_mutex_destroy(&lock);
+}
+
+RC WriteAheadLog::open(const string& filename)
+{
+  RC rc = 0;
+
+  pthread_mutex_lock(&lock);
+  if (fd < 0) {
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+      rc = RC_FILE_OPEN_FAILED;
+    } else if ((rc = recover()) < 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return rc;
+}
+
+// redo the pages of the committed transactions in the log, sync the
+// files and empty the log
+RC WriteAheadLog::recover()
+{
+  RC rc = 0;
+  struct stat statbuf;
+
+  if (::fstat(fd, &statbuf) < 0) return RC_FILE_READ_FAILED;
+  if (statbuf.st_size == 0) return 0;
+  string log(statbuf.st_size, '\0');
+  if (::pread(fd, &log[0], log.size(), 0) != (ssize_t) log.size()) return RC_FILE_READ_FAILED;
+
+  // the records up to the first one that is cut short or damaged
+  vector<int> records;
+  set<int> committed;
+  LogRecord record;
+  for (unsigned pos = 0; pos + sizeof(record) <= log.size(); pos += record.length) {
+    memcpy(&record, &log[pos], sizeof(record));
+    if (record.length < (int) sizeof(record) || record.length > (int) (log.size() - pos) ||
+        record.nameLength < 0 || record.size < 0 ||
+        (int) sizeof(record) + record.nameLength + record.size != record.length) break;
+    const char* name = &log[pos] + sizeof(record);
+    if (checksum(record, name, name + record.nameLength) != record.checksum) break;
+    if (record.type == COMMIT_RECORD) committed.insert(record.txn);
+    records.push_back(pos);
+  }
+
+  // redo the changes of the committed transactions
+  map<string, PageFile*> files;
+  char page[PageFile::PAGE_SIZE];
+  for (unsigned i = 0; i < records.size() && rc == 0; i++) {
+    memcpy(&record, &log[records[i]], sizeof(record));
+    if (record.type != PAGE_RECORD || committed.count(record.txn) == 0) continue;
+
+    const char* name = &log[records[i]] + sizeof(record);
+    const char* changes = name + record.nameLength;
+    PageFile*& pf = files[string(name, record.nameLength)];
+    if (pf == NULL) {
+      pf = new PageFile();
+      if ((rc = pf->open(string(name, record.nameLength), 'w', record.compressed != 0)) < 0) break;
+    }
+    if (pf->read(record.pid, page) < 0) memset(page, 0, sizeof(page));
+    if (!applyChanges(page, changes, record.size)) {
+      rc = RC_INVALID_FILE_FORMAT;
+      break;
+    }
+    rc = pf->write(record.pid, page);
+  }
+
+  for (map<string, PageFile*>::iterator it = files.begin(); it != files.end(); ++it) {
+    if (it->second->fd >= 0) {
+      if (rc == 0) rc = it->second->sync();
+      RC closed = it->second->close();
+      if (rc == 0) rc = closed;
+    }
+    delete it->second;
+  }
+  if (rc < 0) return rc;
+
+  // the files hold the changes now
+  if (::ftruncate(fd, 0) < 0 || ::fdatasync(fd) < 0) return RC_FILE_WRITE_FAILED;
+  return 0;
+}
+
+RC WriteAheadLog::begin()
+{
+  if (current != NULL) return 0;
+
+  pthread_mutex_lock(&lock);
+  if (fd < 0) {
+    pthread_mutex_unlock(&lock);
+    return 0;
+  }
+  while (checkpointing) pthread_cond_wait(&idle, &lock);
+  active++;
+  current = new Transaction;
+  current->id = nextId++;
+  pthread_mutex_unlock(&lock);
+  return 0;
+}
+
+// append a record to the buffer and return the end of the log after it
+off_t WriteAheadLog::appendRecord(int type, int id, const PageFile* pf, PageId pid,
+                                  const string& changes)
+{
+  LogRecord record;
+  int nameLength = (pf != NULL) ? pf->name.size() : 0;
+
+  record.length = sizeof(record) + nameLength + changes.size();
+  record.checksum = 0;
+  record.type = type;
+  record.txn = id;
+  record.pid = pid;
+  record.size = changes.size();
+  record.nameLength = nameLength;
+  record.compressed = (pf != NULL && pf->compressed);
+  const char* name = (pf != NULL) ? pf->name.data() : NULL;
+  record.checksum = checksum(record, name, changes.data());
+
+  pthread_mutex_lock(&lock);
+  buffer.append((const char*) &record, sizeof(record));
+  if (nameLength > 0) buffer.append(name, nameLength);
+  buffer += changes;
+  appended += record.length;
+  off_t lsn = appended;
+  pthread_mutex_unlock(&lock);
+  return lsn;
+}
+
+RC WriteAheadLog::append(PageFile& pf, PageId pid, const char* before, const char* after)
+{
+  if (find(current->files.begin(), current->files.end(), &pf) == current->files.end()) {
+    current->files.push_back(&pf);
+  }
+
+  string changes;
+  encodeChanges(before, after, changes);
+  if (!changes.empty()) appendRecord(PAGE_RECORD, current->id, &pf, pid, changes);
+  return 0;
+}
+
+// make the log durable up to lsn. called with the lock held. the thread
+// that flushes writes what all threads appended; the threads that come
+// while it syncs wait, and the first of them flushes for the others
+RC WriteAheadLog::flush(off_t lsn)
+{
+  while (durable < lsn) {
+    if (flushing) {
+      pthread_cond_wait(&flushed, &lock);
+      continue;
+    }
+    flushing = true;
+    string data;
+    data.swap(buffer);
+    off_t end = appended;
+    pthread_mutex_unlock(&lock);
+
+    bool ok = true;
+    for (size_t done = 0; ok && done < data.size(); ) {
+      ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+      ok = (n > 0);
+      done += (n > 0) ? n : 0;
+    }
+    ok = ok && ::fdatasync(fd) == 0;
+
+    pthread_mutex_lock(&lock);
+    flushing = false;
+    if (ok) durable = end;
+    pthread_cond_broadcast(&flushed);
+    if (!ok) return RC_FILE_WRITE_FAILED;
+  }
+  return 0;
+}
+
+RC WriteAheadLog::commit()
+{
+  RC rc;
+  Transaction* txn = current;
+  if (txn == NULL) return 0;
+  current = NULL;
+
+  off_t lsn = appendRecord(COMMIT_RECORD, txn->id, NULL, 0, string());
+  pthread_mutex_lock(&lock);
+  rc = flush(lsn);
+  pthread_mutex_unlock(&lock);
+
+  // the pages reach their files after their records reach the log. the
+  // pages of a transaction that could not commit are dropped
+  for (unsigned i = 0; i < txn->files.size(); i++) {
+    RC written = txn->files[i]->writeBack(rc < 0);
+    if (rc == 0) rc = written;
+  }
+
+  RC finished = finish(txn, true);
+  return (rc < 0) ? rc : finished;
+}
+
+RC WriteAheadLog::abort()
+{
+  Transaction* txn = current;
+  if (txn == NULL) return 0;
+  current = NULL;
+
+  for (unsigned i = 0; i < txn->files.size(); i++) {
+    txn->files[i]->writeBack(true);
+  }
+  return finish(txn, false);
+}
+
+// end a transaction whose pages were written back (or dropped), and
+// take the checkpoint that waits for it. the files of a transaction
+// that wrote its pages are synced by the next checkpoint; those of an
+// aborted one may be closed already.
+RC WriteAheadLog::finish(Transaction* txn, bool written)
+{
+  RC rc = 0;
+
+  pthread_mutex_lock(&lock);
+  for (unsigned i = 0; written && i < txn->files.size(); i++) {
+    openFiles.insert(txn->files[i]);
+    fileNames.insert(txn->files[i]->name);
+  }
+  active--;
+  if (appended >= CHECKPOINT_SIZE) checkpointing = true;
+  if (checkpointing && active == 0) rc = checkpoint();
+  pthread_mutex_unlock(&lock);
+
+  delete txn;
+  return rc;
+}
+
+// sync the files written since the last checkpoint and empty the log.
+// called with the lock held when no transaction runs, so the pages of
+// every committed record are in their files. the records still in the
+// buffer are those of aborted transactions
+RC WriteAheadLog::checkpoint()
+{
+  RC rc = 0;
+
+  for (set<PageFile*>::iterator it = openFiles.begin(); it != openFiles.end() && rc == 0; ++it) {
+    rc = (*it)->sync();
+  }
+  for (set<string>::iterator it = fileNames.begin(); it != fileNames.end() && rc == 0; ++it) {
+    rc = syncFile(*it);
+  }
+  if (rc == 0 && (::ftruncate(fd, 0) < 0 || ::fdatasync(fd) < 0)) rc = RC_FILE_WRITE_FAILED;
+  if (rc == 0) {
+    buffer.clear();
+    appended = durable = 0;
+    epoch++;
+    openFiles.clear();
+    fileNames.clear();
+  }
+
+  checkpointing = false;
+  pthread_cond_broadcast(&idle);
+  return rc;
+}
+
+RC WriteAheadLog::closeFile(PageFile& pf)
+{
+  RC rc = 0;
+
+  pthread_mutex_lock(&lock);
+  if (openFiles.erase(&pf) > 0) rc = pf.sync();
+  pthread_mutex_unlock(&lock);
+  return rc;
+}
@@ -0,0 +1,163 @@
+/*
+ * The write-ahead log of the changes LOAD makes to the table files.
+ */
+
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "PageFile.h"
+
+/**
+ * The write-ahead log of the process. LOAD changes the files of a table
+ * in transactions, one per batch of tuples. Between begin() and
+ * commit(), PageFile::write() keeps the pages written by the thread in
+ * memory and appends a record of each change to the log. commit()
+ * appends a commit record, waits until the log is on the disk up to it,
+ * and only then writes the pages to their files. A file thus never
+ * holds a change that the log could not redo, and the files of a table
+ * are redone to the end of the last batch that committed: the heap
+ * pages, the index nodes and the index headers that point to them.
+ *
+ * A record changes one page of a file, named by the file name and the
+ * page id, with operations on the page as it was before: set bytes at
+ * an offset, or move bytes within the page. Inserting an entry into a
+ * sorted page, such as a B+tree node, is logged as a move of the
+ * entries after it and the bytes of the new entry. The first time a
+ * page is written after a checkpoint its whole image is logged
+ * instead, so that redo starts from a known page even if a crash tore
+ * it.
+ *
+ * Group commit: the log is written and synced by one thread at a time,
+ * with the records that all threads appended until then. The threads
+ * that commit while it syncs wait for it, and the next of them syncs
+ * all their commit records with one fdatasync().
+ *
+ * Checkpoint: when the log grows beyond CHECKPOINT_SIZE, new
+ * transactions wait until the running ones commit. The last of them
+ * syncs the files written since the last checkpoint, the open ones
+ * first (a compressed file writes its map), and empties the log. The
+ * log is also checkpointed when the process exits.
+ *
+ * Recovery: open() redoes the changes of the transactions that
+ * committed, in the order of the log, syncs the files and empties the
+ * log. The records of a transaction whose commit record is missing are
+ * ignored: its pages never reached the files. The log ends at the first
+ * record that is cut short or whose checksum does not match.
+ */
+class WriteAheadLog {
+ public:
+  // the log is checkpointed when it grows beyond this # bytes
+  static const int CHECKPOINT_SIZE = 64 * 1024 * 1024;
+
+  /**
+   * @return the log of the process
+   */
+  static WriteAheadLog& instance();
+
+  /**
+   * open the log file, creating it if it does not exist, and redo the
+   * transactions it holds. the log is opened once by the process;
+   * opening it again does nothing. until it is opened, transactions
+   * write their pages directly.
+   * @param filename[IN] the name of the log file
+   * @return error code. 0 if no error
+   */
+  RC open(const std::string& filename);
+
+  /**
+   * start a transaction in the calling thread. waits while the log is
+   * checkpointed.
+   * @return error code. 0 if no error
+   */
+  RC begin();
+
+  /**
+   * commit the transaction of the calling thread: make its records
+   * durable, then write its pages to their files.
+   * @return error code. 0 if no error
+   */
+  RC commit();
+
+  /**
+   * abort the transaction of the calling thread: drop the pages it
+   * wrote, and those written to its files until they are closed (see
+   * PageFile). its records stay in the log without a commit record, so
+   * recovery ignores them.
+   * @return error code. 0 if no error
+   */
+  RC abort();
+
+  /**
+   * @return whether the calling thread runs a transaction
+   */
+  static bool inTransaction() { return current != NULL; }
+
+  /**
+   * @return the # checkpoints taken. a page is logged whole the first
+   *         time it is written in an epoch
+   */
+  int getEpoch() const { return epoch; }
+
+  /**
+   * log a page written by the running transaction.
+   * @param pf[IN] the file of the page
+   * @param pid[IN] the page
+   * @param before[IN] the page before the write. NULL to log the whole
+   *                   page
+   * @param after[IN] the page written
+   * @return error code. 0 if no error
+   */
+  RC append(PageFile& pf, PageId pid, const char* before, const char* after);
+
+  /**
+   * sync a file written by a transaction that is being closed, and stop
+   * tracking it.
+   * @param pf[IN] the file
+   * @return error code. 0 if no error
+   */
+  RC closeFile(PageFile& pf);
+
+ private:
+  // the pages a transaction wrote, by file
+  struct Transaction {
+    int id;
+    std::vector<PageFile*> files;
+  };
+
+  pthread_mutex_t lock;      // protects the members below
+  pthread_cond_t flushed;    // signaled when a flush ends
+  pthread_cond_t idle;       // signaled when a checkpoint ends
+  int fd;                    // the log file. -1 if not open
+  std::string buffer;        // the records appended but not written
+  off_t appended;            // the end of the records appended
+  off_t durable;             // the end of the records on the disk
+  bool flushing;             // whether a thread writes the log
+  bool checkpointing;        // whether a checkpoint waits or runs
+  int active;                // # transactions running
+  int nextId;                // the id of the next transaction
+  int epoch;                 // # checkpoints taken
+  std::set<PageFile*> openFiles;     // the open files written since
+                                     //   the last checkpoint
+  std::set<std::string> fileNames;   // the names of all of them
+
+  static __thread Transaction* current;  // the transaction of the thread
+
+  WriteAheadLog();
+  ~WriteAheadLog();
+  off_t appendRecord(int type, int id, const PageFile* pf, PageId pid,
+                     const std::string& changes);
+  RC flush(off_t lsn);
+  RC finish(Transaction* txn, bool written);
+  RC checkpoint();
+  RC recover();
+  WriteAheadLog(const WriteAheadLog&);
+  WriteAheadLog& operator=(const WriteAheadLog&);
+};
+
+#endif /* WRITEAHEADLOG_H */
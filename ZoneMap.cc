@@ -0,0 +1,136 @@
+/*
+ * The key range of each page of a table.
+ */
+
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include "ZoneMap.h"
+
+using namespace std;
+
+//
+// the zone map file:
+//   page 0: the header below
+//   page 1-: the zones of the pages in order, ZONES_PER_PAGE to a page
+//
+typedef struct {
+  int    format;     // ZONE_FORMAT
+  PageId endPid;     // the end of the table described
+  int    endSid;
+  int    zoneCount;  // # zones
+} ZoneHeader;
+
+static const int ZONE_FORMAT = 0x454e4f5a;
+static const int ZONES_PER_PAGE = PageFile::PAGE_SIZE / sizeof(ZoneMap::Zone);
+
+ZoneMap::ZoneMap()
+  : valid(true), dirty(0)
+{
+}
+
+void ZoneMap::clear()
+{
+  zones.clear();
+  valid = true;
+  dirty = 0;
+}
+
+void ZoneMap::invalidate()
+{
+  zones.clear();
+  valid = false;
+  dirty = 0;
+}
+
+void ZoneMap::add(PageId pid, int key)
+{
+  if (pid >= (PageId) zones.size()) {
+    Zone empty;
+    empty.minKey = INT_MAX;
+    empty.maxKey = INT_MIN;
+    empty.rowCount = 0;
+    zones.resize(pid + 1, empty);
+  }
+
+  Zone& zone = zones[pid];
+  if (key < zone.minKey) zone.minKey = key;
+  if (key > zone.maxKey) zone.maxKey = key;
+  zone.rowCount++;
+  if (pid < dirty) dirty = pid;
+}
+
+RC ZoneMap::load(const string& filename, PageId endPid, int endSid)
+{
+  RC rc;
+  PageFile pf;
+  char page[PageFile::PAGE_SIZE];
+  ZoneHeader header;
+
+  invalidate();
+  if ((rc = pf.open(filename, 'r')) < 0) return rc;
+
+  // the map must describe the table as it is now
+  if ((rc = pf.read(0, page)) < 0) {
+    pf.close();
+    return rc;
+  }
+  memcpy(&header, page, sizeof(header));
+  if (header.format != ZONE_FORMAT || header.endPid != endPid || header.endSid != endSid ||
+      header.zoneCount < 0 || header.zoneCount > endPid + 1) {
+    pf.close();
+    return RC_INVALID_FILE_FORMAT;
+  }
+
+  zones.resize(header.zoneCount);
+  for (int i = 0; i < header.zoneCount; i += ZONES_PER_PAGE) {
+    if ((rc = pf.read(1 + i / ZONES_PER_PAGE, page)) < 0) {
+      pf.close();
+      zones.clear();
+      return rc;
+    }
+    int n = min(header.zoneCount - i, ZONES_PER_PAGE);
+    memcpy(&zones[i], page, n * sizeof(Zone));
+  }
+  pf.close();
+
+  valid = true;
+  dirty = zones.size();
+  return 0;
+}
+
+RC ZoneMap::save(const string& filename, PageId endPid, int endSid)
+{
+  RC rc;
+  PageFile pf;
+  char page[PageFile::PAGE_SIZE];
+  ZoneHeader header;
+
+  if (!valid) return 0;
+  if ((rc = pf.open(filename, 'w')) < 0) return rc;
+
+  // rewrite the pages of the zones from the first one changed
+  int zoneCount = zones.size();
+  for (int i = dirty - dirty % ZONES_PER_PAGE; i < zoneCount; i += ZONES_PER_PAGE) {
+    int n = min(zoneCount - i, ZONES_PER_PAGE);
+    memset(page, 0, sizeof(page));
+    memcpy(page, &zones[i], n * sizeof(Zone));
+    if ((rc = pf.write(1 + i / ZONES_PER_PAGE, page)) < 0) {
+      pf.close();
+      return rc;
+    }
+  }
+
+  // the header goes last: the map is not used until it is complete
+  header.format = ZONE_FORMAT;
+  header.endPid = endPid;
+  header.endSid = endSid;
+  header.zoneCount = zoneCount;
+  memset(page, 0, sizeof(page));
+  memcpy(page, &header, sizeof(header));
+  rc = pf.write(0, page);
+  pf.close();
+
+  if (rc == 0) dirty = zoneCount;
+  return rc;
+}
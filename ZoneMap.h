@@ -0,0 +1,99 @@
+/*
+ * The key range of each page of a table.
+ */
+
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "PageFile.h"
+
+/**
+ * The smallest and the largest key and the # records of each page of a
+ * record file. A scan with key conditions skips the pages whose range
+ * cannot hold a matching key without reading them; when the keys were
+ * loaded roughly in order, most pages of a narrow range are skipped.
+ *
+ * The zone map is kept in the file "table.zone" next to the table. It
+ * records the end of the table it describes; a zone map that does not
+ * match its table is not used.
+ */
+class ZoneMap {
+ public:
+  /**
+   * the keys of one page. a page without records (e.g., an overflow
+   * page) has rowCount 0 and an empty range.
+   */
+  struct Zone {
+    int minKey;
+    int maxKey;
+    int rowCount;
+  };
+
+  ZoneMap();
+
+  /**
+   * forget all pages. the map describes an empty table.
+   */
+  void clear();
+
+  /**
+   * mark the map unknown: every page may hold any key.
+   */
+  void invalidate();
+
+  /**
+   * @return whether the map describes the pages of the table
+   */
+  bool isValid() const { return valid; }
+
+  /**
+   * add a key stored in a page.
+   * @param pid[IN] the page
+   * @param key[IN] the key of a record appended to the page
+   */
+  void add(PageId pid, int key);
+
+  /**
+   * @param pid[IN] the page
+   * @param lo[IN] the smallest key wanted (inclusive)
+   * @param hi[IN] the largest key wanted (inclusive)
+   * @return whether the page may hold a record with a key in [lo, hi].
+   *         true for a page the map does not know
+   */
+  bool mayContain(PageId pid, int lo, int hi) const
+  {
+    if (!valid || pid >= (PageId) zones.size()) return true;
+    const Zone& zone = zones[pid];
+    return zone.rowCount > 0 && zone.minKey <= hi && zone.maxKey >= lo;
+  }
+
+  /**
+   * read the zone map of a table. a map written for a different end of
+   * the table is not loaded.
+   * @param filename[IN] the name of the zone map file
+   * @param endPid[IN] the end of the table (RecordFile::endRid().pid)
+   * @param endSid[IN] the end of the table (RecordFile::endRid().sid)
+   * @return error code. 0 if no error. RC_INVALID_FILE_FORMAT if the
+   *         map does not match the table
+   */
+  RC load(const std::string& filename, PageId endPid, int endSid);
+
+  /**
+   * write the pages of the map that changed since it was loaded.
+   * @param filename[IN] the name of the zone map file
+   * @param endPid[IN] the end of the table (RecordFile::endRid().pid)
+   * @param endSid[IN] the end of the table (RecordFile::endRid().sid)
+   * @return error code. 0 if no error
+   */
+  RC save(const std::string& filename, PageId endPid, int endSid);
+
+ private:
+  std::vector<Zone> zones;  // the zone of each page
+  bool valid;               // whether the zones describe the table
+  PageId dirty;             // the first zone changed since loaded
+};
+
+#endif /* ZONEMAP_H */
@@ -0,0 +1,452 @@
+/*
+ * Tests of the Bruinbase library API.
+ *
+ *   bruinbase_test
+ *
+ * Each test runs in a new directory under /tmp. A test that would hang
+ * is stopped by an alarm, which fails the run. The write-ahead log is
+ * opened once by a process, so the tests of its recovery run in child
+ * processes before the main one opens it.
+ */
+
+#include "Bruinbase.h"
+#include "Database.h"
+#include "PageFile.h"
+#include "ValueIndex.h"
+#include "WriteAheadLog.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// # seconds a test may take
+static const int TIMEOUT = 20;
+
+// # tuples of the test table
+static const int TUPLES = 5000;
+
+static string dir;       // the directory of the test tables
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+  printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+  if (!ok) failures++;
+}
+
+// write a load file of TUPLES tuples
+static bool writeLoadFile(const string& name)
+{
+  FILE* f = fopen(name.c_str(), "w");
+  if (f == NULL) return false;
+  for (int i = 0; i < TUPLES; i++) {
+    fprintf(f, "%d,'value %d'\n", i, i);
+  }
+  return fclose(f) == 0;
+}
+
+// run one statement
+static RC run(Database& db, const string& sql)
+{
+  Statement stmt;
+  RC rc;
+
+  if ((rc = db.prepare(sql, stmt)) < 0) return rc;
+  return db.execute(stmt);
+}
+
+// open a cursor over a SELECT and read its first tuple
+static RC openCursor(Database& db, const string& sql, ResultCursor& cursor)
+{
+  Statement stmt;
+  RC rc;
+
+  if ((rc = db.prepare(sql, stmt)) < 0) return rc;
+  if ((rc = db.query(stmt, cursor)) < 0) return rc;
+  return cursor.next();
+}
+
+// # tuples of the rest of a cursor's result, the current one included
+static int countRest(ResultCursor& cursor)
+{
+  int n = 1;
+  while (cursor.next() == 0) n++;
+  return n;
+}
+
+/*
+ * a LOAD run on its own thread and database
+ */
+struct Loader {
+  string sql;
+  RC rc;
+  bool done;
+};
+
+static void* runLoader(void* arg)
+{
+  Loader& loader = *(Loader*) arg;
+  Database db;
+
+  loader.rc = db.open(dir);
+  if (loader.rc == 0) loader.rc = run(db, loader.sql);
+  loader.done = true;
+  return NULL;
+}
+
+// a thread that loads a table it still reads with an open cursor is
+// refused instead of waiting for itself
+static void testLoadWithOpenCursor(Database& db, const string& load)
+{
+  ResultCursor cursor;
+
+  check(openCursor(db, "select * from t", cursor) == 0, "cursor reads the table");
+  check(run(db, load) == RC_TABLE_IN_USE, "load of a table read by an open cursor fails");
+  check(run(db, "analyze t") == RC_TABLE_IN_USE, "analyze of a table read by an open cursor fails");
+  check(countRest(cursor) == TUPLES, "the open cursor reads the whole table");
+  cursor.close();
+  check(run(db, load) == 0, "load succeeds once the cursor is closed");
+}
+
+// a thread with an open cursor on a table can query the table again
+// while another thread waits to load it
+static void testQueryWithWaitingLoad(Database& db, const string& load)
+{
+  ResultCursor first, second;
+  Loader loader;
+  pthread_t thread;
+
+  loader.sql = load;
+  loader.rc = 0;
+  loader.done = false;
+
+  check(openCursor(db, "select * from t", first) == 0, "first cursor reads the table");
+  if (pthread_create(&thread, NULL, runLoader, &loader) != 0) {
+    check(false, "start the loading thread");
+    return;
+  }
+
+  // let the other thread wait for the lock of the table
+  sleep(1);
+  check(!loader.done, "load waits for the open cursor");
+  check(openCursor(db, "select count(*) from t", second) == 0, "second cursor opens");
+  check(second.key() == 2 * TUPLES, "second cursor counts the table");
+  second.close();
+  check(countRest(first) == 2 * TUPLES, "first cursor reads the whole table");
+  first.close();
+
+  pthread_join(thread, NULL);
+  check(loader.done && loader.rc == 0, "load runs once the cursors are closed");
+}
+
+// a load without "WITH INDEX" keeps the index of the table up to date
+static void testAppendWithoutIndex(Database& db, const string& loadFile)
+{
+  ResultCursor cursor;
+
+  check(run(db, "load k from '" + loadFile + "' with index") == 0, "load with the index");
+  check(run(db, "load k from '" + loadFile + "'") == 0, "append without the index");
+  check(openCursor(db, "select count(*) from k where key > 100", cursor) == 0 &&
+        cursor.key() == 2 * (TUPLES - 101), "key range finds the appended tuples");
+  cursor.close();
+}
+
+// a load without "INDEX ON value" keeps the value index of the table
+// up to date
+static void testAppendWithoutValueIndex(Database& db, const string& loadFile)
+{
+  ResultCursor cursor;
+  ValueIndex vi;
+
+  check(run(db, "load v from '" + loadFile + "' with index on value") == 0,
+        "load with the value index");
+  check(run(db, "load v from '" + loadFile + "' with index") == 0,
+        "append without the value index");
+  check(vi.open(dir + "/v.vidx", 'r') == 0 && vi.getEntryCount() == 2 * TUPLES,
+        "the value index has every tuple");
+  vi.close();
+
+  check(openCursor(db, "select count(*) from v where value = 'value 7'", cursor) == 0 &&
+        cursor.key() == 2, "value lookup finds the appended tuples");
+  cursor.close();
+  // 'value 10' to 'value 19', 'value 100' to 'value 199', ...
+  check(openCursor(db, "select count(*) from v where value > 'value 1' and value < 'value 2'",
+                   cursor) == 0 && cursor.key() == 2 * 1110,
+        "value range finds the appended tuples");
+  cursor.close();
+
+  check(run(db, "load c from '" + loadFile + "' with columns, index on value") < 0,
+        "a columnar table gets no value index");
+}
+
+// the size of a file. -1 if it does not exist
+static off_t fileSize(const string& name)
+{
+  struct stat statbuf;
+  return (stat(name.c_str(), &statbuf) == 0) ? statbuf.st_size : -1;
+}
+
+// fill a page with bytes that compress well, or with random bytes
+static void fillPage(char* page, PageId pid, bool random)
+{
+  unsigned seed = pid;
+  for (int i = 0; i < PageFile::PAGE_SIZE; i++) {
+    page[i] = random ? (char) rand_r(&seed) : (char) ('a' + (pid + i / 64) % 26);
+  }
+}
+
+// whether the pages [0, n) of a file hold what fillPage() wrote
+static bool pagesHold(PageFile& pf, PageId n, bool random)
+{
+  char page[PageFile::PAGE_SIZE];
+  char expected[PageFile::PAGE_SIZE];
+
+  for (PageId pid = 0; pid < n; pid++) {
+    fillPage(expected, pid, random);
+    if (pf.read(pid, page) < 0 || memcmp(page, expected, sizeof(page)) != 0) return false;
+  }
+  return true;
+}
+
+// the pages of a compressed file read back as they were written
+static void testCompressedRoundTrip(const string& name)
+{
+  PageFile pf;
+  char page[PageFile::PAGE_SIZE];
+  const PageId n = 64;
+  bool ok = true;
+
+  check(pf.open(name, 'w', true) == 0, "create a compressed file");
+  for (PageId pid = 0; pid < n; pid++) {
+    // every fourth page does not compress
+    fillPage(page, pid, pid % 4 == 0);
+    ok = ok && pf.write(pid, page) == 0;
+  }
+  check(ok && pf.close() == 0, "write the pages");
+
+  ok = (pf.open(name, 'r') == 0 && pf.endPid() == n);
+  for (PageId pid = 0; ok && pid < n; pid++) {
+    char expected[PageFile::PAGE_SIZE];
+    fillPage(expected, pid, pid % 4 == 0);
+    ok = pf.read(pid, page) == 0 && memcmp(page, expected, sizeof(page)) == 0;
+  }
+  pf.close();
+  check(ok, "the pages read back as written");
+  check(fileSize(name) < n * PageFile::PAGE_SIZE / 2, "the file is compressed");
+}
+
+// close moves the pages at the end of a compressed file into the free
+// places before them and cuts the file short
+static void testCompressedCompaction(const string& name)
+{
+  PageFile pf;
+  char page[PageFile::PAGE_SIZE];
+  const PageId n = 64;
+  bool ok;
+
+  ok = (pf.open(name, 'w', true) == 0);
+  for (PageId pid = 0; ok && pid < n; pid++) {
+    fillPage(page, pid, false);
+    ok = pf.write(pid, page) == 0;
+  }
+  ok = ok && pf.close() == 0;
+
+  // pages that grow move to the end of the file. once they shrink again
+  // their old places are free
+  ok = ok && pf.open(name, 'w') == 0;
+  for (int random = 1; random >= 0; random--) {
+    for (PageId pid = 0; ok && pid < n / 2; pid++) {
+      fillPage(page, pid, random);
+      ok = pf.write(pid, page) == 0;
+    }
+  }
+  check(ok, "rewrite the pages");
+  off_t grown = fileSize(name);
+  check(pf.close() == 0, "close the file");
+  check(fileSize(name) * 2 < grown, "close cuts the free space off");
+
+  check(pf.open(name, 'r') == 0 && pagesHold(pf, n, false), "the moved pages read back");
+  pf.close();
+}
+
+// a compressed table stays compressed and readable after appends
+static void testCompressedAppend(Database& db, const string& loadFile)
+{
+  ResultCursor cursor;
+
+  check(run(db, "load z from '" + loadFile + "' with index, compress") == 0,
+        "load a compressed table");
+  check(run(db, "load z from '" + loadFile + "'") == 0, "append to the compressed table");
+  check(openCursor(db, "select count(*) from z", cursor) == 0 && cursor.key() == 2 * TUPLES,
+        "the reopened table has every tuple");
+  cursor.close();
+  check(openCursor(db, "select * from z where key = 7", cursor) == 0 &&
+        string(cursor.value()) == "value 7" && countRest(cursor) == 2,
+        "the reopened index finds the appended tuples");
+  cursor.close();
+  // k holds the same tuples uncompressed (testAppendWithoutIndex)
+  check(fileSize(dir + "/z.tbl") < fileSize(dir + "/k.tbl") &&
+        fileSize(dir + "/z.idx") < fileSize(dir + "/k.idx"), "the files stay compressed");
+}
+
+// run a test in a child process. false if it failed
+static bool runChild(void (*test)(const string&), const string& arg)
+{
+  int status;
+
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    failures = 0;
+    test(arg);
+    exit(failures > 0);
+  }
+  return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+         WEXITSTATUS(status) == 0;
+}
+
+// whether a page of a file holds only the byte c
+static bool pageHolds(PageFile& pf, PageId pid, char c)
+{
+  char page[PageFile::PAGE_SIZE];
+
+  if (pf.read(pid, page) < 0) return false;
+  for (int i = 0; i < PageFile::PAGE_SIZE; i++) {
+    if (page[i] != c) return false;
+  }
+  return true;
+}
+
+static void* commitEmpty(void*)
+{
+  WriteAheadLog::instance().begin();
+  WriteAheadLog::instance().commit();
+  return NULL;
+}
+
+// write two transactions to the log in a directory, then crash. the
+// first one writes pages 0 and 1 of "pages" and commits. the second
+// one changes page 0 and adds page 2; unless it commits, the commit of
+// an empty transaction of another thread writes its records to the log.
+static void writeTransactions(const string& logDir, bool commitSecond)
+{
+  WriteAheadLog& log = WriteAheadLog::instance();
+  PageFile pf;
+  char page[PageFile::PAGE_SIZE];
+  pthread_t thread;
+
+  if (Database::openLog(logDir) < 0 || pf.open(logDir + "/pages", 'w') < 0) _exit(1);
+
+  log.begin();
+  memset(page, 'a', sizeof(page));
+  pf.write(0, page);
+  pf.write(1, page);
+  if (log.commit() < 0) _exit(1);
+
+  log.begin();
+  memset(page, 'b', sizeof(page));
+  pf.write(0, page);
+  pf.write(2, page);
+  if (commitSecond) {
+    if (log.commit() < 0) _exit(1);
+  } else if (pthread_create(&thread, NULL, commitEmpty, NULL) != 0 ||
+             pthread_join(thread, NULL) != 0) {
+    _exit(1);
+  }
+
+  // the exit handlers would checkpoint the log
+  _exit(0);
+}
+
+static void writeUncommitted(const string& logDir)
+{
+  writeTransactions(logDir, false);
+}
+
+static void writeCommitted(const string& logDir)
+{
+  writeTransactions(logDir, true);
+}
+
+// recover the log in a directory and check that only the first
+// transaction of writeTransactions() was redone
+static void recoverFirst(const string& logDir)
+{
+  PageFile pf;
+
+  check(Database::openLog(logDir) == 0, "recover the log");
+  check(fileSize(logDir + "/bruinbase.wal") == 0, "recovery empties the log");
+  check(pf.open(logDir + "/pages", 'r') == 0 && pf.endPid() == 2,
+        "redo ends the file after the committed pages");
+  check(pageHolds(pf, 0, 'a') && pageHolds(pf, 1, 'a'), "redo writes the committed pages");
+  pf.close();
+}
+
+// a crash after a transaction wrote records but did not commit
+static void testRecoverUncommitted(const string& logDir)
+{
+  mkdir(logDir.c_str(), 0755);
+  check(runChild(writeUncommitted, logDir), "write a committed and an uncommitted transaction");
+  check(fileSize(logDir + "/bruinbase.wal") > 0, "the log holds both transactions");
+
+  // the pages lost by the crash are redone from the log
+  check(truncate((logDir + "/pages").c_str(), 0) == 0, "lose the pages written");
+  check(runChild(recoverFirst, logDir), "recovery redoes only the committed transaction");
+}
+
+// a crash that cut the last record of the log short
+static void testRecoverTruncated(const string& logDir)
+{
+  mkdir(logDir.c_str(), 0755);
+  check(runChild(writeCommitted, logDir), "write two committed transactions");
+
+  // the last record is the commit record of the second transaction
+  string logFile = logDir + "/bruinbase.wal";
+  check(truncate(logFile.c_str(), fileSize(logFile) - 1) == 0, "cut the last record short");
+  check(truncate((logDir + "/pages").c_str(), 0) == 0, "lose the pages written");
+  check(runChild(recoverFirst, logDir), "the log ends at the record cut short");
+}
+
+int main()
+{
+  char name[] = "/tmp/bruinbase_test.XXXXXX";
+  Database db;
+
+  if (mkdtemp(name) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  dir = name;
+  string loadFile = dir + "/t.del";
+  string load = "load t from '" + loadFile + "'";
+  if (!writeLoadFile(loadFile)) {
+    perror(loadFile.c_str());
+    return 1;
+  }
+
+  alarm(TIMEOUT);
+  testRecoverUncommitted(dir + "/uncommitted");
+  testRecoverTruncated(dir + "/truncated");
+  check(Database::openLog(dir) == 0, "open the write-ahead log");
+  check(db.open(dir) == 0, "open the database");
+  check(run(db, load) == 0, "load the table");
+  testLoadWithOpenCursor(db, load);
+  testQueryWithWaitingLoad(db, load);
+  testAppendWithoutIndex(db, loadFile);
+  testAppendWithoutValueIndex(db, loadFile);
+  testCompressedRoundTrip(dir + "/roundtrip.pages");
+  testCompressedCompaction(dir + "/compaction.pages");
+  testCompressedAppend(db, loadFile);
+
+  if (system(("rm -rf " + dir).c_str()) != 0) {
+    fprintf(stderr, "could not remove %s\n", dir.c_str());
+  }
+  printf("%d failures\n", failures);
+  return failures > 0;
+}
@@ -0,0 +1,240 @@
+/*
+ * A load generator for the Bruinbase server: clients on their own
+ * threads send statements back to back and the latency of each one is
+ * reported.
+ *
+ *   bruinbase_loadgen [-s socket | -p port] [-c clients] [-n requests]
+ *                     [-k keys] [-P] statement...
+ *
+ * Each client sends n requests, taking the statements in turn. A '?' in
+ * a statement is replaced by a random key in [0, keys). With -P the
+ * statements are prepared once per client and run with EXECUTE.
+ */
+
+#include "Bruinbase.h"
+#include "Protocol.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+static const char* socketPath = "bruinbase.sock";
+static int port = 0;
+static int requests = 1000;     // # requests per client
+static int keys = 1000;         // the keys substituted for '?'
+static bool prepared = false;   // run the statements with EXECUTE
+static vector<string> statements;
+
+/*
+ * the state and the measurements of a client thread
+ */
+struct Client {
+  int id;
+  vector<double> latencies;  // seconds, one per request
+  int errors;
+  bool failed;               // whether the connection failed
+};
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int connectServer()
+{
+  int fd;
+
+  if (port > 0) {
+    struct sockaddr_in addr;
+    int one = 1;
+
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) return -1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+      close(fd);
+      return -1;
+    }
+  } else {
+    struct sockaddr_un addr;
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+// send a statement and wait for its response.
+// returns error code. 0 if the statement succeeded
+static RC request(int fd, const string& sql, string& response)
+{
+  RC rc;
+
+  if ((rc = writeFrame(fd, sql)) < 0) return rc;
+  if ((rc = readFrame(fd, response)) < 0) return rc;
+  return (!response.empty() && response[0] == STATUS_OK) ? 0 : RC_INVALID_STATEMENT;
+}
+
+// the text of request i with random keys for the placeholders
+static string makeRequest(int i, unsigned& seed)
+{
+  const string& stmt = statements[i % statements.size()];
+  string sql;
+  char buf[16];
+
+  if (prepared) {
+    sprintf(buf, "s%u", (unsigned) (i % statements.size()));
+    sql = string("execute ") + buf;
+    int params = count(stmt.begin(), stmt.end(), '?');
+    for (int p = 0; p < params; p++) {
+      sprintf(buf, "%d", (int) (rand_r(&seed) % keys));
+      sql += (p == 0) ? " using " : ", ";
+      sql += buf;
+    }
+    return sql;
+  }
+
+  for (unsigned j = 0; j < stmt.size(); j++) {
+    if (stmt[j] == '?') {
+      sprintf(buf, "%d", (int) (rand_r(&seed) % keys));
+      sql += buf;
+    } else {
+      sql += stmt[j];
+    }
+  }
+  return sql;
+}
+
+static void* runClient(void* arg)
+{
+  Client& client = *(Client*) arg;
+  unsigned seed = client.id * 7919 + 1;
+  string response;
+  int fd;
+
+  if ((fd = connectServer()) < 0) {
+    client.failed = true;
+    return NULL;
+  }
+
+  if (prepared) {
+    for (unsigned i = 0; i < statements.size(); i++) {
+      char name[16];
+      sprintf(name, "s%u", i);
+      if (request(fd, string("prepare ") + name + " as " + statements[i], response) < 0) {
+        fprintf(stderr, "Error: %s\n", response.empty() ? "no response" : response.c_str() + 1);
+        client.failed = true;
+        close(fd);
+        return NULL;
+      }
+    }
+  }
+
+  client.latencies.reserve(requests);
+  for (int i = 0; i < requests; i++) {
+    string sql = makeRequest(i, seed);
+    double start = now();
+    RC rc = request(fd, sql, response);
+    client.latencies.push_back(now() - start);
+    if (rc == RC_INVALID_STATEMENT) {
+      client.errors++;
+    } else if (rc < 0) {
+      client.failed = true;
+      break;
+    }
+  }
+
+  request(fd, "quit", response);
+  close(fd);
+  return NULL;
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: bruinbase_loadgen [-s socket | -p port] [-c clients] [-n requests]\n"
+                  "                         [-k keys] [-P] statement...\n");
+  exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+  int clients = 8;
+  int c;
+
+  while ((c = getopt(argc, argv, "s:p:c:n:k:P")) != -1) {
+    switch (c) {
+    case 's': socketPath = optarg; break;
+    case 'p': port = atoi(optarg); break;
+    case 'c': clients = atoi(optarg); break;
+    case 'n': requests = atoi(optarg); break;
+    case 'k': keys = atoi(optarg); break;
+    case 'P': prepared = true; break;
+    default:  usage();
+    }
+  }
+  for (int i = optind; i < argc; i++) {
+    statements.push_back(argv[i]);
+  }
+  if (statements.empty() || clients < 1 || requests < 1 || keys < 1) usage();
+
+  vector<Client> state(clients);
+  vector<pthread_t> tids(clients);
+  double start = now();
+  for (int i = 0; i < clients; i++) {
+    state[i].id = i;
+    state[i].errors = 0;
+    state[i].failed = false;
+    pthread_create(&tids[i], NULL, runClient, &state[i]);
+  }
+  for (int i = 0; i < clients; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  double elapsed = now() - start;
+
+  // merge the measurements of the clients
+  vector<double> all;
+  int errors = 0;
+  int failed = 0;
+  for (int i = 0; i < clients; i++) {
+    all.insert(all.end(), state[i].latencies.begin(), state[i].latencies.end());
+    errors += state[i].errors;
+    failed += state[i].failed;
+  }
+  if (all.empty()) {
+    fprintf(stderr, "Error: no request was answered\n");
+    return 1;
+  }
+  sort(all.begin(), all.end());
+
+  printf("clients %d, requests %u, errors %d, failed clients %d\n",
+         clients, (unsigned) all.size(), errors, failed);
+  printf("throughput %.1f statements/s\n", all.size() / elapsed);
+  printf("latency (ms) p50 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n",
+         all[all.size() * 50 / 100] * 1e3, all[all.size() * 99 / 100] * 1e3,
+         all[all.size() * 999 / 1000] * 1e3, all.back() * 1e3);
+  return failed > 0;
+}
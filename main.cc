@@ -8,13 +8,51 @@
  */
  
 #include "Bruinbase.h"
-#include "SqlEngine.h"
+#include "Database.h"
 #include <cstdio>
+#include <iostream>
+#include <string>
+
+// run a SELECT and report its time and # page reads
+static RC runSelect(Database& db, const Statement& stmt)
+{
+  Database::Stats before = db.getStats();
+  RC rc = db.execute(stmt);
+  const Database::Stats& after = db.getStats();
+
+  fprintf(stderr, "  -- %.3f seconds to run the select command. Read %lu pages\n",
+          after.seconds - before.seconds, after.pageReads - before.pageReads);
+  return rc;
+}
 
 int main()
 {
-  // run the SQL engine taking user commands from standard input (console).
-  SqlEngine::run(stdin);
+  Database    db;
+  Statement   stmt;
+  std::string line;
+
+  // run the SQL commands typed on standard input (console), one per line.
+  if (Database::openLog("") < 0) {
+    fprintf(stderr, "Error: cannot open or recover the write-ahead log\n");
+    return 1;
+  }
+  db.open("");
+  fprintf(stdout, "Bruinbase> ");
+  fflush(stdout);
+  while (std::getline(std::cin, line)) {
+    if (db.prepare(line, stmt) < 0) {
+      fprintf(stderr, "Error: %s\n", db.getError().c_str());
+    } else if (stmt.kind == Statement::QUIT) {
+      break;
+    } else if (stmt.kind == Statement::SELECT || stmt.kind == Statement::EXECUTE) {
+      if (runSelect(db, stmt) < 0 && !db.getError().empty())
+        fprintf(stderr, "Error: %s\n", db.getError().c_str());
+    } else if (db.execute(stmt) < 0 && !db.getError().empty()) {
+      fprintf(stderr, "Error: %s\n", db.getError().c_str());
+    }
+    fprintf(stdout, "Bruinbase> ");
+    fflush(stdout);
+  }
 
   return 0;
 }
@@ -0,0 +1,365 @@
+/*
+ * The Bruinbase server: runs the statements of many clients sent over a
+ * Unix domain socket or a local TCP port (see Protocol.h).
+ *
+ *   bruinbase_server [-s socket | -p port] [-t threads] [-d dir]
+ *
+ * A fixed pool of worker threads, one per CPU by default, serves the
+ * sessions. The sockets of the idle sessions wait in one epoll set;
+ * the worker that picks a ready session runs the statements that
+ * arrived whole and puts the session back. The sockets never block a
+ * worker: a session whose request is not all there, or whose client
+ * does not read the response yet, waits in the epoll set for the rest.
+ * The sessions share the open tables and the buffer pool.
+ */
+
+#include "Bruinbase.h"
+#include "Database.h"
+#include "Protocol.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+/*
+ * a client connection with its own prepared statements and caches
+ */
+struct Session {
+  int fd;
+  Database db;
+  string input;        // the bytes received and not yet taken as requests
+  string output;       // the responses not yet sent
+  size_t sent;         // # bytes of output sent
+  bool eof;            // whether the client closed its side
+  bool ending;         // whether the session ends once output is sent
+};
+
+// # bytes read from a socket at a time
+static const int READ_SIZE = 64 * 1024;
+
+static int epfd;         // the epoll set of the listener and the idle sessions
+static int listenFd;
+static string dataDir;   // the directory of the tables
+
+// wait for the next event of fd: readable, or writable with EPOLLOUT.
+// each event goes to one worker.
+static void arm(int fd, void* ptr, int op, unsigned events = EPOLLIN)
+{
+  struct epoll_event ev;
+  ev.events = events | EPOLLONESHOT;
+  ev.data.ptr = ptr;
+  if (epoll_ctl(epfd, op, fd, &ev) < 0) {
+    perror("epoll_ctl");
+  }
+}
+
+static void closeSession(Session* session)
+{
+  epoll_ctl(epfd, EPOLL_CTL_DEL, session->fd, NULL);
+  close(session->fd);
+  delete session;
+}
+
+// accept the pending connections
+static void acceptSessions()
+{
+  int fd;
+
+  while ((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    Session* session = new Session;
+    session->fd = fd;
+    session->sent = 0;
+    session->eof = false;
+    session->ending = false;
+    if (session->db.open(dataDir) < 0) {
+      close(fd);
+      delete session;
+      continue;
+    }
+    arm(fd, session, EPOLL_CTL_ADD);
+  }
+  if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+    perror("accept");
+  }
+  arm(listenFd, NULL, EPOLL_CTL_MOD);
+}
+
+// run one statement of a session and build its response.
+// returns false if the session ends.
+static bool runStatement(Session& session, const string& sql, string& response)
+{
+  Statement stmt;
+  char*  data = NULL;
+  size_t size = 0;
+  RC     rc;
+
+  response.clear();
+  if (session.db.prepare(sql, stmt) < 0) {
+    response += STATUS_ERROR;
+    response += session.db.getError();
+    return true;
+  }
+  if (stmt.kind == Statement::QUIT) {
+    response += STATUS_OK;
+    return false;
+  }
+
+  // collect the output of the statement in memory
+  FILE* out = open_memstream(&data, &size);
+  if (out == NULL) {
+    response += STATUS_ERROR;
+    response += strerror(errno);
+    return true;
+  }
+  rc = session.db.execute(stmt, out);
+  fclose(out);
+
+  if (rc < 0) {
+    char buf[32];
+    sprintf(buf, "error code %d", rc);
+    response += STATUS_ERROR;
+    response += session.db.getError().empty() ? buf : session.db.getError();
+  } else {
+    response.reserve(size + 1);
+    response += STATUS_OK;
+    response.append(data, size);
+  }
+  free(data);
+  return true;
+}
+
+// read the bytes that arrived on the socket of a session, until it
+// would block or the client closes its side
+static RC readInput(Session& session)
+{
+  char buf[READ_SIZE];
+
+  for (;;) {
+    ssize_t n = ::read(session.fd, buf, sizeof(buf));
+    if (n > 0) {
+      session.input.append(buf, n);
+    } else if (n == 0) {
+      session.eof = true;
+      return 0;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return 0;
+    } else if (errno != EINTR) {
+      return RC_FILE_READ_FAILED;
+    }
+  }
+}
+
+// send the responses of a session until the socket would block
+static RC writeOutput(Session& session)
+{
+  while (session.sent < session.output.size()) {
+    ssize_t n = ::write(session.fd, session.output.data() + session.sent,
+                        session.output.size() - session.sent);
+    if (n >= 0) {
+      session.sent += n;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return 0;
+    } else if (errno != EINTR) {
+      return RC_FILE_WRITE_FAILED;
+    }
+  }
+  session.output.clear();
+  session.sent = 0;
+  return 0;
+}
+
+// serve a ready session: send what is left of its responses, then run
+// its requests that arrived whole. the session goes back to the epoll
+// set to wait for what it cannot do without blocking
+static void serveSession(Session* session)
+{
+  string request;
+  string response;
+  bool received = false;  // whether the socket was read by this call
+  RC rc;
+
+  for (;;) {
+    if ((rc = writeOutput(*session)) < 0) break;
+    if (!session->output.empty()) {
+      arm(session->fd, session, EPOLL_CTL_MOD, EPOLLOUT);
+      return;
+    }
+    if (session->ending) break;
+
+    if ((rc = takeFrame(session->input, request)) == 0) {
+      session->ending = !runStatement(*session, request, response);
+      appendFrame(session->output, response);
+      continue;
+    }
+    if (rc != RC_END_OF_SCAN) {
+      fprintf(stderr, "Error: bad request frame\n");
+      break;
+    }
+
+    // the next request is not all there
+    if (session->eof) break;
+    if (received) {
+      arm(session->fd, session, EPOLL_CTL_MOD);
+      return;
+    }
+    if ((rc = readInput(*session)) < 0) break;
+    received = true;
+  }
+  closeSession(session);
+}
+
+// a worker thread: serve whatever is ready
+static void* worker(void* arg)
+{
+  long cpu = (long) arg;
+
+  // one worker per core
+  if (cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+  for (;;) {
+    struct epoll_event ev;
+    int n = epoll_wait(epfd, &ev, 1, -1);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("epoll_wait");
+      break;
+    }
+    if (n == 0) continue;
+
+    if (ev.data.ptr == NULL)
+      acceptSessions();
+    else
+      serveSession((Session*) ev.data.ptr);
+  }
+  return NULL;
+}
+
+// listen on a Unix domain socket, or on a local TCP port if port > 0
+static int listenOn(const char* path, int port)
+{
+  int fd;
+
+  if (port > 0) {
+    struct sockaddr_in addr;
+    int one = 1;
+
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) return -1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+      close(fd);
+      return -1;
+    }
+  } else {
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+      close(fd);
+      return -1;
+    }
+  }
+
+  if (listen(fd, SOMAXCONN) < 0 || fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: bruinbase_server [-s socket | -p port] [-t threads] [-d dir]\n");
+  exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+  const char* path = "bruinbase.sock";
+  int  port = 0;
+  int  cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int  threads = 0;
+  int  c;
+
+  while ((c = getopt(argc, argv, "s:p:t:d:")) != -1) {
+    switch (c) {
+    case 's': path = optarg; break;
+    case 'p': port = atoi(optarg); break;
+    case 't': threads = atoi(optarg); break;
+    case 'd': dataDir = optarg; break;
+    default:  usage();
+    }
+  }
+  if (optind < argc) usage();
+  if (cpus < 1) cpus = 1;
+
+  // a client that goes away must not stop the server
+  signal(SIGPIPE, SIG_IGN);
+
+  // redo the LOADs cut short by a crash before any session reads a table
+  RC rc;
+  if ((rc = Database::openLog(dataDir)) < 0) {
+    fprintf(stderr, "cannot open or recover the write-ahead log in %s: error code %d\n",
+            dataDir.empty() ? "." : dataDir.c_str(), rc);
+    return 1;
+  }
+
+  if ((listenFd = listenOn(path, port)) < 0) {
+    perror("listen");
+    return 1;
+  }
+  if ((epfd = epoll_create1(0)) < 0) {
+    perror("epoll_create1");
+    return 1;
+  }
+  arm(listenFd, NULL, EPOLL_CTL_ADD);
+
+  if (port > 0)
+    fprintf(stderr, "Bruinbase server on 127.0.0.1:%d\n", port);
+  else
+    fprintf(stderr, "Bruinbase server on %s\n", path);
+
+  // pin the workers to the cores unless there are more of them
+  bool pin = (threads == 0 || threads <= cpus);
+  if (threads <= 0) threads = cpus;
+
+  vector<pthread_t> tids(threads);
+  for (int i = 1; i < threads; i++) {
+    pthread_create(&tids[i], NULL, worker, (void*) (long) (pin ? i : -1));
+  }
+  worker((void*) (long) (pin ? 0 : -1));
+  return 0;
+}